@@ -17,8 +17,14 @@ LOCAL_SRC_FILES := \
     src/NfcIpcSocket.cpp \
     src/IpcSocketListener.cpp \
     src/NfcUtil.cpp \
+    src/NfcLog.cpp \
     src/MessageHandler.cpp \
-    src/SessionId.cpp \
+    src/SessionManager.cpp \
+    src/TapLatency.cpp \
+    src/TapBenchmark.cpp \
+    src/StartupTiming.cpp \
+    src/TraceRing.cpp \
+    src/ProvisioningJob.cpp \
     src/P2pLinkManager.cpp \
     src/snep/SnepServer.cpp \
     src/snep/SnepClient.cpp \
@@ -37,11 +43,20 @@ BROADCOM_SRC_FILES := \
     src/broadcom/NfcTagManager.cpp \
     src/broadcom/Mutex.cpp \
     src/broadcom/CondVar.cpp \
+    src/broadcom/SyncEvent.cpp \
     src/broadcom/PowerSwitch.cpp \
     src/broadcom/NfcTag.cpp \
     src/broadcom/PeerToPeer.cpp \
     src/broadcom/Pn544Interop.cpp \
-    src/broadcom/IntervalTimer.cpp
+    src/broadcom/IntervalTimer.cpp \
+    src/broadcom/TimerService.cpp \
+    src/broadcom/NfaEventTrace.cpp \
+    src/broadcom/TagProbePlanner.cpp \
+    src/broadcom/TagInfoCache.cpp \
+    src/broadcom/T2tReader.cpp \
+    src/broadcom/T2tNdefWriter.cpp \
+    src/broadcom/NdefBufferPool.cpp \
+    src/broadcom/DiscoveryScheduler.cpp
 
 INTERFACE_SRC_FILES := \
     src/interface/DeviceHost.cpp \
@@ -89,8 +104,7 @@ LOCAL_SHARED_LIBRARIES += \
     libutils \
     liblog \
     libstlport \
-    libcrypto \
-    libbinder
+    libcrypto
 
 ifeq ($(NFC_VENDOR),BROADCOM)
 LOCAL_SHARED_LIBRARIES += \
@@ -100,8 +114,42 @@ endif
 LOCAL_MODULE := nfcd
 LOCAL_MODULE_TAGS := optional
 
-LOCAL_CFLAGS := -DDEBUG -DPLATFORM_ANDROID -DSTDC_HEADERS=1 -DHAVE_SYS_TYPES_H=1 -DHAVE_SYS_STAT_H=1 -DHAVE_STDLIB_H=1 -DHAVE_STRING_H=1 -DHAVE_MEMORY_H=1 -DHAVE_STRINGS_H=1 -DHAVE_INTTYPES_H=1 -DHAVE_STDINT_H=1 -DHAVE_UNISTD_H=1 -DHAVE_DLFCN_H=1 -DSILENT=1 -DNO_SIGNALS=1 -DNO_EXECUTE_PERMISSION=1 -D_GNU_SOURCE -D_REENTRANT -DUSE_MMAP -DUSE_MUNMAP -D_FILE_OFFSET_BITS=64 -DNO_UNALIGNED_ACCESS
+LOCAL_CFLAGS := -DPLATFORM_ANDROID -DSTDC_HEADERS=1 -DHAVE_SYS_TYPES_H=1 -DHAVE_SYS_STAT_H=1 -DHAVE_STDLIB_H=1 -DHAVE_STRING_H=1 -DHAVE_MEMORY_H=1 -DHAVE_STRINGS_H=1 -DHAVE_INTTYPES_H=1 -DHAVE_STDINT_H=1 -DHAVE_UNISTD_H=1 -DHAVE_DLFCN_H=1 -DSILENT=1 -DNO_SIGNALS=1 -DNO_EXECUTE_PERMISSION=1 -D_GNU_SOURCE -D_REENTRANT -DUSE_MMAP -DUSE_MUNMAP -D_FILE_OFFSET_BITS=64 -DNO_UNALIGNED_ACCESS
+
+# DEBUG keeps verbose and debug messages in the binary (see NfcLog.h);
+# user builds compile them out.
+ifneq ($(TARGET_BUILD_VARIANT),user)
+LOCAL_CFLAGS += -DDEBUG
+endif
 
 include $(BUILD_EXECUTABLE)
 
+# Host test of the Type 2 tag reader and writer against an in-memory tag;
+# run nfcd_t2t_test, it exits with the number of failed checks.
+ifeq ($(NFC_VENDOR),BROADCOM)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    tests/T2tReaderTest.cpp \
+    src/broadcom/T2tReader.cpp \
+    src/broadcom/T2tNdefWriter.cpp \
+    src/NfcLog.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/src \
+    $(LOCAL_PATH)/src/broadcom \
+    $(LOCAL_PATH)/src/interface
+
+LOCAL_STATIC_LIBRARIES += \
+    libcutils \
+    liblog
+
+LOCAL_MODULE := nfcd_t2t_test
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -DDEBUG
+
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
 #endif #} TARGET_PROVIDES_NFCD
@@ -8,133 +8,254 @@
 #include "NfcUtil.h"
 #include "NdefMessage.h"
 #include "NdefRecord.h"
-#include "SessionId.h"
+#include "SessionManager.h"
+#include "ProvisioningJob.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
+#include "StartupTiming.h"
+#include "TraceRing.h"
 
 #define MAJOR_VERSION (1)
-#define MINOR_VERSION (7)
+#define MINOR_VERSION (8)
+
+#define REQUEST_SCHEMA_ENTRY(type, handler, numFields, tail, response) \
+  { type, numFields, tail, response, &MessageHandler::handler },
+#define OUTGOING_SCHEMA_ENTRY(type, encoder, bodySize) \
+  { type, &MessageHandler::encoder, bodySize },
+
+const MessageHandler::RequestSchema MessageHandler::sRequestSchemas[] = {
+  NFC_REQUEST_SCHEMA(REQUEST_SCHEMA_ENTRY)
+};
+
+const MessageHandler::OutgoingSchema MessageHandler::sResponseSchemas[] = {
+  NFC_RESPONSE_SCHEMA(OUTGOING_SCHEMA_ENTRY)
+};
+
+const MessageHandler::OutgoingSchema MessageHandler::sNotificationSchemas[] = {
+  NFC_NOTIFICATION_SCHEMA(OUTGOING_SCHEMA_ENTRY)
+};
+
+// The tables are indexed by type, so each schema list must be complete and
+// in type order. Checked at compile time from the same lists.
+#define CHECK_REQUEST_INDEX(type, handler, numFields, tail, response) \
+  REQUEST_INDEX_##type,
+#define CHECK_OUTGOING_INDEX(type, encoder, bodySize) \
+  OUTGOING_INDEX_##type,
+enum { NFC_REQUEST_SCHEMA(CHECK_REQUEST_INDEX) REQUEST_SCHEMA_COUNT };
+enum { NFC_RESPONSE_SCHEMA(CHECK_OUTGOING_INDEX) RESPONSE_SCHEMA_COUNT };
+enum { NFC_NOTIFICATION_SCHEMA(CHECK_OUTGOING_INDEX) NOTIFICATION_SCHEMA_COUNT };
+
+#define ASSERT_REQUEST_INDEX(type, handler, numFields, tail, response) \
+  typedef char type##_in_order[((int) REQUEST_INDEX_##type == (int) type && \
+                                numFields <= WireRequest::MAX_FIELDS) ? 1 : -1];
+#define ASSERT_RESPONSE_INDEX(type, encoder, bodySize) \
+  typedef char type##_in_order[((int) OUTGOING_INDEX_##type == type - NFC_RESPONSE_GENERAL) ? 1 : -1];
+#define ASSERT_NOTIFICATION_INDEX(type, encoder, bodySize) \
+  typedef char type##_in_order[((int) OUTGOING_INDEX_##type == type - NFC_NOTIFICATION_INITIALIZED) ? 1 : -1];
+NFC_REQUEST_SCHEMA(ASSERT_REQUEST_INDEX)
+NFC_RESPONSE_SCHEMA(ASSERT_RESPONSE_INDEX)
+NFC_NOTIFICATION_SCHEMA(ASSERT_NOTIFICATION_INDEX)
+
+MessageHandler::MessageHandler(NfcService* service)
+ : mSocket(NULL)
+ , mService(service)
+{
+  pthread_mutex_init(&mOutgoingMutex, NULL);
+}
+
+MessageHandler::~MessageHandler()
+{
+  pthread_mutex_destroy(&mOutgoingMutex);
+}
 
-using android::Parcel;
 
-void MessageHandler::notifyInitialized(Parcel& parcel)
+bool MessageHandler::validateNdefMsg(const WireReader& reader)
 {
-  parcel.writeInt32(0); // status
-  parcel.writeInt32(MAJOR_VERSION);
-  parcel.writeInt32(MINOR_VERSION);
-  sendResponse(parcel);
+  WireReader check = reader;
+  uint32_t numRecords;
+  check.readUint32(numRecords);
+  for (uint32_t i = 0; i < numRecords && check.ok(); i++) {
+    int32_t tnf;
+    uint32_t len;
+    const uint8_t* bytes;
+    check.readInt32(tnf);
+    check.readUint32(len);  // type
+    check.readInplace(len, bytes);
+    check.readUint32(len);  // id
+    check.readInplace(len, bytes);
+    check.readUint32(len);  // payload
+    check.readInplace(len, bytes);
+  }
+  return check.ok();
 }
 
-void MessageHandler::notifyTechDiscovered(Parcel& parcel, void* data)
+bool MessageHandler::validateTransceiveCommands(const WireReader& reader)
 {
-  TechDiscoveredEvent *event = reinterpret_cast<TechDiscoveredEvent*>(data);
+  WireReader check = reader;
+  uint32_t numCommands;
+  check.readUint32(numCommands);
+  for (uint32_t i = 0; i < numCommands && check.ok(); i++) {
+    int32_t timeoutMs;
+    uint32_t len;
+    const uint8_t* bytes;
+    check.readInt32(timeoutMs);
+    check.readUint32(len);
+    check.readInplace(len, bytes);
+  }
+  return check.ok();
+}
 
-  if (event->isNewSession) {
-    parcel.writeInt32(SessionId::generateNewId());
-  } else {
-    parcel.writeInt32(SessionId::getCurrentId());
+size_t MessageHandler::ndefWireSize(NdefMessage* ndef)
+{
+  if (!ndef)
+    return 0;
+
+  size_t size = WireInt32::SIZE;  // numRecords
+  for (uint32_t i = 0; i < ndef->mRecords.size(); i++) {
+    NdefRecord& record = ndef->mRecords[i];
+    size += 4 * WireInt32::SIZE +  // tnf, typeLength, idLength, payloadLength
+            WIRE_ALIGN(record.mType.size()) +
+            WIRE_ALIGN(record.mId.size()) +
+            WIRE_ALIGN(record.mPayload.size());
   }
-  parcel.writeInt32(event->techCount);
-  void* dest = parcel.writeInplace(event->techCount);
-  memcpy(dest, event->techList, event->techCount);
-  parcel.writeInt32(event->ndefMsgCount);
-  sendNdefMsg(parcel, event->ndefMsg);
-  sendResponse(parcel);
+  return size;
 }
 
-void MessageHandler::notifyTechLost(Parcel& parcel)
+size_t MessageHandler::readNdefResponseSize(void* data)
 {
-  parcel.writeInt32(SessionId::getCurrentId());
-  sendResponse(parcel);
+  return WireSessionIdBody::SIZE + ndefWireSize(reinterpret_cast<NdefMessage*>(data));
+}
+
+size_t MessageHandler::transceiveResponseSize(void* data)
+{
+  TransceiveBatch* batch = reinterpret_cast<TransceiveBatch*>(data);
+  size_t size = 2 * WireInt32::SIZE;  // sessionId, numResults
+  if (!batch)
+    return size;
+
+  for (uint32_t i = 0; i < batch->results.size(); i++) {
+    // status, elapsedUs, length, response
+    size += 3 * WireInt32::SIZE + WIRE_ALIGN(batch->results[i].response.size());
+  }
+  return size;
+}
+
+size_t MessageHandler::provisionedSize(void* data)
+{
+  ProvisionResult* result = reinterpret_cast<ProvisionResult*>(data);
+  // status, serial, elapsedUs, uidLength, uid
+  return 4 * WireInt32::SIZE + WIRE_ALIGN(result->uid.size());
+}
+
+size_t MessageHandler::techDiscoveredSize(void* data)
+{
+  TechDiscoveredEvent *event = reinterpret_cast<TechDiscoveredEvent*>(data);
+  // sessionId, techCount, techList, ndefMsgCount, NDEF message.
+  return 3 * WireInt32::SIZE + WIRE_ALIGN(event->techCount) + ndefWireSize(event->ndefMsg);
+}
+
+uint8_t* MessageHandler::getOutgoingBuffer(size_t size)
+{
+  // Grows to the largest message sent so far and is then reused.
+  if (mOutgoingBuffer.size() < size)
+    mOutgoingBuffer.resize(size);
+  return &mOutgoingBuffer.front();
 }
 
 void MessageHandler::processRequest(const uint8_t* data, size_t dataLen)
 {
-  Parcel parcel;
-  int32_t sizeLe, size, request;
-  uint32_t status;
+  WireReader reader(data, dataLen);
+  int32_t type;
+
+  NFC_LOGD(IPC, "%s enter data=%p, dataLen=%d", FUNC, data, dataLen);
+  // Every request is answered, so that no client waits forever.
+  if (!reader.readInt32(type)) {
+    NFC_LOGE(IPC, "Invalid request block");
+    processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_INVALID_PARAMETER, 0, NULL);
+    return;
+  }
+
+  NFCD_TRACE_SCOPE_ARG(TRACE_IPC_REQUEST, type);
 
-  ALOGD("%s enter data=%p, dataLen=%d", FUNC, data, dataLen);
-  parcel.setData((uint8_t*)data, dataLen);
-  status = parcel.readInt32(&request);
-  if (status != 0) {
-    ALOGE("Invalid request block");
+  if ((uint32_t) type >= REQUEST_SCHEMA_COUNT) {
+    NFC_LOGE(IPC, "Unhandled Request %d", type);
+    processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_INVALID_PARAMETER, 0, NULL);
     return;
   }
 
-  switch (request) {
-    case NFC_REQUEST_CONFIG:
-      handleConfigRequest(parcel);
-      break;
-    case NFC_REQUEST_GET_DETAILS:
-      handleReadNdefDetailRequest(parcel);
-      break;
-    case NFC_REQUEST_READ_NDEF:
-      handleReadNdefRequest(parcel);
-      break;
-    case NFC_REQUEST_WRITE_NDEF:
-      handleWriteNdefRequest(parcel);
-      break;
-    case NFC_REQUEST_CONNECT:
-      handleConnectRequest(parcel);
-      break;
-    case NFC_REQUEST_CLOSE:
-      handleCloseRequest(parcel);
-      break;
-    case NFC_REQUEST_MAKE_NDEF_READ_ONLY:
-      handleMakeNdefReadonlyRequest(parcel);
-      break;
-    default:
-      ALOGE("Unhandled Request %d", request);
-      break;
+  const RequestSchema& schema = sRequestSchemas[type];
+  WireRequest request;
+  request.response = schema.response;
+  if (!decodeRequest(schema, reader, request)) {
+    NFC_LOGE(IPC, "Malformed request %d (%d bytes)", type, dataLen);
+    processResponse(schema.response, NFC_ERROR_INVALID_PARAMETER, 0, NULL);
+    return;
   }
+  (this->*schema.handle)(request);
 }
 
-void MessageHandler::processResponse(NfcResponseType response, NfcErrorCode error, void* data)
+bool MessageHandler::decodeRequest(const RequestSchema& schema, WireReader& reader, WireRequest& request)
 {
-  ALOGD("%s enter response=%d", FUNC, response);
-  Parcel parcel;
-  parcel.writeInt32(response);
-  parcel.writeInt32(error);
+  for (uint32_t i = 0; i < schema.numFields; i++) {
+    if (!reader.readInt32(request.fields[i]))
+      return false;
+  }
 
-  switch (response) {
-    case NFC_RESPONSE_CONFIG:
-      handleConfigResponse(parcel, data);
-      break;
-    case NFC_RESPONSE_READ_NDEF_DETAILS:
-      handleReadNdefDetailResponse(parcel, data);
+  switch (schema.tail) {
+    case WIRE_TAIL_NDEF:
+      if (!validateNdefMsg(reader))
+        return false;
       break;
-    case NFC_RESPONSE_READ_NDEF:
-      handleReadNdefResponse(parcel, data);
+    case WIRE_TAIL_TRANSCEIVE:
+      if (!validateTransceiveCommands(reader))
+        return false;
       break;
-    case NFC_RESPONSE_GENERAL:
-      handleResponse(parcel);
-      break;
-    default:
-      ALOGE("Not implement");
+    case WIRE_TAIL_NONE:
       break;
   }
+  request.tail = reader;
+  return true;
 }
 
-void MessageHandler::processNotification(NfcNotificationType notification, void* data)
+void MessageHandler::processResponse(NfcResponseType response, NfcErrorCode error, int sessionId, void* data)
 {
-  ALOGD("processNotificaton notification=%d", notification);
-  Parcel parcel;
-  parcel.writeInt32(notification);
+  NFC_LOGD(IPC, "%s enter response=%d", FUNC, response);
 
-  switch (notification) {
-    case NFC_NOTIFICATION_INITIALIZED :
-      notifyInitialized(parcel);
-      break;
-    case NFC_NOTIFICATION_TECH_DISCOVERED:
-      notifyTechDiscovered(parcel, data);
-      break;
-    case NFC_NOTIFICATION_TECH_LOST:
-      notifyTechLost(parcel);
-      break;
-    default:
-      ALOGE("Not implement");
-      break;
+  uint32_t index = response - NFC_RESPONSE_GENERAL;
+  if (index >= RESPONSE_SCHEMA_COUNT) {
+    NFC_LOGE(IPC, "Not implement");
+    return;
+  }
+  sendMessage(sResponseSchemas[index], true, error, sessionId, data);
+}
+
+void MessageHandler::processNotification(NfcNotificationType notification, int sessionId, void* data)
+{
+  NFC_LOGD(IPC, "processNotificaton notification=%d", notification);
+
+  uint32_t index = notification - NFC_NOTIFICATION_INITIALIZED;
+  if (index >= NOTIFICATION_SCHEMA_COUNT) {
+    NFC_LOGE(IPC, "Not implement");
+    return;
+  }
+  sendMessage(sNotificationSchemas[index], false, NFC_ERROR_SUCCESS, sessionId, data);
+}
+
+void MessageHandler::sendMessage(const OutgoingSchema& schema, bool hasError, NfcErrorCode error,
+                                 int sessionId, void* data)
+{
+  size_t size = WireWriter::PREFIX_SIZE + WireInt32::SIZE +
+                (hasError ? WireInt32::SIZE : 0) + schema.bodySize(data);
+
+  pthread_mutex_lock(&mOutgoingMutex);
+  WireWriter writer(getOutgoingBuffer(size), size);
+  writer.writeInt32(schema.type);
+  if (hasError) {
+    writer.writeInt32(error);
   }
+  (this->*schema.encode)(writer, sessionId, data);
+  sendResponse(writer);
+  pthread_mutex_unlock(&mOutgoingMutex);
 }
 
 void MessageHandler::setOutgoingSocket(NfcIpcSocket* socket)
@@ -142,14 +263,64 @@ void MessageHandler::setOutgoingSocket(NfcIpcSocket* socket)
   mSocket = socket;
 }
 
-void MessageHandler::sendResponse(Parcel& parcel)
+void MessageHandler::sendResponse(WireWriter& writer)
+{
+  const uint8_t* frame = writer.frame();
+  if (!frame) {
+    NFC_LOGE(IPC, "%s: message does not fit its buffer", FUNC);
+    return;
+  }
+  mSocket->writeToOutgoingQueue(frame, writer.frameSize());
+}
+
+void MessageHandler::encodeInitialized(WireWriter& writer, int sessionId, void* data)
+{
+  writer.writeInt32(0); // status
+  writer.writeInt32(MAJOR_VERSION);
+  writer.writeInt32(MINOR_VERSION);
+  encodeStartupTiming(writer, sessionId, data);
+}
+
+void MessageHandler::encodeStartupTiming(WireWriter& writer, int sessionId, void* data)
 {
-  mSocket->writeToOutgoingQueue(const_cast<uint8_t*>(parcel.data()), parcel.dataSize());
+  StartupTiming* timing = StartupTiming::Instance();
+  for (int i = 0; i < StartupTiming::PHASE_COUNT; i++) {
+    writer.writeInt32(timing->getMs(static_cast<StartupTiming::Phase>(i)));
+  }
 }
 
-bool MessageHandler::handleConfigRequest(Parcel& parcel)
+void MessageHandler::encodeTechDiscovered(WireWriter& writer, int sessionId, void* data)
 {
-  int hardwareState = parcel.readInt32();
+  TechDiscoveredEvent *event = reinterpret_cast<TechDiscoveredEvent*>(data);
+
+  writer.writeInt32(sessionId);
+  writer.writeInt32(event->techCount);
+  writer.writeBytes(event->techList, event->techCount);
+  writer.writeInt32(event->ndefMsgCount);
+  sendNdefMsg(writer, event->ndefMsg);
+}
+
+void MessageHandler::encodeTechLost(WireWriter& writer, int sessionId, void* data)
+{
+  writer.writeInt32(sessionId);
+}
+
+void MessageHandler::encodeProvisioned(WireWriter& writer, int sessionId, void* data)
+{
+  ProvisionResult* result = reinterpret_cast<ProvisionResult*>(data);
+  uint32_t uidLength = result->uid.size();
+
+  writer.writeInt32(result->status);
+  writer.writeInt32(result->serial);
+  writer.writeInt32(result->elapsedUs);
+  writer.writeInt32(uidLength);
+  writer.writeBytes(uidLength ? &result->uid.front() : NULL, uidLength);
+}
+
+bool MessageHandler::handleConfigRequest(WireRequest& request)
+{
+  int32_t hardwareState = request.fields[0];
+
   bool value;
   switch (hardwareState) {
     case NFC_TURN_OFF: // Fall through.
@@ -160,181 +331,332 @@ bool MessageHandler::handleConfigRequest(Parcel& parcel)
     case NFC_ENABLE_DISCOVERY:
       value = hardwareState == NFC_ENABLE_DISCOVERY;
       return mService->handleEnableDiscoveryRequest(value);
+    case NFC_STANDBY:
+      return mService->handleStandbyRequest();
+    case NFC_SCREEN_OFF:
+      return mService->handleConfigRequest(SCREEN_OFF);
+    case NFC_SCREEN_ON_LOCKED:
+      return mService->handleConfigRequest(SCREEN_ON_LOCKED);
+    case NFC_SCREEN_ON_UNLOCKED:
+      return mService->handleConfigRequest(SCREEN_ON_UNLOCKED);
+    case NFC_DEFINE_DISCOVERY_PROFILE:
+      return handleDefineDiscoveryProfile(request.tail);
+    case NFC_SELECT_DISCOVERY_PROFILE: {
+      uint32_t profileId;
+      if (!request.tail.readUint32(profileId) || profileId >= NFC_MAX_DISCOVERY_PROFILES) {
+        processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_INVALID_PARAMETER, 0, NULL);
+        return false;
+      }
+      return mService->handleSelectDiscoveryProfileRequest(profileId);
+    }
   }
+
+  NFC_LOGE(IPC, "%s: unknown state %d", FUNC, hardwareState);
+  processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_INVALID_PARAMETER, 0, NULL);
   return false;
 }
 
-bool MessageHandler::handleReadNdefDetailRequest(Parcel& parcel)
+bool MessageHandler::handleDefineDiscoveryProfile(WireReader& reader)
 {
-  int sessionId = parcel.readInt32();
-  //TODO check SessionId
-  return mService->handleReadNdefDetailRequest();
+  uint32_t profileId;
+  DiscoveryProfile* profile = new DiscoveryProfile();
+  if (!reader.readUint32(profileId) ||
+      !reader.readUint32(profile->techMask) ||
+      !reader.readUint32(profile->p2pListenMask) ||
+      !reader.readUint32(profile->pollMs) ||
+      profileId < NFC_DISCOVERY_PROFILE_FIRST_CUSTOM ||
+      profileId >= NFC_MAX_DISCOVERY_PROFILES ||
+      profile->pollMs == 0) {
+    delete profile;
+    processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_INVALID_PARAMETER, 0, NULL);
+    return false;
+  }
+
+  NFC_LOGD(IPC, "%s profile=%u, techs=0x%x, p2pListen=0x%x, poll=%u", FUNC, profileId,
+           profile->techMask, profile->p2pListenMask, profile->pollMs);
+  return mService->handleDefineDiscoveryProfileRequest(profileId, profile);
 }
 
-bool MessageHandler::handleReadNdefRequest(Parcel& parcel)
+int32_t MessageHandler::readOptionalInt32(WireReader& reader)
 {
-  int sessionId = parcel.readInt32();
-  //TODO check SessionId
-  return mService->handleReadNdefRequest();
+  // Trailing fields added to a request later are absent from older clients.
+  int32_t value = 0;
+  if (reader.remaining() >= WireInt32::SIZE) {
+    reader.readInt32(value);
+  }
+  return value;
 }
 
-bool MessageHandler::handleWriteNdefRequest(Parcel& parcel)
+bool MessageHandler::checkSession(const WireRequest& request)
 {
-  NdefMessagePdu ndefMessagePdu;
-  NdefMessage* ndefMessage = new NdefMessage();
+  int sessionId = request.fields[0];
+  if (SessionManager::Instance()->isValid(sessionId))
+    return true;
 
-  int sessionId = parcel.readInt32();
-  //TODO check SessionId
+  NFC_LOGW(IPC, "%s: reject request for stale session %d", FUNC, sessionId);
+  processResponse(request.response, NFC_ERROR_INVALID_SESSION, sessionId, NULL);
+  return false;
+}
 
-  uint32_t numRecords = parcel.readInt32();
-  ndefMessagePdu.numRecords = numRecords;
-  ndefMessagePdu.records = new NdefRecordPdu[numRecords];
+bool MessageHandler::handleReadNdefDetailRequest(WireRequest& request)
+{
+  int sessionId = request.fields[0];
+  if (!checkSession(request))
+    return false;
+  int timeoutMs = readOptionalInt32(request.tail);
+  return mService->handleReadNdefDetailRequest(sessionId, timeoutMs);
+}
 
-  for (uint32_t i = 0; i < numRecords; i++) {
-    ndefMessagePdu.records[i].tnf = parcel.readInt32();
-
-    uint32_t typeLength = parcel.readInt32();
-    ndefMessagePdu.records[i].typeLength = typeLength;
-    ndefMessagePdu.records[i].type = new uint8_t[typeLength];
-    const void* data = parcel.readInplace(typeLength);
-    memcpy(ndefMessagePdu.records[i].type, data, typeLength);
-
-    uint32_t idLength = parcel.readInt32();
-    ndefMessagePdu.records[i].idLength = idLength;
-    ndefMessagePdu.records[i].id = new uint8_t[idLength];
-    data = parcel.readInplace(idLength);
-    memcpy(ndefMessagePdu.records[i].id, data, idLength);
-
-    uint32_t payloadLength = parcel.readInt32();
-    ndefMessagePdu.records[i].payloadLength = payloadLength;
-    ndefMessagePdu.records[i].payload = new uint8_t[payloadLength];
-    data = parcel.readInplace(payloadLength);
-    memcpy(ndefMessagePdu.records[i].payload, data, payloadLength);
-  }
+bool MessageHandler::handleReadNdefRequest(WireRequest& request)
+{
+  int sessionId = request.fields[0];
+  if (!checkSession(request))
+    return false;
+  int timeoutMs = readOptionalInt32(request.tail);
+  return mService->handleReadNdefRequest(sessionId, timeoutMs);
+}
+
+bool MessageHandler::handleWriteNdefRequest(WireRequest& request)
+{
+  int sessionId = request.fields[0];
+  if (!checkSession(request))
+    return false;
+
+  WireReader& reader = request.tail;
+  NdefMessage* ndefMessage = readNdefMsg(reader);
+  int32_t flags = readOptionalInt32(reader);
+  int timeoutMs = readOptionalInt32(reader);
+
+  return mService->handleWriteNdefRequest(sessionId, ndefMessage,
+                                          flags & NFC_WRITE_NDEF_SUPERSEDABLE, timeoutMs);
+}
 
-  NfcUtil::convertNdefPduToNdefMessage(ndefMessagePdu, ndefMessage);
+NdefMessage* MessageHandler::readNdefMsg(WireReader& reader)
+{
+  // The message was validated by decodeRequest, so the reads below cannot
+  // fail.
+  uint32_t numRecords;
+  reader.readUint32(numRecords);
 
+  NdefMessage* ndefMessage = new NdefMessage();
+  ndefMessage->mRecords.reserve(numRecords);
   for (uint32_t i = 0; i < numRecords; i++) {
-    delete[] ndefMessagePdu.records[i].type;
-    delete[] ndefMessagePdu.records[i].id;
-    delete[] ndefMessagePdu.records[i].payload;
+    int32_t tnf;
+    uint32_t typeLength, idLength, payloadLength;
+    const uint8_t* type;
+    const uint8_t* id;
+    const uint8_t* payload;
+
+    reader.readInt32(tnf);
+    reader.readUint32(typeLength);
+    reader.readInplace(typeLength, type);
+    reader.readUint32(idLength);
+    reader.readInplace(idLength, id);
+    reader.readUint32(payloadLength);
+    reader.readInplace(payloadLength, payload);
+
+    ndefMessage->mRecords.push_back(NdefRecord(tnf,
+      typeLength, const_cast<uint8_t*>(type),
+      idLength, const_cast<uint8_t*>(id),
+      payloadLength, const_cast<uint8_t*>(payload)));
   }
-  delete[] ndefMessagePdu.records;
-
-  return mService->handleWriteNdefRequest(ndefMessage);
+  return ndefMessage;
 }
 
-bool MessageHandler::handleConnectRequest(Parcel& parcel)
+bool MessageHandler::handleConnectRequest(WireRequest& request)
 {
-  int sessionId = parcel.readInt32();
-  //TODO check SessionId
+  int sessionId = request.fields[0];
+  if (!checkSession(request))
+    return false;
 
   //TODO should only read 1 octet here.
-  int32_t techType = parcel.readInt32();
-  ALOGD("%s techType=%d", FUNC, techType);
-  mService->handleConnect(techType);
+  int32_t techType = request.fields[1];
+  NFC_LOGD(IPC, "%s techType=%d", FUNC, techType);
+  mService->handleConnect(sessionId, techType);
   return true;
 }
 
-bool MessageHandler::handleCloseRequest(Parcel& parcel)
+bool MessageHandler::handleCloseRequest(WireRequest& request)
 {
-  mService->handleCloseRequest();
+  int sessionId = request.fields[0];
+  if (!checkSession(request))
+    return false;
+  mService->handleCloseRequest(sessionId);
   return true;
 }
 
-bool MessageHandler::handleMakeNdefReadonlyRequest(Parcel& parcel)
+bool MessageHandler::handleMakeNdefReadonlyRequest(WireRequest& request)
 {
-  mService->handleMakeNdefReadonlyRequest();
+  int sessionId = request.fields[0];
+  if (!checkSession(request))
+    return false;
+  int timeoutMs = readOptionalInt32(request.tail);
+  mService->handleMakeNdefReadonlyRequest(sessionId, timeoutMs);
   return true;
 }
 
-bool MessageHandler::handleConfigResponse(Parcel& parcel, void* data)
+bool MessageHandler::handleTransceiveRequest(WireRequest& request)
 {
-  sendResponse(parcel);
-  return true;
+  int sessionId = request.fields[0];
+  if (!checkSession(request))
+    return false;
+
+  TransceiveBatch* batch = new TransceiveBatch();
+  batch->technology = NfcUtil::convertGonkFormatToTagTech((NfcTechnology) request.fields[1]);
+  batch->flags = request.fields[2];
+  batch->statusWordMask = request.fields[3];
+  batch->statusWordValue = request.fields[4];
+
+  // The tail was validated by decodeRequest, so the reads below cannot fail.
+  // The commands are copied, the request buffer is reused once this returns.
+  WireReader& reader = request.tail;
+  uint32_t numCommands;
+  reader.readUint32(numCommands);
+  batch->commands.resize(numCommands);
+  for (uint32_t i = 0; i < numCommands; i++) {
+    TransceiveCommand& command = batch->commands[i];
+    uint32_t length;
+    const uint8_t* data;
+
+    reader.readInt32(command.timeoutMs);
+    reader.readUint32(length);
+    reader.readInplace(length, data);
+    command.data.assign(data, data + length);
+  }
+
+  int timeoutMs = readOptionalInt32(reader);
+
+  NFC_LOGD(IPC, "%s tech=%d, %u commands, flags=0x%x", FUNC,
+           batch->technology, numCommands, batch->flags);
+  return mService->handleTransceiveRequest(sessionId, batch, timeoutMs);
 }
 
-bool MessageHandler::handleReadNdefDetailResponse(Parcel& parcel, void* data)
+bool MessageHandler::handleStartProvisioningRequest(WireRequest& request)
 {
-  NdefDetail* ndefDetail = reinterpret_cast<NdefDetail*>(data);
+  uint32_t flags = request.fields[0];
+  uint32_t firstSerial = request.fields[1];
+  uint32_t count = request.fields[2];
 
-  parcel.writeInt32(SessionId::getCurrentId());
+  NdefMessage* ndef = readNdefMsg(request.tail);
+  int timeoutMs = readOptionalInt32(request.tail);
 
-  bool isReadOnly = ndefDetail->isReadOnly;
-  bool canBeMadeReadOnly = ndefDetail->canBeMadeReadOnly;
+  NFC_LOGD(IPC, "%s flags=0x%x, firstSerial=%u, count=%u", FUNC, flags, firstSerial, count);
+  ProvisioningJob* job = new ProvisioningJob(ndef, flags, firstSerial, count, timeoutMs);
+  return mService->handleStartProvisioningRequest(job);
+}
 
-  bool params[] = {isReadOnly, canBeMadeReadOnly};
-  void* dest = parcel.writeInplace(sizeof(params));
-  memcpy(dest, params, sizeof(params));
+bool MessageHandler::handleStopProvisioningRequest(WireRequest& request)
+{
+  return mService->handleStopProvisioningRequest();
+}
 
-  parcel.writeInt32(ndefDetail->maxSupportedLength);
+bool MessageHandler::handleSetDiscoveryPolicyRequest(WireRequest& request)
+{
+  DiscoveryPolicy* policy = new DiscoveryPolicy();
+  policy->activePollMs = request.fields[0];
+  policy->idlePollMs = request.fields[1];
+  policy->screenOffPollMs = request.fields[2];
+  policy->idleTimeoutMs = request.fields[3];
+  policy->screenOffTechMask = request.fields[4];
+
+  NFC_LOGD(IPC, "%s active=%u, idle=%u, screenOff=%u, timeout=%u", FUNC, policy->activePollMs,
+           policy->idlePollMs, policy->screenOffPollMs, policy->idleTimeoutMs);
+  return mService->handleSetDiscoveryPolicyRequest(policy);
+}
 
-  sendResponse(parcel);
-  return true;
+void MessageHandler::encodeConfigResponse(WireWriter& writer, int sessionId, void* data)
+{
 }
 
-bool MessageHandler::handleReadNdefResponse(Parcel& parcel, void* data)
+void MessageHandler::encodeNdefDetailResponse(WireWriter& writer, int sessionId, void* data)
 {
-  NdefMessage* ndef = reinterpret_cast<NdefMessage*>(data);
+  NdefDetail* ndefDetail = reinterpret_cast<NdefDetail*>(data);
 
-  parcel.writeInt32(SessionId::getCurrentId());
+  writer.writeInt32(sessionId);
 
-  sendNdefMsg(parcel, ndef);
-  sendResponse(parcel);
+  // A failed request has no detail; its fields are sent as zeros.
+  uint8_t params[] = {0, 0};
+  if (ndefDetail) {
+    params[0] = ndefDetail->isReadOnly;
+    params[1] = ndefDetail->canBeMadeReadOnly;
+  }
+  writer.writeBytes(params, sizeof(params));
 
-  // NDEF message is written to parcel, delete it here.
-  delete ndef;
+  writer.writeInt32(ndefDetail ? ndefDetail->maxSupportedLength : 0);
+}
 
-  return true;
+void MessageHandler::encodeReadNdefResponse(WireWriter& writer, int sessionId, void* data)
+{
+  NdefMessage* ndef = reinterpret_cast<NdefMessage*>(data);
+
+  writer.writeInt32(sessionId);
+  sendNdefMsg(writer, ndef);
 }
 
-bool MessageHandler::handleResponse(Parcel& parcel)
+void MessageHandler::encodeGeneralResponse(WireWriter& writer, int sessionId, void* data)
 {
-  parcel.writeInt32(SessionId::getCurrentId());
-  sendResponse(parcel);
-  return true;
+  writer.writeInt32(sessionId);
+}
+
+void MessageHandler::encodeTransceiveResponse(WireWriter& writer, int sessionId, void* data)
+{
+  TransceiveBatch* batch = reinterpret_cast<TransceiveBatch*>(data);
+
+  writer.writeInt32(sessionId);
+  if (!batch) {
+    writer.writeInt32(0);
+    return;
+  }
+
+  writer.writeInt32(batch->results.size());
+  for (uint32_t i = 0; i < batch->results.size(); i++) {
+    TransceiveResult& result = batch->results[i];
+    uint32_t length = result.response.size();
+    writer.writeInt32(result.status);
+    writer.writeInt32(result.elapsedUs);
+    writer.writeInt32(length);
+    writer.writeBytes(length ? &result.response.front() : NULL, length);
+  }
 }
 
-bool MessageHandler::sendNdefMsg(Parcel& parcel, NdefMessage* ndef)
+bool MessageHandler::sendNdefMsg(WireWriter& writer, NdefMessage* ndef)
 {
   if (!ndef)
     return false;
 
   int numRecords = ndef->mRecords.size();
-  ALOGD("numRecords=%d", numRecords);
-  parcel.writeInt32(numRecords);
+  NFC_LOGD(IPC, "numRecords=%d", numRecords);
+  writer.writeInt32(numRecords);
 
   for (int i = 0; i < numRecords; i++) {
     NdefRecord &record = ndef->mRecords[i];
 
-    ALOGD("tnf=%u",record.mTnf);
-    parcel.writeInt32(record.mTnf);
+    NFC_LOGD(IPC, "tnf=%u",record.mTnf);
+    writer.writeInt32(record.mTnf);
 
     uint32_t typeLength = record.mType.size();
-    ALOGD("typeLength=%u",typeLength);
-    parcel.writeInt32(typeLength);
-    void* dest = parcel.writeInplace(typeLength);
-    if (dest == NULL) {
-      ALOGE("writeInplace returns NULL");
-      return false;
-    }
-    memcpy(dest, &record.mType.front(), typeLength);
+    NFC_LOGD(IPC, "typeLength=%u",typeLength);
+    writer.writeInt32(typeLength);
+    writer.writeBytes(typeLength ? &record.mType.front() : NULL, typeLength);
 
     uint32_t idLength = record.mId.size();
-    ALOGD("idLength=%d",idLength);
-    parcel.writeInt32(idLength);
-    dest = parcel.writeInplace(idLength);
-    memcpy(dest, &record.mId.front(), idLength);
+    NFC_LOGD(IPC, "idLength=%d",idLength);
+    writer.writeInt32(idLength);
+    writer.writeBytes(idLength ? &record.mId.front() : NULL, idLength);
 
     uint32_t payloadLength = record.mPayload.size();
-    ALOGD("payloadLength=%u",payloadLength);
-    parcel.writeInt32(payloadLength);
-    dest = parcel.writeInplace(payloadLength);
-    memcpy(dest, &record.mPayload.front(), payloadLength);
-    for (uint32_t j = 0; j < payloadLength; j++) {
-      ALOGD("mPayload %d = %u", j, record.mPayload[j]);
+    NFC_LOGD(IPC, "payloadLength=%u",payloadLength);
+    writer.writeInt32(payloadLength);
+    uint8_t* dest = writer.writeInplace(payloadLength);
+    if (dest == NULL) {
+      NFC_LOGE(IPC, "writeInplace returns NULL");
+      return false;
+    }
+    if (payloadLength) {
+      memcpy(dest, &record.mPayload.front(), payloadLength);
+      NFC_LOG_HEXDUMP(IPC, "payload", dest, payloadLength);
     }
   }
 
-  return true;
+  return writer.ok();
 }
@@ -6,9 +6,12 @@
 #define mozilla_nfcd_MessageHandler_h
 
 #include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
 #include "NfcGonkMessage.h"
 #include "TagTechnology.h"
-#include <binder/Parcel.h>
+#include "MessageSchema.h"
 
 class NfcIpcSocket;
 class NfcService;
@@ -16,41 +19,175 @@ class NdefMessage;
 
 class MessageHandler {
 public:
-  MessageHandler(NfcService* service): mService(service) {};
+  MessageHandler(NfcService* service);
+  ~MessageHandler();
+
   void processRequest(const uint8_t* data, size_t length);
-  void processResponse(NfcResponseType response, NfcErrorCode error, void* data);
-  void processNotification(NfcNotificationType notification, void* data);
+  /**
+   * @param  sessionId Session of the request being answered, 0 if none.
+   */
+  void processResponse(NfcResponseType response, NfcErrorCode error, int sessionId, void* data);
+  /**
+   * @param  sessionId Session the notification is about, 0 if none.
+   */
+  void processNotification(NfcNotificationType notification, int sessionId, void* data);
 
   void setOutgoingSocket(NfcIpcSocket* socket);
 
 private:
-  void notifyInitialized(android::Parcel& parcel);
-  void notifyTechDiscovered(android::Parcel& parcel, void* data);
-  void notifyTechLost(android::Parcel& parcel);
+  typedef bool (MessageHandler::*RequestHandler)(WireRequest& request);
+  typedef void (MessageHandler::*BodyEncoder)(WireWriter& writer, int sessionId, void* data);
+  typedef size_t (*BodySize)(void* data);
+
+  struct RequestSchema {
+    int32_t type;
+    uint32_t numFields;
+    WireTail tail;
+    NfcResponseType response;
+    RequestHandler handle;
+  };
+
+  struct OutgoingSchema {
+    int32_t type;
+    BodyEncoder encode;
+    BodySize bodySize;
+  };
+
+  // Dispatch tables generated from MessageSchema.h, indexed by type.
+  static const RequestSchema sRequestSchemas[];
+  static const OutgoingSchema sResponseSchemas[];
+  static const OutgoingSchema sNotificationSchemas[];
+
+  bool decodeRequest(const RequestSchema& schema, WireReader& reader, WireRequest& request);
+  void sendMessage(const OutgoingSchema& schema, bool hasError, NfcErrorCode error,
+                   int sessionId, void* data);
+
+  /**
+   * Reject a request whose session is no longer open, before any work is
+   * queued for it.
+   *
+   * @param  request Request whose first field is its session ID.
+   * @return         True if the session is open; otherwise an
+   *                 NFC_ERROR_INVALID_SESSION response of the request's
+   *                 type was sent.
+   */
+  bool checkSession(const WireRequest& request);
+
+  /**
+   * Read an optional trailing field of a request.
+   *
+   * @param  reader Reader positioned at the field.
+   * @return        The field, 0 if the request ends before it.
+   */
+  static int32_t readOptionalInt32(WireReader& reader);
+
+  void encodeInitialized(WireWriter& writer, int sessionId, void* data);
+  void encodeTechDiscovered(WireWriter& writer, int sessionId, void* data);
+  void encodeTechLost(WireWriter& writer, int sessionId, void* data);
+  void encodeProvisioned(WireWriter& writer, int sessionId, void* data);
+  void encodeStartupTiming(WireWriter& writer, int sessionId, void* data);
+
+  bool handleConfigRequest(WireRequest& request);
+  bool handleDefineDiscoveryProfile(WireReader& reader);
+  bool handleReadNdefDetailRequest(WireRequest& request);
+  bool handleReadNdefRequest(WireRequest& request);
+  bool handleWriteNdefRequest(WireRequest& request);
+  bool handleConnectRequest(WireRequest& request);
+  bool handleCloseRequest(WireRequest& request);
+  bool handleMakeNdefReadonlyRequest(WireRequest& request);
+  bool handleTransceiveRequest(WireRequest& request);
+  bool handleStartProvisioningRequest(WireRequest& request);
+  bool handleStopProvisioningRequest(WireRequest& request);
+  bool handleSetDiscoveryPolicyRequest(WireRequest& request);
+
+  void encodeConfigResponse(WireWriter& writer, int sessionId, void* data);
+  void encodeNdefDetailResponse(WireWriter& writer, int sessionId, void* data);
+  void encodeReadNdefResponse(WireWriter& writer, int sessionId, void* data);
+  void encodeGeneralResponse(WireWriter& writer, int sessionId, void* data);
+  void encodeTransceiveResponse(WireWriter& writer, int sessionId, void* data);
+
+  void sendResponse(WireWriter& writer);
 
-  bool handleConfigRequest(android::Parcel& parcel);
-  bool handleReadNdefDetailRequest(android::Parcel& parcel);
-  bool handleReadNdefRequest(android::Parcel& parcel);
-  bool handleWriteNdefRequest(android::Parcel& parcel);
-  bool handleConnectRequest(android::Parcel& parcel);
-  bool handleCloseRequest(android::Parcel& parcel);
-  bool handleMakeNdefReadonlyRequest(android::Parcel& parcel);
+  bool sendNdefMsg(WireWriter& writer, NdefMessage* ndef);
 
-  bool handleConfigResponse(android::Parcel& parcel, void* data);
-  bool handleReadNdefDetailResponse(android::Parcel& parcel, void* data);
-  bool handleReadNdefResponse(android::Parcel& parcel, void* data);
-  bool handleResponse(android::Parcel& parcel);
+  /**
+   * Check that an NDEF message is entirely within the frame.
+   *
+   * @param  reader Reader positioned at the message; not advanced.
+   * @return        True if every record is in bounds.
+   */
+  static bool validateNdefMsg(const WireReader& reader);
 
-  void sendResponse(android::Parcel& parcel);
+  /**
+   * Read an NDEF message checked by validateNdefMsg.
+   *
+   * @param  reader Reader positioned at the message; advanced past it.
+   * @return        The message, owned by the caller.
+   */
+  static NdefMessage* readNdefMsg(WireReader& reader);
 
-  bool sendNdefMsg(android::Parcel& parcel, NdefMessage* ndef);
+  /**
+   * Encoded size of an NDEF message as written by sendNdefMsg.
+   *
+   * @param  ndef NDEF message, may be NULL.
+   * @return      Size in bytes, 0 if ndef is NULL.
+   */
+  static size_t ndefWireSize(NdefMessage* ndef);
+
+  /**
+   * Check that the commands of a transceive request are entirely within the
+   * frame.
+   *
+   * @param  reader Reader positioned at the commands; not advanced.
+   * @return        True if every command is in bounds.
+   */
+  static bool validateTransceiveCommands(const WireReader& reader);
+
+  static size_t readNdefResponseSize(void* data);
+  static size_t techDiscoveredSize(void* data);
+  static size_t transceiveResponseSize(void* data);
+  static size_t provisionedSize(void* data);
+
+  /**
+   * Buffer for outgoing messages. Must be called with mOutgoingMutex held.
+   *
+   * @param  size Bytes needed, including the frame size prefix.
+   * @return      Buffer of at least size bytes.
+   */
+  uint8_t* getOutgoingBuffer(size_t size);
 
   NfcIpcSocket* mSocket;
   NfcService* mService;
+
+  // Serializes outgoing messages; notifications also come from P2P threads.
+  pthread_mutex_t mOutgoingMutex;
+  std::vector<uint8_t> mOutgoingBuffer;
+};
+
+struct TransceiveCommand {
+  std::vector<uint8_t> data;
+  int timeoutMs;  // 0 for the default.
+};
+
+struct TransceiveResult {
+  NfcErrorCode status;
+  uint32_t elapsedUs;
+  std::vector<uint8_t> response;
+};
+
+/**
+ * Commands of an NFC_REQUEST_TRANSCEIVE and, once executed, their results.
+ */
+struct TransceiveBatch {
+  TagTechnology technology;
+  uint32_t flags;  // NfcTransceiveFlags.
+  uint32_t statusWordMask;
+  uint32_t statusWordValue;
+  std::vector<TransceiveCommand> commands;
+  std::vector<TransceiveResult> results;
 };
 
 struct TechDiscoveredEvent {
-  bool isNewSession;
   uint32_t techCount;
   void* techList;
   uint32_t ndefMsgCount;
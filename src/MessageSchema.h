@@ -0,0 +1,120 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_MessageSchema_h
+#define mozilla_nfcd_MessageSchema_h
+
+#include "NfcGonkMessage.h"
+#include "WireCodec.h"
+
+/**
+ * Wire schemas of the messages in NfcGonkMessage.h, declared once.
+ *
+ * MessageHandler expands these lists into its dispatch tables: one entry per
+ * message type, indexed by the type, holding the generic decoder parameters
+ * or the encoder and its size. Adding a message type means adding one line
+ * here and writing its handler or encoder.
+ */
+
+/**
+ * Variable-length data that may follow the fixed fields of a message.
+ */
+typedef enum {
+  WIRE_TAIL_NONE = 0,
+  WIRE_TAIL_NDEF,
+  WIRE_TAIL_TRANSCEIVE
+} WireTail;
+
+/**
+ * A request decoded according to its schema. The fixed fields are already
+ * bounds checked and the tail, if any, is already validated, so handlers
+ * only run on well-formed frames.
+ */
+struct WireRequest {
+  static const uint32_t MAX_FIELDS = 5;
+
+  WireRequest() : response(NFC_RESPONSE_GENERAL), tail(NULL, 0) {}
+
+  int32_t fields[MAX_FIELDS];
+  NfcResponseType response;  // Type the request is answered with.
+  WireReader tail;
+};
+
+/**
+ * Requests: X(type, handler, number of int32 fields, tail, response type).
+ * A request that cannot be handled is answered NFC_ERROR_INVALID_PARAMETER,
+ * or NFC_ERROR_INVALID_SESSION, with its response type.
+ *
+ * NFC_REQUEST_CONFIG:              hardwareState, then the NfcDiscoveryProfile
+ *                                  or profile id of the profile states
+ * NFC_REQUEST_CONNECT:             sessionId, technology
+ * NFC_REQUEST_WRITE_NDEF:          sessionId, then an NDEF message
+ * NFC_REQUEST_TRANSCEIVE:          sessionId, technology, flags, statusWordMask,
+ *                                  statusWordValue, then the commands
+ * NFC_REQUEST_START_PROVISIONING:  flags, firstSerial, count, then an NDEF
+ *                                  message
+ * NFC_REQUEST_STOP_PROVISIONING:   none
+ * NFC_REQUEST_SET_DISCOVERY_POLICY: activePollMs, idlePollMs, screenOffPollMs,
+ *                                  idleTimeoutMs, screenOffTechMask
+ * all others:                      sessionId
+ */
+#define NFC_REQUEST_SCHEMA(X) \
+  X(NFC_REQUEST_CONFIG,              handleConfigRequest,           1, WIRE_TAIL_NONE, NFC_RESPONSE_CONFIG) \
+  X(NFC_REQUEST_CONNECT,             handleConnectRequest,          2, WIRE_TAIL_NONE, NFC_RESPONSE_GENERAL) \
+  X(NFC_REQUEST_CLOSE,               handleCloseRequest,            1, WIRE_TAIL_NONE, NFC_RESPONSE_GENERAL) \
+  X(NFC_REQUEST_GET_DETAILS,         handleReadNdefDetailRequest,   1, WIRE_TAIL_NONE, NFC_RESPONSE_READ_NDEF_DETAILS) \
+  X(NFC_REQUEST_READ_NDEF,           handleReadNdefRequest,         1, WIRE_TAIL_NONE, NFC_RESPONSE_READ_NDEF) \
+  X(NFC_REQUEST_WRITE_NDEF,          handleWriteNdefRequest,        1, WIRE_TAIL_NDEF, NFC_RESPONSE_GENERAL) \
+  X(NFC_REQUEST_MAKE_NDEF_READ_ONLY, handleMakeNdefReadonlyRequest, 1, WIRE_TAIL_NONE, NFC_RESPONSE_GENERAL) \
+  X(NFC_REQUEST_TRANSCEIVE,          handleTransceiveRequest,       5, WIRE_TAIL_TRANSCEIVE, NFC_RESPONSE_TRANSCEIVE) \
+  X(NFC_REQUEST_START_PROVISIONING,  handleStartProvisioningRequest, 3, WIRE_TAIL_NDEF, NFC_RESPONSE_GENERAL) \
+  X(NFC_REQUEST_STOP_PROVISIONING,   handleStopProvisioningRequest, 0, WIRE_TAIL_NONE, NFC_RESPONSE_GENERAL) \
+  X(NFC_REQUEST_SET_DISCOVERY_POLICY, handleSetDiscoveryPolicyRequest, 5, WIRE_TAIL_NONE, NFC_RESPONSE_GENERAL)
+
+/**
+ * Bodies of fixed-layout responses and notifications, i.e. what follows the
+ * type (and the error code of a response).
+ */
+typedef WireLayout<WireNone> WireEmptyBody;
+typedef WireLayout<WireInt32> WireSessionIdBody;
+// status, majorVersion, minorVersion, then the startup phase timestamps
+typedef WireLayout<WireInt32, WireInt32, WireInt32,
+                   WireInt32, WireInt32, WireInt32, WireInt32, WireInt32> WireInitializedBody;
+// The startup phase timestamps
+typedef WireLayout<WireInt32, WireInt32, WireInt32, WireInt32, WireInt32> WireStartupTimingBody;
+// sessionId, {isReadOnly, canBeMadeReadOnly}, maxSupportedLength
+typedef WireLayout<WireInt32, WireBytes<2>, WireInt32> WireNdefDetailBody;
+
+template<typename Layout>
+size_t wireFixedSize(void* data)
+{
+  return Layout::SIZE;
+}
+
+// Body size of a fixed-layout message, known at compile time.
+#define WIRE_SIZE_FIXED(layout) (&wireFixedSize<layout>)
+// Body size computed by a MessageHandler function from the message data.
+#define WIRE_SIZE_OF(func) (&MessageHandler::func)
+
+/**
+ * Responses: X(type, encoder, body size).
+ */
+#define NFC_RESPONSE_SCHEMA(X) \
+  X(NFC_RESPONSE_GENERAL,           encodeGeneralResponse,    WIRE_SIZE_FIXED(WireSessionIdBody)) \
+  X(NFC_RESPONSE_CONFIG,            encodeConfigResponse,     WIRE_SIZE_FIXED(WireEmptyBody)) \
+  X(NFC_RESPONSE_READ_NDEF_DETAILS, encodeNdefDetailResponse, WIRE_SIZE_FIXED(WireNdefDetailBody)) \
+  X(NFC_RESPONSE_READ_NDEF,         encodeReadNdefResponse,   WIRE_SIZE_OF(readNdefResponseSize)) \
+  X(NFC_RESPONSE_TRANSCEIVE,        encodeTransceiveResponse, WIRE_SIZE_OF(transceiveResponseSize))
+
+/**
+ * Notifications: X(type, encoder, body size).
+ */
+#define NFC_NOTIFICATION_SCHEMA(X) \
+  X(NFC_NOTIFICATION_INITIALIZED,     encodeInitialized,    WIRE_SIZE_FIXED(WireInitializedBody)) \
+  X(NFC_NOTIFICATION_TECH_DISCOVERED, encodeTechDiscovered, WIRE_SIZE_OF(techDiscoveredSize)) \
+  X(NFC_NOTIFICATION_TECH_LOST,       encodeTechLost,       WIRE_SIZE_FIXED(WireSessionIdBody)) \
+  X(NFC_NOTIFICATION_PROVISIONED,     encodeProvisioned,    WIRE_SIZE_OF(provisionedSize)) \
+  X(NFC_NOTIFICATION_STARTUP_TIMING,  encodeStartupTiming,  WIRE_SIZE_FIXED(WireStartupTimingBody))
+
+#endif // mozilla_nfcd_MessageSchema_h
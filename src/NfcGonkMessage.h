@@ -45,6 +45,42 @@ typedef enum {
  */
 typedef enum {
   NFC_ERROR_SUCCESS = 0,
+
+  /**
+   * The sessionId of the request does not match an active session, e.g. the
+   * tag was removed and another one tapped since.
+   */
+  NFC_ERROR_INVALID_SESSION = 1,
+
+  /**
+   * The tag did not complete the operation before its deadline. The tag was
+   * deactivated. The deadline is the timeout of the request, counted from
+   * when the operation starts; 0 or no timeout uses nfcd's defaults.
+   */
+  NFC_ERROR_TIMEOUT = 2,
+
+  /**
+   * The exchange with the tag failed, e.g. the tag answered with an error,
+   * left the field, has no NDEF message to read or cannot hold the NDEF
+   * message written to it.
+   */
+  NFC_ERROR_IO = 3,
+
+  /**
+   * The NDEF message read back from the tag differs from the one written.
+   */
+  NFC_ERROR_VERIFY_FAILED = 4,
+
+  /**
+   * A field of the request is out of range, e.g. an unknown profile.
+   */
+  NFC_ERROR_INVALID_PARAMETER = 5,
+
+  /**
+   * The request would deactivate the tag or peer in the field, e.g. a
+   * discovery profile switch; retry once it has left.
+   */
+  NFC_ERROR_BUSY = 6,
 //TODO Error Code
 } NfcErrorCode;
 
@@ -77,8 +113,79 @@ typedef enum {
    * Disable discovery mode.
    */
   NFC_DISABLE_DISCOVERY = 3,
+
+  /**
+   * The screen of the platform is off. Discovery polls with the screen-off
+   * settings of NFC_REQUEST_SET_DISCOVERY_POLICY.
+   */
+  NFC_SCREEN_OFF = 4,
+
+  /**
+   * The screen is on and the user is locked out. Discovery polls at its
+   * idle rate.
+   */
+  NFC_SCREEN_ON_LOCKED = 5,
+
+  /**
+   * The screen is on and the user unlocked it; the default. Discovery polls
+   * at its active rate after activity and backs off when idle.
+   */
+  NFC_SCREEN_ON_UNLOCKED = 6,
+
+  /**
+   * Define a discovery profile, followed by NfcDiscoveryProfile. Profiles
+   * below NFC_DISCOVERY_PROFILE_FIRST_CUSTOM are built in and cannot be
+   * redefined. Redefining the selected profile does not switch to it again.
+   */
+  NFC_DEFINE_DISCOVERY_PROFILE = 7,
+
+  /**
+   * Switch discovery to a profile, followed by a uint32 profile id.
+   * Discovery is restarted with it if enabled, without turning NFC off; the
+   * profile stays selected across NFC_TURN_OFF and NFC_TURN_ON. Answered
+   * NFC_ERROR_BUSY, without switching, while a tag or peer is activated.
+   */
+  NFC_SELECT_DISCOVERY_PROFILE = 8,
+
+  /**
+   * Stop discovery and power the NFC chip down, but keep it initialized so
+   * that the next NFC_TURN_ON only restarts discovery. Discovery enabled or
+   * disabled in standby takes effect on NFC_TURN_ON; NFC_TURN_OFF turns the
+   * chip off as usual.
+   */
+  NFC_STANDBY = 9,
 } NfcHardwareState;
 
+/**
+ * Built-in discovery profiles.
+ */
+typedef enum {
+  /**
+   * What the configuration file sets; selected at startup.
+   */
+  NFC_DISCOVERY_PROFILE_DEFAULT = 0,
+
+  /**
+   * Tags of all technologies, no P2P.
+   */
+  NFC_DISCOVERY_PROFILE_TAGS = 1,
+
+  /**
+   * P2P only, polling and listening in NFC-A and NFC-F.
+   */
+  NFC_DISCOVERY_PROFILE_P2P = 2,
+
+  NFC_DISCOVERY_PROFILE_FIRST_CUSTOM = 3,
+} NfcDiscoveryProfileId;
+
+#define NFC_MAX_DISCOVERY_PROFILES 16
+
+/**
+ * Field value of NfcDiscoveryProfile that keeps what the configuration file
+ * sets.
+ */
+#define NFC_DISCOVERY_CONFIGURED 0xFFFFFFFF
+
 /**
  * NFC technologies.
  */
@@ -186,6 +293,167 @@ typedef struct {
   NdefMessagePdu ndef;
 } NfcNdefReadWritePdu;
 
+typedef struct {
+  /**
+   * Time the tag may take to answer, in milliseconds; 0 for the default.
+   */
+  uint32_t timeoutMs;
+
+  uint32_t length;
+  uint8_t* data;
+} NfcTransceiveCommandPdu;
+
+typedef struct {
+  /**
+   * The sessionId must correspond to that of a prior
+   * NfcNotificationTechDiscovered.
+   */
+  NfcSessionId sessionId;
+
+  /**
+   * Technology to exchange the commands over, one of NfcTechnology.
+   */
+  uint32_t technology;
+
+  /**
+   * NfcTransceiveFlags.
+   */
+  uint32_t flags;
+
+  /**
+   * With NFC_TRANSCEIVE_STOP_ON_STATUS_WORD, the batch goes on only while
+   * (SW1SW2 & statusWordMask) == statusWordValue, SW1SW2 being the last two
+   * bytes of the response.
+   */
+  uint32_t statusWordMask;
+  uint32_t statusWordValue;
+
+  uint32_t numCommands;
+  NfcTransceiveCommandPdu* commands;
+} NfcTransceiveRequest;
+
+typedef struct {
+  /**
+   * NfcErrorCode of the exchange.
+   */
+  uint32_t status;
+
+  /**
+   * Time from sending the command to receiving the response, in
+   * microseconds.
+   */
+  uint32_t elapsedUs;
+
+  uint32_t length;
+  uint8_t* data;
+} NfcTransceiveResultPdu;
+
+typedef struct {
+  NfcSessionId sessionId;
+
+  /**
+   * One result per command executed, in order; commands after the one the
+   * batch stopped at are not executed.
+   */
+  uint32_t numResults;
+  NfcTransceiveResultPdu* results;
+} NfcTransceiveResponse;
+
+typedef struct {
+  /**
+   * NfcProvisionFlags.
+   */
+  uint32_t flags;
+
+  /**
+   * Serial number of the first tag, see NFC_PROVISION_SERIAL_PLACEHOLDER.
+   */
+  uint32_t firstSerial;
+
+  /**
+   * Tags to provision before the job ends by itself, 0 for no limit.
+   */
+  uint32_t count;
+
+  /**
+   * NDEF message written to every tag, after substitution of the
+   * placeholders in the payloads of its records.
+   */
+  NdefMessagePdu ndef;
+} NfcProvisionRequest;
+
+/**
+ * Technologies polled for.
+ */
+typedef enum {
+  NFC_POLL_NFCA = 1 << 0,
+  NFC_POLL_NFCB = 1 << 1,
+  NFC_POLL_NFCF = 1 << 2,
+  NFC_POLL_NFCV = 1 << 3,
+  NFC_POLL_B_PRIME = 1 << 4,
+  NFC_POLL_KOVIO = 1 << 5,
+  /**
+   * NFC-A and NFC-F active mode, for P2P.
+   */
+  NFC_POLL_ACTIVE = 1 << 6,
+} NfcPollTechnology;
+
+typedef struct {
+  /**
+   * Poll period after a tag or peer left the field, or the screen was
+   * unlocked, in milliseconds. 0 goes back to the configured period and
+   * disables the other fields.
+   */
+  uint32_t activePollMs;
+
+  /**
+   * Poll period once idle, in milliseconds; 0 for activePollMs.
+   */
+  uint32_t idlePollMs;
+
+  /**
+   * Poll period while the screen is off, in milliseconds; 0 for idlePollMs.
+   */
+  uint32_t screenOffPollMs;
+
+  /**
+   * Time without activity before backing off to idlePollMs, in
+   * milliseconds. Doubled for each other tap in the last minute, up to 4
+   * times.
+   */
+  uint32_t idleTimeoutMs;
+
+  /**
+   * NfcPollTechnology flags polled for while the screen is off, 0 for the
+   * usual ones.
+   */
+  uint32_t screenOffTechMask;
+} NfcDiscoveryPolicyRequest;
+
+typedef struct {
+  /**
+   * From NFC_DISCOVERY_PROFILE_FIRST_CUSTOM to NFC_MAX_DISCOVERY_PROFILES - 1.
+   */
+  uint32_t profileId;
+
+  /**
+   * NfcPollTechnology flags polled for, 0 to only listen.
+   */
+  uint32_t techMask;
+
+  /**
+   * NfcPollTechnology flags P2P listens with (NFC_POLL_NFCA, NFC_POLL_NFCF,
+   * NFC_POLL_ACTIVE), 0 not to listen.
+   */
+  uint32_t p2pListenMask;
+
+  /**
+   * Poll period in milliseconds when no NFC_REQUEST_SET_DISCOVERY_POLICY
+   * is set.
+   */
+  uint32_t pollMs;
+} NfcDiscoveryProfile;
+
 typedef enum {
   /**
    * NFC_REQUEST_CONFIG
@@ -229,7 +497,8 @@ typedef enum {
    * NfcNotificationTechDiscovered must include NFC_TECH_NDEF.
    *
    * data is NfcSessionId, which is correlates to a technology that was
-   * previously discovered with NFC_NOTIFICATION_TECH_DISCOVERED.
+   * previously discovered with NFC_NOTIFICATION_TECH_DISCOVERED, optionally
+   * followed by a uint32 timeout in milliseconds (see NFC_ERROR_TIMEOUT).
    *
    * respose is NfcGetDetailsResponse.
    */
@@ -242,7 +511,8 @@ typedef enum {
    * NfcNotificationTechDiscovered must include NFC_TECH_NDEF.
    *
    * data is NfcSessionId, which is correlates to a technology that was
-   * previously discovered with NFC_NOTIFICATION_TECH_DISCOVERED.
+   * previously discovered with NFC_NOTIFICATION_TECH_DISCOVERED, optionally
+   * followed by a uint32 timeout in milliseconds.
    *
    * response is NfcNdefReadWritePdu.
    */
@@ -255,7 +525,8 @@ typedef enum {
    * NfcNotificationTechDiscovered must include NFC_TECH_NDEF_WRITABLE or
    * NFC_TECH_P2P.
    *
-   * data is NfcNdefReadWritePdu.
+   * data is NfcNdefReadWritePdu, optionally followed by a uint32 of
+   * NfcWriteNdefFlags and then a uint32 timeout in milliseconds.
    *
    * response is NULL.
    */
@@ -268,13 +539,125 @@ typedef enum {
    * NfcNotificationTechDiscovered must include NFC_TECH_NDEF_WRITABLE.
    *
    * data is NfcSessionId, which is correlates to a technology that was
-   * previously discovered with NFC_NOTIFICATION_TECH_DISCOVERED.
+   * previously discovered with NFC_NOTIFICATION_TECH_DISCOVERED, optionally
+   * followed by a uint32 timeout in milliseconds.
    *
    * response is NULL.
    */
   NFC_REQUEST_MAKE_NDEF_READ_ONLY = 6,
+
+  /**
+   * NFC_REQUEST_TRANSCEIVE
+   *
+   * Exchange raw commands with the tag, e.g. ISO-DEP APDUs or NFC-A/F/V
+   * commands, back to back in a single request. The 'technology' field in
+   * NfcNotificationTechDiscovered must include the requested technology.
+   *
+   * data is NfcTransceiveRequest, optionally followed by a uint32 timeout in
+   * milliseconds for the whole batch.
+   *
+   * response is NfcTransceiveResponse. Its error code is NFC_ERROR_IO if the
+   * technology could not be connected, NFC_ERROR_TIMEOUT if the batch ran
+   * out of time; the result of each command is in its status.
+   */
+  NFC_REQUEST_TRANSCEIVE = 7,
+
+  /**
+   * NFC_REQUEST_START_PROVISIONING
+   *
+   * Provision every tag discovered from now on without involving the
+   * client: write the NDEF message of the request, then optionally make it
+   * read-only and read it back. Replaces the job in progress, if any. While
+   * a job runs, tags are reported with NFC_NOTIFICATION_PROVISIONED instead
+   * of NFC_NOTIFICATION_TECH_DISCOVERED.
+   *
+   * data is NfcProvisionRequest, optionally followed by a uint32 timeout in
+   * milliseconds for each tag.
+   *
+   * response is NULL.
+   */
+  NFC_REQUEST_START_PROVISIONING = 8,
+
+  /**
+   * NFC_REQUEST_STOP_PROVISIONING
+   *
+   * End the provisioning job in progress, if any. The tag being provisioned,
+   * if any, is finished first.
+   *
+   * data is NULL.
+   *
+   * response is NULL.
+   */
+  NFC_REQUEST_STOP_PROVISIONING = 9,
+
+  /**
+   * NFC_REQUEST_SET_DISCOVERY_POLICY
+   *
+   * Set how often discovery polls depending on activity and on the screen
+   * state reported with NFC_REQUEST_CONFIG. Polling fast right after a tap
+   * keeps the next tap quick, backing off when idle saves power. Changes
+   * are applied once no tag is in the field.
+   *
+   * data is NfcDiscoveryPolicyRequest.
+   *
+   * response is NULL.
+   */
+  NFC_REQUEST_SET_DISCOVERY_POLICY = 10,
 } NfcRequestType;
 
+/**
+ * Flags of NFC_REQUEST_WRITE_NDEF.
+ */
+typedef enum {
+  /**
+   * The write may be dropped in favour of a later write to the same session
+   * queued right behind it, whether or not that one has the flag. Both
+   * requests get the response of the write that is performed.
+   */
+  NFC_WRITE_NDEF_SUPERSEDABLE = 1 << 0,
+} NfcWriteNdefFlags;
+
+/**
+ * Flags of NFC_REQUEST_TRANSCEIVE. A batch always stops when the tag is lost
+ * or a command times out.
+ */
+typedef enum {
+  /**
+   * Stop at the first command whose exchange fails.
+   */
+  NFC_TRANSCEIVE_STOP_ON_ERROR = 1 << 0,
+
+  /**
+   * Stop at the first response whose status word does not match, see
+   * NfcTransceiveRequest.
+   */
+  NFC_TRANSCEIVE_STOP_ON_STATUS_WORD = 1 << 1,
+} NfcTransceiveFlags;
+
+/**
+ * Flags of NFC_REQUEST_START_PROVISIONING.
+ */
+typedef enum {
+  /**
+   * Make the NDEF message read-only once written.
+   */
+  NFC_PROVISION_LOCK = 1 << 0,
+
+  /**
+   * Read the NDEF message back and compare it with the one written.
+   */
+  NFC_PROVISION_VERIFY = 1 << 1,
+} NfcProvisionFlags;
+
+/**
+ * Placeholders of NfcProvisionRequest, replaced in record payloads: the UID
+ * of the tag in upper-case hexadecimal, and the serial number of the tag in
+ * decimal. The serial number starts at firstSerial and is incremented for
+ * every tag a write was attempted on.
+ */
+#define NFC_PROVISION_UID_PLACEHOLDER    "{uid}"
+#define NFC_PROVISION_SERIAL_PLACEHOLDER "{serial}"
+
 typedef enum {
   NFC_RESPONSE_GENERAL = 1000,
 
@@ -283,14 +666,41 @@ typedef enum {
   NFC_RESPONSE_READ_NDEF_DETAILS = 1002,
 
   NFC_RESPONSE_READ_NDEF = 1003,
+
+  NFC_RESPONSE_TRANSCEIVE = 1004,
 } NfcResponseType;
 
 typedef struct {
   uint32_t status;
   uint32_t majorVersion;
   uint32_t minorVersion;
+
+  /**
+   * When nfcd reached each startup phase, in milliseconds since boot, 0 for
+   * a phase not reached yet. Sent from minor version 8.
+   *
+   * Discovery only starts on request of the client, so discoveryStartedMs
+   * is only known from NFC_NOTIFICATION_STARTUP_TIMING.
+   */
+  uint32_t processStartMs;
+  uint32_t socketReadyMs;
+  uint32_t nfaEnabledMs;
+  uint32_t serversRegisteredMs;
+  uint32_t discoveryStartedMs;
 } NfcNotificationInitialized;
 
+typedef struct {
+  /**
+   * When nfcd reached each startup phase, in milliseconds since boot, as in
+   * NfcNotificationInitialized.
+   */
+  uint32_t processStartMs;
+  uint32_t socketReadyMs;
+  uint32_t nfaEnabledMs;
+  uint32_t serversRegisteredMs;
+  uint32_t discoveryStartedMs;
+} NfcNotificationStartupTiming;
+
 typedef struct {
   NfcSessionId sessionId;
   uint32_t numOfTechnogies;
@@ -300,6 +710,26 @@ typedef struct {
   NdefMessagePdu* ndef;
 } NfcNotificationTechDiscovered;
 
+typedef struct {
+  /**
+   * NfcErrorCode of the provisioning.
+   */
+  uint32_t status;
+
+  /**
+   * Serial number of the tag, 0xFFFFFFFF if no write was attempted.
+   */
+  uint32_t serial;
+
+  /**
+   * Time taken to provision the tag, in microseconds.
+   */
+  uint32_t elapsedUs;
+
+  uint32_t uidLength;
+  uint8_t* uid;
+} NfcNotificationProvisioned;
+
 typedef enum {
   NFC_NOTIFICATION_BASE = 1999,
 
@@ -331,6 +761,26 @@ typedef enum {
    * previously discovered with NFC_NOTIFICATION_TECH_DISCOVERED.
    */
   NFC_NOTIFICATION_TECH_LOST = 2002,
+
+  /**
+   * NFC_NOTIFICATION_PROVISIONED
+   *
+   * To notify the result of provisioning a tag, see
+   * NFC_REQUEST_START_PROVISIONING.
+   *
+   * data is NfcNotificationProvisioned.
+   */
+  NFC_NOTIFICATION_PROVISIONED = 2003,
+
+  /**
+   * NFC_NOTIFICATION_STARTUP_TIMING
+   *
+   * To notify when startup ended, i.e. discovery started for the first
+   * time. Sent once, from minor version 8.
+   *
+   * data is NfcNotificationStartupTiming.
+   */
+  NFC_NOTIFICATION_STARTUP_TIMING = 2004,
 } NfcNotificationType;
 
 #ifdef __cplusplus
@@ -21,12 +21,13 @@
 #include "NfcIpcSocket.h"
 #include "MessageHandler.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
+#include "StartupTiming.h"
+#include "TraceRing.h"
 
 #define NFCD_SOCKET_NAME "nfcd"
 #define MAX_COMMAND_BYTES (8 * 1024)
 
-using android::Parcel;
-
 static int nfcdRw;
 
 MessageHandler* NfcIpcSocket::sMsgHandler = NULL;
@@ -43,6 +44,8 @@ NfcIpcSocket* NfcIpcSocket::Instance() {
 }
 
 NfcIpcSocket::NfcIpcSocket()
+ : mListener(NULL)
+ , mClientFd(-1)
 {
 }
 
@@ -68,7 +71,7 @@ int NfcIpcSocket::getListenSocket() {
   const int nfcdConn = android_get_control_socket(NFCD_SOCKET_NAME);
   if (nfcdConn < 0) {
     // TODO : Remove this debug message temporarily until gecko support NFC
-    // ALOGE("Could not connect to %s socket: %s\n", NFCD_SOCKET_NAME, strerror(errno));
+    // NFC_LOGE(IPC, "Could not connect to %s socket: %s\n", NFCD_SOCKET_NAME, strerror(errno));
     return -1;
   }
 
@@ -82,6 +85,10 @@ void NfcIpcSocket::setSocketListener(IpcSocketListener* listener) {
   mListener = listener;
 }
 
+void NfcIpcSocket::setClientSocket(int fd) {
+  mClientFd = fd;
+}
+
 void NfcIpcSocket::loop()
 {
   bool connected = false;
@@ -92,28 +99,34 @@ void NfcIpcSocket::loop()
     struct sockaddr_un peeraddr;
     socklen_t socklen = sizeof (peeraddr);
 
-    if (!connected) {
-      nfcdConn = getListenSocket();
+    if (mClientFd >= 0) {
+      nfcdRw = mClientFd;
+      mClientFd = -1;
+    } else {
       if (nfcdConn < 0) {
-        nanosleep(&mSleep_spec, &mSleep_spec_rem);
-        continue;
+        nfcdConn = getListenSocket();
+        if (nfcdConn < 0) {
+          nanosleep(&mSleep_spec, &mSleep_spec_rem);
+          continue;
+        }
+        StartupTiming::Instance()->mark(StartupTiming::PHASE_SOCKET_READY);
       }
-    }
 
-    nfcdRw = accept(nfcdConn, (struct sockaddr*)&peeraddr, &socklen);
+      nfcdRw = accept(nfcdConn, (struct sockaddr*)&peeraddr, &socklen);
+    }
 
     if (nfcdRw < 0 ) {
-      ALOGE("Error on accept() errno:%d", errno);
+      NFC_LOGE(IPC, "Error on accept() errno:%d", errno);
       /* start listening for new connections again */
       continue;
     }
 
     ret = fcntl(nfcdRw, F_SETFL, O_NONBLOCK);
     if (ret < 0) {
-      ALOGE ("Error setting O_NONBLOCK errno:%d", errno);
+      NFC_LOGE(IPC, "Error setting O_NONBLOCK errno:%d", errno);
     }
 
-    ALOGD("Socket connected");
+    NFC_LOGD(IPC, "Socket connected");
     connected = true;
 
     RecordStream *rs = record_stream_new(nfcdRw, MAX_COMMAND_BYTES);
@@ -133,13 +146,14 @@ void NfcIpcSocket::loop()
         void* data;
         size_t dataLen;
         int ret = record_stream_get_next(rs, &data, &dataLen);
-        ALOGD(" %d of bytes to be sent... data=%p ret=%d", dataLen, data, ret);
+        NFC_LOGD(IPC, " %d of bytes to be sent... data=%p ret=%d", dataLen, data, ret);
         if (ret == 0 && data == NULL) {
           // end-of-stream
           break;
         } else if (ret < 0) {
           break;
         }
+        NFCD_TRACE_SCOPE_ARG(TRACE_IPC_RECORD, dataLen);
         writeToIncomingQueue((uint8_t*)data, dataLen);
       }
     }
@@ -153,30 +167,29 @@ void NfcIpcSocket::loop()
 // Write NFC data to Gecko
 // Outgoing queue contain the data should be send to gecko
 // TODO check thread, this should run on the NfcService thread.
-void NfcIpcSocket::writeToOutgoingQueue(uint8_t* data, size_t dataLen)
+void NfcIpcSocket::writeToOutgoingQueue(const uint8_t* frame, size_t frameLen)
 {
-  ALOGD("%s enter, data=%p, dataLen=%d", __func__, data, dataLen);
+  NFC_LOGD(IPC, "%s enter, frame=%p, frameLen=%d", __func__, frame, frameLen);
 
-  if (data == NULL || dataLen == 0) {
+  if (frame == NULL || frameLen == 0) {
     return;
   }
 
   size_t writeOffset = 0;
   int written = 0;
 
-  size_t size = __builtin_bswap32(dataLen);
-  write(nfcdRw, (void*)&size, sizeof(uint32_t));
-
-  ALOGD("Writing %d bytes to gecko ", dataLen);
-  while (writeOffset < dataLen) {
+  // The frame already starts with its Big-Endian size, so the whole
+  // message goes out in one write in the common case.
+  NFC_LOGD(IPC, "Writing %d bytes to gecko ", frameLen);
+  while (writeOffset < frameLen) {
     do {
-      written = write (nfcdRw, data + writeOffset, dataLen - writeOffset);
+      written = write (nfcdRw, frame + writeOffset, frameLen - writeOffset);
     } while (written < 0 && errno == EINTR);
 
     if (written >= 0) {
       writeOffset += written;
     } else {
-      ALOGE("Response: unexpected error on write errno:%d", errno);
+      NFC_LOGE(IPC, "Response: unexpected error on write errno:%d", errno);
       break;
     }
   }
@@ -187,7 +200,7 @@ void NfcIpcSocket::writeToOutgoingQueue(uint8_t* data, size_t dataLen)
 // TODO check thread, this should run on top of main thread of nfcd.
 void NfcIpcSocket::writeToIncomingQueue(uint8_t* data, size_t dataLen)
 {
-  ALOGD("%s enter, data=%p, dataLen=%d", __func__, data, dataLen);
+  NFC_LOGD(IPC, "%s enter, data=%p, dataLen=%d", __func__, data, dataLen);
 
   if (data != NULL && dataLen > 0) {
     sMsgHandler->processRequest(data, dataLen);
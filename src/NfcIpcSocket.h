@@ -6,8 +6,9 @@
 #define mozilla_nfcd_NfcIpcSocket_h
 
 #include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
-#include <binder/Parcel.h>
 
 class MessageHandler;
 class IpcSocketListener;
@@ -25,7 +26,23 @@ public:
 
   void setSocketListener(IpcSocketListener* lister);
 
-  void writeToOutgoingQueue(uint8_t *data, size_t dataLen);
+  /**
+   * Serve an already connected socket first, instead of waiting for a
+   * client on the nfcd control socket. Used by the benchmark client.
+   *
+   * @param  fd Connected stream socket; closed when the client leaves.
+   * @return    None.
+   */
+  void setClientSocket(int fd);
+
+  /**
+   * Send a complete frame, size prefix included, to the client.
+   *
+   * @param  frame    Frame built by WireWriter.
+   * @param  frameLen Length of the frame.
+   * @return          None.
+   */
+  void writeToOutgoingQueue(const uint8_t* frame, size_t frameLen);
   void writeToIncomingQueue(uint8_t *data, size_t dataLen);
 
 private:
@@ -37,6 +54,7 @@ private:
   static MessageHandler* sMsgHandler;
 
   IpcSocketListener* mListener;
+  int mClientFd;
 
   void initSocket();
   int getListenSocket();
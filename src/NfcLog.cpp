@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "NfcLog.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <cutils/properties.h>
+
+volatile uint8_t gNfcLogLevel[NFC_LOG_SS_COUNT] = {
+  ANDROID_LOG_DEBUG,  // ipc
+  ANDROID_LOG_DEBUG,  // service
+  ANDROID_LOG_DEBUG,  // tag
+  ANDROID_LOG_DEBUG,  // p2p
+  ANDROID_LOG_DEBUG,  // snep
+  ANDROID_LOG_DEBUG   // handover
+};
+volatile bool gNfcLogPayload = false;
+
+static const char* sSubsystemNames[NFC_LOG_SS_COUNT] = {
+  "ipc", "service", "tag", "p2p", "snep", "handover"
+};
+
+static pthread_mutex_t sHexdumpMutex = PTHREAD_MUTEX_INITIALIZER;
+static time_t sHexdumpSecond = 0;
+static int sHexdumpCount = 0;
+static int sHexdumpDropped = 0;
+
+static int parseLevel(const char* value, int defaultLevel)
+{
+  switch (value[0]) {
+    case 'v': case 'V': return ANDROID_LOG_VERBOSE;
+    case 'd': case 'D': return ANDROID_LOG_DEBUG;
+    case 'i': case 'I': return ANDROID_LOG_INFO;
+    case 'w': case 'W': return ANDROID_LOG_WARN;
+    case 'e': case 'E': return ANDROID_LOG_ERROR;
+    case 's': case 'S': return ANDROID_LOG_SILENT;
+    default:            return defaultLevel;
+  }
+}
+
+void NfcLog::initialize()
+{
+  char name[PROPERTY_KEY_MAX];
+  char value[PROPERTY_VALUE_MAX];
+
+  for (int i = 0; i < NFC_LOG_SS_COUNT; i++) {
+    snprintf(name, sizeof(name), "nfcd.log.%s", sSubsystemNames[i]);
+    if (property_get(name, value, "") > 0) {
+      gNfcLogLevel[i] = parseLevel(value, gNfcLogLevel[i]);
+    }
+  }
+
+  if (property_get("nfcd.log.payload", value, "0") > 0) {
+    gNfcLogPayload = value[0] == '1' || value[0] == 'y' || value[0] == 't';
+  }
+}
+
+void NfcLog::setLevel(NfcLogSubsystem ss, int priority)
+{
+  if (ss >= 0 && ss < NFC_LOG_SS_COUNT) {
+    gNfcLogLevel[ss] = priority;
+  }
+}
+
+void NfcLog::hexdump(const char* tag, const char* label, const uint8_t* data, size_t len)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  int dropped;
+  pthread_mutex_lock(&sHexdumpMutex);
+  if (now.tv_sec != sHexdumpSecond) {
+    sHexdumpSecond = now.tv_sec;
+    sHexdumpCount = 0;
+  }
+  if (sHexdumpCount >= MAX_HEXDUMPS_PER_SEC) {
+    sHexdumpDropped++;
+    pthread_mutex_unlock(&sHexdumpMutex);
+    return;
+  }
+  sHexdumpCount++;
+  dropped = sHexdumpDropped;
+  sHexdumpDropped = 0;
+  pthread_mutex_unlock(&sHexdumpMutex);
+
+  size_t shown = len < MAX_HEXDUMP_BYTES ? len : MAX_HEXDUMP_BYTES;
+  LOG_PRI(ANDROID_LOG_DEBUG, tag, "%s: %zu bytes%s (%d dumps rate-limited)",
+          label, len, shown < len ? ", truncated" : "", dropped);
+
+  // "0000: " + 16 * "xx " + NUL.
+  char line[6 + 16 * 3 + 1];
+  for (size_t offset = 0; offset < shown; offset += 16) {
+    int pos = snprintf(line, sizeof(line), "%04zx: ", offset);
+    for (size_t i = offset; i < shown && i < offset + 16; i++) {
+      pos += snprintf(line + pos, sizeof(line) - pos, "%02x ", data[i]);
+    }
+    LOG_PRI(ANDROID_LOG_DEBUG, tag, "%s", line);
+  }
+}
@@ -0,0 +1,129 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_NfcLog_h
+#define mozilla_nfcd_NfcLog_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cutils/log.h>
+
+/**
+ * Per-subsystem logging.
+ *
+ *   NFC_LOGD(TAG, "%s: read %u bytes", FUNC, len);
+ *
+ * A message is emitted only if its priority passes both the compile-time
+ * floor of the subsystem (NFCD_LOG_MIN_LEVEL_<SUBSYSTEM>, a constant, so a
+ * disabled level compiles to nothing) and the runtime level of the
+ * subsystem (property nfcd.log.<subsystem>, one of v/d/i/w/e/s).
+ *
+ * Payload bytes are never logged one per line; NFC_LOG_HEXDUMP writes a
+ * rate-limited hexdump record, off unless nfcd.log.payload is set.
+ */
+typedef enum {
+  NFC_LOG_SS_IPC = 0,
+  NFC_LOG_SS_SERVICE,
+  NFC_LOG_SS_TAG,
+  NFC_LOG_SS_P2P,
+  NFC_LOG_SS_SNEP,
+  NFC_LOG_SS_HANDOVER,
+  NFC_LOG_SS_COUNT
+} NfcLogSubsystem;
+
+// Compile-time floor shared by all subsystems. Debug builds keep every
+// level, release builds drop verbose and debug messages entirely.
+#ifndef NFCD_LOG_MIN_LEVEL
+#ifdef DEBUG
+#define NFCD_LOG_MIN_LEVEL ANDROID_LOG_VERBOSE
+#else
+#define NFCD_LOG_MIN_LEVEL ANDROID_LOG_INFO
+#endif
+#endif
+
+#ifndef NFCD_LOG_MIN_LEVEL_IPC
+#define NFCD_LOG_MIN_LEVEL_IPC NFCD_LOG_MIN_LEVEL
+#endif
+#ifndef NFCD_LOG_MIN_LEVEL_SERVICE
+#define NFCD_LOG_MIN_LEVEL_SERVICE NFCD_LOG_MIN_LEVEL
+#endif
+#ifndef NFCD_LOG_MIN_LEVEL_TAG
+#define NFCD_LOG_MIN_LEVEL_TAG NFCD_LOG_MIN_LEVEL
+#endif
+#ifndef NFCD_LOG_MIN_LEVEL_P2P
+#define NFCD_LOG_MIN_LEVEL_P2P NFCD_LOG_MIN_LEVEL
+#endif
+#ifndef NFCD_LOG_MIN_LEVEL_SNEP
+#define NFCD_LOG_MIN_LEVEL_SNEP NFCD_LOG_MIN_LEVEL
+#endif
+#ifndef NFCD_LOG_MIN_LEVEL_HANDOVER
+#define NFCD_LOG_MIN_LEVEL_HANDOVER NFCD_LOG_MIN_LEVEL
+#endif
+
+// Runtime level of each subsystem, indexed by NfcLogSubsystem.
+extern volatile uint8_t gNfcLogLevel[NFC_LOG_SS_COUNT];
+// Whether payload hexdumps are enabled.
+extern volatile bool gNfcLogPayload;
+
+#define NFC_LOG_ENABLED(ss, prio) \
+  ((prio) >= NFCD_LOG_MIN_LEVEL_##ss && (prio) >= gNfcLogLevel[NFC_LOG_SS_##ss])
+
+#define NFC_LOG(ss, prio, ...) \
+  do { \
+    if (NFC_LOG_ENABLED(ss, prio)) \
+      LOG_PRI(prio, LOG_TAG, __VA_ARGS__); \
+  } while (0)
+
+#define NFC_LOGV(ss, ...) NFC_LOG(ss, ANDROID_LOG_VERBOSE, __VA_ARGS__)
+#define NFC_LOGD(ss, ...) NFC_LOG(ss, ANDROID_LOG_DEBUG, __VA_ARGS__)
+#define NFC_LOGI(ss, ...) NFC_LOG(ss, ANDROID_LOG_INFO, __VA_ARGS__)
+#define NFC_LOGW(ss, ...) NFC_LOG(ss, ANDROID_LOG_WARN, __VA_ARGS__)
+#define NFC_LOGE(ss, ...) NFC_LOG(ss, ANDROID_LOG_ERROR, __VA_ARGS__)
+
+#define NFC_LOG_HEXDUMP(ss, label, data, len) \
+  do { \
+    if (NFC_LOG_ENABLED(ss, ANDROID_LOG_DEBUG) && gNfcLogPayload) \
+      NfcLog::hexdump(LOG_TAG, label, data, len); \
+  } while (0)
+
+class NfcLog {
+public:
+  // Bytes shown by one hexdump record; the rest is summarized.
+  static const size_t MAX_HEXDUMP_BYTES = 256;
+  // Hexdump records allowed per second.
+  static const int MAX_HEXDUMPS_PER_SEC = 4;
+
+  /**
+   * Load the runtime levels from the nfcd.log.* system properties.
+   *
+   * @return None.
+   */
+  static void initialize();
+
+  /**
+   * Change the runtime level of a subsystem.
+   *
+   * @param  ss       Subsystem.
+   * @param  priority Lowest android_LogPriority that is emitted.
+   * @return          None.
+   */
+  static void setLevel(NfcLogSubsystem ss, int priority);
+
+  /**
+   * Log a buffer as a hexdump record, 16 bytes per line. Records over the
+   * rate limit are dropped and counted in the next emitted record.
+   *
+   * @param  tag   Log tag.
+   * @param  label What the buffer is.
+   * @param  data  Buffer.
+   * @param  len   Length of the buffer.
+   * @return       None.
+   */
+  static void hexdump(const char* tag, const char* label, const uint8_t* data, size_t len);
+
+private:
+  NfcLog();
+};
+
+#endif // mozilla_nfcd_NfcLog_h
@@ -5,6 +5,9 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cutils/properties.h>
 
 #include "MessageHandler.h"
 #include "INfcManager.h"
@@ -15,10 +18,19 @@
 #include "NfcService.h"
 #include "NfcUtil.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
 #include "P2pLinkManager.h"
+#include "ProvisioningJob.h"
+#include "SessionManager.h"
+#include "StartupTiming.h"
+#include "TapLatency.h"
+#include "TraceRing.h"
 
 using namespace android;
 
+// Whether the client left NFC on, "1" or "0".
+#define NFC_ENABLED_PROPERTY "persist.nfcd.enabled"
+
 typedef enum {
   MSG_UNDEFINED = 0,
   MSG_LLCP_LINK_ACTIVATION,
@@ -39,37 +51,82 @@ typedef enum {
   MSG_MAKE_NDEF_READONLY,
   MSG_ENABLE_DISCOVERY,
   MSG_ENABLE,
+  MSG_TRANSCEIVE,
+  MSG_START_PROVISIONING,
+  MSG_STOP_PROVISIONING,
+  MSG_SET_DISCOVERY_POLICY,
+  MSG_DEFINE_DISCOVERY_PROFILE,
+  MSG_SELECT_DISCOVERY_PROFILE,
+  MSG_STANDBY,
+  MSG_WARM_UP,
 } NfcEventType;
 
 class NfcEvent {
 public:
-  NfcEvent (NfcEventType type) :mType(type) {}
+  NfcEvent (NfcEventType type) :sessionId(0), waiters(1), mType(type) {}
 
   NfcEventType getType() { return mType; }
 
   int arg1;
   int arg2;
   void* obj;
+  // Session of the request or tag the event is for, 0 if none.
+  int sessionId;
+  // Requests answered by this event; more than 1 once identical requests
+  // were coalesced into it.
+  int waiters;
 
 private:
   NfcEventType mType;
 };
 
+/**
+ * Bounds the tag operations of one request by its timeout, and lifts the
+ * deadline when the request is done so that it does not apply to the next
+ * tag operations, e.g. the NDEF read of a new tag.
+ */
+class RequestDeadline {
+public:
+  RequestDeadline(INfcTag* tag, int timeoutMs) : mTag(tag) { mTag->setDeadline(timeoutMs); }
+  ~RequestDeadline() { mTag->setDeadline(0); }
+
+private:
+  INfcTag* mTag;
+};
+
 static pthread_t thread_id;
 static sem_t thread_sem;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 NfcService* NfcService::sInstance = NULL;
 NfcManager* NfcService::sNfcManager = NULL;
 
 NfcService::NfcService()
  : mIsEnable(false)
+ , mInStandby(false)
+ , mProvisioningJob(NULL)
+ , mProvisionedSessionId(0)
+ , mProfileId(NFC_DISCOVERY_PROFILE_DEFAULT)
 {
   mP2pLinkManager = new P2pLinkManager(this);
+
+  static const uint32_t ALL_TAGS = NFC_POLL_NFCA | NFC_POLL_NFCB | NFC_POLL_NFCF |
+                                   NFC_POLL_NFCV | NFC_POLL_B_PRIME | NFC_POLL_KOVIO;
+  static const uint32_t P2P = NFC_POLL_NFCA | NFC_POLL_NFCF | NFC_POLL_ACTIVE;
+  memset(mProfileDefined, 0, sizeof(mProfileDefined));
+  memset(mNumEnables, 0, sizeof(mNumEnables));
+  memset(mTotalEnableUs, 0, sizeof(mTotalEnableUs));
+  mProfiles[NFC_DISCOVERY_PROFILE_TAGS] = DiscoveryProfile(ALL_TAGS, 0, DiscoveryProfile::CONFIGURED);
+  mProfiles[NFC_DISCOVERY_PROFILE_P2P] = DiscoveryProfile(P2P, P2P, DiscoveryProfile::CONFIGURED);
+  for (uint32_t i = 0; i < NFC_DISCOVERY_PROFILE_FIRST_CUSTOM; i++) {
+    mProfileDefined[i] = true;
+  }
 }
 
 NfcService::~NfcService()
 {
   delete mP2pLinkManager;
+  delete mProvisioningJob;
 }
 
 static void *serviceThreadFunc(void *arg)
@@ -82,12 +139,12 @@ static void *serviceThreadFunc(void *arg)
 void NfcService::initialize(NfcManager* pNfcManager, MessageHandler* msgHandler)
 {
   if (sem_init(&thread_sem, 0, 0) == -1) {
-    ALOGE("%s: init_nfc_service Semaphore creation failed", FUNC);
+    NFC_LOGE(SERVICE, "%s: init_nfc_service Semaphore creation failed", FUNC);
     abort();
   }
 
   if (pthread_create(&thread_id, NULL, serviceThreadFunc, this) != 0) {
-    ALOGE("%s: init_nfc_service pthread_create failed", FUNC);
+    NFC_LOGE(SERVICE, "%s: init_nfc_service pthread_create failed", FUNC);
     abort();
   }
 
@@ -95,69 +152,77 @@ void NfcService::initialize(NfcManager* pNfcManager, MessageHandler* msgHandler)
   sNfcManager = pNfcManager;
 }
 
+bool NfcService::wasEnabled()
+{
+  char value[PROPERTY_VALUE_MAX];
+  property_get(NFC_ENABLED_PROPERTY, value, "0");
+  return value[0] == '1';
+}
+
+void NfcService::warmUp()
+{
+  NfcEvent *event = new NfcEvent(MSG_WARM_UP);
+  queueEvent(event);
+}
+
 void NfcService::notifyLlcpLinkActivation(void* pDevice)
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
   NfcEvent *event = new NfcEvent(MSG_LLCP_LINK_ACTIVATION);
   event->obj = pDevice;
-  NfcService::Instance()->mQueue.push_back(event);
-  sem_post(&thread_sem);
+  NfcService::Instance()->queueEvent(event);
 }
 
 void NfcService::notifyLlcpLinkDeactivation(void* pDevice)
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
   NfcEvent *event = new NfcEvent(MSG_LLCP_LINK_DEACTIVATION);
   event->obj = pDevice;
-  NfcService::Instance()->mQueue.push_back(event);
-  sem_post(&thread_sem);
+  NfcService::Instance()->queueEvent(event);
 }
 
 void NfcService::notifyTagDiscovered(void* pTag)
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
   NfcEvent *event = new NfcEvent(MSG_TAG_DISCOVERED);
   event->obj = pTag;
-  NfcService::Instance()->mQueue.push_back(event);
-  sem_post(&thread_sem);
+  TapLatency::Instance()->mark(TapLatency::STAGE_TAG_QUEUED);
+  NfcService::Instance()->queueEvent(event);
 }
 
-void NfcService::notifyTagLost()
+void NfcService::notifyTagLost(int sessionId)
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
   NfcEvent *event = new NfcEvent(MSG_TAG_LOST);
   event->obj = NULL;
-  NfcService::Instance()->mQueue.push_back(event);
-  sem_post(&thread_sem);
+  event->sessionId = sessionId;
+  NfcService::Instance()->queueEvent(event);
 }
 
 void NfcService::notifySEFieldActivated()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
   NfcEvent *event = new NfcEvent(MSG_SE_FIELD_ACTIVATED);
-  NfcService::Instance()->mQueue.push_back(event);
-  sem_post(&thread_sem);
+  NfcService::Instance()->queueEvent(event);
 }
 
 void NfcService::notifySEFieldDeactivated()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
   NfcEvent *event = new NfcEvent(MSG_SE_FIELD_DEACTIVATED);
-  NfcService::Instance()->mQueue.push_back(event);
-  sem_post(&thread_sem);
+  NfcService::Instance()->queueEvent(event);
 }
 
 void NfcService::notifySETransactionListeners()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
   NfcEvent *event = new NfcEvent(MSG_SE_NOTIFY_TRANSACTION_LISTENERS);
-  NfcService::Instance()->mQueue.push_back(event);
-  sem_post(&thread_sem);
+  NfcService::Instance()->queueEvent(event);
 }
 
 void NfcService::handleLlcpLinkDeactivation(NfcEvent* event)
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
 
   void* pDevice = event->obj;
   IP2pDevice* pIP2pDevice = reinterpret_cast<IP2pDevice*>(pDevice);
@@ -167,11 +232,13 @@ void NfcService::handleLlcpLinkDeactivation(NfcEvent* event)
   }
 
   mP2pLinkManager->onLlcpDeactivated();
+
+  SessionManager::Instance()->closeSession(SessionManager::Instance()->findSession(pDevice));
 }
 
 void NfcService::handleLlcpLinkActivation(NfcEvent* event)
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
   void* pDevice = event->obj;
   IP2pDevice* pIP2pDevice = reinterpret_cast<IP2pDevice*>(pDevice);
 
@@ -179,10 +246,10 @@ void NfcService::handleLlcpLinkActivation(NfcEvent* event)
       pIP2pDevice->getMode() == NfcDepEndpoint::MODE_P2P_INITIATOR) {
     if (pIP2pDevice->getMode() == NfcDepEndpoint::MODE_P2P_TARGET) {
       if (pIP2pDevice->connect()) {
-        ALOGD("%s: Connected to device!", FUNC);
+        NFC_LOGD(SERVICE, "%s: Connected to device!", FUNC);
       }
       else {
-        ALOGE("%s: Cannot connect remote Target. Polling loop restarted.", FUNC);
+        NFC_LOGE(SERVICE, "%s: Cannot connect remote Target. Polling loop restarted.", FUNC);
       }
     }
 
@@ -191,35 +258,43 @@ void NfcService::handleLlcpLinkActivation(NfcEvent* event)
     if (ret == true) {
       ret = pINfcManager->activateLlcp();
       if (ret == true) {
-        ALOGD("%s: Target Activate LLCP OK", FUNC);
+        NFC_LOGD(SERVICE, "%s: Target Activate LLCP OK", FUNC);
       } else {
-        ALOGE("%s: doActivateLLcp failed", FUNC);
+        NFC_LOGE(SERVICE, "%s: doActivateLLcp failed", FUNC);
       }
     } else {
-      ALOGE("%s: doCheckLLcp failed", FUNC);
+      NFC_LOGE(SERVICE, "%s: doCheckLLcp failed", FUNC);
     }
   } else {
-    ALOGE("%s: Unknown LLCP P2P mode", FUNC);
+    NFC_LOGE(SERVICE, "%s: Unknown LLCP P2P mode", FUNC);
     //stop();
   }
 
   mP2pLinkManager->onLlcpActivated();
 
+  int sessionId = SessionManager::Instance()->openSession(SessionManager::SESSION_P2P, pDevice);
+  if (!sessionId) {
+    return;
+  }
+
   TechDiscoveredEvent* data = new TechDiscoveredEvent();
-  data->isNewSession = true;
   data->techCount = 1;
   uint8_t techs[] = { NFC_TECH_P2P };
   data->techList = &techs;
   data->ndefMsgCount = 0;
   data->ndefMsg = NULL;
-  mMsgHandler->processNotification(NFC_NOTIFICATION_TECH_DISCOVERED, data);
+  mMsgHandler->processNotification(NFC_NOTIFICATION_TECH_DISCOVERED, sessionId, data);
   delete data;
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(SERVICE, "%s: exit", FUNC);
 }
 
 static void *pollingThreadFunc(void *arg)
 {
-  INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(arg);
+  int sessionId = (int) reinterpret_cast<intptr_t>(arg);
+  INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(SessionManager::Instance()->getEndpoint(sessionId));
+  if (!pINfcTag) {
+    return NULL;
+  }
 
   // TODO : check if check tag presence here is correct
   // For android. it use startPresenceChecking API in INfcTag.java
@@ -229,7 +304,7 @@ static void *pollingThreadFunc(void *arg)
 
   pINfcTag->disconnect();
 
-  NfcService::Instance()->notifyTagLost();
+  NfcService::Instance()->notifyTagLost(sessionId);
   return NULL;
 }
 
@@ -237,10 +312,18 @@ void NfcService::handleTagDiscovered(NfcEvent* event)
 {
   void* pTag = event->obj;
   INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(pTag);
+  TapLatency* latency = TapLatency::Instance();
+  latency->mark(TapLatency::STAGE_TAG_DEQUEUED);
+
+  if (mProvisioningJob) {
+    provisionTag(pINfcTag);
+    return;
+  }
 
   // To get complete tag information, need to call read ndef first.
   // In findAndReadNdef function, it will add NDEF related info in NfcTagManager.
   NdefMessage* pNdefMessage = pINfcTag->findAndReadNdef();
+  latency->mark(TapLatency::STAGE_NDEF_READ);
 
   // Do the following after read ndef.
   std::vector<TagTechnology>& techList = pINfcTag->getTechList();
@@ -251,41 +334,100 @@ void NfcService::handleTagDiscovered(NfcEvent* event)
     gonkTechList[i] = (uint8_t)NfcUtil::convertTagTechToGonkFormat(techList[i]);
   }
 
+  int sessionId = SessionManager::Instance()->openSession(SessionManager::SESSION_TAG, pINfcTag);
+  if (!sessionId) {
+    // Released so that discovery goes on.
+    pINfcTag->disconnect();
+    delete[] gonkTechList;
+    delete pNdefMessage;
+    return;
+  }
+
   TechDiscoveredEvent* data = new TechDiscoveredEvent();
-  data->isNewSession = true;
   data->techCount = techCount;
   data->techList = gonkTechList;
   data->ndefMsgCount = pNdefMessage ? 1 : 0;
   data->ndefMsg = pNdefMessage;
-  mMsgHandler->processNotification(NFC_NOTIFICATION_TECH_DISCOVERED, data);
+  mMsgHandler->processNotification(NFC_NOTIFICATION_TECH_DISCOVERED, sessionId, data);
+  latency->mark(TapLatency::STAGE_TECH_NOTIFIED);
 
-  delete gonkTechList;
+  delete[] gonkTechList;
   delete data;
 
   pthread_t tid;
-  pthread_create(&tid, NULL, pollingThreadFunc, pINfcTag);
+  pthread_create(&tid, NULL, pollingThreadFunc, reinterpret_cast<void*>(sessionId));
+}
+
+void NfcService::provisionTag(INfcTag* pINfcTag)
+{
+  ProvisionResult result;
+  mProvisioningJob->provision(pINfcTag, result);
+  mMsgHandler->processNotification(NFC_NOTIFICATION_PROVISIONED, 0, &result);
+  if (mProvisioningJob->isDone()) {
+    endProvisioning();
+  }
+
+  // The presence check releases the tag once it leaves the field, so that
+  // the next one is discovered.
+  int sessionId = SessionManager::Instance()->openSession(SessionManager::SESSION_TAG, pINfcTag);
+  if (!sessionId) {
+    pINfcTag->disconnect();
+    return;
+  }
+  mProvisionedSessionId = sessionId;
+  // Nobody joins it, and a job may go through thousands of tags.
+  pthread_t tid;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&tid, &attr, pollingThreadFunc, reinterpret_cast<void*>(sessionId)) != 0) {
+    NFC_LOGE(SERVICE, "%s: cannot start the presence check", FUNC);
+  }
+  pthread_attr_destroy(&attr);
+}
+
+void NfcService::endProvisioning()
+{
+  if (!mProvisioningJob)
+    return;
+  mProvisioningJob->logSummary();
+  delete mProvisioningJob;
+  mProvisioningJob = NULL;
 }
 
 void NfcService::handleTagLost(NfcEvent* event)
 {
-  mMsgHandler->processNotification(NFC_NOTIFICATION_TECH_LOST, NULL);
+  SessionManager::Instance()->closeSession(event->sessionId);
+  if (event->sessionId == mProvisionedSessionId) {
+    // The client never heard of this tag.
+    mProvisionedSessionId = 0;
+    return;
+  }
+  mMsgHandler->processNotification(NFC_NOTIFICATION_TECH_LOST, event->sessionId, NULL);
 }
 
 void* NfcService::eventLoop()
 {
-  ALOGD("%s: NFCService started", FUNC);
+  NFC_LOGD(SERVICE, "%s: NFCService started", FUNC);
   while(true) {
     if(sem_wait(&thread_sem)) {
-      ALOGE("%s: Failed to wait for semaphore", FUNC);
+      NFC_LOGE(SERVICE, "%s: Failed to wait for semaphore", FUNC);
       abort();
     }
 
-    while (!mQueue.empty()) {
+    while (true) {
+      pthread_mutex_lock(&queue_mutex);
+      if (mQueue.empty()) {
+        pthread_mutex_unlock(&queue_mutex);
+        break;
+      }
       NfcEvent* event = *mQueue.begin();
       mQueue.erase(mQueue.begin());
+      pthread_mutex_unlock(&queue_mutex);
       NfcEventType eventType = event->getType();
+      NFCD_TRACE_SCOPE_ARG(TRACE_SERVICE_EVENT, eventType);
 
-      ALOGD("%s: NFCService msg=%d", FUNC, eventType);
+      NFC_LOGD(SERVICE, "%s: NFCService msg=%d", FUNC, eventType);
       switch(eventType) {
         case MSG_LLCP_LINK_ACTIVATION:
           handleLlcpLinkActivation(event);
@@ -304,6 +446,7 @@ void* NfcService::eventLoop()
           break;
         case MSG_READ_NDEF_DETAIL:
           handleReadNdefDetailResponse(event);
+          break;
         case MSG_READ_NDEF:
           handleReadNdefResponse(event);
           break;
@@ -314,7 +457,7 @@ void* NfcService::eventLoop()
           handleCloseResponse(event);
           break;
         case MSG_SOCKET_CONNECTED:
-          mMsgHandler->processNotification(NFC_NOTIFICATION_INITIALIZED , NULL);
+          mMsgHandler->processNotification(NFC_NOTIFICATION_INITIALIZED, 0, NULL);
           break;
         case MSG_PUSH_NDEF:
           handlePushNdefResponse(event);
@@ -328,8 +471,32 @@ void* NfcService::eventLoop()
         case MSG_ENABLE:
           handleEnableResponse(event);
           break;
+        case MSG_TRANSCEIVE:
+          handleTransceiveResponse(event);
+          break;
+        case MSG_START_PROVISIONING:
+          handleStartProvisioningResponse(event);
+          break;
+        case MSG_STOP_PROVISIONING:
+          handleStopProvisioningResponse(event);
+          break;
+        case MSG_SET_DISCOVERY_POLICY:
+          handleSetDiscoveryPolicyResponse(event);
+          break;
+        case MSG_DEFINE_DISCOVERY_PROFILE:
+          handleDefineDiscoveryProfileResponse(event);
+          break;
+        case MSG_SELECT_DISCOVERY_PROFILE:
+          handleSelectDiscoveryProfileResponse(event);
+          break;
+        case MSG_STANDBY:
+          handleStandbyResponse(event);
+          break;
+        case MSG_WARM_UP:
+          handleWarmUp(event);
+          break;
         default:
-          ALOGE("%s: NFCService bad message", FUNC);
+          NFC_LOGE(SERVICE, "%s: NFCService bad message", FUNC);
           abort();
       }
 
@@ -339,6 +506,87 @@ void* NfcService::eventLoop()
   }
 }
 
+void NfcService::queueEvent(NfcEvent* event)
+{
+  pthread_mutex_lock(&queue_mutex);
+  bool merged = coalesceEvent(event);
+  if (!merged) {
+    mQueue.push_back(event);
+  }
+  pthread_mutex_unlock(&queue_mutex);
+
+  if (merged) {
+    delete event;
+  } else {
+    sem_post(&thread_sem);
+  }
+}
+
+bool NfcService::coalesceEvent(NfcEvent* event)
+{
+  int type = event->getType();
+  if (!event->sessionId) {
+    return false;
+  }
+
+  switch (type) {
+    case MSG_READ_NDEF:
+    case MSG_READ_NDEF_DETAIL:
+      // Join a pending identical read of the session, unless something that
+      // may change the tag is queued after it.
+      for (List<NfcEvent*>::iterator it = mQueue.end(); it != mQueue.begin(); ) {
+        NfcEvent* queued = *--it;
+        // Control events, e.g. MSG_ENABLE or MSG_TAG_DISCOVERED, carry no
+        // session and may change the tag or the RF state; nothing is
+        // merged across them.
+        if (!queued->sessionId) {
+          break;
+        }
+        if (queued->sessionId != event->sessionId) {
+          continue;
+        }
+        if (queued->getType() == type) {
+          queued->waiters += event->waiters;
+          // The shared read must not be cut short for any of its waiters.
+          if (!queued->arg2 || !event->arg2) {
+            queued->arg2 = 0;
+          } else if (event->arg2 > queued->arg2) {
+            queued->arg2 = event->arg2;
+          }
+          NFC_LOGD(SERVICE, "%s: read %d of session %d joins a queued one (%d waiters)",
+                   FUNC, type, event->sessionId, queued->waiters);
+          return true;
+        }
+        if (queued->getType() != MSG_READ_NDEF &&
+            queued->getType() != MSG_READ_NDEF_DETAIL) {
+          break;
+        }
+      }
+      return false;
+
+    case MSG_WRITE_NDEF:
+      // A write of the session directly behind a supersedable one replaces
+      // it; the queue order is otherwise kept. Whether the merged write may
+      // be superseded in turn is up to the later one.
+      if (!mQueue.empty()) {
+        NfcEvent* last = *--mQueue.end();
+        if (last->getType() == MSG_WRITE_NDEF && last->arg1 &&
+            last->sessionId == event->sessionId) {
+          delete reinterpret_cast<NdefMessage*>(last->obj);
+          last->obj = event->obj;
+          last->arg1 = event->arg1;
+          last->arg2 = event->arg2;
+          last->waiters += event->waiters;
+          NFC_LOGD(SERVICE, "%s: write of session %d superseded (%d waiters)",
+                   FUNC, event->sessionId, last->waiters);
+          return true;
+        }
+      }
+      return false;
+  }
+  return false;
+}
+
 NfcService* NfcService::Instance() {
     if (!sInstance)
         sInstance = new NfcService();
@@ -357,82 +605,125 @@ bool NfcService::handleDisconnect()
   return result;
 }
 
-int NfcService::handleConnect(int technology)
+int NfcService::handleConnect(int sessionId, int technology)
 {
   INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(sNfcManager->queryInterface(INTERFACE_TAG_MANAGER));
   int status = pINfcTag->connectWithStatus(technology);
-  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS,  NULL);
+  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, sessionId, NULL);
   return status;
 }
 
-bool NfcService::handleConfigRequest(int powerLevel)
+bool NfcService::handleConfigRequest(ScreenState screenState)
 {
   NfcEvent *event = new NfcEvent(MSG_CONFIG);
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  event->arg1 = screenState;
+  queueEvent(event);
   return true;
 }
 
-bool NfcService::handleReadNdefDetailRequest()
+bool NfcService::handleReadNdefDetailRequest(int sessionId, int timeoutMs)
 {
   NfcEvent *event = new NfcEvent(MSG_READ_NDEF_DETAIL);
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  event->arg2 = timeoutMs;
+  event->sessionId = sessionId;
+  queueEvent(event);
   return true;
 }
 
 void NfcService::handleConfigResponse(NfcEvent* event)
 {
-  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, NULL);
+  sNfcManager->setScreenState(static_cast<ScreenState>(event->arg1));
+  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, 0, NULL);
+}
+
+bool NfcService::checkSession(NfcEvent* event, NfcResponseType response)
+{
+  if (SessionManager::Instance()->isValid(event->sessionId))
+    return true;
+
+  NFC_LOGW(SERVICE, "%s: drop request for closed session %d", FUNC, event->sessionId);
+  for (int i = 0; i < event->waiters; i++) {
+    mMsgHandler->processResponse(response, NFC_ERROR_INVALID_SESSION, event->sessionId, NULL);
+  }
+  return false;
 }
 
 void NfcService::handleReadNdefDetailResponse(NfcEvent* event)
 {
+  if (!checkSession(event, NFC_RESPONSE_READ_NDEF_DETAILS))
+    return;
+
   INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(sNfcManager->queryInterface(INTERFACE_TAG_MANAGER));
+  RequestDeadline deadline(pINfcTag, event->arg2);
   NdefDetail* pNdefDetail = pINfcTag->ReadNdefDetail();
+  NfcErrorCode error = NFC_ERROR_SUCCESS;
+  if (pINfcTag->hasTimedOut()) {
+    error = NFC_ERROR_TIMEOUT;
+  } else if (!pNdefDetail) {
+    error = NFC_ERROR_IO;
+  }
 
-  if (pNdefDetail != NULL) {
-    mMsgHandler->processResponse(NFC_RESPONSE_READ_NDEF_DETAILS, NFC_ERROR_SUCCESS, pNdefDetail);
-  } else {
-    //TODO can we notify null ndef detail?
+  // A failed request is answered with an empty detail, so that none of the
+  // merged requests waits forever.
+  for (int i = 0; i < event->waiters; i++) {
+    mMsgHandler->processResponse(NFC_RESPONSE_READ_NDEF_DETAILS, error, event->sessionId, pNdefDetail);
   }
 
   delete pNdefDetail;
 }
 
-bool NfcService::handleReadNdefRequest()
+bool NfcService::handleReadNdefRequest(int sessionId, int timeoutMs)
 {
   NfcEvent *event = new NfcEvent(MSG_READ_NDEF);
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  event->arg2 = timeoutMs;
+  event->sessionId = sessionId;
+  queueEvent(event);
   return true;
 }
 
 void NfcService::handleReadNdefResponse(NfcEvent* event)
 {
+  if (!checkSession(event, NFC_RESPONSE_READ_NDEF))
+    return;
+
   INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(sNfcManager->queryInterface(INTERFACE_TAG_MANAGER));
+  RequestDeadline deadline(pINfcTag, event->arg2);
   NdefMessage* pNdefMessage = pINfcTag->findAndReadNdef();
+  NfcErrorCode error = NFC_ERROR_SUCCESS;
+  if (pINfcTag->hasTimedOut()) {
+    error = NFC_ERROR_TIMEOUT;
+  } else if (!pNdefMessage) {
+    error = NFC_ERROR_IO;
+  }
 
-  ALOGD("pNdefMessage=%p",pNdefMessage);
-  if (pNdefMessage != NULL) {
-    mMsgHandler->processResponse(NFC_RESPONSE_READ_NDEF, NFC_ERROR_SUCCESS, pNdefMessage);
-  } else {
-    //TODO can we notify null ndef?
+  NFC_LOGD(SERVICE, "pNdefMessage=%p",pNdefMessage);
+  for (int i = 0; i < event->waiters; i++) {
+    mMsgHandler->processResponse(NFC_RESPONSE_READ_NDEF, error, event->sessionId, pNdefMessage);
   }
+
+  delete pNdefMessage;
 }
 
-bool NfcService::handleWriteNdefRequest(NdefMessage* ndef)
+bool NfcService::handleWriteNdefRequest(int sessionId, NdefMessage* ndef, bool supersedable, int timeoutMs)
 {
   NfcEvent *event = new NfcEvent(MSG_WRITE_NDEF);
   event->obj = ndef;
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  event->arg1 = supersedable;
+  event->arg2 = timeoutMs;
+  event->sessionId = sessionId;
+  queueEvent(event);
   return true;
 }
 
 void NfcService::handleWriteNdefResponse(NfcEvent* event)
 {
   NdefMessage* ndef = reinterpret_cast<NdefMessage*>(event->obj);
+  NfcErrorCode error = NFC_ERROR_SUCCESS;
+
+  if (!checkSession(event, NFC_RESPONSE_GENERAL)) {
+    delete ndef;
+    return;
+  }
 
   // Use single API wirte to send data.
   // nfcd check current connection is p2p or tag.
@@ -441,21 +732,29 @@ void NfcService::handleWriteNdefResponse(NfcEvent* event)
       mP2pLinkManager->push(*ndef);
     } else {
       INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(sNfcManager->queryInterface(INTERFACE_TAG_MANAGER));
-      pINfcTag->writeNdef(*ndef);
+      RequestDeadline deadline(pINfcTag, event->arg2);
+      if (!pINfcTag->writeNdef(*ndef)) {
+        // Larger than the tag, read-only, or the tag failed the write.
+        error = pINfcTag->hasTimedOut() ? NFC_ERROR_TIMEOUT : NFC_ERROR_IO;
+      }
     }
   } else {
-    ALOGE("%s: empty NDEF message", FUNC);
+    NFC_LOGE(SERVICE, "%s: empty NDEF message", FUNC);
+    error = NFC_ERROR_INVALID_PARAMETER;
   }
 
   delete ndef;
-  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, NULL);
+  // Superseded writes are answered with the result of the one that ran.
+  for (int i = 0; i < event->waiters; i++) {
+    mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, error, event->sessionId, NULL);
+  }
 }
 
-void NfcService::handleCloseRequest()
+void NfcService::handleCloseRequest(int sessionId)
 {
   NfcEvent *event = new NfcEvent(MSG_CLOSE);
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  event->sessionId = sessionId;
+  queueEvent(event);
 }
 
 void NfcService::handleCloseResponse(NfcEvent* event)
@@ -463,22 +762,20 @@ void NfcService::handleCloseResponse(NfcEvent* event)
   // TODO : If we call tag disconnect here, will keep trggering tag discover notification
   //        Need to check with DT what should we do here
 
-  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, NULL);
+  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, event->sessionId, NULL);
 }
 
 void NfcService::onConnected()
 {
   NfcEvent *event = new NfcEvent(MSG_SOCKET_CONNECTED);
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  queueEvent(event);
 }
 
 bool NfcService::handlePushNdefRequest(NdefMessage* ndef)
 {
   NfcEvent *event = new NfcEvent(MSG_PUSH_NDEF);
   event->obj = ndef;
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  queueEvent(event);
   return true;
 }
 
@@ -489,31 +786,216 @@ void NfcService::handlePushNdefResponse(NfcEvent* event)
   mP2pLinkManager->push(*ndef);
 
   delete ndef;
-  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, NULL);
+  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, event->sessionId, NULL);
 }
 
-bool NfcService::handleMakeNdefReadonlyRequest()
+bool NfcService::handleMakeNdefReadonlyRequest(int sessionId, int timeoutMs)
 {
   NfcEvent *event = new NfcEvent(MSG_MAKE_NDEF_READONLY);
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  event->arg2 = timeoutMs;
+  event->sessionId = sessionId;
+  queueEvent(event);
   return true;
 }
 
 void NfcService::handleMakeNdefReadonlyResponse(NfcEvent* event)
 {
+  if (!checkSession(event, NFC_RESPONSE_GENERAL))
+    return;
+
   INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(sNfcManager->queryInterface(INTERFACE_TAG_MANAGER));
-  bool result = pINfcTag->makeReadOnly();
+  RequestDeadline deadline(pINfcTag, event->arg2);
+  NfcErrorCode error = NFC_ERROR_SUCCESS;
+  if (!pINfcTag->makeReadOnly()) {
+    // Not lockable, or the tag failed the lock.
+    error = pINfcTag->hasTimedOut() ? NFC_ERROR_TIMEOUT : NFC_ERROR_IO;
+  }
 
-  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, NULL);
+  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, error, event->sessionId, NULL);
+}
+
+bool NfcService::handleTransceiveRequest(int sessionId, TransceiveBatch* batch, int timeoutMs)
+{
+  NfcEvent *event = new NfcEvent(MSG_TRANSCEIVE);
+  event->obj = batch;
+  event->arg2 = timeoutMs;
+  event->sessionId = sessionId;
+  queueEvent(event);
+  return true;
+}
+
+/**
+ * Whether the status word, the last two bytes of a response, lets a
+ * transceive batch go on.
+ */
+static bool statusWordMatches(const TransceiveBatch& batch, const std::vector<uint8_t>& response)
+{
+  if (response.size() < 2)
+    return false;
+  uint32_t sw = (response[response.size() - 2] << 8) | response[response.size() - 1];
+  return (sw & batch.statusWordMask) == batch.statusWordValue;
+}
+
+static uint32_t microsecondsSince(const struct timespec& start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+void NfcService::handleTransceiveResponse(NfcEvent* event)
+{
+  TransceiveBatch* batch = reinterpret_cast<TransceiveBatch*>(event->obj);
+  if (!checkSession(event, NFC_RESPONSE_TRANSCEIVE)) {
+    delete batch;
+    return;
+  }
+
+  INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(sNfcManager->queryInterface(INTERFACE_TAG_MANAGER));
+  NfcErrorCode error = NFC_ERROR_SUCCESS;
+
+  RequestDeadline deadline(pINfcTag, event->arg2);
+  if (pINfcTag->connectWithStatus(batch->technology) != 0) {
+    NFC_LOGE(SERVICE, "%s: cannot connect to technology %d", FUNC, batch->technology);
+    error = NFC_ERROR_IO;
+  }
+
+  // Back to back on this thread; nothing else reaches the tag in between.
+  for (uint32_t i = 0; error == NFC_ERROR_SUCCESS && i < batch->commands.size(); i++) {
+    TransceiveCommand& command = batch->commands[i];
+    batch->results.push_back(TransceiveResult());
+    TransceiveResult& result = batch->results.back();
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    TransceiveStatus status = pINfcTag->transceive(command.data, result.response, command.timeoutMs);
+    result.elapsedUs = microsecondsSince(start);
+
+    switch (status) {
+      case TRANSCEIVE_OK:
+        result.status = NFC_ERROR_SUCCESS;
+        break;
+      case TRANSCEIVE_TIMEOUT:
+        result.status = NFC_ERROR_TIMEOUT;
+        break;
+      default:
+        result.status = NFC_ERROR_IO;
+        break;
+    }
+    NFC_LOGD(SERVICE, "%s: command %u: status=%d, %zu bytes in %u us", FUNC, i,
+             result.status, result.response.size(), result.elapsedUs);
+
+    // The tag is gone, or was deactivated on a timeout.
+    if (status == TRANSCEIVE_TIMEOUT || status == TRANSCEIVE_TARGET_LOST || pINfcTag->hasTimedOut())
+      break;
+    if (status != TRANSCEIVE_OK && (batch->flags & NFC_TRANSCEIVE_STOP_ON_ERROR))
+      break;
+    if (status == TRANSCEIVE_OK && (batch->flags & NFC_TRANSCEIVE_STOP_ON_STATUS_WORD) &&
+        !statusWordMatches(*batch, result.response))
+      break;
+  }
+
+  if (pINfcTag->hasTimedOut()) {
+    error = NFC_ERROR_TIMEOUT;
+  }
+  mMsgHandler->processResponse(NFC_RESPONSE_TRANSCEIVE, error, event->sessionId, batch);
+  delete batch;
+}
+
+bool NfcService::handleStartProvisioningRequest(ProvisioningJob* job)
+{
+  NfcEvent *event = new NfcEvent(MSG_START_PROVISIONING);
+  event->obj = job;
+  queueEvent(event);
+  return true;
+}
+
+void NfcService::handleStartProvisioningResponse(NfcEvent* event)
+{
+  endProvisioning();
+  mProvisioningJob = reinterpret_cast<ProvisioningJob*>(event->obj);
+  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, 0, NULL);
+}
+
+bool NfcService::handleStopProvisioningRequest()
+{
+  NfcEvent *event = new NfcEvent(MSG_STOP_PROVISIONING);
+  queueEvent(event);
+  return true;
+}
+
+void NfcService::handleStopProvisioningResponse(NfcEvent* event)
+{
+  endProvisioning();
+  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, 0, NULL);
+}
+
+bool NfcService::handleSetDiscoveryPolicyRequest(DiscoveryPolicy* policy)
+{
+  NfcEvent *event = new NfcEvent(MSG_SET_DISCOVERY_POLICY);
+  event->obj = policy;
+  queueEvent(event);
+  return true;
+}
+
+void NfcService::handleSetDiscoveryPolicyResponse(NfcEvent* event)
+{
+  DiscoveryPolicy* policy = reinterpret_cast<DiscoveryPolicy*>(event->obj);
+  sNfcManager->setDiscoveryPolicy(*policy);
+  delete policy;
+  mMsgHandler->processResponse(NFC_RESPONSE_GENERAL, NFC_ERROR_SUCCESS, 0, NULL);
+}
+
+bool NfcService::handleDefineDiscoveryProfileRequest(uint32_t profileId, DiscoveryProfile* profile)
+{
+  NfcEvent *event = new NfcEvent(MSG_DEFINE_DISCOVERY_PROFILE);
+  event->arg1 = profileId;
+  event->obj = profile;
+  queueEvent(event);
+  return true;
+}
+
+void NfcService::handleDefineDiscoveryProfileResponse(NfcEvent* event)
+{
+  DiscoveryProfile* profile = reinterpret_cast<DiscoveryProfile*>(event->obj);
+  mProfiles[event->arg1] = *profile;
+  mProfileDefined[event->arg1] = true;
+  delete profile;
+  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, 0, NULL);
+}
+
+bool NfcService::handleSelectDiscoveryProfileRequest(uint32_t profileId)
+{
+  NfcEvent *event = new NfcEvent(MSG_SELECT_DISCOVERY_PROFILE);
+  event->arg1 = profileId;
+  queueEvent(event);
+  return true;
+}
+
+void NfcService::handleSelectDiscoveryProfileResponse(NfcEvent* event)
+{
+  uint32_t profileId = event->arg1;
+  if (!mProfileDefined[profileId]) {
+    NFC_LOGW(SERVICE, "%s: profile %u is not defined", FUNC, profileId);
+    mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_INVALID_PARAMETER, 0, NULL);
+    return;
+  }
+
+  if (mIsEnable && !sNfcManager->setDiscoveryProfile(mProfiles[profileId])) {
+    NFC_LOGW(SERVICE, "%s: tag or peer activated, profile %u not selected", FUNC, profileId);
+    mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_BUSY, 0, NULL);
+    return;
+  }
+
+  mProfileId = profileId;
+  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, 0, NULL);
 }
 
 bool NfcService::handleEnableDiscoveryRequest(bool enable)
 {
   NfcEvent *event = new NfcEvent(MSG_ENABLE_DISCOVERY);
   event->arg1 = enable;
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  queueEvent(event);
   return true;
 }
 
@@ -524,48 +1006,100 @@ void NfcService::handleEnableDiscoveryResponse(NfcEvent* event)
   bool enable = event->arg1;
   enableNfcDiscovery(enable);
 
-  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, NULL);
+  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, 0, NULL);
 }
 
 bool NfcService::handleEnableRequest(bool enable)
 {
   NfcEvent *event = new NfcEvent(MSG_ENABLE);
   event->arg1 = enable;
-  mQueue.push_back(event);
-  sem_post(&thread_sem);
+  queueEvent(event);
   return true;
 }
 
 void NfcService::handleEnableResponse(NfcEvent* event)
 {
   bool enable = event->arg1;
+  bool wasEnable = mIsEnable;
   if (enable) {
     enableNfc();
   } else {
     disableNfc();
   }
-  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, NULL);
+  if (mIsEnable != wasEnable) {
+    property_set(NFC_ENABLED_PROPERTY, mIsEnable ? "1" : "0");
+  }
+  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, 0, NULL);
 }
 
-void NfcService::enableNfc()
+bool NfcService::handleStandbyRequest()
 {
-  ALOGD("%s: enter", FUNC);
+  NfcEvent *event = new NfcEvent(MSG_STANDBY);
+  queueEvent(event);
+  return true;
+}
 
-  if (!mIsEnable) {
-    sNfcManager->initialize();
+void NfcService::handleStandbyResponse(NfcEvent* event)
+{
+  if (mIsEnable && !mInStandby) {
+    mInStandby = sNfcManager->standby(true);
+  }
+  mMsgHandler->processResponse(NFC_RESPONSE_CONFIG, NFC_ERROR_SUCCESS, 0, NULL);
+}
 
-    if (mP2pLinkManager)
+void NfcService::handleWarmUp(NfcEvent* event)
+{
+  // The client may have turned NFC on already.
+  if (mIsEnable)
+    return;
+
+  enableNfc();
+  mInStandby = sNfcManager->standby(true);
+}
+
+void NfcService::recordEnableTime(bool warm, uint32_t us)
+{
+  mNumEnables[warm]++;
+  mTotalEnableUs[warm] += us;
+  NFC_LOGI(SERVICE, "%s: NFC on in %u us (%s); %u cold, avg %u us; %u warm, avg %u us", FUNC,
+           us, warm ? "warm" : "cold",
+           mNumEnables[0], mNumEnables[0] ? (uint32_t)(mTotalEnableUs[0] / mNumEnables[0]) : 0,
+           mNumEnables[1], mNumEnables[1] ? (uint32_t)(mTotalEnableUs[1] / mNumEnables[1]) : 0);
+}
+
+void NfcService::enableNfc()
+{
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (mInStandby) {
+    // The stack is up, only discovery needs to restart.
+    sNfcManager->standby(false);
+    mInStandby = false;
+    recordEnableTime(true, microsecondsSince(start));
+  } else if (!mIsEnable) {
+    if (sNfcManager->initialize())
+      StartupTiming::Instance()->mark(StartupTiming::PHASE_NFA_ENABLED);
+    // Initializing starts over from the configuration.
+    if (mProfileId != NFC_DISCOVERY_PROFILE_DEFAULT)
+      sNfcManager->setDiscoveryProfile(mProfiles[mProfileId]);
+
+    if (mP2pLinkManager) {
       mP2pLinkManager->enableDisable(true);
+      StartupTiming::Instance()->mark(StartupTiming::PHASE_SERVERS_REGISTERED);
+    }
 
     mIsEnable = true;
+    recordEnableTime(false, microsecondsSince(start));
   }
 
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(SERVICE, "%s: exit", FUNC);
 }
 
 void NfcService::disableNfc()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SERVICE, "%s: enter", FUNC);
 
   if (mIsEnable) {
     if (mP2pLinkManager)
@@ -574,43 +1108,50 @@ void NfcService::disableNfc()
     sNfcManager->deinitialize();
 
     mIsEnable = false;
+    mInStandby = false;
   }
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(SERVICE, "%s: exit", FUNC);
 }
 
 bool NfcService::enableNfcDiscovery(bool enable)
 {
-  ALOGD("%s: enter, enable = %d", FUNC, enable);
+  NFC_LOGD(SERVICE, "%s: enter, enable = %d", FUNC, enable);
 
   if (enable) {
     if (mIsEnable) {
       sNfcManager->enableDiscovery();
+      // In standby discovery only starts with NFC_TURN_ON.
+      if (!mInStandby &&
+          StartupTiming::Instance()->mark(StartupTiming::PHASE_DISCOVERY_STARTED)) {
+        // NFC_NOTIFICATION_INITIALIZED went out before this phase.
+        mMsgHandler->processNotification(NFC_NOTIFICATION_STARTUP_TIMING, 0, NULL);
+      }
     } else {
-      ALOGE("%s: try to enable discovery before library is initialized.", FUNC);
+      NFC_LOGE(SERVICE, "%s: try to enable discovery before library is initialized.", FUNC);
       return false;
     }
   } else {
     if (mIsEnable) {
       sNfcManager->disableDiscovery();
     } else {
-      ALOGE("%s: try to disable discovery before library is initialized.", FUNC);
+      NFC_LOGE(SERVICE, "%s: try to disable discovery before library is initialized.", FUNC);
       return false;
     }
   }
 
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(SERVICE, "%s: exit", FUNC);
   return true;
 }
 
 void NfcService::onP2pReceivedNdef(NdefMessage* ndef)
 {
   TechDiscoveredEvent* data = new TechDiscoveredEvent();
-  data->isNewSession = false;
   data->techCount = 2;
   uint8_t techs[] = { NFC_TECH_P2P, NFC_TECH_NDEF };
   data->techList = &techs;
   data->ndefMsgCount = 1;
   data->ndefMsg = ndef;
-  mMsgHandler->processNotification(NFC_NOTIFICATION_TECH_DISCOVERED, data);
+  mMsgHandler->processNotification(NFC_NOTIFICATION_TECH_DISCOVERED,
+    SessionManager::Instance()->getCurrentId(SessionManager::SESSION_P2P), data);
   delete data;
 }
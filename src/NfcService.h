@@ -6,13 +6,17 @@
 #define mozilla_nfcd_NfcService_h
 
 #include "utils/List.h"
+#include "NfcGonkMessage.h"
 #include "IpcSocketListener.h"
 #include "NfcManager.h"
 
 class NdefMessage;
 class MessageHandler;
+struct TransceiveBatch;
+class ProvisioningJob;
 class NfcEvent;
 class INfcManager;
+class INfcTag;
 class P2pLinkManager;
 
 class NfcService : public IpcSocketListener {
@@ -20,13 +24,30 @@ public:
   ~NfcService();
   void initialize(NfcManager* pNfcManager, MessageHandler* msgHandler);
 
+  /**
+   * Bring NFC up on the service thread and put it in standby, so that it
+   * initializes while the client connects and its NFC_TURN_ON is a warm one.
+   *
+   * @return None.
+   */
+  void warmUp();
+
+  /**
+   * Check whether the client left NFC on, as kept in the
+   * "persist.nfcd.enabled" property, so that NFC is not brought up at boot
+   * for a user who turned it off.
+   *
+   * @return True if NFC was left on.
+   */
+  static bool wasEnabled();
+
   static NfcService* Instance();
   static INfcManager* getNfcManager();
 
   static void notifyLlcpLinkActivation(void* pDevice);
   static void notifyLlcpLinkDeactivation(void* pDevice);
   static void notifyTagDiscovered(void* pTag);
-  static void notifyTagLost();
+  static void notifyTagLost(int sessionId);
   static void notifySEFieldActivated();
   static void notifySEFieldDeactivated();
   static void notifySETransactionListeners();
@@ -39,25 +60,40 @@ public:
   void handleTagLost(NfcEvent* event);
   void handleLlcpLinkActivation(NfcEvent* event);
   void handleLlcpLinkDeactivation(NfcEvent* event);
-  int handleConnect(int technology);
-  bool handleConfigRequest(int powerLevel);
+  int handleConnect(int sessionId, int technology);
+  bool handleConfigRequest(ScreenState screenState);
   void handleConfigResponse(NfcEvent* event);
-  bool handleReadNdefDetailRequest();
+  bool handleReadNdefDetailRequest(int sessionId, int timeoutMs);
   void handleReadNdefDetailResponse(NfcEvent* event);
-  bool handleReadNdefRequest();
+  bool handleReadNdefRequest(int sessionId, int timeoutMs);
   void handleReadNdefResponse(NfcEvent* event);
-  bool handleWriteNdefRequest(NdefMessage* ndef);
+  bool handleWriteNdefRequest(int sessionId, NdefMessage* ndef, bool supersedable, int timeoutMs);
   void handleWriteNdefResponse(NfcEvent* event);
-  void handleCloseRequest();
+  void handleCloseRequest(int sessionId);
   void handleCloseResponse(NfcEvent* event);
   bool handlePushNdefRequest(NdefMessage* ndef);
   void handlePushNdefResponse(NfcEvent* event);
-  bool handleMakeNdefReadonlyRequest();
+  bool handleMakeNdefReadonlyRequest(int sessionId, int timeoutMs);
   void handleMakeNdefReadonlyResponse(NfcEvent* event);
+  bool handleTransceiveRequest(int sessionId, TransceiveBatch* batch, int timeoutMs);
+  void handleTransceiveResponse(NfcEvent* event);
+  bool handleStartProvisioningRequest(ProvisioningJob* job);
+  void handleStartProvisioningResponse(NfcEvent* event);
+  bool handleStopProvisioningRequest();
+  void handleStopProvisioningResponse(NfcEvent* event);
+  bool handleSetDiscoveryPolicyRequest(DiscoveryPolicy* policy);
+  void handleSetDiscoveryPolicyResponse(NfcEvent* event);
+  bool handleDefineDiscoveryProfileRequest(uint32_t profileId, DiscoveryProfile* profile);
+  void handleDefineDiscoveryProfileResponse(NfcEvent* event);
+  bool handleSelectDiscoveryProfileRequest(uint32_t profileId);
+  void handleSelectDiscoveryProfileResponse(NfcEvent* event);
   bool handleEnableDiscoveryRequest(bool enter);
   void handleEnableDiscoveryResponse(NfcEvent* event);
   bool handleEnableRequest(bool enable);
   void handleEnableResponse(NfcEvent* event);
+  bool handleStandbyRequest();
+  void handleStandbyResponse(NfcEvent* event);
+  void handleWarmUp(NfcEvent* event);
 
   void onConnected();
   void onP2pReceivedNdef(NdefMessage* ndef);
@@ -68,12 +104,63 @@ public:
 private:
   NfcService();
 
+  /**
+   * Queue an event for the service thread, coalescing it with an identical
+   * pending request of the same session.
+   *
+   * @param  event Event to queue; owned by the queue, and deleted at once
+   *               if it was merged into a queued event.
+   * @return       None.
+   */
+  void queueEvent(NfcEvent* event);
+  bool coalesceEvent(NfcEvent* event);
+
+  /**
+   * Reject a queued request whose session was closed while it waited,
+   * e.g. because the tag left the field.
+   *
+   * @param  event    Request dequeued.
+   * @param  response Response type of the request.
+   * @return          True if the session is still open; otherwise every
+   *                  waiter was answered NFC_ERROR_INVALID_SESSION.
+   */
+  bool checkSession(NfcEvent* event, NfcResponseType response);
+
+  /**
+   * Run the provisioning job on a discovered tag in place of notifying the
+   * client of it.
+   *
+   * @param  pINfcTag Tag discovered.
+   * @return          None.
+   */
+  void provisionTag(INfcTag* pINfcTag);
+  void endProvisioning();
+
+  /**
+   * Account the time NFC_TURN_ON took and log the enable statistics.
+   *
+   * @param  warm True if NFC was in standby.
+   * @param  us   Time taken, in microseconds.
+   * @return      None.
+   */
+  void recordEnableTime(bool warm, uint32_t us);
+
   bool mIsEnable;
+  bool mInStandby;
   static NfcService* sInstance;
   static NfcManager* sNfcManager;
   android::List<NfcEvent*> mQueue;
   MessageHandler* mMsgHandler;
   P2pLinkManager* mP2pLinkManager;
+  // Only touched on the service thread.
+  ProvisioningJob* mProvisioningJob;
+  int mProvisionedSessionId;  // Session of the last tag provisioned, hidden from the client.
+  DiscoveryProfile mProfiles[NFC_MAX_DISCOVERY_PROFILES];
+  bool mProfileDefined[NFC_MAX_DISCOVERY_PROFILES];
+  uint32_t mProfileId;        // Selected discovery profile.
+  // Enable statistics, indexed by whether the enable was warm.
+  uint32_t mNumEnables[2];
+  uint64_t mTotalEnableUs[2];
 };
 
 #endif // mozilla_nfcd_NfcService_h
@@ -29,3 +29,22 @@ NfcTechnology NfcUtil::convertTagTechToGonkFormat(TagTechnology tagTech) {
   }
   return NFC_TECH_NFCA;
 }
+
+TagTechnology NfcUtil::convertGonkFormatToTagTech(NfcTechnology gonkTech) {
+  switch(gonkTech) {
+    case NFC_TECH_NFCA:               return  NFC_A;
+    case NFC_TECH_NFCB:               return  NFC_B;
+    case NFC_TECH_ISO_DEP:            return  NFC_ISO_DEP;
+    case NFC_TECH_NFCF:               return  NFC_F;
+    case NFC_TECH_NFCV:               return  NFC_V;
+    case NFC_TECH_NDEF:               return  NDEF;
+    case NFC_TECH_NDEF_FORMATABLE:    return  NDEF_FORMATABLE;
+    case NFC_TECH_NDEF_WRITABLE:      return  NDEF_WRITABLE;
+    case NFC_TECH_MIFARE_CLASSIC:     return  MIFARE_CLASSIC;
+    case NFC_TECH_MIFARE_ULTRALIGHT:  return  MIFARE_ULTRALIGHT;
+    case NFC_TECH_BARCODE:            return  NFC_BARCODE;
+    case NFC_TECH_P2P:
+    case NFC_TECH_UNKNOWN:
+    default:                          return  UNKNOWN_TECH;
+  }
+}
@@ -15,6 +15,7 @@ class NfcUtil{
 public:
   static void convertNdefPduToNdefMessage(NdefMessagePdu& ndefPdu, NdefMessage* ndefMessage);
   static NfcTechnology convertTagTechToGonkFormat(TagTechnology tagTech);
+  static TagTechnology convertGonkFormatToTagTech(NfcTechnology gonkTech);
 private:
   NfcUtil();
 };
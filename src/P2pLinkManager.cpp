@@ -8,6 +8,7 @@
 #include "HandoverClient.h"
 #include "NfcService.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
 
 static const uint8_t RTD_HANDOVER_REQUEST[2] = {0x48, 0x72};  // "Hr"
 static const uint8_t RTD_HANDOVER_SELECT[2] = {0x48, 0x73};   // "Hs"
@@ -34,7 +35,7 @@ SnepCallback::~SnepCallback()
 SnepMessage* SnepCallback::doPut(NdefMessage* ndef)
 {
   if (!ndef) {
-    ALOGE("%s: invalid parameter", FUNC);
+    NFC_LOGE(P2P, "%s: invalid parameter", FUNC);
     return NULL;
   }
 
@@ -51,7 +52,7 @@ SnepMessage* SnepCallback::doPut(NdefMessage* ndef)
 SnepMessage* SnepCallback::doGet(int acceptableLength, NdefMessage* ndef)
 {
   if (!ndef) {
-    ALOGE("%s: invalid parameter", FUNC);
+    NFC_LOGE(P2P, "%s: invalid parameter", FUNC);
     return NULL;
   }
 
@@ -122,7 +123,7 @@ void P2pLinkManager::enableDisable(bool bEnable)
 void P2pLinkManager::push(NdefMessage& ndef)
 {
   if (ndef.mRecords.size() == 0) {
-    ALOGE("%s: no NDEF record", FUNC);
+    NFC_LOGE(P2P, "%s: no NDEF record", FUNC);
     return;
   }
 
@@ -145,7 +146,7 @@ void P2pLinkManager::push(NdefMessage& ndef)
 
   if (handoverType != NOT_HANDOVER) {
     if (mHandoverClient) {
-      ALOGD("%s: send NDEF by HANDOVER client", FUNC);
+      NFC_LOGD(P2P, "%s: send NDEF by HANDOVER client", FUNC);
       if (HANDOVER_REQUEST == handoverType) {
         NdefMessage* selectMsg = mHandoverClient->processHandoverRequest(ndef);
         notifyNdefReceived(selectMsg);
@@ -154,14 +155,14 @@ void P2pLinkManager::push(NdefMessage& ndef)
         mHandoverClient->put(ndef);
       }
     } else {
-      ALOGE("%s: handover client not connected", FUNC);
+      NFC_LOGE(P2P, "%s: handover client not connected", FUNC);
     }
   } else {
     if (mSnepClient) {
-      ALOGD("%s: send NDEF by SNEP client", FUNC);
+      NFC_LOGD(P2P, "%s: send NDEF by SNEP client", FUNC);
       mSnepClient->put(ndef);
     } else {
-      ALOGE("%s: snep client not connected", FUNC);
+      NFC_LOGE(P2P, "%s: snep client not connected", FUNC);
     }
   }
 }
@@ -0,0 +1,146 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "ProvisioningJob.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "INfcTag.h"
+#include "NdefMessage.h"
+#include "NdefRecord.h"
+#include "NfcDebug.h"
+#include "NfcLog.h"
+
+static uint32_t microsecondsSince(const struct timespec& start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+/**
+ * Replace every occurrence of a placeholder in a payload.
+ */
+static void replaceAll(std::vector<uint8_t>& bytes, const char* placeholder,
+                       const std::vector<uint8_t>& value)
+{
+  size_t length = strlen(placeholder);
+  std::vector<uint8_t> result;
+  result.reserve(bytes.size());
+
+  size_t i = 0;
+  while (i < bytes.size()) {
+    if (i + length <= bytes.size() && !memcmp(&bytes[i], placeholder, length)) {
+      result.insert(result.end(), value.begin(), value.end());
+      i += length;
+    } else {
+      result.push_back(bytes[i++]);
+    }
+  }
+  bytes.swap(result);
+}
+
+ProvisioningJob::ProvisioningJob(NdefMessage* ndef, uint32_t flags, uint32_t firstSerial,
+                                 uint32_t count, int timeoutMs)
+ : mTemplate(ndef)
+ , mFlags(flags)
+ , mNextSerial(firstSerial)
+ , mCount(count)
+ , mTimeoutMs(timeoutMs)
+ , mNumTags(0)
+ , mNumFailed(0)
+{
+}
+
+ProvisioningJob::~ProvisioningJob()
+{
+  delete mTemplate;
+}
+
+void ProvisioningJob::provision(INfcTag* tag, ProvisionResult& result)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  result.status = doProvision(tag, result);
+  // The deadline is this tag's only.
+  tag->setDeadline(0);
+  result.elapsedUs = microsecondsSince(start);
+
+  mNumTags++;
+  if (result.status != NFC_ERROR_SUCCESS) {
+    mNumFailed++;
+  }
+  NFC_LOGD(SERVICE, "%s: tag %u: status=%d, serial=%u, %u us", FUNC,
+           mNumTags, result.status, result.serial, result.elapsedUs);
+}
+
+NfcErrorCode ProvisioningJob::doProvision(INfcTag* tag, ProvisionResult& result)
+{
+  std::vector<std::vector<uint8_t> >& uids = tag->getUid();
+  for (uint32_t i = 0; i < uids.size(); i++) {
+    if (!uids[i].empty()) {
+      result.uid = uids[i];
+      break;
+    }
+  }
+
+  tag->setDeadline(mTimeoutMs);
+
+  // Connects to the NDEF technology and detects what the write relies on.
+  delete tag->findAndReadNdef();
+  if (tag->hasTimedOut())
+    return NFC_ERROR_TIMEOUT;
+
+  NdefMessage ndef;
+  result.serial = mNextSerial++;
+  render(result.uid, result.serial, ndef);
+  if (!tag->writeNdef(ndef))
+    return tag->hasTimedOut() ? NFC_ERROR_TIMEOUT : NFC_ERROR_IO;
+
+  if ((mFlags & NFC_PROVISION_LOCK) && !tag->makeReadOnly())
+    return tag->hasTimedOut() ? NFC_ERROR_TIMEOUT : NFC_ERROR_IO;
+
+  if (mFlags & NFC_PROVISION_VERIFY) {
+    // Over the technology connected above; probing again would add the
+    // NDEF technologies to the tag a second time.
+    std::vector<uint8_t> read;
+    tag->readNdef(read);
+    if (read.empty())
+      return tag->hasTimedOut() ? NFC_ERROR_TIMEOUT : NFC_ERROR_IO;
+
+    std::vector<uint8_t> written;
+    ndef.toByteArray(written);
+    if (written != read)
+      return NFC_ERROR_VERIFY_FAILED;
+  }
+  return NFC_ERROR_SUCCESS;
+}
+
+void ProvisioningJob::render(const std::vector<uint8_t>& uid, uint32_t serial, NdefMessage& ndef)
+{
+  static const char HEX[] = "0123456789ABCDEF";
+  std::vector<uint8_t> uidText;
+  for (uint32_t i = 0; i < uid.size(); i++) {
+    uidText.push_back(HEX[uid[i] >> 4]);
+    uidText.push_back(HEX[uid[i] & 0x0F]);
+  }
+
+  char buf[16];
+  int length = snprintf(buf, sizeof(buf), "%u", serial);
+  std::vector<uint8_t> serialText(buf, buf + length);
+
+  ndef.mRecords = mTemplate->mRecords;
+  for (uint32_t i = 0; i < ndef.mRecords.size(); i++) {
+    std::vector<uint8_t>& payload = ndef.mRecords[i].mPayload;
+    replaceAll(payload, NFC_PROVISION_UID_PLACEHOLDER, uidText);
+    replaceAll(payload, NFC_PROVISION_SERIAL_PLACEHOLDER, serialText);
+  }
+}
+
+void ProvisioningJob::logSummary() const
+{
+  NFC_LOGI(SERVICE, "%s: %u tags provisioned, %u failed", FUNC, mNumTags, mNumFailed);
+}
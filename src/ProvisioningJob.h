@@ -0,0 +1,89 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_ProvisioningJob_h
+#define mozilla_nfcd_ProvisioningJob_h
+
+#include <stdint.h>
+#include <vector>
+
+#include "NfcGonkMessage.h"
+
+class INfcTag;
+class NdefMessage;
+
+/**
+ * Outcome of provisioning one tag, sent as NFC_NOTIFICATION_PROVISIONED.
+ */
+struct ProvisionResult {
+  static const uint32_t NO_SERIAL = 0xFFFFFFFF;
+
+  ProvisionResult() : status(NFC_ERROR_SUCCESS), serial(NO_SERIAL), elapsedUs(0) {}
+
+  NfcErrorCode status;
+  uint32_t serial;
+  uint32_t elapsedUs;
+  std::vector<uint8_t> uid;
+};
+
+/**
+ * A job of NFC_REQUEST_START_PROVISIONING: writes its NDEF template to every
+ * tag handed to it, on the service thread, so that a production line only
+ * waits for RF and not for the client.
+ */
+class ProvisioningJob {
+public:
+  /**
+   * @param  ndef        NDEF template; owned by the job.
+   * @param  flags       NfcProvisionFlags.
+   * @param  firstSerial Serial number of the first tag.
+   * @param  count       Tags to provision, 0 for no limit.
+   * @param  timeoutMs   Deadline of each tag, 0 for none.
+   */
+  ProvisioningJob(NdefMessage* ndef, uint32_t flags, uint32_t firstSerial,
+                  uint32_t count, int timeoutMs);
+  ~ProvisioningJob();
+
+  /**
+   * Provision a tag that was just discovered.
+   *
+   * @param  tag    Tag to provision.
+   * @param  result Returns the outcome.
+   * @return        None.
+   */
+  void provision(INfcTag* tag, ProvisionResult& result);
+
+  /**
+   * @return True once count tags were provisioned.
+   */
+  bool isDone() const { return mCount && mNumTags >= mCount; }
+
+  /**
+   * Log how many tags were provisioned and how many failed.
+   */
+  void logSummary() const;
+
+private:
+  NfcErrorCode doProvision(INfcTag* tag, ProvisionResult& result);
+
+  /**
+   * Fill in the placeholders of the template for a tag.
+   *
+   * @param  uid    UID of the tag.
+   * @param  serial Serial number of the tag.
+   * @param  ndef   Returns the NDEF message to write.
+   * @return        None.
+   */
+  void render(const std::vector<uint8_t>& uid, uint32_t serial, NdefMessage& ndef);
+
+  NdefMessage* mTemplate;
+  uint32_t mFlags;
+  uint32_t mNextSerial;
+  uint32_t mCount;
+  int mTimeoutMs;
+  uint32_t mNumTags;
+  uint32_t mNumFailed;
+};
+
+#endif // mozilla_nfcd_ProvisioningJob_h
@@ -0,0 +1,112 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "SessionManager.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include "NfcDebug.h"
+#include "NfcLog.h"
+
+SessionManager* SessionManager::sInstance = NULL;
+
+SessionManager* SessionManager::Instance()
+{
+  if (!sInstance)
+    sInstance = new SessionManager();
+  return sInstance;
+}
+
+SessionManager::SessionManager()
+ : mGeneration(0)
+{
+  memset(mSessions, 0, sizeof(mSessions));
+  memset(mCurrentId, 0, sizeof(mCurrentId));
+  pthread_mutex_init(&mMutex, NULL);
+}
+
+int SessionManager::openSession(SessionType type, void* endpoint)
+{
+  pthread_mutex_lock(&mMutex);
+  uint32_t slot = 0;
+  while (slot < MAX_SESSIONS && mSessions[slot].id) {
+    slot++;
+  }
+  if (slot == MAX_SESSIONS) {
+    pthread_mutex_unlock(&mMutex);
+    NFC_LOGE(SERVICE, "%s: no free session for type=%d", FUNC, type);
+    return 0;
+  }
+
+  // Skip 0 and negative IDs once the generation wraps.
+  if (++mGeneration > (INT_MAX >> SLOT_BITS)) {
+    mGeneration = 1;
+  }
+  int id = (mGeneration << SLOT_BITS) | slot;
+
+  Session& session = mSessions[slot];
+  session.id = id;
+  session.type = type;
+  session.endpoint = endpoint;
+  mCurrentId[type] = id;
+  pthread_mutex_unlock(&mMutex);
+
+  NFC_LOGD(SERVICE, "%s: session %d type=%d", FUNC, id, type);
+  return id;
+}
+
+void SessionManager::closeSession(int id)
+{
+  pthread_mutex_lock(&mMutex);
+  Session& session = mSessions[id & (MAX_SESSIONS - 1)];
+  if (id > 0 && session.id == id) {
+    if (mCurrentId[session.type] == id) {
+      mCurrentId[session.type] = 0;
+    }
+    memset(&session, 0, sizeof(session));
+  }
+  pthread_mutex_unlock(&mMutex);
+}
+
+void* SessionManager::getEndpoint(int id, SessionType* type)
+{
+  void* endpoint = NULL;
+
+  pthread_mutex_lock(&mMutex);
+  Session& session = mSessions[id & (MAX_SESSIONS - 1)];
+  if (id > 0 && session.id == id) {
+    endpoint = session.endpoint;
+    if (type) {
+      *type = session.type;
+    }
+  }
+  pthread_mutex_unlock(&mMutex);
+
+  return endpoint;
+}
+
+int SessionManager::findSession(void* endpoint)
+{
+  int id = 0;
+
+  pthread_mutex_lock(&mMutex);
+  for (uint32_t i = 0; i < MAX_SESSIONS; i++) {
+    if (mSessions[i].id && mSessions[i].endpoint == endpoint) {
+      id = mSessions[i].id;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mMutex);
+
+  return id;
+}
+
+int SessionManager::getCurrentId(SessionType type)
+{
+  pthread_mutex_lock(&mMutex);
+  int id = mCurrentId[type];
+  pthread_mutex_unlock(&mMutex);
+  return id;
+}
@@ -0,0 +1,96 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_SessionManager_h
+#define mozilla_nfcd_SessionManager_h
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * Table of the sessions handed out to the client in TECH_DISCOVERED.
+ *
+ * A session maps its ID to the tag or P2P endpoint it was opened for. A
+ * new session takes a free slot, and its ID is the slot in the low bits
+ * above a generation count, so looking up an ID is O(1), IDs are not reused
+ * until the count wraps, and an ID whose session was closed, or whose slot
+ * was taken by a newer session since, no longer resolves. Open sessions are
+ * never evicted.
+ */
+class SessionManager {
+public:
+  typedef enum {
+    SESSION_NONE = 0,
+    SESSION_TAG,
+    SESSION_P2P,
+    SESSION_TYPE_COUNT
+  } SessionType;
+
+  // Sessions that can be open at once; a power of two.
+  static const uint32_t SLOT_BITS = 3;
+  static const uint32_t MAX_SESSIONS = 1 << SLOT_BITS;
+
+  static SessionManager* Instance();
+
+  /**
+   * Open a session for an endpoint.
+   *
+   * @param  type     Kind of endpoint.
+   * @param  endpoint INfcTag or IP2pDevice of the session.
+   * @return          New session ID; 0 if MAX_SESSIONS sessions are open.
+   */
+  int openSession(SessionType type, void* endpoint);
+
+  /**
+   * Close a session. Requests carrying its ID are rejected from now on.
+   *
+   * @param  id Session ID; closing a stale ID does nothing.
+   * @return    None.
+   */
+  void closeSession(int id);
+
+  /**
+   * Look up an open session.
+   *
+   * @param  id   Session ID from the client.
+   * @param  type Set to the kind of endpoint if not NULL.
+   * @return      Endpoint of the session, NULL if the ID is stale or unknown.
+   */
+  void* getEndpoint(int id, SessionType* type = NULL);
+
+  bool isValid(int id) { return getEndpoint(id) != NULL; }
+
+  /**
+   * Find the open session of an endpoint.
+   *
+   * @param  endpoint Endpoint passed to openSession.
+   * @return          Session ID, 0 if the endpoint has no open session.
+   */
+  int findSession(void* endpoint);
+
+  /**
+   * @param  type Kind of endpoint.
+   * @return      ID of the most recently opened session of that kind if it
+   *              is still open, 0 otherwise.
+   */
+  int getCurrentId(SessionType type);
+
+private:
+  SessionManager();
+
+  struct Session {
+    int id;
+    SessionType type;
+    void* endpoint;
+  };
+
+  static SessionManager* sInstance;
+
+  Session mSessions[MAX_SESSIONS];
+  int mCurrentId[SESSION_TYPE_COUNT];
+  int mGeneration;
+  pthread_mutex_t mMutex;
+};
+
+#endif // mozilla_nfcd_SessionManager_h
@@ -0,0 +1,75 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "StartupTiming.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "NfcDebug.h"
+#include "NfcLog.h"
+
+StartupTiming* StartupTiming::sInstance = NULL;
+
+StartupTiming::StartupTiming()
+{
+  pthread_mutex_init(&mMutex, NULL);
+  memset(mMarksMs, 0, sizeof(mMarksMs));
+  memset(mReached, 0, sizeof(mReached));
+}
+
+StartupTiming* StartupTiming::Instance()
+{
+  if (!sInstance)
+    sInstance = new StartupTiming();
+  return sInstance;
+}
+
+const char* StartupTiming::phaseName(int phase)
+{
+  switch (phase) {
+    case PHASE_PROCESS_START:      return "process-start";
+    case PHASE_SOCKET_READY:       return "socket-ready";
+    case PHASE_NFA_ENABLED:        return "nfa-enabled";
+    case PHASE_SERVERS_REGISTERED: return "servers-registered";
+    case PHASE_DISCOVERY_STARTED:  return "discovery-started";
+    default:                       return "unknown";
+  }
+}
+
+bool StartupTiming::mark(Phase phase)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint32_t nowMs = (uint32_t) (now.tv_sec * 1000LL + now.tv_nsec / 1000000);
+
+  pthread_mutex_lock(&mMutex);
+  if (mReached[phase]) {
+    pthread_mutex_unlock(&mMutex);
+    return false;
+  }
+  mMarksMs[phase] = nowMs;
+  mReached[phase] = true;
+
+  if (phase == PHASE_DISCOVERY_STARTED) {
+    uint32_t startMs = mMarksMs[PHASE_PROCESS_START];
+    NFC_LOGD(SERVICE, "%s: nfcd started %u ms after boot", FUNC, startMs);
+    for (int i = PHASE_SOCKET_READY; i < PHASE_COUNT; i++) {
+      if (mReached[i])
+        NFC_LOGD(SERVICE, "%s:   %-18s +%u ms", FUNC, phaseName(i), mMarksMs[i] - startMs);
+      else
+        NFC_LOGD(SERVICE, "%s:   %-18s not reached", FUNC, phaseName(i));
+    }
+  }
+  pthread_mutex_unlock(&mMutex);
+  return true;
+}
+
+uint32_t StartupTiming::getMs(Phase phase)
+{
+  pthread_mutex_lock(&mMutex);
+  uint32_t ms = mMarksMs[phase];
+  pthread_mutex_unlock(&mMutex);
+  return ms;
+}
@@ -0,0 +1,62 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_StartupTiming_h
+#define mozilla_nfcd_StartupTiming_h
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * Records when nfcd reached each phase of its startup, in milliseconds of
+ * CLOCK_MONOTONIC, i.e. since boot. The phases are reported to the client in
+ * NFC_NOTIFICATION_INITIALIZED, which only has the phases reached when the
+ * client connects, and in NFC_NOTIFICATION_STARTUP_TIMING once discovery
+ * first starts, when they are also logged.
+ *
+ * Only the first time a phase is reached counts, so that turning NFC off
+ * and on again does not move the startup figures.
+ */
+class StartupTiming {
+public:
+  enum Phase {
+    PHASE_PROCESS_START = 0,   // main() entered.
+    PHASE_SOCKET_READY,        // Listening on the client socket.
+    PHASE_NFA_ENABLED,         // NfcManager::initialize() succeeded.
+    PHASE_SERVERS_REGISTERED,  // SNEP and handover servers registered.
+    PHASE_DISCOVERY_STARTED,   // Discovery started for the first time.
+    PHASE_COUNT
+  };
+
+  static StartupTiming* Instance();
+
+  /**
+   * Record that startup reached a phase, unless it already did.
+   *
+   * @param  phase Phase reached.
+   * @return       True if the phase was reached for the first time.
+   */
+  bool mark(Phase phase);
+
+  /**
+   * Get when startup reached a phase.
+   *
+   * @param  phase Phase to query.
+   * @return       Milliseconds since boot, 0 if not reached yet.
+   */
+  uint32_t getMs(Phase phase);
+
+private:
+  StartupTiming();
+
+  static const char* phaseName(int phase);
+
+  pthread_mutex_t mMutex;
+  uint32_t mMarksMs[PHASE_COUNT];
+  bool mReached[PHASE_COUNT];
+
+  static StartupTiming* sInstance;
+};
+
+#endif // mozilla_nfcd_StartupTiming_h
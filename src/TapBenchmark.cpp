@@ -0,0 +1,279 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "TapBenchmark.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "NdefMessage.h"
+#include "NfcDebug.h"
+#include "NfcGonkMessage.h"
+#include "NfcIpcSocket.h"
+#include "NfcManager.h"
+#include "P2pLinkManager.h"
+#include "SnepMessage.h"
+#include "TapLatency.h"
+#include "WireCodec.h"
+
+#define MAX_LINE_LEN 512
+
+static const char BENCH_MIME_TYPE[] = "application/x-nfcd-bench";
+
+TapBenchmark::TapBenchmark(NfcManager* manager)
+ : mManager(manager)
+ , mSpeedPercent(100)
+ , mP2pPerSecond(0)
+ , mP2pBytes(0)
+ , mClientFd(-1)
+ , mP2pRunning(false)
+ , mTagsReceived(0)
+ , mP2pReceived(0)
+ , mP2pSent(0)
+{
+}
+
+TapBenchmark::~TapBenchmark()
+{
+}
+
+bool TapBenchmark::load(const char* path)
+{
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    ALOGE("%s: cannot open %s, errno=%d", FUNC, path, errno);
+    return false;
+  }
+
+  char line[MAX_LINE_LEN];
+  int lineNo = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file)) {
+    lineNo++;
+    char* comment = strchr(line, '#');
+    if (comment)
+      *comment = '\0';
+
+    char keyword[16];
+    char arg[MAX_LINE_LEN];
+    int value1 = 0, value2 = 0;
+    if (sscanf(line, "%15s", keyword) != 1)
+      continue;
+
+    if (strcmp(keyword, "speed") == 0) {
+      ok = sscanf(line, "%*s %d", &value1) == 1 && value1 >= 0;
+      mSpeedPercent = value1;
+    } else if (strcmp(keyword, "tap") == 0) {
+      ok = sscanf(line, "%*s %511s %d", arg, &value1) == 2 && value1 > 0;
+      TapSource source;
+      source.path = arg;
+      source.count = value1;
+      mTaps.push_back(source);
+    } else if (strcmp(keyword, "p2p") == 0) {
+      ok = sscanf(line, "%*s %d %d", &value1, &value2) == 2 &&
+           value1 > 0 && value2 >= 0;
+      mP2pPerSecond = value1;
+      mP2pBytes = value2;
+    } else if (strcmp(keyword, "threshold") == 0) {
+      ok = sscanf(line, "%*s %511s %d", arg, &value1) == 2 && value1 >= 0 &&
+           TapLatency::Instance()->setThreshold(arg, value1);
+    } else {
+      ok = false;
+    }
+
+    if (!ok)
+      ALOGE("%s: %s:%d: invalid line", FUNC, path, lineNo);
+  }
+  fclose(file);
+
+  if (ok && mTaps.empty()) {
+    ALOGE("%s: %s has no tap", FUNC, path);
+    ok = false;
+  }
+  return ok;
+}
+
+bool TapBenchmark::start(NfcIpcSocket* socket)
+{
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    ALOGE("%s: socketpair failed, errno=%d", FUNC, errno);
+    return false;
+  }
+  socket->setClientSocket(fds[0]);
+  mClientFd = fds[1];
+
+  TapLatency::Instance()->setClientTimed(true);
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int ret = pthread_create(&thread, &attr, clientThreadFunc, this);
+  if (ret == 0)
+    ret = pthread_create(&thread, &attr, runThreadFunc, this);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    ALOGE("%s: pthread_create failed (%d)", FUNC, ret);
+    return false;
+  }
+  return true;
+}
+
+void* TapBenchmark::runThreadFunc(void* arg)
+{
+  static_cast<TapBenchmark*>(arg)->run();
+  return NULL;
+}
+
+void* TapBenchmark::clientThreadFunc(void* arg)
+{
+  static_cast<TapBenchmark*>(arg)->readNotifications();
+  return NULL;
+}
+
+void* TapBenchmark::p2pThreadFunc(void* arg)
+{
+  static_cast<TapBenchmark*>(arg)->receiveP2p();
+  return NULL;
+}
+
+void TapBenchmark::run()
+{
+  if (mP2pPerSecond) {
+    mP2pRunning = true;
+    if (pthread_create(&mP2pThread, NULL, p2pThreadFunc, this) != 0) {
+      ALOGE("%s: cannot start the P2P load", FUNC);
+      mP2pRunning = false;
+    }
+  }
+
+  // Round robin over the tap lines, so that consecutive taps are of
+  // different tags as long as several remain.
+  std::vector<int> remaining;
+  int total = 0;
+  for (size_t i = 0; i < mTaps.size(); i++) {
+    remaining.push_back(mTaps[i].count);
+    total += mTaps[i].count;
+  }
+
+  int replayed = 0;
+  bool ok = true;
+  while (ok && replayed < total) {
+    for (size_t i = 0; ok && i < mTaps.size(); i++) {
+      if (!remaining[i])
+        continue;
+      remaining[i]--;
+      replayed++;
+      ok = mManager->replayEventLog(mTaps[i].path.c_str(), mSpeedPercent);
+    }
+  }
+
+  if (mP2pRunning) {
+    mP2pRunning = false;
+    pthread_join(mP2pThread, NULL);
+  }
+
+  struct timespec drain;
+  drain.tv_sec = DRAIN_MS / 1000;
+  drain.tv_nsec = (DRAIN_MS % 1000) * 1000000;
+  nanosleep(&drain, NULL);
+
+  ALOGD("%s: %d/%d taps replayed, %d tags and %d/%d P2P messages received by the client",
+        FUNC, replayed, total, mTagsReceived, mP2pReceived, mP2pSent);
+  int regressions = TapLatency::Instance()->report();
+  ALOGD("%s: benchmark done; %d stage(s) over threshold", FUNC, regressions);
+
+  exit(ok && !regressions ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+bool TapBenchmark::readFully(uint8_t* buf, size_t len)
+{
+  size_t offset = 0;
+  while (offset < len) {
+    ssize_t n = read(mClientFd, buf + offset, len - offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    offset += n;
+  }
+  return true;
+}
+
+void TapBenchmark::readNotifications()
+{
+  std::vector<uint8_t> message;
+
+  while (true) {
+    uint8_t prefix[WireWriter::PREFIX_SIZE];
+    if (!readFully(prefix, sizeof(prefix)))
+      break;
+    uint32_t size = ((uint32_t) prefix[0] << 24) | ((uint32_t) prefix[1] << 16) |
+                    ((uint32_t) prefix[2] << 8) | (uint32_t) prefix[3];
+    message.resize(size);
+    if (size && !readFully(&message[0], size))
+      break;
+
+    // Responses and other notifications are only drained.
+    WireReader reader(size ? &message[0] : NULL, size);
+    int32_t type, sessionId, techCount;
+    const uint8_t* techs;
+    if (!reader.readInt32(type) || type != NFC_NOTIFICATION_TECH_DISCOVERED ||
+        !reader.readInt32(sessionId) || !reader.readInt32(techCount) ||
+        !reader.readInplace(techCount, techs)) {
+      continue;
+    }
+
+    bool p2p = false;
+    for (int i = 0; i < techCount; i++) {
+      p2p |= techs[i] == NFC_TECH_P2P;
+    }
+    if (p2p) {
+      mP2pReceived++;
+    } else {
+      TapLatency::Instance()->mark(TapLatency::STAGE_CLIENT_RECEIVED);
+      mTagsReceived++;
+    }
+  }
+
+  ALOGE("%s: IPC socket closed", FUNC);
+  close(mClientFd);
+}
+
+void TapBenchmark::receiveP2p()
+{
+  std::vector<uint8_t> type(BENCH_MIME_TYPE, BENCH_MIME_TYPE + strlen(BENCH_MIME_TYPE));
+  std::vector<uint8_t> id;
+  std::vector<uint8_t> payload(mP2pBytes, 0xA5);
+  NdefRecord record(NdefRecord::TNF_MIME_MEDIA, type, id, payload);
+
+  // The SNEP server callback, as for a PUT from a real peer.
+  SnepCallback callback;
+
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  long intervalNs = 1000000000L / mP2pPerSecond;
+
+  while (mP2pRunning) {
+    NdefMessage* ndef = new NdefMessage();
+    ndef->mRecords.push_back(record);
+    SnepMessage* response = callback.doPut(ndef);
+    delete response;
+    delete ndef;
+    mP2pSent++;
+
+    next.tv_nsec += intervalNs;
+    while (next.tv_nsec >= 1000000000L) {
+      next.tv_sec++;
+      next.tv_nsec -= 1000000000L;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+}
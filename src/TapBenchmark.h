@@ -0,0 +1,94 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_TapBenchmark_h
+#define mozilla_nfcd_TapBenchmark_h
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class NfcManager;
+class NfcIpcSocket;
+
+/**
+ * Benchmarks the tap-to-notification path under load, for
+ * "nfcd --bench <script>". The recorded taps of the script are replayed back
+ * to back while SNEP PUTs come in from a simulated peer, and a client in the
+ * daemon reads every notification off the IPC socket, so that TapLatency
+ * times the taps up to the client. Once the script is done the process
+ * exits with a failure status if any stage went over its threshold.
+ *
+ * Script lines, '#' starts a comment:
+ *   speed <percent>           Replay speed of the taps, 100 is real time.
+ *   tap <log> <count>         Replay a recorded tap log <count> times. The
+ *                             taps of all tap lines are interleaved.
+ *   p2p <per-second> <bytes>  Receive SNEP PUTs of <bytes> of NDEF payload
+ *                             while the taps run.
+ *   threshold <stage> <us>    p99 threshold of a stage, e.g. "total".
+ */
+class TapBenchmark {
+public:
+  TapBenchmark(NfcManager* manager);
+  ~TapBenchmark();
+
+  /**
+   * Read a benchmark script.
+   *
+   * @param  path Path of the script.
+   * @return      True if the script is valid and has taps.
+   */
+  bool load(const char* path);
+
+  /**
+   * Connect the benchmark client to the IPC socket and start the run on
+   * its own thread. The socket loop must be entered afterwards.
+   *
+   * @param  socket IPC socket of the daemon.
+   * @return        True if the run was started.
+   */
+  bool start(NfcIpcSocket* socket);
+
+private:
+  // Time given to the client to read the last notifications.
+  static const int DRAIN_MS = 500;
+
+  struct TapSource {
+    std::string path;
+    int count;
+  };
+
+  static void* runThreadFunc(void* arg);
+  static void* clientThreadFunc(void* arg);
+  static void* p2pThreadFunc(void* arg);
+
+  void run();
+  void readNotifications();
+  void receiveP2p();
+
+  /**
+   * Read exactly len bytes from the client socket.
+   */
+  bool readFully(uint8_t* buf, size_t len);
+
+  NfcManager* mManager;
+  std::vector<TapSource> mTaps;
+  int mSpeedPercent;
+  int mP2pPerSecond;
+  int mP2pBytes;
+
+  int mClientFd;
+  volatile bool mP2pRunning;
+  pthread_t mP2pThread;
+
+  // Counted by the client thread.
+  volatile int mTagsReceived;
+  volatile int mP2pReceived;
+  // Counted by the P2P thread.
+  int mP2pSent;
+};
+
+#endif // mozilla_nfcd_TapBenchmark_h
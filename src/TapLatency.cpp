@@ -0,0 +1,216 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "TapLatency.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/properties.h>
+
+#include "NfcDebug.h"
+
+TapLatency* TapLatency::sInstance = NULL;
+
+// Default p99 regression thresholds in microseconds, indexed like mSamples.
+static const uint32_t sDefaultThresholds[TapLatency::STAGE_COUNT + 1] = {
+  0,       // STAGE_ACTIVATED, no predecessor.
+  5000,    // ACTIVATED -> TAG_CREATED.
+  1000,    // TAG_CREATED -> TAG_QUEUED.
+  10000,   // TAG_QUEUED -> TAG_DEQUEUED.
+  150000,  // TAG_DEQUEUED -> NDEF_READ.
+  10000,   // NDEF_READ -> TECH_NOTIFIED.
+  10000,   // TECH_NOTIFIED -> CLIENT_RECEIVED.
+  200000   // End to end.
+};
+
+static uint32_t elapsedUs(const struct timespec& from, const struct timespec& to)
+{
+  long long us = (to.tv_sec - from.tv_sec) * 1000000LL +
+                 (to.tv_nsec - from.tv_nsec) / 1000;
+  if (us < 0)
+    return 0;
+  return us > 0xFFFFFFFFLL ? 0xFFFFFFFF : (uint32_t) us;
+}
+
+// Value at the given per-mille rank of a sorted array.
+static uint32_t percentile(const uint32_t* sorted, int count, int perMille)
+{
+  if (count == 0)
+    return 0;
+  return sorted[(int) (((long long) (count - 1) * perMille) / 1000)];
+}
+
+TapLatency::TapLatency()
+ : mNextStage(STAGE_ACTIVATED)
+ , mLastStage(STAGE_TECH_NOTIFIED)
+ , mHasEarlyReceipt(false)
+ , mSampleCount(0)
+ , mSampleIndex(0)
+ , mTapCount(0)
+{
+  pthread_mutex_init(&mMutex, NULL);
+  memset(mMarks, 0, sizeof(mMarks));
+  memset(mSamples, 0, sizeof(mSamples));
+  memcpy(mThresholds, sDefaultThresholds, sizeof(mThresholds));
+}
+
+TapLatency* TapLatency::Instance()
+{
+  if (!sInstance)
+    sInstance = new TapLatency();
+  return sInstance;
+}
+
+void TapLatency::initialize()
+{
+  char name[PROPERTY_KEY_MAX];
+  char value[PROPERTY_VALUE_MAX];
+
+  for (int i = STAGE_TAG_CREATED; i <= STAGE_COUNT; i++) {
+    snprintf(name, sizeof(name), "nfcd.latency.%s", stageName(i));
+    if (property_get(name, value, "") > 0) {
+      setThreshold(static_cast<Stage>(i), strtoul(value, NULL, 10));
+    }
+  }
+}
+
+void TapLatency::setClientTimed(bool timed)
+{
+  pthread_mutex_lock(&mMutex);
+  mLastStage = timed ? STAGE_CLIENT_RECEIVED : STAGE_TECH_NOTIFIED;
+  mNextStage = STAGE_ACTIVATED;
+  mHasEarlyReceipt = false;
+  pthread_mutex_unlock(&mMutex);
+}
+
+const char* TapLatency::stageName(int stage)
+{
+  switch (stage) {
+    case STAGE_ACTIVATED:     return "activated";
+    case STAGE_TAG_CREATED:   return "tag-created";
+    case STAGE_TAG_QUEUED:    return "tag-queued";
+    case STAGE_TAG_DEQUEUED:  return "tag-dequeued";
+    case STAGE_NDEF_READ:     return "ndef-read";
+    case STAGE_TECH_NOTIFIED: return "tech-notified";
+    case STAGE_CLIENT_RECEIVED: return "client-received";
+    case STAGE_COUNT:         return "total";
+    default:                  return "unknown";
+  }
+}
+
+void TapLatency::mark(Stage stage)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  bool needReport = false;
+
+  pthread_mutex_lock(&mMutex);
+  if (stage == STAGE_ACTIVATED) {
+    // A new activation always starts a new tap.
+    mMarks[STAGE_ACTIVATED] = now;
+    mNextStage = STAGE_TAG_CREATED;
+    mHasEarlyReceipt = false;
+  } else if (stage == mNextStage && stage <= mLastStage) {
+    mMarks[stage] = now;
+    mNextStage++;
+
+    if (stage == STAGE_TECH_NOTIFIED && mLastStage == STAGE_CLIENT_RECEIVED &&
+        mHasEarlyReceipt) {
+      // The client already read it, the stage counts as 0.
+      mMarks[STAGE_CLIENT_RECEIVED] = now;
+      mHasEarlyReceipt = false;
+      stage = STAGE_CLIENT_RECEIVED;
+      mNextStage++;
+    }
+
+    if (stage == mLastStage)
+      needReport = completeTap();
+  } else if (stage == STAGE_CLIENT_RECEIVED && mNextStage == STAGE_TECH_NOTIFIED) {
+    mHasEarlyReceipt = true;
+  }
+  // Marks out of order belong to a path we do not time (P2P, reconnect...).
+  pthread_mutex_unlock(&mMutex);
+
+  if (needReport)
+    report();
+}
+
+bool TapLatency::completeTap()
+{
+  for (int i = STAGE_TAG_CREATED; i <= mLastStage; i++) {
+    mSamples[i][mSampleIndex] = elapsedUs(mMarks[i - 1], mMarks[i]);
+  }
+  mSamples[STAGE_COUNT][mSampleIndex] = elapsedUs(mMarks[STAGE_ACTIVATED], mMarks[mLastStage]);
+  mSampleIndex = (mSampleIndex + 1) % MAX_SAMPLES;
+  if (mSampleCount < MAX_SAMPLES)
+    mSampleCount++;
+  mTapCount++;
+
+  ALOGD("%s: tap complete in %u us", FUNC, mSamples[STAGE_COUNT][(mSampleIndex + MAX_SAMPLES - 1) % MAX_SAMPLES]);
+  mNextStage = STAGE_ACTIVATED;
+  return (mTapCount % REPORT_INTERVAL) == 0;
+}
+
+void TapLatency::setThreshold(Stage stage, uint32_t us)
+{
+  pthread_mutex_lock(&mMutex);
+  mThresholds[stage] = us;
+  pthread_mutex_unlock(&mMutex);
+}
+
+bool TapLatency::setThreshold(const char* name, uint32_t us)
+{
+  for (int i = STAGE_TAG_CREATED; i <= STAGE_COUNT; i++) {
+    if (strcmp(name, stageName(i)) == 0) {
+      setThreshold(static_cast<Stage>(i), us);
+      return true;
+    }
+  }
+  return false;
+}
+
+int TapLatency::report()
+{
+  static uint32_t sorted[MAX_SAMPLES];
+  int regressions = 0;
+
+  pthread_mutex_lock(&mMutex);
+  ALOGD("%s: tap latency over the last %d of %u taps (us)", FUNC, mSampleCount, mTapCount);
+  for (int i = STAGE_TAG_CREATED; i <= STAGE_COUNT; i++) {
+    if (i > mLastStage && i < STAGE_COUNT)
+      continue;
+
+    memcpy(sorted, mSamples[i], mSampleCount * sizeof(uint32_t));
+    std::sort(sorted, sorted + mSampleCount);
+
+    uint32_t p50 = percentile(sorted, mSampleCount, 500);
+    uint32_t p99 = percentile(sorted, mSampleCount, 990);
+    uint32_t p999 = percentile(sorted, mSampleCount, 999);
+    bool regressed = mThresholds[i] && p99 > mThresholds[i];
+    if (regressed) {
+      regressions++;
+      ALOGW("%s: %-15s p50=%u p99=%u p999=%u REGRESSION (threshold %u)",
+            FUNC, stageName(i), p50, p99, p999, mThresholds[i]);
+    } else {
+      ALOGD("%s: %-15s p50=%u p99=%u p999=%u", FUNC, stageName(i), p50, p99, p999);
+    }
+  }
+  pthread_mutex_unlock(&mMutex);
+
+  return regressions;
+}
+
+void TapLatency::reset()
+{
+  pthread_mutex_lock(&mMutex);
+  mSampleCount = 0;
+  mSampleIndex = 0;
+  mTapCount = 0;
+  mNextStage = STAGE_ACTIVATED;
+  mHasEarlyReceipt = false;
+  pthread_mutex_unlock(&mMutex);
+}
@@ -0,0 +1,138 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_TapLatency_h
+#define mozilla_nfcd_TapLatency_h
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Measures the latency of the tap-to-notification path, from the stack
+ * activating a tag to the TECH_DISCOVERED notification being sent to the
+ * client, and keeps per-stage percentiles.
+ *
+ * Each stage is timed from the previous one. A tap is only accounted once
+ * every stage was marked in order, so taps that end early (tag lost, P2P)
+ * do not skew the figures.
+ *
+ * The p99 regression thresholds default to sDefaultThresholds and can be
+ * set per stage with the "nfcd.latency.<stage>" properties, in
+ * microseconds, e.g. "nfcd.latency.ndef-read" or "nfcd.latency.total".
+ */
+class TapLatency {
+public:
+  enum Stage {
+    STAGE_ACTIVATED = 0,   // NFA_ACTIVATED_EVT received.
+    STAGE_TAG_CREATED,     // NfcTag::createNfcTag filled the tag object.
+    STAGE_TAG_QUEUED,      // NfcService::notifyTagDiscovered queued the event.
+    STAGE_TAG_DEQUEUED,    // NfcService::handleTagDiscovered started.
+    STAGE_NDEF_READ,       // findAndReadNdef returned.
+    STAGE_TECH_NOTIFIED,   // TECH_DISCOVERED notification sent.
+    STAGE_CLIENT_RECEIVED, // Notification read by the benchmark client.
+    STAGE_COUNT
+  };
+
+  // Number of taps kept for the percentile computation.
+  static const int MAX_SAMPLES = 1024;
+  // Log a report every REPORT_INTERVAL complete taps.
+  static const int REPORT_INTERVAL = 100;
+
+  static TapLatency* Instance();
+
+  /**
+   * Read the regression thresholds from the system properties.
+   *
+   * @return None.
+   */
+  void initialize();
+
+  /**
+   * Let taps run until STAGE_CLIENT_RECEIVED instead of ending at
+   * STAGE_TECH_NOTIFIED. Only a client in the daemon, i.e. the benchmark
+   * one, can mark that stage.
+   *
+   * @param  timed True to time the client.
+   * @return       None.
+   */
+  void setClientTimed(bool timed);
+
+  /**
+   * Record that the current tap reached a stage.
+   *
+   * @param  stage Stage reached.
+   * @return       None.
+   */
+  void mark(Stage stage);
+
+  /**
+   * Set the p99 regression threshold of a stage. A report flags the stage
+   * when its p99 goes above the threshold.
+   *
+   * @param  stage Stage to configure, or STAGE_COUNT for the end-to-end total.
+   * @param  us    Threshold in microseconds, 0 to disable.
+   * @return       None.
+   */
+  void setThreshold(Stage stage, uint32_t us);
+
+  /**
+   * Set the p99 regression threshold of a stage by name.
+   *
+   * @param  name Stage name as in the reports, e.g. "ndef-read" or "total".
+   * @param  us   Threshold in microseconds, 0 to disable.
+   * @return      False if there is no such stage.
+   */
+  bool setThreshold(const char* name, uint32_t us);
+
+  /**
+   * Log p50/p99/p999 of every stage and of the whole path.
+   *
+   * @return Number of stages above their regression threshold.
+   */
+  int report();
+
+  /**
+   * Drop all collected samples.
+   *
+   * @return None.
+   */
+  void reset();
+
+private:
+  TapLatency();
+
+  static const char* stageName(int stage);
+
+  /**
+   * Account the tap that reached mLastStage. Must be called with mMutex
+   * held.
+   *
+   * @return True if a report is due.
+   */
+  bool completeTap();
+
+  pthread_mutex_t mMutex;
+  struct timespec mMarks[STAGE_COUNT];
+  int mNextStage;
+  int mLastStage;
+
+  // The client can read the notification before the service thread marks
+  // it sent; its receipt is then accounted with STAGE_TECH_NOTIFIED.
+  bool mHasEarlyReceipt;
+
+  // Slot STAGE_COUNT holds the end-to-end latency; slot 0 is unused since
+  // STAGE_ACTIVATED has no predecessor.
+  uint32_t mSamples[STAGE_COUNT + 1][MAX_SAMPLES];
+  uint32_t mThresholds[STAGE_COUNT + 1];
+  int mSampleCount;
+  int mSampleIndex;
+  // Taps completed since the last reset; unlike mSampleCount not capped at
+  // MAX_SAMPLES, so that reports keep coming once the window is full.
+  uint32_t mTapCount;
+
+  static TapLatency* sInstance;
+};
+
+#endif // mozilla_nfcd_TapLatency_h
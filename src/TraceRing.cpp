@@ -0,0 +1,233 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "TraceRing.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#include "NfcDebug.h"
+
+#define TRACE_DUMP_PATH "/data/nfc/nfcd_trace.json"
+
+static const char* sEventNames[] = {
+  "ipc-record",
+  "ipc-request",
+  "service-event",
+  "tag-connect",
+  "tag-reselect",
+  "tag-check-ndef",
+  "tag-read",
+  "tag-write",
+  "tag-presence-check",
+  "tag-make-readonly",
+  "tag-format",
+  "tag-disconnect",
+  "tag-transceive",
+  "p2p-send",
+  "p2p-receive"
+};
+
+// Fails to compile when a trace point is added without a name.
+typedef char TraceNamesMatchIds[
+  (sizeof(sEventNames) / sizeof(sEventNames[0]) == TRACE_EVENT_COUNT) ? 1 : -1];
+
+static TraceRing sRings[TraceRing::MAX_THREADS];
+static pthread_key_t sRingKey;
+static pthread_once_t sRingKeyOnce = PTHREAD_ONCE_INIT;
+static sem_t sDumpSem;
+
+void TraceRing::createKey()
+{
+  pthread_key_create(&sRingKey, release);
+}
+
+static uint64_t nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+TraceRing* TraceRing::current()
+{
+  pthread_once(&sRingKeyOnce, createKey);
+
+  TraceRing* ring = reinterpret_cast<TraceRing*>(pthread_getspecific(sRingKey));
+  if (ring) {
+    return ring;
+  }
+
+  // First trace point hit by this thread; claim a free ring. A ring is
+  // released when its thread exits, so short-lived threads can reuse it.
+  for (int i = 0; i < MAX_THREADS; i++) {
+    if (__sync_bool_compare_and_swap(&sRings[i].mInUse, 0, 1)) {
+      ring = &sRings[i];
+      ring->mTid = syscall(__NR_gettid);
+      memset(ring->mName, 0, sizeof(ring->mName));
+      prctl(PR_GET_NAME, (unsigned long) ring->mName, 0, 0, 0);
+      ring->mHead = 0;
+      pthread_setspecific(sRingKey, ring);
+      return ring;
+    }
+  }
+  return NULL;
+}
+
+void TraceRing::release(void* ring)
+{
+  // Keep the records for the next dump; the slot is only reused by a new
+  // thread.
+  __sync_lock_release(&reinterpret_cast<TraceRing*>(ring)->mInUse);
+}
+
+void TraceRing::push(TraceEventId id, uint8_t phase, int32_t arg)
+{
+  uint32_t head = mHead;
+  Record& record = mRecords[head & (RING_SIZE - 1)];
+  record.timeNs = nowNs();
+  record.arg = arg;
+  record.id = id;
+  record.phase = phase;
+  // Publish the record before the dump thread can see the new head.
+  __sync_synchronize();
+  mHead = head + 1;
+}
+
+void TraceRing::begin(TraceEventId id, int32_t arg)
+{
+  TraceRing* ring = current();
+  if (ring)
+    ring->push(id, 'B', arg);
+}
+
+void TraceRing::end(TraceEventId id)
+{
+  TraceRing* ring = current();
+  if (ring)
+    ring->push(id, 'E', 0);
+}
+
+bool TraceRing::dump(const char* path)
+{
+  static Record sCopy[RING_SIZE];
+
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    ALOGE("%s: cannot open %s (errno=%d)", FUNC, path, errno);
+    return false;
+  }
+
+  pid_t pid = getpid();
+  bool first = true;
+  int total = 0;
+
+  fprintf(file, "{\"traceEvents\":[");
+  for (int i = 0; i < MAX_THREADS; i++) {
+    TraceRing& ring = sRings[i];
+
+    uint32_t head = ring.mHead;
+    __sync_synchronize();
+    uint32_t count = head < RING_SIZE ? head : RING_SIZE;
+    uint32_t start = head - count;
+    for (uint32_t n = 0; n < count; n++) {
+      sCopy[n] = ring.mRecords[(start + n) & (RING_SIZE - 1)];
+    }
+    __sync_synchronize();
+
+    // Records the owner overwrote while they were copied are dropped, and
+    // so is the one it may be writing at newHead.
+    uint32_t newHead = ring.mHead;
+    uint32_t skip = 0;
+    if (newHead + 1 - start > RING_SIZE) {
+      skip = newHead + 1 - start - RING_SIZE;
+      if (skip > count)
+        skip = count;
+    }
+    if (head == 0 || skip == count) {
+      continue;
+    }
+
+    fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}", first ? "" : ",", pid, ring.mTid, ring.mName);
+    first = false;
+
+    for (uint32_t n = skip; n < count; n++) {
+      const Record& record = sCopy[n];
+      if (record.id >= TRACE_EVENT_COUNT) {
+        continue;
+      }
+      fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"nfcd\",\"ph\":\"%c\",\"ts\":%llu.%03llu,"
+              "\"pid\":%d,\"tid\":%d", sEventNames[record.id], record.phase,
+              (unsigned long long) (record.timeNs / 1000),
+              (unsigned long long) (record.timeNs % 1000), pid, ring.mTid);
+      if (record.phase == 'B') {
+        fprintf(file, ",\"args\":{\"arg\":%d}", record.arg);
+      }
+      fprintf(file, "}");
+      total++;
+    }
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  ALOGD("%s: wrote %d trace records to %s", FUNC, total, path);
+  return ok;
+}
+
+static void dumpSignalHandler(int signo)
+{
+  // Only async-signal-safe work here; the dump thread does the rest.
+  sem_post(&sDumpSem);
+}
+
+static void* dumpThreadFunc(void* arg)
+{
+  pthread_setname_np(pthread_self(), "nfcd trace dump");
+  while (true) {
+    if (sem_wait(&sDumpSem)) {
+      if (errno == EINTR)
+        continue;
+      ALOGE("%s: failed to wait for dump semaphore", FUNC);
+      break;
+    }
+    TraceRing::dump(TRACE_DUMP_PATH);
+  }
+  return NULL;
+}
+
+bool TraceRing::installDumpSignal(int signo)
+{
+  if (sem_init(&sDumpSem, 0, 0) == -1) {
+    ALOGE("%s: semaphore creation failed (errno=0x%08x)", FUNC, errno);
+    return false;
+  }
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, dumpThreadFunc, NULL) != 0) {
+    ALOGE("%s: pthread_create failed", FUNC);
+    return false;
+  }
+  pthread_detach(thread);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = dumpSignalHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  if (sigaction(signo, &action, NULL) != 0) {
+    ALOGE("%s: sigaction failed (errno=0x%08x)", FUNC, errno);
+    return false;
+  }
+  return true;
+}
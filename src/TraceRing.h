@@ -0,0 +1,132 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_TraceRing_h
+#define mozilla_nfcd_TraceRing_h
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Trace points of the daemon's hot paths. The ids are fixed at compile
+ * time so recording a span only stores a small integer.
+ */
+typedef enum {
+  TRACE_IPC_RECORD = 0,      // NfcIpcSocket::loop, one record from the socket.
+  TRACE_IPC_REQUEST,         // MessageHandler::processRequest.
+  TRACE_SERVICE_EVENT,       // NfcService::eventLoop, one queued event.
+  TRACE_TAG_CONNECT,         // NfcTagManager::doConnect.
+  TRACE_TAG_RESELECT,        // NfcTagManager::reSelect.
+  TRACE_TAG_CHECK_NDEF,      // NfcTagManager::doCheckNdef.
+  TRACE_TAG_READ,            // NfcTagManager::doRead.
+  TRACE_TAG_WRITE,           // NfcTagManager::doWrite.
+  TRACE_TAG_PRESENCE_CHECK,  // NfcTagManager::doPresenceCheck.
+  TRACE_TAG_MAKE_READONLY,   // NfcTagManager::doMakeReadonly.
+  TRACE_TAG_FORMAT,          // NfcTagManager::doNdefFormat.
+  TRACE_TAG_DISCONNECT,      // NfcTagManager::doDisconnect.
+  TRACE_TAG_TRANSCEIVE,      // NfcTagManager::doTransceive.
+  TRACE_P2P_SEND,            // PeerToPeer::send.
+  TRACE_P2P_RECEIVE,         // PeerToPeer::receive.
+  TRACE_EVENT_COUNT
+} TraceEventId;
+
+/**
+ * Per-thread ring of span begin/end records. Each thread writes only to its
+ * own ring, so recording takes no lock; a dump copies every ring and writes
+ * them in the Chrome trace event JSON format (chrome://tracing, Perfetto).
+ */
+class TraceRing {
+public:
+  // Records kept per thread; must be a power of two.
+  static const uint32_t RING_SIZE = 4096;
+  // Threads that can record at the same time.
+  static const int MAX_THREADS = 16;
+
+  /**
+   * Open a span on the calling thread.
+   *
+   * @param  id  Trace point.
+   * @param  arg Value shown with the span, e.g. a message type.
+   * @return     None.
+   */
+  static void begin(TraceEventId id, int32_t arg);
+
+  /**
+   * Close the span opened by the matching begin() on the calling thread.
+   *
+   * @param  id Trace point.
+   * @return    None.
+   */
+  static void end(TraceEventId id);
+
+  /**
+   * Write the content of every ring to a file.
+   *
+   * @param  path Output path.
+   * @return      True if ok.
+   */
+  static bool dump(const char* path);
+
+  /**
+   * Start a thread that dumps the rings to TRACE_DUMP_PATH every time the
+   * process receives the given signal.
+   *
+   * @param  signo Signal number, e.g. SIGUSR2.
+   * @return       True if ok.
+   */
+  static bool installDumpSignal(int signo);
+
+private:
+  struct Record {
+    uint64_t timeNs;
+    int32_t arg;
+    uint16_t id;
+    uint8_t phase;
+  };
+
+  Record mRecords[RING_SIZE];
+  volatile uint32_t mHead;  // Number of records ever written.
+  volatile int mInUse;
+  pid_t mTid;
+  char mName[16];
+
+  static TraceRing* current();
+  static void createKey();
+  static void release(void* ring);
+  void push(TraceEventId id, uint8_t phase, int32_t arg);
+};
+
+/**
+ * Span covering the enclosing scope.
+ */
+class TraceScope {
+public:
+  TraceScope(TraceEventId id, int32_t arg = 0)
+    : mId(id)
+  {
+    TraceRing::begin(id, arg);
+  }
+
+  ~TraceScope()
+  {
+    TraceRing::end(mId);
+  }
+
+private:
+  TraceEventId mId;
+};
+
+#ifdef NFCD_NO_TRACE
+#define NFCD_TRACE_SCOPE(id)            do {} while (0)
+#define NFCD_TRACE_SCOPE_ARG(id, arg)   do {} while (0)
+#else
+#define NFCD_TRACE_CONCAT2(a, b) a##b
+#define NFCD_TRACE_CONCAT(a, b) NFCD_TRACE_CONCAT2(a, b)
+#define NFCD_TRACE_SCOPE(id) \
+  TraceScope NFCD_TRACE_CONCAT(traceScope, __LINE__)(id)
+#define NFCD_TRACE_SCOPE_ARG(id, arg) \
+  TraceScope NFCD_TRACE_CONCAT(traceScope, __LINE__)(id, arg)
+#endif
+
+#endif // mozilla_nfcd_TraceRing_h
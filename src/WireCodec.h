@@ -0,0 +1,217 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_WireCodec_h
+#define mozilla_nfcd_WireCodec_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Reader and writer for the nfcd wire format described in NfcGonkMessage.h:
+ * a frame is a 4-byte Big-Endian size followed by the message, whose fields
+ * are Little-Endian int32s and byte arrays padded to a multiple of 4 bytes.
+ *
+ * Both work over caller-provided memory and never allocate. A failed read
+ * or an overflowing write puts the codec in an error state that sticks, so
+ * a sequence of calls can be checked once at the end.
+ */
+
+#define WIRE_ALIGN(len) (((len) + 3) & ~((size_t) 3))
+
+/**
+ * Compile-time sizes of fixed-layout messages, e.g.
+ *   WireLayout<WireInt32, WireInt32, WireBytes<2> >::SIZE == 12
+ */
+struct WireNone  { enum { SIZE = 0 }; };
+struct WireInt32 { enum { SIZE = 4 }; };
+template<size_t N>
+struct WireBytes { enum { SIZE = (N + 3) & ~3 }; };
+
+template<typename T0,            typename T1 = WireNone, typename T2 = WireNone,
+         typename T3 = WireNone, typename T4 = WireNone, typename T5 = WireNone,
+         typename T6 = WireNone, typename T7 = WireNone>
+struct WireLayout {
+  enum {
+    SIZE = T0::SIZE + T1::SIZE + T2::SIZE + T3::SIZE +
+           T4::SIZE + T5::SIZE + T6::SIZE + T7::SIZE
+  };
+};
+
+class WireReader {
+public:
+  /**
+   * @param  data Message, without the frame size prefix.
+   * @param  len  Length of the message.
+   */
+  WireReader(const uint8_t* data, size_t len)
+    : mData(data)
+    , mLen(len)
+    , mPos(0)
+    , mOk(true)
+  {}
+
+  bool readInt32(int32_t& value)
+  {
+    if (!check(4)) {
+      value = 0;
+      return false;
+    }
+    const uint8_t* p = mData + mPos;
+    value = (int32_t) ((uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+                       ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+    mPos += 4;
+    return true;
+  }
+
+  bool readUint32(uint32_t& value)
+  {
+    int32_t v;
+    bool ok = readInt32(v);
+    value = (uint32_t) v;
+    return ok;
+  }
+
+  /**
+   * Point into the message instead of copying a padded byte array.
+   *
+   * @param  len  Length of the array, without padding.
+   * @param  data Set to the first byte of the array; valid as long as the
+   *              message buffer is.
+   * @return      True if the whole padded array is in the message.
+   */
+  bool readInplace(size_t len, const uint8_t*& data)
+  {
+    if (len > mLen || !check(WIRE_ALIGN(len))) {
+      data = NULL;
+      return false;
+    }
+    data = mData + mPos;
+    mPos += WIRE_ALIGN(len);
+    return true;
+  }
+
+  size_t remaining() const { return mLen - mPos; }
+  bool ok() const { return mOk; }
+
+private:
+  const uint8_t* mData;
+  size_t mLen;
+  size_t mPos;
+  bool mOk;
+
+  bool check(size_t len)
+  {
+    if (!mOk || len > mLen - mPos) {
+      mOk = false;
+      return false;
+    }
+    return true;
+  }
+};
+
+class WireWriter {
+public:
+  static const size_t PREFIX_SIZE = 4;
+
+  /**
+   * The first PREFIX_SIZE bytes of the buffer are kept for the frame size
+   * so the whole frame can be sent with a single write.
+   *
+   * @param  buffer   Output buffer.
+   * @param  capacity Size of the buffer.
+   */
+  WireWriter(uint8_t* buffer, size_t capacity)
+    : mBuffer(buffer)
+    , mCapacity(capacity)
+    , mPos(PREFIX_SIZE)
+    , mOk(capacity >= PREFIX_SIZE)
+  {}
+
+  bool writeInt32(int32_t value)
+  {
+    if (!check(4))
+      return false;
+    uint8_t* p = mBuffer + mPos;
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t) (value >> 8);
+    p[2] = (uint8_t) (value >> 16);
+    p[3] = (uint8_t) (value >> 24);
+    mPos += 4;
+    return true;
+  }
+
+  /**
+   * Write a byte array followed by zero padding to a multiple of 4 bytes.
+   *
+   * @param  data Bytes to write, may be NULL if len is 0.
+   * @param  len  Number of bytes.
+   * @return      True if ok.
+   */
+  bool writeBytes(const void* data, size_t len)
+  {
+    uint8_t* dest = writeInplace(len);
+    if (!dest)
+      return false;
+    if (len)
+      memcpy(dest, data, len);
+    return true;
+  }
+
+  /**
+   * Reserve a padded byte array to be filled by the caller.
+   *
+   * @param  len Number of bytes.
+   * @return     Where to write the bytes, NULL on overflow.
+   */
+  uint8_t* writeInplace(size_t len)
+  {
+    size_t padded = WIRE_ALIGN(len);
+    if (len > mCapacity || !check(padded))
+      return NULL;
+    uint8_t* dest = mBuffer + mPos;
+    memset(dest + len, 0, padded - len);
+    mPos += padded;
+    return dest;
+  }
+
+  /**
+   * Fill in the Big-Endian size prefix.
+   *
+   * @return The complete frame, NULL if a write overflowed.
+   */
+  const uint8_t* frame()
+  {
+    if (!mOk)
+      return NULL;
+    uint32_t size = mPos - PREFIX_SIZE;
+    mBuffer[0] = (uint8_t) (size >> 24);
+    mBuffer[1] = (uint8_t) (size >> 16);
+    mBuffer[2] = (uint8_t) (size >> 8);
+    mBuffer[3] = (uint8_t) size;
+    return mBuffer;
+  }
+
+  size_t frameSize() const { return mPos; }
+  size_t size() const { return mPos - PREFIX_SIZE; }
+  bool ok() const { return mOk; }
+
+private:
+  uint8_t* mBuffer;
+  size_t mCapacity;
+  size_t mPos;
+  bool mOk;
+
+  bool check(size_t len)
+  {
+    if (!mOk || len > mCapacity - mPos) {
+      mOk = false;
+      return false;
+    }
+    return true;
+  }
+};
+
+#endif // mozilla_nfcd_WireCodec_h
@@ -0,0 +1,185 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+#include <time.h>
+#include "CondVar.h"
+#include "Mutex.h"
+
+/**
+ * State of a Completion.
+ */
+typedef enum {
+  COMPLETION_IDLE = 0,  // Never armed.
+  COMPLETION_PENDING,   // Armed; the operation is in flight.
+  COMPLETION_DONE,      // The operation completed; status and payload are set.
+  COMPLETION_TIMED_OUT, // The waiter gave up before the operation completed.
+  COMPLETION_CANCELLED  // Cancelled before the operation completed.
+} CompletionState;
+
+/**
+ * Payload of a completion that only carries a status.
+ */
+struct CompletionNoPayload {};
+
+/**
+ * Outcome of one asynchronous RF operation. It is armed before the operation
+ * is handed to the stack and completed from the NFA callback with a status
+ * and a payload; the caller either waits for it or gives a continuation.
+ *
+ * Only the operation it was armed for can complete it: once done, timed out
+ * or cancelled, complete() is ignored until the next arm(), so a late NFA
+ * event cannot be taken for the result of a later operation.
+ */
+template<typename T = CompletionNoPayload>
+class Completion
+{
+public:
+  typedef void (*Continuation)(Completion<T>& completion, void* context);
+
+  Completion()
+    : mState(COMPLETION_IDLE)
+    , mStatus(0)
+    , mContinuation(NULL)
+    , mContext(NULL)
+  {
+  }
+
+  /**
+   * Arm for a new operation. Must be called before the operation is
+   * started, so that its completion cannot be missed.
+   *
+   * @param  continuation Called on the completing thread once the operation
+   *                      is done or cancelled; NULL if the caller waits.
+   * @param  context      Passed to the continuation.
+   * @return              None.
+   */
+  void arm(Continuation continuation = NULL, void* context = NULL)
+  {
+    AutoMutex lock(mMutex);
+    mState = COMPLETION_PENDING;
+    mStatus = 0;
+    mPayload = T();
+    mContinuation = continuation;
+    mContext = context;
+  }
+
+  /**
+   * Complete the pending operation and wake its waiter or run its
+   * continuation.
+   *
+   * @param  status  Status of the operation.
+   * @param  payload Result of the operation.
+   * @return         False if no operation was pending, e.g. it already timed
+   *                 out; the result is then dropped.
+   */
+  bool complete(int status, const T& payload = T())
+  {
+    return finish(COMPLETION_DONE, status, &payload);
+  }
+
+  /**
+   * Cancel the pending operation, if any. Its waiter returns
+   * COMPLETION_CANCELLED and its continuation runs.
+   *
+   * @param  status Status reported for the cancelled operation.
+   * @return        False if no operation was pending.
+   */
+  bool cancel(int status = 0)
+  {
+    return finish(COMPLETION_CANCELLED, status, NULL);
+  }
+
+  /**
+   * Block until the operation is done or cancelled, or the timeout expires.
+   * On timeout the operation is given up and its late completion dropped.
+   *
+   * @param  timeoutMs Timeout in milliseconds; negative to wait forever.
+   * @return           The state the operation ended in.
+   */
+  CompletionState wait(long timeoutMs)
+  {
+    AutoMutex lock(mMutex);
+    if (timeoutMs < 0) {
+      while (mState == COMPLETION_PENDING) {
+        mCondVar.wait(mMutex);
+      }
+      return mState;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (timeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+
+    while (mState == COMPLETION_PENDING) {
+      long leftMs = millisecondsUntil(deadline);
+      if (leftMs <= 0) {
+        mState = COMPLETION_TIMED_OUT;
+        break;
+      }
+      mCondVar.wait(mMutex, leftMs);
+    }
+    return mState;
+  }
+
+  CompletionState state()
+  {
+    AutoMutex lock(mMutex);
+    return mState;
+  }
+
+  /**
+   * Status and payload of the last operation. Only meaningful once it is
+   * done, to the thread that armed it.
+   */
+  int status() const { return mStatus; }
+  const T& payload() const { return mPayload; }
+
+private:
+  Completion(const Completion&);
+  Completion& operator=(const Completion&);
+
+  bool finish(CompletionState state, int status, const T* payload)
+  {
+    Continuation continuation;
+    void* context;
+    {
+      AutoMutex lock(mMutex);
+      if (mState != COMPLETION_PENDING)
+        return false;
+      mState = state;
+      mStatus = status;
+      if (payload)
+        mPayload = *payload;
+      continuation = mContinuation;
+      context = mContext;
+      mCondVar.notifyOne();
+    }
+    // Outside the lock, so the continuation may arm the next operation.
+    if (continuation)
+      continuation(*this, context);
+    return true;
+  }
+
+  static long millisecondsUntil(const struct timespec& deadline)
+  {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (deadline.tv_sec - now.tv_sec) * 1000 +
+           (deadline.tv_nsec - now.tv_nsec) / 1000000;
+  }
+
+  Mutex mMutex;
+  CondVar mCondVar;
+  CompletionState mState;
+  int mStatus;
+  T mPayload;
+  Continuation mContinuation;
+  void* mContext;
+};
@@ -10,13 +10,14 @@
 
 #define LOG_TAG "BroadcomNfc"
 #include <cutils/log.h>
+#include "NfcLog.h"
 
 CondVar::CondVar()
 {
   memset(&mCondition, 0, sizeof(mCondition));
   int const res = pthread_cond_init(&mCondition, NULL);
   if (res) {
-    ALOGE("%s: fail init; error=0x%X", __FUNCTION__, res);
+    NFC_LOGE(SERVICE, "%s: fail init; error=0x%X", __FUNCTION__, res);
   }
 }
 
@@ -24,7 +25,7 @@ CondVar::~CondVar()
 {
   int const res = pthread_cond_destroy(&mCondition);
   if (res) {
-    ALOGE("%s: fail destroy; error=0x%X", __FUNCTION__, res);
+    NFC_LOGE(SERVICE, "%s: fail destroy; error=0x%X", __FUNCTION__, res);
   }
 }
 
@@ -32,43 +33,54 @@ void CondVar::wait(Mutex& mutex)
 {
   int const res = pthread_cond_wait(&mCondition, mutex.nativeHandle());
   if (res) {
-    ALOGE("%s: fail wait; error=0x%X", __FUNCTION__, res);
+    NFC_LOGE(SERVICE, "%s: fail wait; error=0x%X", __FUNCTION__, res);
   }
 }
 
 bool CondVar::wait(Mutex& mutex, long millisec)
 {
-  bool retVal = false;
   struct timespec absoluteTime;
 
   if (clock_gettime(CLOCK_MONOTONIC, &absoluteTime) == -1) {
-    ALOGE("%s: fail get time; errno=0x%X", __FUNCTION__, errno);
+    NFC_LOGE(SERVICE, "%s: fail get time; errno=0x%X", __FUNCTION__, errno);
   } else {
     absoluteTime.tv_sec += millisec / 1000;
     long ns = absoluteTime.tv_nsec + ((millisec % 1000) * 1000000);
-    if (ns > 1000000000) {
+    if (ns >= 1000000000) {
       absoluteTime.tv_sec++;
       absoluteTime.tv_nsec = ns - 1000000000;
     } else {
       absoluteTime.tv_nsec = ns;
     }
   }
+  return waitUntil(mutex, absoluteTime);
+}
+
+bool CondVar::waitUntil(Mutex& mutex, const struct timespec& deadline)
+{
   // pthread_cond_timedwait_monotonic_np() is an Android-specific function.
   // Declared in /development/ndk/platforms/android-9/include/pthread.h.
   // It uses monotonic clock.
   // The standard pthread_cond_timedwait() uses realtime clock.
-  const int waitResult = pthread_cond_timedwait_monotonic_np(&mCondition, mutex.nativeHandle(), &absoluteTime);
+  const int waitResult = pthread_cond_timedwait_monotonic_np(&mCondition, mutex.nativeHandle(), &deadline);
   if ((waitResult != 0) && (waitResult != ETIMEDOUT)) {
-    ALOGE("%s: fail timed wait; error=0x%X", __FUNCTION__, waitResult);
+    NFC_LOGE(SERVICE, "%s: fail timed wait; error=0x%X", __FUNCTION__, waitResult);
   }
-  retVal = (waitResult == 0); // Waited successfully.
-  return retVal;
+  return waitResult == 0; // Waited successfully.
 }
 
 void CondVar::notifyOne()
 {
   const int res = pthread_cond_signal(&mCondition);
   if (res) {
-    ALOGE("%s: fail signal; error=0x%X", __FUNCTION__, res);
+    NFC_LOGE(SERVICE, "%s: fail signal; error=0x%X", __FUNCTION__, res);
+  }
+}
+
+void CondVar::notifyAll()
+{
+  const int res = pthread_cond_broadcast(&mCondition);
+  if (res) {
+    NFC_LOGE(SERVICE, "%s: fail broadcast; error=0x%X", __FUNCTION__, res);
   }
 }
@@ -4,6 +4,7 @@
 
 #pragma once
 #include <pthread.h>
+#include <time.h>
 #include "Mutex.h"
 
 /**
@@ -32,6 +33,15 @@ public:
    */
   bool wait(Mutex& mutex, long millisec);
 
+  /**
+   * Block the caller and wait for a condition until a deadline.
+   *
+   * @param  mutex    Lock.
+   * @param  deadline Absolute time of CLOCK_MONOTONIC.
+   * @return          True if wait is successful; false if timeout occurs.
+   */
+  bool waitUntil(Mutex& mutex, const struct timespec& deadline);
+
   /**
    * Unblock the waiting thread. 
    *
@@ -39,6 +49,13 @@ public:
    */
   void notifyOne();
 
+  /**
+   * Unblock all the waiting threads.
+   *
+   * @return None.
+   */
+  void notifyAll();
+
 private:
   pthread_cond_t mCondition;
 };
@@ -0,0 +1,297 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "DiscoveryScheduler.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include "NfcGonkMessage.h"
+#include "NfcTag.h"
+#include "Pn544Interop.h"
+
+#undef LOG_TAG
+#define LOG_TAG "BroadcomNfc"
+#include <cutils/log.h>
+#include "NfcLog.h"
+
+extern void reconfigureRfDiscovery(UINT16 pollMs, tNFA_TECHNOLOGY_MASK techMask, bool techsChanged);
+
+static uint64_t nowMs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+DiscoveryScheduler::DiscoveryScheduler()
+ : mThreadStarted(false)
+ , mEvaluatePending(false)
+ , mScreenState(SCREEN_ON_UNLOCKED)
+ , mDiscoveryEnabled(false)
+ , mDefaultPollMs(DEFAULT_POLL_MS)
+ , mBaseTechMask(0)
+ , mLevel(LEVEL_NONE)
+ , mPollMs(DEFAULT_POLL_MS)
+ , mTechMask(0)
+ , mLastActivityMs(0)
+ , mNextTap(0)
+{
+  memset(mTaps, 0, sizeof(mTaps));
+}
+
+DiscoveryScheduler& DiscoveryScheduler::getInstance()
+{
+  static DiscoveryScheduler scheduler;
+  return scheduler;
+}
+
+tNFA_TECHNOLOGY_MASK DiscoveryScheduler::toNfaTechMask(uint32_t pollTechs)
+{
+  tNFA_TECHNOLOGY_MASK mask = 0;
+  if (pollTechs & NFC_POLL_NFCA) mask |= NFA_TECHNOLOGY_MASK_A;
+  if (pollTechs & NFC_POLL_NFCB) mask |= NFA_TECHNOLOGY_MASK_B;
+  if (pollTechs & NFC_POLL_NFCF) mask |= NFA_TECHNOLOGY_MASK_F;
+  if (pollTechs & NFC_POLL_NFCV) mask |= NFA_TECHNOLOGY_MASK_ISO15693;
+  if (pollTechs & NFC_POLL_B_PRIME) mask |= NFA_TECHNOLOGY_MASK_B_PRIME;
+  if (pollTechs & NFC_POLL_KOVIO) mask |= NFA_TECHNOLOGY_MASK_KOVIO;
+  if (pollTechs & NFC_POLL_ACTIVE) mask |= NFA_TECHNOLOGY_MASK_A_ACTIVE | NFA_TECHNOLOGY_MASK_F_ACTIVE;
+  return mask;
+}
+
+void DiscoveryScheduler::setDefaultPollMs(UINT16 pollMs)
+{
+  AutoMutex lock(mMutex);
+  mDefaultPollMs = pollMs;
+  mPollMs = pollMs;
+}
+
+void DiscoveryScheduler::setPolicy(const DiscoveryPolicy& policy)
+{
+  NFC_LOGD(SERVICE, "%s: active %u ms, idle %u ms, screen off %u ms, timeout %u ms, screen off techs 0x%X",
+           __FUNCTION__, policy.activePollMs, policy.idlePollMs, policy.screenOffPollMs,
+           policy.idleTimeoutMs, policy.screenOffTechMask);
+  {
+    AutoMutex lock(mMutex);
+    mPolicy = policy;
+  }
+  evaluate();
+}
+
+void DiscoveryScheduler::setScreenState(ScreenState state)
+{
+  NFC_LOGD(SERVICE, "%s: state=%d", __FUNCTION__, state);
+  {
+    AutoMutex lock(mMutex);
+    if (state == SCREEN_ON_UNLOCKED && mScreenState != SCREEN_ON_UNLOCKED)
+      mLastActivityMs = nowMs();
+    mScreenState = state;
+  }
+  evaluate();
+}
+
+tNFA_TECHNOLOGY_MASK DiscoveryScheduler::prepareDiscovery(tNFA_TECHNOLOGY_MASK techMask)
+{
+  AutoMutex applyLock(mApplyMutex);
+  AutoMutex lock(mMutex);
+
+  mBaseTechMask = techMask;
+  mLastActivityMs = nowMs();
+
+  uint32_t holdMs = 0;
+  Level level = getLevel(holdMs);
+  UINT16 pollMs = 0;
+  getDutyCycle(level, pollMs, mTechMask);
+  mLevel = level;
+  if (pollMs != mPollMs) {
+    tNFA_STATUS stat = NFA_SetRfDiscoveryDuration(pollMs);
+    if (stat == NFA_STATUS_OK)
+      mPollMs = pollMs;
+    else
+      NFC_LOGE(SERVICE, "%s: NFA_SetRfDiscoveryDuration fail, error=0x%X", __FUNCTION__, stat);
+  }
+  return mTechMask;
+}
+
+void DiscoveryScheduler::setDiscoveryEnabled(bool enabled)
+{
+  // Wait for a change being applied to finish.
+  AutoMutex applyLock(mApplyMutex);
+  AutoMutex lock(mMutex);
+
+  mDiscoveryEnabled = enabled;
+  if (!enabled) {
+    mTimer.kill();
+  } else if (isEnabled()) {
+    // Arms the timer for the end of the active period.
+    mTimer.set(APPLY_DELAY_MS, onTimer);
+  }
+}
+
+void DiscoveryScheduler::noteTap()
+{
+  AutoMutex lock(mMutex);
+  uint64_t now = nowMs();
+  mLastActivityMs = now;
+  mTaps[mNextTap] = now;
+  mNextTap = (mNextTap + 1) % MAX_TAPS;
+}
+
+void DiscoveryScheduler::noteTagGone()
+{
+  AutoMutex lock(mMutex);
+  mLastActivityMs = nowMs();
+  if (mDiscoveryEnabled && isEnabled())
+    mTimer.set(APPLY_DELAY_MS, onTimer);
+}
+
+void DiscoveryScheduler::onTimer(union sigval)
+{
+  getInstance().requestEvaluate();
+}
+
+void DiscoveryScheduler::requestEvaluate()
+{
+  AutoMutex lock(mMutex);
+
+  if (!mThreadStarted) {
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&thread, &attr, threadFunc, this);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+      NFC_LOGE(SERVICE, "%s: fail create thread, error=%d", __FUNCTION__, ret);
+      return;
+    }
+    mThreadStarted = true;
+  }
+  mEvaluatePending = true;
+  mEvaluateCond.notifyOne();
+}
+
+void* DiscoveryScheduler::threadFunc(void* arg)
+{
+  pthread_setname_np(pthread_self(), "NFC discovery");
+  static_cast<DiscoveryScheduler*>(arg)->run();
+  return NULL;
+}
+
+void DiscoveryScheduler::run()
+{
+  mMutex.lock();
+  while (true) {
+    while (!mEvaluatePending)
+      mEvaluateCond.wait(mMutex);
+    mEvaluatePending = false;
+
+    mMutex.unlock();
+    evaluate();
+    mMutex.lock();
+  }
+}
+
+void DiscoveryScheduler::evaluate()
+{
+  AutoMutex applyLock(mApplyMutex);
+
+  // Restarting discovery now would deactivate the tag. Checked before
+  // taking mMutex, as the PN544 work-around holds its lock across NFA calls.
+  bool busy = NfcTag::getInstance().getActivationState() != NfcTag::Idle ||
+              pn544InteropIsBusy();
+
+  uint32_t holdMs = 0;
+  Level level;
+  UINT16 pollMs = 0;
+  tNFA_TECHNOLOGY_MASK techMask = 0;
+  bool techsChanged = false;
+  {
+    AutoMutex lock(mMutex);
+    if (!mDiscoveryEnabled)
+      return;
+
+    level = getLevel(holdMs);
+    getDutyCycle(level, pollMs, techMask);
+    if (pollMs == mPollMs && techMask == mTechMask) {
+      mLevel = level;
+      if (holdMs)
+        mTimer.set(holdMs, onTimer);
+      return;
+    }
+
+    if (busy) {
+      mTimer.set(RETRY_MS, onTimer);
+      return;
+    }
+    techsChanged = techMask != mTechMask;
+  }
+
+  NFC_LOGD(SERVICE, "%s: level %d, poll %u ms, tech mask 0x%X", __FUNCTION__, level, pollMs, techMask);
+  reconfigureRfDiscovery(pollMs, techMask, techsChanged);
+
+  AutoMutex lock(mMutex);
+  mLevel = level;
+  mPollMs = pollMs;
+  mTechMask = techMask;
+  if (holdMs)
+    mTimer.set(holdMs, onTimer);
+}
+
+DiscoveryScheduler::Level DiscoveryScheduler::getLevel(uint32_t& holdMs)
+{
+  holdMs = 0;
+  if (!isEnabled())
+    return LEVEL_NONE;
+  if (mScreenState == SCREEN_OFF)
+    return LEVEL_SCREEN_OFF;
+  if (mScreenState == SCREEN_ON_LOCKED)
+    return LEVEL_IDLE;
+
+  uint64_t now = nowMs();
+  uint32_t recentTaps = 0;
+  for (uint32_t i = 0; i < MAX_TAPS; i++) {
+    if (mTaps[i] && now - mTaps[i] < TAP_WINDOW_MS)
+      recentTaps++;
+  }
+  uint32_t shift = recentTaps > 1 ? recentTaps - 1 : 0;
+  if (shift > MAX_HOLD_SHIFT)
+    shift = MAX_HOLD_SHIFT;
+
+  uint64_t hold = (uint64_t)mPolicy.idleTimeoutMs << shift;
+  uint64_t elapsed = now - mLastActivityMs;
+  if (elapsed >= hold)
+    return LEVEL_IDLE;
+
+  holdMs = hold - elapsed;
+  return LEVEL_ACTIVE;
+}
+
+void DiscoveryScheduler::getDutyCycle(Level level, UINT16& pollMs, tNFA_TECHNOLOGY_MASK& techMask)
+{
+  uint32_t ms = mDefaultPollMs;
+  techMask = mBaseTechMask;
+
+  switch (level) {
+    case LEVEL_ACTIVE:
+      ms = mPolicy.activePollMs;
+      break;
+    case LEVEL_SCREEN_OFF:
+      if (mPolicy.screenOffTechMask)
+        techMask = toNfaTechMask(mPolicy.screenOffTechMask);
+      if (mPolicy.screenOffPollMs) {
+        ms = mPolicy.screenOffPollMs;
+        break;
+      }
+      // Fall through.
+    case LEVEL_IDLE:
+      ms = mPolicy.idlePollMs ? mPolicy.idlePollMs : mPolicy.activePollMs;
+      break;
+    case LEVEL_NONE:
+      break;
+  }
+  pollMs = ms > 0xFFFF ? 0xFFFF : ms;
+}
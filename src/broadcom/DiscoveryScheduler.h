@@ -0,0 +1,189 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "CondVar.h"
+#include "DiscoveryPolicy.h"
+#include "IntervalTimer.h"
+#include "Mutex.h"
+
+extern "C"
+{
+  #include "nfa_api.h"
+}
+
+/**
+ * Adapts the RF discovery duty cycle to activity and screen state, see
+ * DiscoveryPolicy.
+ *
+ * Changing the duty cycle restarts RF discovery, which would deactivate a
+ * tag in the field. So changes are applied from a timer, only while nothing
+ * is activated, and retried later otherwise. The NFA callbacks only record
+ * activity and never wait for a change to be applied.
+ *
+ * Applying a change waits for the stack, so the timer only wakes up a
+ * thread of the scheduler that applies it; the shared timer thread never
+ * blocks on it.
+ */
+class DiscoveryScheduler
+{
+public:
+  // NFA_DM_DISC_DURATION_POLL of the stack.
+  static const UINT16 DEFAULT_POLL_MS = 500;
+
+  /**
+   * Get a reference to the singleton DiscoveryScheduler object.
+   *
+   * @return Reference to DiscoveryScheduler object.
+   */
+  static DiscoveryScheduler& getInstance();
+
+  /**
+   * Map NfcPollTechnology flags to NFA technologies.
+   *
+   * @param  pollTechs NfcPollTechnology flags.
+   * @return           NFA_TECHNOLOGY_MASK_* flags.
+   */
+  static tNFA_TECHNOLOGY_MASK toNfaTechMask(uint32_t pollTechs);
+
+  /**
+   * Set the poll period used without a policy, once it is configured.
+   *
+   * @param  pollMs Poll period set with NFA_SetRfDiscoveryDuration().
+   * @return        None.
+   */
+  void setDefaultPollMs(UINT16 pollMs);
+
+  /**
+   * Set the policy and apply it.
+   *
+   * @param  policy New policy.
+   * @return        None.
+   */
+  void setPolicy(const DiscoveryPolicy& policy);
+
+  /**
+   * Set the screen state and apply the policy for it. Unlocking counts as
+   * activity.
+   *
+   * @param  state Screen state of the platform.
+   * @return       None.
+   */
+  void setScreenState(ScreenState state);
+
+  /**
+   * Set the poll period discovery is about to start with, and get its
+   * technologies. Called by NfcManager::enableDiscovery() with RF discovery
+   * stopped, so that starting discovery does not need another restart.
+   *
+   * @param  techMask Technologies polled without the scheduler.
+   * @return          Technologies to poll for.
+   */
+  tNFA_TECHNOLOGY_MASK prepareDiscovery(tNFA_TECHNOLOGY_MASK techMask);
+
+  /**
+   * Called once discovery has started, and before it stops; the duty cycle
+   * is only changed in between.
+   *
+   * @param  enabled True if discovery has started.
+   * @return         None.
+   */
+  void setDiscoveryEnabled(bool enabled);
+
+  /**
+   * Record a tag or peer activation. Called from the NFA callback.
+   *
+   * @return None.
+   */
+  void noteTap();
+
+  /**
+   * Record that the activated tag or peer is gone, so that the next change
+   * can be applied. Called from the NFA callback.
+   *
+   * @return None.
+   */
+  void noteTagGone();
+
+private:
+  enum Level {
+    LEVEL_NONE,
+    LEVEL_ACTIVE,
+    LEVEL_IDLE,
+    LEVEL_SCREEN_OFF
+  };
+
+  // Taps remembered to estimate the tap rate.
+  static const uint32_t MAX_TAPS = 4;
+  // Taps older than this do not count towards the rate.
+  static const uint32_t TAP_WINDOW_MS = 60000;
+  // Each other recent tap doubles the active period, up to this many times.
+  static const uint32_t MAX_HOLD_SHIFT = 2;
+  // Delay before applying a change once a tag is gone.
+  static const int APPLY_DELAY_MS = 50;
+  // Delay before trying again while a tag is activated.
+  static const int RETRY_MS = 500;
+
+  DiscoveryScheduler();
+
+  static void onTimer(union sigval);
+
+  static void* threadFunc(void* arg);
+
+  /**
+   * Have the scheduler thread call evaluate(), starting the thread on first
+   * use.
+   */
+  void requestEvaluate();
+
+  /**
+   * Run evaluate() whenever requested, forever.
+   */
+  void run();
+
+  /**
+   * Apply the level due now and arm the timer for the next change.
+   */
+  void evaluate();
+
+  /**
+   * Level due now. Must be called with mMutex held.
+   *
+   * @param  holdMs Returns the time until the level backs off, 0 if it
+   *                does not.
+   * @return        Level due now.
+   */
+  Level getLevel(uint32_t& holdMs);
+
+  /**
+   * Poll period and technologies of a level. Must be called with mMutex
+   * held.
+   */
+  void getDutyCycle(Level level, UINT16& pollMs, tNFA_TECHNOLOGY_MASK& techMask);
+
+  bool isEnabled() const { return mPolicy.activePollMs != 0; }
+
+  // Held while a change is applied, across the NFA calls.
+  Mutex mApplyMutex;
+  // Protects the members below; never held across NFA calls.
+  Mutex mMutex;
+  IntervalTimer mTimer;
+  CondVar mEvaluateCond;
+  bool mThreadStarted;
+  bool mEvaluatePending;
+  DiscoveryPolicy mPolicy;
+  ScreenState mScreenState;
+  bool mDiscoveryEnabled;
+  UINT16 mDefaultPollMs;
+  tNFA_TECHNOLOGY_MASK mBaseTechMask;
+  Level mLevel;
+  UINT16 mPollMs;
+  tNFA_TECHNOLOGY_MASK mTechMask;
+  uint64_t mLastActivityMs;
+  uint64_t mTaps[MAX_TAPS];
+  uint32_t mNextTap;
+};
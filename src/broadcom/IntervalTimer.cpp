@@ -9,40 +9,27 @@
 
 #define LOG_TAG "BroadcomNfc"
 #include <cutils/log.h>
+#include "NfcLog.h"
 
 IntervalTimer::IntervalTimer()
 {
-  mTimerId = 0;
   mCb = NULL;
 }
 
 bool IntervalTimer::set(int ms, TIMER_FUNC cb)
 {
-  if (mTimerId == 0) {
-    if (!cb)
-      return false;
-
-    if (!create(cb))
-      return false;
-  }
-  if (cb != mCb) {
-    kill();
-    if (!create(cb))
-      return false;
-  }
-
-  int stat = 0;
-  struct itimerspec ts;
-  ts.it_value.tv_sec = ms / 1000;
-  ts.it_value.tv_nsec = (ms % 1000) * 1000000;
-
-  ts.it_interval.tv_sec = 0;
-  ts.it_interval.tv_nsec = 0;
+  if (!cb)
+    cb = mCb;
+  if (!cb)
+    return false;
+  mCb = cb;
 
-  stat = timer_settime(mTimerId, 0, &ts, 0);
-  if (stat == -1)
-    ALOGE("%s: fail set timer", __FUNCTION__);
-  return stat == 0;
+  union sigval value;
+  value.sival_ptr = this;
+  bool ok = TimerService::getInstance().schedule(mEntry, ms, cb, value);
+  if (!ok)
+    NFC_LOGE(SERVICE, "%s: fail set timer", __FUNCTION__);
+  return ok;
 }
 
 IntervalTimer::~IntervalTimer()
@@ -52,28 +39,14 @@ IntervalTimer::~IntervalTimer()
 
 void IntervalTimer::kill()
 {
-  if (mTimerId == 0)
-    return;
-
-  timer_delete(mTimerId);
-  mTimerId = 0;
+  TimerService::getInstance().cancel(mEntry);
   mCb = NULL;
 }
 
 bool IntervalTimer::create(TIMER_FUNC cb)
 {
-  struct sigevent se;
-  int stat = 0;
-
-  // Set the sigevent structure to cause the signal to be
-  // delivered by creating a new thread.
-  se.sigev_notify = SIGEV_THREAD;
-  se.sigev_value.sival_ptr = &mTimerId;
-  se.sigev_notify_function = cb;
-  se.sigev_notify_attributes = NULL;
+  // Nothing to allocate; the timer is armed by set().
+  kill();
   mCb = cb;
-  stat = timer_create(CLOCK_MONOTONIC, &se, &mTimerId);
-  if (stat == -1)
-    ALOGE("%s: fail create timer", __FUNCTION__);
-  return stat == 0;
+  return cb != NULL;
 }
@@ -2,15 +2,19 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this file,
  * You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include <time.h>
+#pragma once
+
+#include <signal.h>
+
+#include "TimerService.h"
 
 /**
- * Asynchronous interval timer.
+ * Asynchronous interval timer. Callbacks run on the TimerService thread.
  */
 class IntervalTimer
 {
 public:
-  typedef void (*TIMER_FUNC) (union sigval);
+  typedef TimerService::Callback TIMER_FUNC;
 
   IntervalTimer();
   ~IntervalTimer();
@@ -20,6 +24,6 @@ public:
   bool create(TIMER_FUNC);
 
 private:
-  timer_t mTimerId;
+  TimerService::Entry mEntry;
   TIMER_FUNC mCb;
 };
@@ -10,6 +10,7 @@
 
 #define LOG_TAG "BroadcomNfc"
 #include <cutils/log.h>
+#include "NfcLog.h"
 
 LlcpServiceSocket::LlcpServiceSocket(uint32_t handle, int localLinearBufferLength, int localMiu, int localRw)
   : mHandle(handle)
@@ -25,7 +26,7 @@ LlcpServiceSocket::~LlcpServiceSocket()
 
 ILlcpSocket* LlcpServiceSocket::accept()
 {
-  ALOGD("%s: enter", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: enter", __FUNCTION__);
 
   const uint32_t serverHandle = mHandle;
   const uint32_t connHandle = PeerToPeer::getInstance().getNewHandle();
@@ -33,29 +34,29 @@ ILlcpSocket* LlcpServiceSocket::accept()
 
   stat = PeerToPeer::getInstance().accept(serverHandle, connHandle, mLocalMiu, mLocalRw);
   if (!stat) {
-    ALOGE("%s: fail accept", __FUNCTION__);
+    NFC_LOGE(P2P, "%s: fail accept", __FUNCTION__);
     return NULL;
   }
 
   LlcpSocket* clientSocket = new LlcpSocket(connHandle, mLocalMiu, mLocalRw);
 
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: exit", __FUNCTION__);
   return static_cast<ILlcpSocket*>(clientSocket);
 }
 
 bool LlcpServiceSocket::close()
 {
-  ALOGD("%s: enter", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: enter", __FUNCTION__);
 
   const uint32_t serverHandle = mHandle;
   bool stat = false;
 
   stat = PeerToPeer::getInstance().deregisterServer(serverHandle);
   if (!stat) {
-    ALOGE("%s: fail deregister server", __FUNCTION__);
+    NFC_LOGE(P2P, "%s: fail deregister server", __FUNCTION__);
     return NULL;
   }
 
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: exit", __FUNCTION__);
   return true;
 }
@@ -8,6 +8,7 @@
 
 #define LOG_TAG "BroadcomNfc"
 #include <cutils/log.h>
+#include "NfcLog.h"
 
 LlcpSocket::LlcpSocket(unsigned int handle, int sap, int miu, int rw)
   : mHandle(handle)
@@ -71,43 +72,43 @@ int LlcpSocket::getRemoteRw() const
  */ 
 bool LlcpSocket::doConnect(int nSap)
 {
-  ALOGD("%s: enter; sap=%d", __FUNCTION__, nSap);
+  NFC_LOGD(P2P, "%s: enter; sap=%d", __FUNCTION__, nSap);
 
   bool stat = PeerToPeer::getInstance().connectConnOriented(mHandle, nSap);
   if (!stat) {
-    ALOGE("%s: fail connect oriented", __FUNCTION__);
+    NFC_LOGE(P2P, "%s: fail connect oriented", __FUNCTION__);
   }
 
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: exit", __FUNCTION__);
   return stat;
 }
 
 bool LlcpSocket::doConnectBy(const char* sn)
 {
-  ALOGD("%s: enter; sn = %s", __FUNCTION__, sn);
+  NFC_LOGD(P2P, "%s: enter; sn = %s", __FUNCTION__, sn);
 
   if (!sn) {
     return false;
   }
   bool stat = PeerToPeer::getInstance().connectConnOriented(mHandle, sn);
   if (!stat) {
-    ALOGE("%s: fail connect connection oriented", __FUNCTION__);
+    NFC_LOGE(P2P, "%s: fail connect connection oriented", __FUNCTION__);
   }
 
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: exit", __FUNCTION__);
   return stat;
 }
 
 bool LlcpSocket::doClose()
 {
-  ALOGD("%s: enter", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: enter", __FUNCTION__);
 
   bool stat = PeerToPeer::getInstance().disconnectConnOriented(mHandle);
   if (!stat) {
-    ALOGE("%s: fail disconnect connection oriented", __FUNCTION__);
+    NFC_LOGE(P2P, "%s: fail disconnect connection oriented", __FUNCTION__);
   }
 
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: exit", __FUNCTION__);
   return true;  // TODO: stat?
 }
 
@@ -120,7 +121,7 @@ bool LlcpSocket::doSend(std::vector<uint8_t>& data)
 
   bool stat = PeerToPeer::getInstance().send(mHandle, raw_ptr, data.size());
   if (!stat) {
-    ALOGE("%s: fail send", __FUNCTION__);
+    NFC_LOGE(P2P, "%s: fail send", __FUNCTION__);
   }  
 
   delete[] raw_ptr;
@@ -152,20 +153,20 @@ int LlcpSocket::doReceive(std::vector<uint8_t>& recvBuff)
 
 int LlcpSocket::doGetRemoteSocketMIU() const
 {
-  ALOGD("%s: enter", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: enter", __FUNCTION__);
 
   int miu = PeerToPeer::getInstance().getRemoteMaxInfoUnit(mHandle);
 
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: exit", __FUNCTION__);
   return miu;
 }
 
 int LlcpSocket::doGetRemoteSocketRW() const
 {
-  ALOGD("%s: enter", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: enter", __FUNCTION__);
 
   int rw = PeerToPeer::getInstance().getRemoteRecvWindow(mHandle);
 
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(P2P, "%s: exit", __FUNCTION__);
   return rw;
 }
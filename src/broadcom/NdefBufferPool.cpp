@@ -0,0 +1,63 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "NdefBufferPool.h"
+
+NdefBufferPool::NdefBufferPool()
+{
+}
+
+NdefBufferPool& NdefBufferPool::getInstance()
+{
+  static NdefBufferPool pool;
+  return pool;
+}
+
+void NdefBufferPool::acquire(size_t size, std::vector<uint8_t>& buf)
+{
+  release(buf);
+
+  uint32_t sizeClass = 0;
+  while (sizeClass < NUM_CLASSES && classSize(sizeClass) < size)
+    sizeClass++;
+  if (sizeClass == NUM_CLASSES) {
+    buf.reserve(size);
+    return;
+  }
+
+  {
+    AutoMutex lock(mMutex);
+    std::vector<std::vector<uint8_t> >& free = mFree[sizeClass];
+    if (!free.empty()) {
+      buf.swap(free.back());
+      free.pop_back();
+      return;
+    }
+  }
+  buf.reserve(classSize(sizeClass));
+}
+
+void NdefBufferPool::release(std::vector<uint8_t>& buf)
+{
+  size_t capacity = buf.capacity();
+  if (capacity < SMALLEST_CLASS || capacity >= classSize(NUM_CLASSES)) {
+    std::vector<uint8_t>().swap(buf);
+    return;
+  }
+
+  // The largest class the buffer can serve.
+  uint32_t sizeClass = NUM_CLASSES - 1;
+  while (classSize(sizeClass) > capacity)
+    sizeClass--;
+
+  buf.clear();
+  AutoMutex lock(mMutex);
+  std::vector<std::vector<uint8_t> >& free = mFree[sizeClass];
+  if (free.size() < MAX_PER_CLASS) {
+    free.push_back(std::vector<uint8_t>());
+    free.back().swap(buf);
+  } else {
+    std::vector<uint8_t>().swap(buf);
+  }
+}
@@ -0,0 +1,62 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "Mutex.h"
+
+/**
+ * Reusable buffers for the NDEF messages read from tags.
+ *
+ * Buffers are kept in size classes of 256 bytes to 64 KB, a few per class,
+ * and are handed around by swapping vectors, so a read moves its buffer from
+ * the NFA callback to the parser without copying it. Larger buffers are not
+ * kept.
+ */
+class NdefBufferPool
+{
+public:
+  static const uint32_t NUM_CLASSES = 5;
+  static const size_t SMALLEST_CLASS = 256;
+  // Buffers kept per class.
+  static const uint32_t MAX_PER_CLASS = 2;
+
+  /**
+   * Get a reference to the singleton NdefBufferPool object.
+   *
+   * @return Reference to NdefBufferPool object.
+   */
+  static NdefBufferPool& getInstance();
+
+  /**
+   * Get an empty buffer that holds at least size bytes without growing.
+   *
+   * @param  size Bytes needed.
+   * @param  buf  Returns the buffer; its previous storage is released.
+   * @return      None.
+   */
+  void acquire(size_t size, std::vector<uint8_t>& buf);
+
+  /**
+   * Give a buffer back.
+   *
+   * @param  buf Buffer to give back; left empty, without storage.
+   * @return     None.
+   */
+  void release(std::vector<uint8_t>& buf);
+
+private:
+  NdefBufferPool();
+
+  static size_t classSize(uint32_t sizeClass)
+  {
+    return SMALLEST_CLASS << (2 * sizeClass);
+  }
+
+  Mutex mMutex;
+  std::vector<std::vector<uint8_t> > mFree[NUM_CLASSES];
+};
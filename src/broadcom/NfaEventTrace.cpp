@@ -0,0 +1,397 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "NfaEventTrace.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#undef LOG_TAG
+#define LOG_TAG "BroadcomNfc"
+#include <cutils/log.h>
+
+const char NfaEventTrace::MAGIC[4] = {'N', 'F', 'A', 'T'};
+
+NfaEventTrace::NfaEventTrace()
+ : mFile(NULL)
+ , mIsReplaying(false)
+ , mTagActive(false)
+ , mUnmatched(0)
+ , mDmCback(NULL)
+ , mConnCback(NULL)
+ , mP2pServerCback(NULL)
+ , mP2pClientCback(NULL)
+ , mNdefCback(NULL)
+{
+  memset(&mLastTime, 0, sizeof(mLastTime));
+  memset(mRequests, 0, sizeof(mRequests));
+  memset(mCompletions, 0, sizeof(mCompletions));
+}
+
+NfaEventTrace::~NfaEventTrace()
+{
+  stopRecording();
+}
+
+NfaEventTrace& NfaEventTrace::getInstance()
+{
+  static NfaEventTrace trace;
+  return trace;
+}
+
+bool NfaEventTrace::startRecording(const char* path)
+{
+  AutoMutex lock(mMutex);
+
+  if (mFile) {
+    fclose(mFile);
+    mFile = NULL;
+  }
+
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    ALOGE("%s: cannot open %s (errno=%d)", __FUNCTION__, path, errno);
+    return false;
+  }
+
+  if (fwrite(MAGIC, 1, sizeof(MAGIC), file) != sizeof(MAGIC) ||
+      fputc(FORMAT_VERSION, file) == EOF) {
+    ALOGE("%s: cannot write header to %s", __FUNCTION__, path);
+    fclose(file);
+    return false;
+  }
+  fflush(file);
+
+  clock_gettime(CLOCK_MONOTONIC, &mLastTime);
+  mFile = file;
+  ALOGD("%s: recording NFA events to %s", __FUNCTION__, path);
+  return true;
+}
+
+void NfaEventTrace::stopRecording()
+{
+  AutoMutex lock(mMutex);
+
+  if (mFile) {
+    fclose(mFile);
+    mFile = NULL;
+  }
+}
+
+void NfaEventTrace::setNfaCallbacks(tNFA_DM_CBACK* dmCback, tNFA_CONN_CBACK* connCback)
+{
+  mDmCback = dmCback;
+  mConnCback = connCback;
+}
+
+void NfaEventTrace::setP2pCallbacks(tNFA_P2P_CBACK* serverCback, tNFA_P2P_CBACK* clientCback)
+{
+  mP2pServerCback = serverCback;
+  mP2pClientCback = clientCback;
+}
+
+void NfaEventTrace::setNdefCallback(tNFA_NDEF_CBACK* ndefCback)
+{
+  mNdefCback = ndefCback;
+}
+
+void NfaEventTrace::recordDmEvent(UINT8 event, tNFA_DM_CBACK_DATA* eventData)
+{
+  if (!mFile || mIsReplaying)
+    return;
+
+  const void* extra = NULL;
+  size_t extraLen = 0;
+  if (eventData && event == NFA_DM_GET_CONFIG_EVT) {
+    extra = eventData->get_config.param_tlvs;
+    extraLen = eventData->get_config.tlv_size;
+  }
+  record(SOURCE_DEVICE_MANAGEMENT, event, eventData,
+         eventData ? sizeof(*eventData) : 0, extra, extraLen);
+}
+
+void NfaEventTrace::recordConnEvent(UINT8 event, tNFA_CONN_EVT_DATA* eventData)
+{
+  if (!mFile || mIsReplaying)
+    return;
+
+  const void* extra = NULL;
+  size_t extraLen = 0;
+  if (eventData && event == NFA_DATA_EVT) {
+    extra = eventData->data.p_data;
+    extraLen = eventData->data.len;
+  }
+  record(SOURCE_CONNECTION, event, eventData,
+         eventData ? sizeof(*eventData) : 0, extra, extraLen);
+}
+
+void NfaEventTrace::recordP2pEvent(Source source, tNFA_P2P_EVT event, tNFA_P2P_EVT_DATA* eventData)
+{
+  if (!mFile || mIsReplaying)
+    return;
+
+  record(source, event, eventData, eventData ? sizeof(*eventData) : 0, NULL, 0);
+}
+
+void NfaEventTrace::recordNdefEvent(tNFA_NDEF_EVT event, tNFA_NDEF_EVT_DATA* eventData)
+{
+  if (!mFile || mIsReplaying)
+    return;
+
+  const void* extra = NULL;
+  size_t extraLen = 0;
+  if (eventData && event == NFA_NDEF_DATA_EVT) {
+    extra = eventData->ndef_data.p_data;
+    extraLen = eventData->ndef_data.len;
+  }
+  record(SOURCE_NDEF_HANDLER, event, eventData,
+         eventData ? sizeof(*eventData) : 0, extra, extraLen);
+}
+
+void NfaEventTrace::record(Source source, UINT8 event, const void* data, size_t size,
+                           const void* extra, size_t extraLen)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  // Most events only use a small member of the data union; dropping the
+  // trailing zero bytes keeps each record close to the size of that member.
+  const UINT8* bytes = reinterpret_cast<const UINT8*>(data);
+  while (size > 0 && bytes[size - 1] == 0)
+    size--;
+
+  if (size > 0xFFFF)
+    size = 0xFFFF;
+  if (!extra || extraLen > 0xFFFF)
+    extraLen = extra ? 0xFFFF : 0;
+
+  AutoMutex lock(mMutex);
+  if (!mFile)
+    return;
+
+  long long deltaUs = (now.tv_sec - mLastTime.tv_sec) * 1000000LL +
+                      (now.tv_nsec - mLastTime.tv_nsec) / 1000;
+  if (deltaUs < 0)
+    deltaUs = 0;
+  else if (deltaUs > 0xFFFFFFFFLL)
+    deltaUs = 0xFFFFFFFFLL;
+  mLastTime = now;
+
+  UINT8 header[HEADER_SIZE];
+  UINT32 delta = (UINT32) deltaUs;
+  UINT16 payloadLen = (UINT16) size;
+  UINT16 extraLength = (UINT16) extraLen;
+  header[0] = (UINT8) source;
+  header[1] = event;
+  memcpy(&header[2], &delta, sizeof(delta));
+  memcpy(&header[6], &payloadLen, sizeof(payloadLen));
+  memcpy(&header[8], &extraLength, sizeof(extraLength));
+
+  bool ok = fwrite(header, 1, sizeof(header), mFile) == sizeof(header);
+  if (ok && payloadLen)
+    ok = fwrite(bytes, 1, payloadLen, mFile) == payloadLen;
+  if (ok && extraLength)
+    ok = fwrite(extra, 1, extraLength, mFile) == extraLength;
+  fflush(mFile);
+
+  if (!ok) {
+    ALOGE("%s: write failed (errno=%d); stop recording", __FUNCTION__, errno);
+    fclose(mFile);
+    mFile = NULL;
+  }
+}
+
+bool NfaEventTrace::replay(const char* path, int speedPercent)
+{
+  ALOGD("%s: enter; path=%s, speed=%d%%", __FUNCTION__, path, speedPercent);
+
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    ALOGE("%s: cannot open %s (errno=%d)", __FUNCTION__, path, errno);
+    return false;
+  }
+
+  bool result = false;
+  int count = 0;
+  UINT8* extra = NULL;
+  char magic[sizeof(MAGIC)];
+
+  if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+      memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      fgetc(file) != FORMAT_VERSION) {
+    ALOGE("%s: %s is not an NFA event trace", __FUNCTION__, path);
+    goto TheEnd;
+  }
+
+  {
+    AutoMutex lock(mReplayMutex);
+    memset(mRequests, 0, sizeof(mRequests));
+    memset(mCompletions, 0, sizeof(mCompletions));
+    mTagActive = false;
+    mUnmatched = 0;
+  }
+
+  mIsReplaying = true;
+  while (true) {
+    UINT8 header[HEADER_SIZE];
+    size_t got = fread(header, 1, sizeof(header), file);
+    if (got == 0 && feof(file)) {
+      result = true;
+      break;
+    }
+    if (got != sizeof(header)) {
+      ALOGE("%s: truncated record %d", __FUNCTION__, count);
+      break;
+    }
+
+    UINT32 delta;
+    UINT16 payloadLen, extraLen;
+    memcpy(&delta, &header[2], sizeof(delta));
+    memcpy(&payloadLen, &header[6], sizeof(payloadLen));
+    memcpy(&extraLen, &header[8], sizeof(extraLen));
+
+    EventData eventData;
+    memset(&eventData, 0, sizeof(eventData));
+    if (payloadLen > sizeof(eventData)) {
+      ALOGE("%s: record %d payload too large (%u)", __FUNCTION__, count, payloadLen);
+      break;
+    }
+    if (payloadLen && fread(&eventData, 1, payloadLen, file) != payloadLen) {
+      ALOGE("%s: truncated payload in record %d", __FUNCTION__, count);
+      break;
+    }
+
+    extra = extraLen ? new UINT8[extraLen] : NULL;
+    if (extraLen && fread(extra, 1, extraLen, file) != extraLen) {
+      ALOGE("%s: truncated extra data in record %d", __FUNCTION__, count);
+      break;
+    }
+
+    if (speedPercent > 0 && delta > 0)
+      usleep((useconds_t) ((unsigned long long) delta * 100 / speedPercent));
+
+    bool consumes;
+    int request = completedRequest((Source) header[0], header[1], eventData, consumes);
+    if (request != REQUEST_COUNT)
+      waitForRequest(request, consumes);
+
+    dispatch((Source) header[0], header[1], eventData, extra, extraLen);
+    delete[] extra;
+    extra = NULL;
+    count++;
+  }
+  mIsReplaying = false;
+
+TheEnd:
+  delete[] extra;
+  fclose(file);
+  ALOGD("%s: exit; replayed %d events, %d without their request; result=%d",
+        __FUNCTION__, count, mUnmatched, result);
+  return result;
+}
+
+bool NfaEventTrace::interceptRequest(Request request)
+{
+  if (!mIsReplaying)
+    return false;
+
+  AutoMutex lock(mReplayMutex);
+  mRequests[request]++;
+  mRequestMade.notifyAll();
+  return true;
+}
+
+int NfaEventTrace::completedRequest(Source source, UINT8 event, const EventData& eventData,
+                                    bool& consumes)
+{
+  consumes = true;
+
+  if (source == SOURCE_NDEF_HANDLER) {
+    // The message comes before NFA_READ_CPLT_EVT ends the read.
+    consumes = false;
+    return event == NFA_NDEF_DATA_EVT ? REQUEST_READ_NDEF : REQUEST_COUNT;
+  }
+  if (source != SOURCE_CONNECTION)
+    return REQUEST_COUNT;
+
+  switch (event) {
+    case NFA_ACTIVATED_EVT:
+      mTagActive = eventData.conn.activated.activate_ntf.protocol != NFA_PROTOCOL_NFC_DEP;
+      return REQUEST_COUNT;
+    case NFA_NDEF_DETECT_EVT:    return REQUEST_DETECT_NDEF;
+    case NFA_READ_CPLT_EVT:      return REQUEST_READ_NDEF;
+    case NFA_WRITE_CPLT_EVT:     return REQUEST_WRITE_NDEF;
+    case NFA_DATA_EVT:           return mTagActive ? REQUEST_SEND_RAW_FRAME : REQUEST_COUNT;
+    case NFA_PRESENCE_CHECK_EVT: return REQUEST_PRESENCE_CHECK;
+    case NFA_SET_TAG_RO_EVT:     return REQUEST_SET_READ_ONLY;
+    case NFA_FORMAT_CPLT_EVT:    return REQUEST_FORMAT;
+    case NFA_SELECT_RESULT_EVT:  return REQUEST_SELECT;
+    case NFA_DEACTIVATED_EVT:
+      if (eventData.conn.deactivated.type == NFA_DEACTIVATE_TYPE_SLEEP)
+        return REQUEST_DEACTIVATE_SLEEP;
+      // A tag only goes once the daemon saw it gone and released it; a P2P
+      // link drops by itself.
+      return mTagActive ? REQUEST_DEACTIVATE : REQUEST_COUNT;
+    default:
+      return REQUEST_COUNT;
+  }
+}
+
+void NfaEventTrace::waitForRequest(int request, bool consumes)
+{
+  AutoMutex lock(mReplayMutex);
+
+  while (mRequests[request] <= mCompletions[request]) {
+    if (!mRequestMade.wait(mReplayMutex, REQUEST_WAIT_MS)) {
+      ALOGW("%s: no request %d for its completion; deliver it anyway", __FUNCTION__, request);
+      mUnmatched++;
+      return;
+    }
+  }
+  if (consumes)
+    mCompletions[request]++;
+}
+
+void NfaEventTrace::dispatch(Source source, UINT8 event, EventData& eventData,
+                             UINT8* extra, UINT16 extraLen)
+{
+  switch (source) {
+    case SOURCE_DEVICE_MANAGEMENT:
+      if (event == NFA_DM_GET_CONFIG_EVT) {
+        eventData.dm.get_config.param_tlvs = extra;
+        eventData.dm.get_config.tlv_size = extraLen;
+      }
+      if (mDmCback)
+        mDmCback(event, &eventData.dm);
+      break;
+    case SOURCE_CONNECTION:
+      if (event == NFA_DATA_EVT) {
+        eventData.conn.data.p_data = extra;
+        eventData.conn.data.len = extraLen;
+      }
+      if (mConnCback)
+        mConnCback(event, &eventData.conn);
+      break;
+    case SOURCE_P2P_SERVER:
+      if (mP2pServerCback)
+        mP2pServerCback(event, &eventData.p2p);
+      break;
+    case SOURCE_P2P_CLIENT:
+      if (mP2pClientCback)
+        mP2pClientCback(event, &eventData.p2p);
+      break;
+    case SOURCE_NDEF_HANDLER:
+      if (event == NFA_NDEF_DATA_EVT) {
+        eventData.ndef.ndef_data.p_data = extra;
+        eventData.ndef.ndef_data.len = extraLen;
+      }
+      if (mNdefCback)
+        mNdefCback(event, &eventData.ndef);
+      break;
+    default:
+      ALOGE("%s: unknown source %d; event=0x%X", __FUNCTION__, source, event);
+      break;
+  }
+}
@@ -0,0 +1,253 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+
+#include "CondVar.h"
+#include "Mutex.h"
+
+extern "C"
+{
+  #include "nfa_api.h"
+  #include "nfa_p2p_api.h"
+}
+
+/**
+ * Records the events delivered by the NFA stack to the daemon's callbacks
+ * into a compact binary log, and replays such a log back into the same
+ * callbacks so a field session can be reproduced without the controller.
+ *
+ * Log layout (host byte order):
+ *   File header: "NFAT" magic, 1 byte format version.
+ *   Record:      1 byte source, 1 byte event code,
+ *                4 bytes microseconds since the previous record,
+ *                2 bytes payload length, 2 bytes extra length,
+ *                payload (event data union, trailing zero bytes trimmed),
+ *                extra (buffer referenced by a pointer inside the payload).
+ *
+ * While a log is replayed the controller is not used. The tag requests of
+ * the daemon are made through NFA_TRACED_REQUEST, which stands in for the
+ * stack: it only counts the request. A recorded completion event, e.g.
+ * NFA_READ_CPLT_EVT, is then held back until the daemon made the request it
+ * answers, so it never arrives before the daemon waits for it however fast
+ * the log is replayed. Other events, e.g. NFA_ACTIVATED_EVT or the P2P
+ * events, follow the recorded timing. Other NFA calls are not stood in for,
+ * so a replay still needs the stack of the device build.
+ */
+class NfaEventTrace
+{
+public:
+  enum Source {
+    SOURCE_DEVICE_MANAGEMENT = 1, // nfaDeviceManagementCallback.
+    SOURCE_CONNECTION = 2,        // nfaConnectionCallback.
+    SOURCE_P2P_SERVER = 3,        // PeerToPeer::nfaServerCallback.
+    SOURCE_P2P_CLIENT = 4,        // PeerToPeer::nfaClientCallback.
+    SOURCE_NDEF_HANDLER = 5       // ndefHandlerCallback.
+  };
+
+  /**
+   * Tag requests whose completion events the replay matches.
+   */
+  enum Request {
+    REQUEST_DETECT_NDEF = 0,  // NFA_RwDetectNDef: NFA_NDEF_DETECT_EVT.
+    REQUEST_READ_NDEF,        // NFA_RwReadNDef: NFA_NDEF_DATA_EVT, NFA_READ_CPLT_EVT.
+    REQUEST_WRITE_NDEF,       // NFA_RwWriteNDef: NFA_WRITE_CPLT_EVT.
+    REQUEST_SEND_RAW_FRAME,   // NFA_SendRawFrame: NFA_DATA_EVT.
+    REQUEST_PRESENCE_CHECK,   // NFA_RwPresenceCheck: NFA_PRESENCE_CHECK_EVT.
+    REQUEST_SET_READ_ONLY,    // NFA_RwSetTagReadOnly: NFA_SET_TAG_RO_EVT.
+    REQUEST_FORMAT,           // NFA_RwFormatTag: NFA_FORMAT_CPLT_EVT.
+    REQUEST_SELECT,           // NFA_Select: NFA_SELECT_RESULT_EVT.
+    REQUEST_DEACTIVATE_SLEEP, // NFA_Deactivate(TRUE): NFA_DEACTIVATED_EVT to sleep.
+    REQUEST_DEACTIVATE,       // NFA_Deactivate(FALSE): NFA_DEACTIVATED_EVT of a tag.
+    REQUEST_COUNT
+  };
+
+  static const UINT8 FORMAT_VERSION = 1;
+
+  // How long a completion waits for its request before it is delivered
+  // anyway, e.g. because the daemon took another path than when recorded.
+  static const int REQUEST_WAIT_MS = 2000;
+
+  /**
+   * Get a reference to the singleton NfaEventTrace object.
+   *
+   * @return Reference to NfaEventTrace object.
+   */
+  static NfaEventTrace& getInstance();
+
+  /**
+   * Start appending events to a log file. Any previous recording is stopped.
+   *
+   * @param  path Path of the log file; truncated if it exists.
+   * @return      True if ok.
+   */
+  bool startRecording(const char* path);
+
+  /**
+   * Stop recording and close the log file.
+   *
+   * @return None.
+   */
+  void stopRecording();
+
+  /**
+   * Whether events are currently written to a log.
+   *
+   * @return True if recording.
+   */
+  bool isRecording() const { return mFile != NULL; }
+
+  /**
+   * Set the callbacks that replayed device-management and connection
+   * events are delivered to.
+   *
+   * @param  dmCback   Device-management callback.
+   * @param  connCback Connection callback.
+   * @return           None.
+   */
+  void setNfaCallbacks(tNFA_DM_CBACK* dmCback, tNFA_CONN_CBACK* connCback);
+
+  /**
+   * Set the callbacks that replayed P2P events are delivered to.
+   *
+   * @param  serverCback P2P server callback.
+   * @param  clientCback P2P client callback.
+   * @return             None.
+   */
+  void setP2pCallbacks(tNFA_P2P_CBACK* serverCback, tNFA_P2P_CBACK* clientCback);
+
+  /**
+   * Set the callback that replayed NDEF type handler events are delivered to.
+   *
+   * @param  ndefCback NDEF type handler callback.
+   * @return           None.
+   */
+  void setNdefCallback(tNFA_NDEF_CBACK* ndefCback);
+
+  /**
+   * Record an event received by one of the NFA callbacks. Does nothing
+   * unless recording is active.
+   */
+  void recordDmEvent(UINT8 event, tNFA_DM_CBACK_DATA* eventData);
+  void recordConnEvent(UINT8 event, tNFA_CONN_EVT_DATA* eventData);
+  void recordP2pEvent(Source source, tNFA_P2P_EVT event, tNFA_P2P_EVT_DATA* eventData);
+  void recordNdefEvent(tNFA_NDEF_EVT event, tNFA_NDEF_EVT_DATA* eventData);
+
+  /**
+   * Feed a recorded log back into the registered callbacks. Blocks until
+   * the whole log is replayed. Events are not recorded while replaying.
+   *
+   * @param  path         Path of the log file.
+   * @param  speedPercent Replay speed relative to the recording, 100 is real
+   *                      time; 0 replays without any delay.
+   * @return              True if the whole log was replayed.
+   */
+  bool replay(const char* path, int speedPercent);
+
+  /**
+   * Account a tag request of the daemon. Use NFA_TRACED_REQUEST.
+   *
+   * @param  request Request made.
+   * @return         True if a log is replayed and the request must not go
+   *                 to the stack.
+   */
+  bool interceptRequest(Request request);
+
+private:
+  static const size_t HEADER_SIZE = 10;
+  static const char   MAGIC[4];
+
+  union EventData {
+    tNFA_DM_CBACK_DATA dm;
+    tNFA_CONN_EVT_DATA conn;
+    tNFA_P2P_EVT_DATA  p2p;
+    tNFA_NDEF_EVT_DATA ndef;
+  };
+
+  Mutex mMutex;
+  FILE* mFile;
+  struct timespec mLastTime;
+  volatile bool mIsReplaying;
+
+  // Requests made and completions delivered during the replay, guarded by
+  // mReplayMutex.
+  Mutex mReplayMutex;
+  CondVar mRequestMade;
+  UINT32 mRequests[REQUEST_COUNT];
+  UINT32 mCompletions[REQUEST_COUNT];
+  bool mTagActive;   // The last activation was a tag, not a P2P peer.
+  int mUnmatched;    // Completions delivered without their request.
+
+  tNFA_DM_CBACK*   mDmCback;
+  tNFA_CONN_CBACK* mConnCback;
+  tNFA_P2P_CBACK*  mP2pServerCback;
+  tNFA_P2P_CBACK*  mP2pClientCback;
+  tNFA_NDEF_CBACK* mNdefCback;
+
+  NfaEventTrace();
+  ~NfaEventTrace();
+
+  /**
+   * Append one record to the log.
+   *
+   * @param  source   Which callback received the event.
+   * @param  event    Event code.
+   * @param  data     Event data.
+   * @param  size     Size of the event data.
+   * @param  extra    Buffer referenced from the event data, may be NULL.
+   * @param  extraLen Length of the referenced buffer.
+   * @return          None.
+   */
+  void record(Source source, UINT8 event, const void* data, size_t size,
+              const void* extra, size_t extraLen);
+
+  /**
+   * Deliver one replayed event to the registered callback.
+   *
+   * @param  source    Which callback received the event.
+   * @param  event     Event code.
+   * @param  eventData Rebuilt event data.
+   * @param  extra     Buffer to re-attach to the event data.
+   * @param  extraLen  Length of the buffer.
+   * @return           None.
+   */
+  void dispatch(Source source, UINT8 event, EventData& eventData,
+                UINT8* extra, UINT16 extraLen);
+
+  /**
+   * Find the request a recorded event completes.
+   *
+   * @param  source    Which callback received the event.
+   * @param  event     Event code.
+   * @param  eventData Recorded event data.
+   * @param  consumes  Set to whether the event ends the request, as opposed
+   *                   to being delivered while it runs.
+   * @return           The request, REQUEST_COUNT for an unsolicited event.
+   */
+  int completedRequest(Source source, UINT8 event, const EventData& eventData, bool& consumes);
+
+  /**
+   * Hold a completion event back until the daemon made its request.
+   *
+   * @param  request  Request the event completes.
+   * @param  consumes Whether the event ends the request.
+   * @return          None.
+   */
+  void waitForRequest(int request, bool consumes);
+};
+
+/**
+ * Make a tag request to the NFA stack, or to the replay while a log is
+ * replayed.
+ *
+ * @param  request NfaEventTrace::Request made.
+ * @param  call    NFA call making it.
+ * @return         Status of the call; NFA_STATUS_OK during a replay.
+ */
+#define NFA_TRACED_REQUEST(request, call) \
+  (NfaEventTrace::getInstance().interceptRequest(NfaEventTrace::request) ? \
+   (tNFA_STATUS) NFA_STATUS_OK : (call))
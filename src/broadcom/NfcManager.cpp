@@ -17,6 +17,11 @@
 #include "LlcpServiceSocket.h"
 #include "NfcTagManager.h"
 #include "P2pDevice.h"
+#include "NfaEventTrace.h"
+#include "TapLatency.h"
+#include "DiscoveryScheduler.h"
+
+#include <string>
 
 extern "C"
 {
@@ -58,6 +63,10 @@ static bool                 sIsDisabling = false;
 static bool                 sRfEnabled = false;             // Whether RF discovery is enabled.
 static bool                 sP2pActive = false;             // Whether p2p was last active.
 static bool                 sAbortConnlessWait = false;
+static bool                 sInStandby = false;
+static bool                 sStandbyDiscovery = false;      // Whether discovery restarts when leaving standby.
+static tNFA_TECHNOLOGY_MASK sConfigTechMask = 0;          // Polling tech mask of the configuration.
+static UINT16               sConfigPollMs = DiscoveryScheduler::DEFAULT_POLL_MS; // Poll period of the configuration.
 
 #define CONFIG_UPDATE_TECH_MASK     (1 << 1)
 #define DEFAULT_TECH_MASK           (NFA_TECHNOLOGY_MASK_A \
@@ -73,6 +82,7 @@ static bool                 sAbortConnlessWait = false;
 static void nfaConnectionCallback(UINT8 event, tNFA_CONN_EVT_DATA *eventData);
 static void nfaDeviceManagementCallback(UINT8 event, tNFA_DM_CBACK_DATA *eventData);
 static bool isPeerToPeer(tNFA_ACTIVATED& activated);
+static void restartPolling(tNFA_TECHNOLOGY_MASK techMask);
 static bool isListenMode(tNFA_ACTIVATED& activated);
 
 static UINT16 sCurrentConfigLen;
@@ -84,6 +94,10 @@ NfcManager::NfcManager()
 {
   mP2pDevice = new P2pDevice();
   mNfcTagManager = new NfcTagManager();
+
+  NfaEventTrace& trace = NfaEventTrace::getInstance();
+  trace.setNfaCallbacks(nfaDeviceManagementCallback, nfaConnectionCallback);
+  trace.setP2pCallbacks(PeerToPeer::nfaServerCallback, PeerToPeer::nfaClientCallback);
 }
 
 NfcManager::~NfcManager()
@@ -111,6 +125,12 @@ bool NfcManager::initialize()
   tNFA_STATUS stat = NFA_STATUS_OK;
   unsigned long num = 5;
 
+  // Start recording NFA events before NFA_Enable() so the log can be
+  // replayed from the very first event.
+  char tracePath[256];
+  if (GetStrValue("NFA_EVENT_TRACE_FILE", tracePath, sizeof(tracePath)))
+    NfaEventTrace::getInstance().startRecording(tracePath);
+
   // Initialize PowerSwitch.
   PowerSwitch::getInstance().initialize(PowerSwitch::FULL_POWER);
 
@@ -154,13 +174,17 @@ bool NfcManager::initialize()
           gNat.tech_mask = num;
         else
           gNat.tech_mask = DEFAULT_TECH_MASK;
+        sConfigTechMask = gNat.tech_mask;
 
         ALOGD("%s: tag polling tech mask = 0x%X", __FUNCTION__, gNat.tech_mask);
       }
 
       // If this value exists, set polling interval.
-      if (GetNumValue(NAME_NFA_DM_DISC_DURATION_POLL, &num, sizeof(num)))
+      if (GetNumValue(NAME_NFA_DM_DISC_DURATION_POLL, &num, sizeof(num))) {
+        sConfigPollMs = num;
         NFA_SetRfDiscoveryDuration(num);
+        DiscoveryScheduler::getInstance().setDefaultPollMs(num);
+      }
 
       // Do custom NFCA startup configuration.
       doStartupConfig();
@@ -191,6 +215,12 @@ bool NfcManager::deinitialize()
 
   sIsDisabling = true;
   pn544InteropAbortNow();
+  DiscoveryScheduler::getInstance().setDiscoveryEnabled(false);
+  if (sInStandby) {
+    // Wake the controller up for a graceful NFA_Disable().
+    PowerSwitch::getInstance().setLevel(PowerSwitch::FULL_POWER);
+    sInStandby = false;
+  }
   // TODO : Implement SE
   //SecureElement::getInstance().finalize();
 
@@ -206,6 +236,12 @@ bool NfcManager::deinitialize()
       ALOGE("%s: NFA_Disable fail; error = 0x%X", __FUNCTION__, stat);
     }
   }
+  {
+    SyncEventStats stats;
+    sNfaDisableEvent.getStats(stats);
+    ALOGD("%s: NFA_Disable took %u us; %u waits, %u contended", __FUNCTION__,
+          stats.lastWaitUs, stats.waits, stats.contended);
+  }
 
   NfcTagManager::doAbortWaits();
   NfcTag::getInstance().abort();
@@ -226,16 +262,52 @@ bool NfcManager::deinitialize()
   NfcAdaptation& theInstance = NfcAdaptation::GetInstance();
   theInstance.Finalize();
 
+  NfaEventTrace::getInstance().stopRecording();
+
   ALOGD("%s: exit", __FUNCTION__);
   return true;
 }
 
+bool NfcManager::standby(bool enter)
+{
+  ALOGD("%s: enter=%d, in standby=%d", __FUNCTION__, enter, sInStandby);
+
+  if (!sIsNfaEnabled || enter == sInStandby)
+    return false;
+
+  if (enter) {
+    sStandbyDiscovery = sDiscoveryEnabled;
+    disableDiscovery();
+    sInStandby = true;
+    PowerSwitch::getInstance().setLevel(PowerSwitch::POWER_OFF);
+    return true;
+  }
+
+  sInStandby = false;
+  if (sStandbyDiscovery) {
+    // Powers the controller up.
+    enableDiscovery();
+  } else {
+    // Back to the power level of disabled discovery.
+    PowerSwitch::getInstance().setLevel(PowerSwitch::FULL_POWER);
+    if (!(PowerSwitch::getInstance().setModeOff(PowerSwitch::DISCOVERY)))
+      PowerSwitch::getInstance().setLevel(PowerSwitch::LOW_POWER);
+  }
+  return true;
+}
+
 void NfcManager::enableDiscovery()
 {
   tNFA_TECHNOLOGY_MASK tech_mask = DEFAULT_TECH_MASK;
 
   tech_mask = (tNFA_TECHNOLOGY_MASK)gNat.tech_mask;
 
+  if (sInStandby) {
+    ALOGD("%s: in standby, enable when leaving it", __FUNCTION__);
+    sStandbyDiscovery = true;
+    return;
+  }
+
   if (sDiscoveryEnabled) {
     ALOGW("%s: already polling", __FUNCTION__);
     return;
@@ -250,6 +322,10 @@ void NfcManager::enableDiscovery()
     startRfDiscovery(false);
   }
 
+  // The poll period and technologies may differ from the configured ones
+  // while the platform is idle.
+  tech_mask = DiscoveryScheduler::getInstance().prepareDiscovery(tech_mask);
+
   {
     SyncEventGuard guard(sNfaEnableDisablePollingEvent);
     stat = NFA_EnablePolling(tech_mask);
@@ -275,6 +351,7 @@ void NfcManager::enableDiscovery()
   startRfDiscovery(true);
 
   PowerSwitch::getInstance().setModeOn(PowerSwitch::DISCOVERY);
+  DiscoveryScheduler::getInstance().setDiscoveryEnabled(true);
 
   ALOGD("%s: exit", __FUNCTION__);
 }
@@ -285,11 +362,19 @@ void NfcManager::disableDiscovery()
   ALOGD("%s: enter;", __FUNCTION__);
 
   pn544InteropAbortNow();
+  if (sInStandby) {
+    ALOGD("%s: in standby, stay disabled when leaving it", __FUNCTION__);
+    sStandbyDiscovery = false;
+    goto TheEnd;
+  }
+
   if (!sDiscoveryEnabled) {
     ALOGD("%s: already disabled", __FUNCTION__);
     goto TheEnd;
   }
 
+  DiscoveryScheduler::getInstance().setDiscoveryEnabled(false);
+
   // Stop RF Discovery.
   startRfDiscovery(false);
 
@@ -322,6 +407,62 @@ TheEnd:
   ALOGD("%s: exit", __FUNCTION__);
 }
 
+void NfcManager::setDiscoveryPolicy(const DiscoveryPolicy& policy)
+{
+  DiscoveryScheduler::getInstance().setPolicy(policy);
+}
+
+void NfcManager::setScreenState(ScreenState state)
+{
+  DiscoveryScheduler::getInstance().setScreenState(state);
+}
+
+bool NfcManager::setDiscoveryProfile(const DiscoveryProfile& profile)
+{
+  // As DiscoveryScheduler, never restart discovery under an activated tag
+  // or peer.
+  if (sDiscoveryEnabled &&
+      (NfcTag::getInstance().getActivationState() != NfcTag::Idle || pn544InteropIsBusy())) {
+    ALOGE("%s: tag or peer activated", __FUNCTION__);
+    return false;
+  }
+
+  DiscoveryScheduler& scheduler = DiscoveryScheduler::getInstance();
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+
+  tNFA_TECHNOLOGY_MASK techMask = profile.techMask == DiscoveryProfile::CONFIGURED ?
+    sConfigTechMask : DiscoveryScheduler::toNfaTechMask(profile.techMask);
+  tNFA_TECHNOLOGY_MASK p2pMask = profile.p2pListenMask == DiscoveryProfile::CONFIGURED ?
+    p2p.getConfiguredP2pListenMask() : DiscoveryScheduler::toNfaTechMask(profile.p2pListenMask);
+  UINT16 pollMs = sConfigPollMs;
+  if (profile.pollMs != DiscoveryProfile::CONFIGURED)
+    pollMs = profile.pollMs > 0xFFFF ? 0xFFFF : profile.pollMs;
+
+  ALOGD("%s: enter; tech mask=0x%X, p2p listen mask=0x%X, poll=%u ms", __FUNCTION__,
+        techMask, p2pMask, pollMs);
+
+  gNat.tech_mask = techMask;
+  p2p.setP2pListenMask(p2pMask);
+  NFA_SetRfDiscoveryDuration(pollMs);
+  scheduler.setDefaultPollMs(pollMs);
+
+  // Otherwise enableDiscovery() picks the profile up.
+  if (!sDiscoveryEnabled)
+    return true;
+
+  scheduler.setDiscoveryEnabled(false);
+  startRfDiscovery(false);
+
+  restartPolling(scheduler.prepareDiscovery(techMask));
+  p2p.enableP2pListening(false);
+  p2p.enableP2pListening(true);
+
+  startRfDiscovery(true);
+  scheduler.setDiscoveryEnabled(true);
+  ALOGD("%s: exit", __FUNCTION__);
+  return true;
+}
+
 bool NfcManager::checkLlcp()
 {
   // Not used in NCI case.
@@ -393,6 +534,55 @@ void NfcManager::setP2pTargetModes(int modes)
   // This function is not called by the NFC service nor exposed by public API.
 }
 
+struct EventReplayArgs
+{
+  std::string path;
+  int speedPercent;
+  int iterations;
+};
+
+static void* eventReplayThreadFunc(void* arg)
+{
+  EventReplayArgs* args = reinterpret_cast<EventReplayArgs*>(arg);
+  for (int i = 0; i < args->iterations; i++) {
+    if (!NfaEventTrace::getInstance().replay(args->path.c_str(), args->speedPercent))
+      break;
+  }
+  // Replaying a tap log is how the tap-to-notification latency is benchmarked.
+  int regressions = TapLatency::Instance()->report();
+  ALOGD("%s: replay done; %d stage(s) over threshold", __FUNCTION__, regressions);
+  delete args;
+  return NULL;
+}
+
+bool NfcManager::startEventReplay(const char* path, int speedPercent, int iterations)
+{
+  ALOGD("%s: path=%s, speed=%d%%, iterations=%d", __FUNCTION__, path, speedPercent, iterations);
+
+  EventReplayArgs* args = new EventReplayArgs();
+  args->path = path;
+  args->speedPercent = speedPercent;
+  args->iterations = iterations > 0 ? iterations : 1;
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int ret = pthread_create(&thread, &attr, eventReplayThreadFunc, args);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    ALOGE("%s: pthread_create failed (%d)", __FUNCTION__, ret);
+    delete args;
+    return false;
+  }
+  return true;
+}
+
+bool NfcManager::replayEventLog(const char* path, int speedPercent)
+{
+  return NfaEventTrace::getInstance().replay(path, speedPercent);
+}
+
 /**
  * Private functions.
  */
@@ -417,6 +607,7 @@ static void handleRfDiscoveryEvent(tNFC_RESULT_DEVT* discoveredDevice)
 void nfaDeviceManagementCallback(UINT8 dmEvent, tNFA_DM_CBACK_DATA* eventData)
 {
   ALOGD("%s: enter; event=0x%X", __FUNCTION__, dmEvent);
+  NfaEventTrace::getInstance().recordDmEvent(dmEvent, eventData);
 
   switch (dmEvent) {
     // Result of NFA_Enable.
@@ -528,6 +719,7 @@ static void nfaConnectionCallback(UINT8 connEvent, tNFA_CONN_EVT_DATA* eventData
 {
   tNFA_STATUS status = NFA_STATUS_FAILED;
   ALOGD("%s: enter; event=0x%X", __FUNCTION__, connEvent);
+  NfaEventTrace::getInstance().recordConnEvent(connEvent, eventData);
 
   switch (connEvent) {
     // Whether polling successfully started.
@@ -586,12 +778,14 @@ static void nfaConnectionCallback(UINT8 connEvent, tNFA_CONN_EVT_DATA* eventData
       if (sIsDisabling || !sIsNfaEnabled)
         break;
 
+      TapLatency::Instance()->mark(TapLatency::STAGE_ACTIVATED);
       NfcTag::getInstance().setActivationState();
       if (gIsSelectingRfInterface) {
         NfcTagManager::doConnectStatus(true);
         break;
       }
 
+      DiscoveryScheduler::getInstance().noteTap();
       NfcTagManager::doResetPresenceCheck();
       if (isPeerToPeer(eventData->activated)) {
         sP2pActive = true;
@@ -628,6 +822,7 @@ static void nfaConnectionCallback(UINT8 connEvent, tNFA_CONN_EVT_DATA* eventData
         NfcTag::getInstance().connectionEventHandler(connEvent, eventData);
         NfcTagManager::doAbortWaits();
         NfcTag::getInstance().abort();
+        DiscoveryScheduler::getInstance().noteTagGone();
       } else if (gIsTagDeactivating) {
         NfcTagManager::doDeactivateStatus(0);
       }
@@ -667,6 +862,13 @@ static void nfaConnectionCallback(UINT8 connEvent, tNFA_CONN_EVT_DATA* eventData
     // Data message received (for non-NDEF reads).
     case NFA_DATA_EVT:
       ALOGD("%s: NFA_DATA_EVT:  len = %d", __FUNCTION__, eventData->data.len);
+      NfcTagManager::doTransceiveStatus(eventData->status, eventData->data.p_data,
+                                        eventData->data.len);
+      break;
+    // The tag did not answer a raw frame.
+    case NFA_RW_INTF_ERROR_EVT:
+      ALOGD("%s: NFA_RW_INTF_ERROR_EVT", __FUNCTION__);
+      NfcTagManager::doTransceiveRfTimeout();
       break;
     // Select completed.
     case NFA_SELECT_CPLT_EVT:
@@ -829,6 +1031,47 @@ void startStopPolling(bool isStartPolling)
   ALOGD("%s: exit", __FUNCTION__);
 }
 
+void reconfigureRfDiscovery(UINT16 pollMs, tNFA_TECHNOLOGY_MASK techMask, bool techsChanged)
+{
+  ALOGD("%s: enter; poll=%u ms, tech mask=0x%X, changed=%d", __FUNCTION__, pollMs, techMask, techsChanged);
+  tNFA_STATUS stat = NFA_STATUS_FAILED;
+
+  startRfDiscovery(false);
+
+  // Takes effect when discovery starts again.
+  stat = NFA_SetRfDiscoveryDuration(pollMs);
+  if (stat != NFA_STATUS_OK)
+    ALOGE("%s: NFA_SetRfDiscoveryDuration fail, error=0x%X", __FUNCTION__, stat);
+
+  if (techsChanged)
+    restartPolling(techMask);
+  startRfDiscovery(true);
+  ALOGD("%s: exit", __FUNCTION__);
+}
+
+/**
+ * Poll for other technologies. RF discovery must be stopped.
+ */
+static void restartPolling(tNFA_TECHNOLOGY_MASK techMask)
+{
+  tNFA_STATUS stat = NFA_STATUS_FAILED;
+  SyncEventGuard guard(sNfaEnableDisablePollingEvent);
+
+  stat = NFA_DisablePolling();
+  if (stat == NFA_STATUS_OK) {
+    sNfaEnableDisablePollingEvent.wait(); // Wait for NFA_POLL_DISABLED_EVT.
+  } else {
+    ALOGE("%s: NFA_DisablePolling fail, error=0x%X", __FUNCTION__, stat);
+  }
+
+  stat = NFA_EnablePolling(techMask);
+  if (stat == NFA_STATUS_OK) {
+    sNfaEnableDisablePollingEvent.wait(); // Wait for NFA_POLL_ENABLED_EVT.
+  } else {
+    ALOGE("%s: NFA_EnablePolling fail, error=0x%X", __FUNCTION__, stat);
+  }
+}
+
 static bool isPeerToPeer(tNFA_ACTIVATED& activated)
 {
   return activated.activate_ntf.protocol == NFA_PROTOCOL_NFC_DEP;
@@ -46,6 +46,17 @@ public:
    */
   bool deinitialize();
 
+  /**
+   * Enter or leave standby. In standby the stack stays initialized and its
+   * registrations kept, discovery is stopped and the controller powered
+   * down, so that leaving it only restarts discovery. Discovery enabled or
+   * disabled meanwhile takes effect when leaving.
+   *
+   * @param  enter True to enter standby, false to leave it.
+   * @return       True if ok.
+   */
+  bool standby(bool enter);
+
   /**
    * Start polling and listening for devices.
    *
@@ -60,6 +71,33 @@ public:
    */
   void disableDiscovery();
 
+  /**
+   * Set how the poll period follows activity and screen state.
+   *
+   * @param  policy Policy of the discovery scheduler.
+   * @return        None.
+   */
+  void setDiscoveryPolicy(const DiscoveryPolicy& policy);
+
+  /**
+   * Tell the discovery scheduler the screen and lock state.
+   *
+   * @param  state Screen state of the platform.
+   * @return       None.
+   */
+  void setScreenState(ScreenState state);
+
+  /**
+   * Switch what discovery polls and listens for. Discovery, if enabled, is
+   * restarted with the profile without reinitializing NFC.
+   *
+   * @param  profile Profile to switch to.
+   * @return         False if discovery is enabled and a tag or peer is
+   *                 activated, which restarting discovery would deactivate;
+   *                 the profile is not switched then.
+   */
+  bool setDiscoveryProfile(const DiscoveryProfile& profile);
+
   /**
    * Check Llcp connection.
    * Not used in NCI case.
@@ -129,6 +167,31 @@ public:
    */
   int getDefaultLlcpRwSize() const { return NfcManager::DEFAULT_LLCP_RWSIZE; };
 
+  /**
+   * Replay a recorded NFA event log into the stack callbacks on a
+   * separate thread, then log the tap latency report. Recording is
+   * configured with NFA_EVENT_TRACE_FILE.
+   *
+   * Only the device build replays: NFA calls made outside
+   * NFA_TRACED_REQUEST, e.g. NFA_SetConfig on a P2P activation, still reach
+   * the stack, so the HAL and NFA libraries must be linked and initialized.
+   *
+   * @param  path         Path of the event log.
+   * @param  speedPercent Replay speed, 100 is real time, 0 is no delay.
+   * @param  iterations   Number of times the log is replayed.
+   * @return              True if the replay thread was started.
+   */
+  bool startEventReplay(const char* path, int speedPercent, int iterations);
+
+  /**
+   * Replay a recorded NFA event log once, on the calling thread.
+   *
+   * @param  path         Path of the event log.
+   * @param  speedPercent Replay speed, 100 is real time, 0 is no delay.
+   * @return              True if the whole log was replayed.
+   */
+  bool replayEventLog(const char* path, int speedPercent);
+
 private:
   P2pDevice* mP2pDevice;
   NfcTagManager* mNfcTagManager;
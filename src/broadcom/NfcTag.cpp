@@ -11,6 +11,8 @@
 
 #include "NfcManager.h"
 #include "INfcTag.h"
+#include "NfaEventTrace.h"
+#include "TapLatency.h"
 
 extern "C"
 {
@@ -20,6 +22,7 @@ extern "C"
 #undef LOG_TAG
 #define LOG_TAG "BroadcomNfc"
 #include <cutils/log.h>
+#include "NfcLog.h"
 
 extern nfc_data gNat;
 
@@ -75,7 +78,7 @@ void NfcTag::setDeactivationState(tNFA_DEACTIVATED& deactivated)
   mNdefDetectionTimedOut = false;
   if (deactivated.type == NFA_DEACTIVATE_TYPE_SLEEP)
     mActivationState = Sleep;
-  ALOGD("%s: state=%u", fn, mActivationState);
+  NFC_LOGD(TAG, "%s: state=%u", fn, mActivationState);
 }
 
 void NfcTag::setActivationState()
@@ -83,7 +86,7 @@ void NfcTag::setActivationState()
   static const char fn [] = "NfcTag::setActivationState";
   mNdefDetectionTimedOut = false;
   mActivationState = Active;
-  ALOGD("%s: state=%u", fn, mActivationState);
+  NFC_LOGD(TAG, "%s: state=%u", fn, mActivationState);
 }
 
 tNFC_PROTOCOL NfcTag::getProtocol()
@@ -108,7 +111,7 @@ UINT32 TimeDiff(timespec start, timespec end)
 bool NfcTag::IsSameKovio(tNFA_ACTIVATED& activationData)
 {
   static const char fn [] = "NfcTag::IsSameKovio";
-  ALOGD("%s: enter", fn);
+  NFC_LOGD(TAG, "%s: enter", fn);
   tNFC_ACTIVATE_DEVT& rfDetail = activationData.activate_ntf;
 
   if (rfDetail.protocol != NFC_PROTOCOL_KOVIO)
@@ -139,14 +142,14 @@ bool NfcTag::IsSameKovio(tNFA_ACTIVATED& activationData)
     memcpy(mLastKovioUid, mTechParams[0].param.pk.uid, mLastKovioUidLen);
   }
   mLastKovioTime = now;
-  ALOGD ("%s: exit, is same Kovio=%d", fn, rVal);
+  NFC_LOGD(TAG, "%s: exit, is same Kovio=%d", fn, rVal);
   return rVal;
 }
 
 void NfcTag::discoverTechnologies(tNFA_ACTIVATED& activationData)
 {
   static const char fn [] = "NfcTag::discoverTechnologies (activation)";
-  ALOGD("%s: enter", fn);
+  NFC_LOGD(TAG, "%s: enter", fn);
   tNFC_ACTIVATE_DEVT& rfDetail = activationData.activate_ntf;
 
   mNumTechList = 0;
@@ -218,22 +221,22 @@ void NfcTag::discoverTechnologies(tNFA_ACTIVATED& activationData)
       break;
 
     case NFC_PROTOCOL_KOVIO:
-      ALOGD("%s: Kovio", fn);
+      NFC_LOGD(TAG, "%s: Kovio", fn);
       mTechList[mNumTechList] = TARGET_TYPE_KOVIO_BARCODE;
       break;
 
     default:
-      ALOGE("%s: unknown protocol ????", fn);
+      NFC_LOGE(TAG, "%s: unknown protocol ????", fn);
       mTechList[mNumTechList] = TARGET_TYPE_UNKNOWN;
       break;
   }
 
   mNumTechList++;
   for (int i=0; i < mNumTechList; i++) {
-    ALOGD("%s: index=%d; tech=%d; handle=%d; nfc type=%d", fn,
+    NFC_LOGD(TAG, "%s: index=%d; tech=%d; handle=%d; nfc type=%d", fn,
             i, mTechList[i], mTechHandles[i], mTechLibNfcTypes[i]);
   }
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(TAG, "%s: exit", fn);
 }
 
 void NfcTag::discoverTechnologies(tNFA_DISC_RESULT& discoveryData)
@@ -241,9 +244,9 @@ void NfcTag::discoverTechnologies(tNFA_DISC_RESULT& discoveryData)
   static const char fn [] = "NfcTag::discoverTechnologies (discovery)";
   tNFC_RESULT_DEVT& discovery_ntf = discoveryData.discovery_ntf;
 
-  ALOGD("%s: enter: rf disc. id=%u; protocol=%u, mNumTechList=%u", fn, discovery_ntf.rf_disc_id, discovery_ntf.protocol, mNumTechList);
+  NFC_LOGD(TAG, "%s: enter: rf disc. id=%u; protocol=%u, mNumTechList=%u", fn, discovery_ntf.rf_disc_id, discovery_ntf.protocol, mNumTechList);
   if (mNumTechList >= MAX_NUM_TECHNOLOGY) {
-    ALOGE("%s: exceed max=%d", fn, MAX_NUM_TECHNOLOGY);
+    NFC_LOGE(TAG, "%s: exceed max=%d", fn, MAX_NUM_TECHNOLOGY);
     goto TheEnd;
   }
   mTechHandles[mNumTechList] = discovery_ntf.rf_disc_id;
@@ -306,7 +309,7 @@ void NfcTag::discoverTechnologies(tNFA_DISC_RESULT& discoveryData)
       break;
 
     default:
-      ALOGE("%s: unknown protocol ????", fn);
+      NFC_LOGE(TAG, "%s: unknown protocol ????", fn);
       mTechList[mNumTechList] = TARGET_TYPE_UNKNOWN;
       break;
   }
@@ -314,24 +317,24 @@ void NfcTag::discoverTechnologies(tNFA_DISC_RESULT& discoveryData)
   mNumTechList++;
   if (discovery_ntf.more == FALSE) {
     for (int i=0; i < mNumTechList; i++) {
-      ALOGD("%s: index=%d; tech=%d; handle=%d; nfc type=%d", fn,
+      NFC_LOGD(TAG, "%s: index=%d; tech=%d; handle=%d; nfc type=%d", fn,
         i, mTechList[i], mTechHandles[i], mTechLibNfcTypes[i]);
     }
   }
 
 TheEnd:
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(TAG, "%s: exit", fn);
 }
 
 void NfcTag::createNfcTag(tNFA_ACTIVATED& activationData)
 {
   static const char fn [] = "NfcTag::createNfcTag";
-  ALOGD ("%s: enter", fn);
+  NFC_LOGD(TAG, "%s: enter", fn);
 
   INfcTag* pINfcTag = reinterpret_cast<INfcTag*>(mNfcManager->queryInterface(INTERFACE_TAG_MANAGER));
 
   if (pINfcTag == NULL) {
-    ALOGE("%s : cannot get nfc tag class", fn);
+    NFC_LOGE(TAG, "%s : cannot get nfc tag class", fn);
     return;
   }
 
@@ -350,17 +353,19 @@ void NfcTag::createNfcTag(tNFA_ACTIVATED& activationData)
   // Fill NfcTag's members: mUid.
   fillNfcTagMembers5(pINfcTag, activationData);
 
+  TapLatency::Instance()->mark(TapLatency::STAGE_TAG_CREATED);
+
   // Notify NFC service about this new tag.
-  ALOGD("%s: try notify nfc service", fn);
+  NFC_LOGD(TAG, "%s: try notify nfc service", fn);
   mNfcManager->notifyTagDiscovered(reinterpret_cast<void*>(pINfcTag));
 
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(TAG, "%s: exit", fn);
 }
 
 void NfcTag::fillNfcTagMembers1(INfcTag* pINfcTag)
 {
   static const char fn [] = "NfcTag::fillNfcTagMembers1";
-  ALOGD("%s", fn);
+  NFC_LOGD(TAG, "%s", fn);
 
   std::vector<TagTechnology>& techList = pINfcTag->getTechList();
   std::vector<int>& techHandles = pINfcTag->getTechHandles();
@@ -381,7 +386,7 @@ void NfcTag::fillNfcTagMembers1(INfcTag* pINfcTag)
 void NfcTag::fillNfcTagMembers2(INfcTag* pINfcTag)
 {
   static const char fn [] = "NfcTag::fillNfcTagMembers2";
-  ALOGD("%s", fn);
+  NFC_LOGD(TAG, "%s", fn);
 
   int& connectedTechIndex = pINfcTag->getConnectedHandle();
   connectedTechIndex = 0;
@@ -395,13 +400,13 @@ void NfcTag::fillNfcTagMembers3(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
   std::vector<std::vector<uint8_t> >& techPollBytes = pINfcTag->getTechPollBytes();
 
   for (int i = 0; i < mNumTechList; i++) {
-    ALOGD("%s: index=%d; rf tech params mode=%u", fn, i, mTechParams [i].mode);
+    NFC_LOGD(TAG, "%s: index=%d; rf tech params mode=%u", fn, i, mTechParams [i].mode);
     switch (mTechParams [i].mode) {
       case NFC_DISCOVERY_TYPE_POLL_A:
       case NFC_DISCOVERY_TYPE_POLL_A_ACTIVE:
       case NFC_DISCOVERY_TYPE_LISTEN_A:
       case NFC_DISCOVERY_TYPE_LISTEN_A_ACTIVE:
-        ALOGD("%s: tech A", fn);
+        NFC_LOGD(TAG, "%s: tech A", fn);
         pollBytes.clear();
         for (int idx = 0; idx < 2; idx++) {
           pollBytes.push_back(mTechParams[i].param.pa.sens_res[idx]);
@@ -416,7 +421,7 @@ void NfcTag::fillNfcTagMembers3(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
            // See NFC Forum Digital Protocol specification; section 5.6.2.
            // In SENSB_RES response, byte 6 through 9 is Application Data, byte 10-12 or 13 is Protocol Info.
            // Used by public API: NfcB.getApplicationData(), NfcB.getProtocolInfo().
-          ALOGD("%s: tech B; TARGET_TYPE_ISO14443_3B", fn);
+          NFC_LOGD(TAG, "%s: tech B; TARGET_TYPE_ISO14443_3B", fn);
           len = mTechParams[i].param.pb.sensb_res_len;
           len = len - 4; // Subtract 4 bytes for NFCID0 at byte 2 through 5.
           pollBytes.clear();
@@ -436,14 +441,14 @@ void NfcTag::fillNfcTagMembers3(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
         // See NFC Forum Digital Protocol Specification; sections 6.6.2.
         // PMm: manufacture parameter; 8 bytes.
         // System Code: 2 bytes/
-        ALOGD("%s: tech F", fn);
+        NFC_LOGD(TAG, "%s: tech F", fn);
         UINT8 result [10]; // Return result to NFC service.
         memset(result, 0, sizeof(result));
         len = 10;
 
         /****
         for(int ii = 0; ii < mTechParams [i].param.pf.sensf_res_len; ii++) {
-          ALOGD("%s: tech F, sendf_res[%d]=%d (0x%x)",
+          NFC_LOGD(TAG, "%s: tech F, sendf_res[%d]=%d (0x%x)",
             fn, ii, mTechParams [i].param.pf.sensf_res[ii],mTechParams [i].param.pf.sensf_res[ii]);
         }
         ***/
@@ -452,7 +457,7 @@ void NfcTag::fillNfcTagMembers3(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
           UINT16 systemCode = *(activationData.params.t3t.p_system_codes);
           result [8] = (UINT8) (systemCode >> 8);
           result [9] = (UINT8) systemCode;
-          ALOGD("%s: tech F; sys code=0x%X 0x%X", fn, result [8], result [9]);
+          NFC_LOGD(TAG, "%s: tech F; sys code=0x%X 0x%X", fn, result [8], result [9]);
         }
         pollBytes.clear();
         for (int idx = 0; idx < len; idx++) {
@@ -463,7 +468,7 @@ void NfcTag::fillNfcTagMembers3(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
 
       case NFC_DISCOVERY_TYPE_POLL_ISO15693:
       case NFC_DISCOVERY_TYPE_LISTEN_ISO15693: {
-        ALOGD("%s: tech iso 15693", fn);
+        NFC_LOGD(TAG, "%s: tech iso 15693", fn);
         // iso 15693 response flags: 1 octet.
         // iso 15693 Data Structure Format Identifier (DSF ID): 1 octet.
         // used by public API: NfcV.getDsfId(), NfcV.getResponseFlags().
@@ -476,7 +481,7 @@ void NfcTag::fillNfcTagMembers3(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
       }
 
       default:
-        ALOGE("%s: tech unknown ????", fn);
+        NFC_LOGE(TAG, "%s: tech unknown ????", fn);
         pollBytes.clear();
         break;
     } // switch: every type of technology.
@@ -491,24 +496,24 @@ void NfcTag::fillNfcTagMembers4(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
   std::vector<std::vector<uint8_t> >& techActBytes = pINfcTag->getTechActBytes();
 
   for (int i = 0; i < mNumTechList; i++) {
-    ALOGD("%s: index=%d", fn, i);
+    NFC_LOGD(TAG, "%s: index=%d", fn, i);
     switch (mTechLibNfcTypes[i]) {
       case NFC_PROTOCOL_T1T: {
-        ALOGD("%s: T1T; tech A", fn);
+        NFC_LOGD(TAG, "%s: T1T; tech A", fn);
         actBytes.clear();
         actBytes.push_back(mTechParams[i].param.pa.sel_rsp);
         break;
       }
 
       case NFC_PROTOCOL_T2T: { // TODO: why is this code a duplicate of NFC_PROTOCOL_T1T?
-        ALOGD("%s: T2T; tech A", fn);
+        NFC_LOGD(TAG, "%s: T2T; tech A", fn);
         actBytes.clear();
         actBytes.push_back(mTechParams[i].param.pa.sel_rsp);
         break;
       }
 
       case NFC_PROTOCOL_T3T: { // Felica.
-        ALOGD("%s: T3T; felica; tech F", fn);
+        NFC_LOGD(TAG, "%s: T3T; felica; tech F", fn);
         // Really, there is no data.
         actBytes.clear();
         break;
@@ -525,7 +530,7 @@ void NfcTag::fillNfcTagMembers4(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
             // The public API, IsoDep.getHistoricalBytes(), returns this data.
             if (activationData.activate_ntf.intf_param.type == NFC_INTERFACE_ISO_DEP) {
               tNFC_INTF_PA_ISO_DEP& pa_iso = activationData.activate_ntf.intf_param.intf_param.pa_iso;
-              ALOGD("%s: T4T; ISO_DEP for tech A; copy historical bytes; len=%u", fn, pa_iso.his_byte_len);
+              NFC_LOGD(TAG, "%s: T4T; ISO_DEP for tech A; copy historical bytes; len=%u", fn, pa_iso.his_byte_len);
               actBytes.clear();
               if (pa_iso.his_byte_len > 0) {
                 for (int idx = 0;idx < pa_iso.his_byte_len; idx++) {
@@ -533,7 +538,7 @@ void NfcTag::fillNfcTagMembers4(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
                 }
               }
             } else {
-              ALOGE ("%s: T4T; ISO_DEP for tech A; wrong interface=%u", fn, activationData.activate_ntf.intf_param.type);
+              NFC_LOGE(TAG, "%s: T4T; ISO_DEP for tech A; wrong interface=%u", fn, activationData.activate_ntf.intf_param.type);
               actBytes.clear();
             }
           } else if ( (mTechParams[i].mode == NFC_DISCOVERY_TYPE_POLL_B) ||
@@ -545,7 +550,7 @@ void NfcTag::fillNfcTagMembers4(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
             // The public API, IsoDep.getHiLayerResponse(), returns this data.
             if (activationData.activate_ntf.intf_param.type == NFC_INTERFACE_ISO_DEP) {
               tNFC_INTF_PB_ISO_DEP& pb_iso = activationData.activate_ntf.intf_param.intf_param.pb_iso;
-              ALOGD("%s: T4T; ISO_DEP for tech B; copy response bytes; len=%u", fn, pb_iso.hi_info_len);
+              NFC_LOGD(TAG, "%s: T4T; ISO_DEP for tech B; copy response bytes; len=%u", fn, pb_iso.hi_info_len);
               actBytes.clear();
               if (pb_iso.hi_info_len > 0) {
                 for (int idx = 0;idx < pb_iso.hi_info_len;idx++) {
@@ -553,12 +558,12 @@ void NfcTag::fillNfcTagMembers4(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
                 }
               }
             } else {
-              ALOGE ("%s: T4T; ISO_DEP for tech B; wrong interface=%u", fn, activationData.activate_ntf.intf_param.type);
+              NFC_LOGE(TAG, "%s: T4T; ISO_DEP for tech B; wrong interface=%u", fn, activationData.activate_ntf.intf_param.type);
               actBytes.clear();
             }
           }
         } else if (mTechList [i] == TARGET_TYPE_ISO14443_3A) { // Is TagTechnology.NFC_A by Java API.
-          ALOGD("%s: T4T; tech A", fn);
+          NFC_LOGD(TAG, "%s: T4T; tech A", fn);
           actBytes.clear();
           actBytes.push_back(mTechParams [i].param.pa.sel_rsp);
         } else {
@@ -568,7 +573,7 @@ void NfcTag::fillNfcTagMembers4(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
       } // Case NFC_PROTOCOL_ISO_DEP: //t4t.
 
       case NFC_PROTOCOL_15693: {
-        ALOGD("%s: tech iso 15693", fn);
+        NFC_LOGD(TAG, "%s: tech iso 15693", fn);
         // iso 15693 response flags: 1 octet.
         // iso 15693 Data Structure Format Identifier (DSF ID): 1 octet.
         // used by public API: NfcV.getDsfId(), NfcV.getResponseFlags().
@@ -581,7 +586,7 @@ void NfcTag::fillNfcTagMembers4(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
       }
 
       default:
-        ALOGD("%s: tech unknown ????", fn);
+        NFC_LOGD(TAG, "%s: tech unknown ????", fn);
         actBytes.clear();
         break;
     }
@@ -598,7 +603,7 @@ void NfcTag::fillNfcTagMembers5(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
 
   switch (mTechParams [0].mode) {
     case NFC_DISCOVERY_TYPE_POLL_KOVIO:
-      ALOGD("%s: Kovio", fn);
+      NFC_LOGD(TAG, "%s: Kovio", fn);
       len = mTechParams [0].param.pk.uid_len;
       uid.clear();
       for (int idx = 0;idx < len;idx++) {
@@ -610,7 +615,7 @@ void NfcTag::fillNfcTagMembers5(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
     case NFC_DISCOVERY_TYPE_POLL_A_ACTIVE:
     case NFC_DISCOVERY_TYPE_LISTEN_A:
     case NFC_DISCOVERY_TYPE_LISTEN_A_ACTIVE:
-      ALOGD("%s: tech A", fn);
+      NFC_LOGD(TAG, "%s: tech A", fn);
       len = mTechParams [0].param.pa.nfcid1_len;
       uid.clear();
       for (int idx = 0;idx < len;idx++) {
@@ -622,7 +627,7 @@ void NfcTag::fillNfcTagMembers5(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
     case NFC_DISCOVERY_TYPE_POLL_B_PRIME:
     case NFC_DISCOVERY_TYPE_LISTEN_B:
     case NFC_DISCOVERY_TYPE_LISTEN_B_PRIME:
-      ALOGD("%s: tech B", fn);
+      NFC_LOGD(TAG, "%s: tech B", fn);
       uid.clear();
       for (int idx = 0;idx < NFC_NFCID0_MAX_LEN;idx++) {
         uid.push_back(mTechParams [0].param.pb.nfcid0[idx]);
@@ -633,7 +638,7 @@ void NfcTag::fillNfcTagMembers5(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
     case NFC_DISCOVERY_TYPE_POLL_F_ACTIVE:
     case NFC_DISCOVERY_TYPE_LISTEN_F:
     case NFC_DISCOVERY_TYPE_LISTEN_F_ACTIVE:
-      ALOGD("%s: tech F", fn);
+      NFC_LOGD(TAG, "%s: tech F", fn);
       uid.clear();
       for (int idx = 0;idx < NFC_NFCID2_LEN;idx++) {
         uid.push_back(mTechParams [0].param.pf.nfcid2[idx]);
@@ -642,7 +647,7 @@ void NfcTag::fillNfcTagMembers5(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
 
     case NFC_DISCOVERY_TYPE_POLL_ISO15693:
     case NFC_DISCOVERY_TYPE_LISTEN_ISO15693: {
-      ALOGD("%s: tech iso 15693", fn);
+      NFC_LOGD(TAG, "%s: tech iso 15693", fn);
       unsigned char data [I93_UID_BYTE_LEN];  // 8 bytes.
       for (int i=0; i<I93_UID_BYTE_LEN; ++i)  // Reverse the ID.
         data[i] = activationData.params.i93.uid [I93_UID_BYTE_LEN - i - 1];
@@ -654,7 +659,7 @@ void NfcTag::fillNfcTagMembers5(INfcTag* pINfcTag, tNFA_ACTIVATED& activationDat
     break;
 
     default:
-      ALOGE("%s: tech unknown ????", fn);
+      NFC_LOGE(TAG, "%s: tech unknown ????", fn);
       uid.clear();
       break;
   }
@@ -669,12 +674,12 @@ bool NfcTag::isP2pDiscovered()
   for (int i = 0; i < mNumTechList; i++) {
     if (mTechLibNfcTypes[i] == NFA_PROTOCOL_NFC_DEP) {
       // If remote device supports P2P.
-      ALOGD("%s: discovered P2P", fn);
+      NFC_LOGD(TAG, "%s: discovered P2P", fn);
       retval = true;
       break;
     }
   }
-  ALOGD("%s: return=%u", fn, retval);
+  NFC_LOGD(TAG, "%s: return=%u", fn, retval);
   return retval;
 }
 
@@ -703,19 +708,20 @@ void NfcTag::selectP2p()
   }
 
   if (rfDiscoveryId > 0) {
-    ALOGD("%s: select P2P; target rf discov id=0x%X", fn, rfDiscoveryId);
-    tNFA_STATUS stat = NFA_Select(rfDiscoveryId, NFA_PROTOCOL_NFC_DEP, NFA_INTERFACE_NFC_DEP);
+    NFC_LOGD(TAG, "%s: select P2P; target rf discov id=0x%X", fn, rfDiscoveryId);
+    tNFA_STATUS stat = NFA_TRACED_REQUEST(REQUEST_SELECT,
+      NFA_Select(rfDiscoveryId, NFA_PROTOCOL_NFC_DEP, NFA_INTERFACE_NFC_DEP));
     if (stat != NFA_STATUS_OK)
-      ALOGE("%s: fail select P2P; error=0x%X", fn, stat);
+      NFC_LOGE(TAG, "%s: fail select P2P; error=0x%X", fn, stat);
   } else
-    ALOGE("%s: cannot find P2P", fn);
+    NFC_LOGE(TAG, "%s: cannot find P2P", fn);
   resetTechnologies();
 }
 
 void NfcTag::resetTechnologies()
 {
   static const char fn [] = "NfcTag::resetTechnologies";
-  ALOGD("%s", fn);
+  NFC_LOGD(TAG, "%s", fn);
   mNumTechList = 0;
   memset(mTechList, 0, sizeof(mTechList));
   memset(mTechHandles, 0, sizeof(mTechHandles));
@@ -726,7 +732,7 @@ void NfcTag::resetTechnologies()
 void NfcTag::selectFirstTag()
 {
   static const char fn [] = "NfcTag::selectFirstTag";
-  ALOGD("%s: nfa target h=0x%X; protocol=0x%X",
+  NFC_LOGD(TAG, "%s: nfa target h=0x%X; protocol=0x%X",
           fn, mTechHandles [0], mTechLibNfcTypes [0]);
   tNFA_INTF_TYPE rf_intf = NFA_INTERFACE_FRAME;
 
@@ -739,9 +745,10 @@ void NfcTag::selectFirstTag()
     rf_intf = NFA_INTERFACE_FRAME;
   }
 
-  tNFA_STATUS stat = NFA_Select(mTechHandles [0], mTechLibNfcTypes [0], rf_intf);
+  tNFA_STATUS stat = NFA_TRACED_REQUEST(REQUEST_SELECT,
+    NFA_Select(mTechHandles [0], mTechLibNfcTypes [0], rf_intf));
   if (stat != NFA_STATUS_OK)
-    ALOGE("%s: fail select; error=0x%X", fn, stat);
+    NFC_LOGE(TAG, "%s: fail select; error=0x%X", fn, stat);
 }
 
 int NfcTag::getT1tMaxMessageSize()
@@ -749,7 +756,7 @@ int NfcTag::getT1tMaxMessageSize()
   static const char fn [] = "NfcTag::getT1tMaxMessageSize";
 
   if (mProtocol != NFC_PROTOCOL_T1T) {
-    ALOGE("%s: wrong protocol %u", fn, mProtocol);
+    NFC_LOGE(TAG, "%s: wrong protocol %u", fn, mProtocol);
     return 0;
   }
   return mtT1tMaxMessageSize;
@@ -774,7 +781,7 @@ void NfcTag::calculateT1tMaxMessageSize(tNFA_ACTIVATED& activate)
       mtT1tMaxMessageSize = 462;
       break;
     default:
-      ALOGE("%s: unknown T1T HR0=%u", fn, activate.params.t1t.hr[0]);
+      NFC_LOGE(TAG, "%s: unknown T1T HR0=%u", fn, activate.params.t1t.hr[0]);
       mtT1tMaxMessageSize = 0;
       break;
   }
@@ -795,7 +802,7 @@ bool NfcTag::isMifareUltralight()
            (mTechParams[i].param.pa.sens_res[1] == 0) ) {
         // SyncEventGuard g (mReadCompleteEvent);
         // mReadCompletedStatus = NFA_STATUS_BUSY;
-        // ALOGD ("%s: read block 0x10", fn);
+        // NFC_LOGD(TAG, "%s: read block 0x10", fn);
         // tNFA_STATUS stat = NFA_RwT2tRead (0x10);
         // if (stat == NFA_STATUS_OK)
         // mReadCompleteEvent.wait ();
@@ -810,7 +817,7 @@ bool NfcTag::isMifareUltralight()
       break;
     }
   }
-  ALOGD("%s: return=%u", fn, retval);
+  NFC_LOGD(TAG, "%s: return=%u", fn, retval);
   return retval;
 }
 
@@ -825,7 +832,7 @@ bool NfcTag::isT2tNackResponse(const UINT8* response, UINT32 responseLen)
     else
       isNack = true;  // Assume every value is a NACK.
   }
-  ALOGD("%s: return %u", fn, isNack);
+  NFC_LOGD(TAG, "%s: return %u", fn, isNack);
   return isNack;
 }
 
@@ -878,7 +885,7 @@ void NfcTag::connectionEventHandler(UINT8 event, tNFA_CONN_EVT_DATA* data)
       tNFA_NDEF_DETECT& ndef_detect = data->ndef_detect;
       mNdefDetectionTimedOut = ndef_detect.status == NFA_STATUS_TIMEOUT;
       if (mNdefDetectionTimedOut)
-        ALOGE("%s: NDEF detection timed out", fn);
+        NFC_LOGE(TAG, "%s: NDEF detection timed out", fn);
     }
   }
 }
@@ -4,7 +4,6 @@
 
 #include "NfcTagManager.h"
 
-#include <semaphore.h>
 #include <errno.h>
 #include <time.h>
 #include <signal.h>
@@ -15,8 +14,16 @@
 #include "NfcTag.h"
 #include "config.h"
 #include "Mutex.h"
+#include "Completion.h"
+#include "INfcTagCallback.h"
 #include "IntervalTimer.h"
 #include "Pn544Interop.h"
+#include "NfaEventTrace.h"
+#include "TraceRing.h"
+#include "TagInfoCache.h"
+#include "T2tReader.h"
+#include "T2tNdefWriter.h"
+#include "NdefBufferPool.h"
 
 extern "C"
 {
@@ -29,6 +36,7 @@ extern "C"
 #undef LOG_TAG
 #define LOG_TAG "BroadcomNfc"
 #include <cutils/log.h>
+#include "NfcLog.h"
 
 extern bool nfcManager_isNfcActive();
 extern int gGeneralTransceiveTimeout;
@@ -54,58 +62,534 @@ static tNFA_STATUS  sCheckNdefStatus = 0;      // Whether tag already contains a
 static bool         sCheckNdefCapable = false; // Whether tag has NDEF capability.
 static tNFA_HANDLE  sNdefTypeHandlerHandle = NFA_HANDLE_INVALID;
 static tNFA_INTF_TYPE   sCurrentRfInterface = NFA_INTERFACE_ISO_DEP;
-static uint8_t*     sTransceiveData = NULL;
-static uint32_t     sTransceiveDataLen = 0;
+static std::vector<uint8_t> sTransceiveData; // Response to the raw frame in flight.
 static bool         sWaitingForTransceive = false;
+static bool         sTransceiveRfTimeout = false; // The tag did not answer the raw frame.
 static bool         sNeedToSwitchRf = false;
 static Mutex        sRfInterfaceMutex;
-static uint32_t     sReadDataLen = 0;
-static uint8_t*     sReadData = NULL;
+// Guarded by sReadEvent, as NFA_NDEF_DATA_EVT comes on the stack's thread.
+static std::vector<uint8_t> sReadData;      // NDEF message of NFA_NDEF_DATA_EVT, from NdefBufferPool.
 static bool         sIsReadingNdefMessage = false;
 static SyncEvent    sReadEvent;
-static sem_t        sWriteSem;
-static sem_t        sFormatSem;
 static SyncEvent    sTransceiveEvent;
 static SyncEvent    sReconnectEvent;
-static sem_t        sCheckNdefSem;
-static sem_t        sPresenceCheckSem;
-static sem_t        sMakeReadonlySem;
 static IntervalTimer sSwitchBackTimer; // Timer used to tell us to switch back to ISO_DEP frame interface.
-static bool     	sWriteOk = false;
-static bool     	sWriteWaitingForComplete = false;
-static bool         sFormatOk = false;
 static bool     	sConnectOk = false;
 static bool     	sConnectWaitingForComplete = false;
 static bool         sGotDeactivate = false;
 static uint32_t     sCheckNdefMaxSize = 0;
 static bool         sCheckNdefCardReadOnly = false;
-static bool     	sCheckNdefWaitingForComplete = false;
 static int          sCountTagAway = 0;  // Count the consecutive number of presence-check failures.
-static tNFA_STATUS  sMakeReadonlyStatus = NFA_STATUS_FAILED;
-static bool     	sMakeReadonlyWaitingForComplete = false;
+static struct timespec sDeadline;           // Deadline of the current request, CLOCK_MONOTONIC.
+static bool         sHasDeadline = false;
+static bool         sTimedOut = false;      // An operation missed its deadline since setDeadline().
+static bool         sCheckNdefDetected = false; // Whether the last doCheckNdef() ran NFA_RwDetectNDef to completion.
+static TagFingerprint sTagFingerprint;      // Fingerprint of the tag the sCheckNdef* state belongs to.
+
+// Result of NFA_NDEF_DETECT_EVT, see doCheckNdefResult().
+struct NdefDetectResult {
+  NdefDetectResult() : maxSize(0), currentSize(0), flags(0) {}
+  uint32_t maxSize;
+  uint32_t currentSize;
+  uint8_t flags;
+};
+
+// One completion per RF operation; status is the tNFA_STATUS of the operation.
+static Completion<>  sWriteCompletion;
+static Completion<>  sFormatCompletion;
+static Completion<NdefDetectResult> sCheckNdefCompletion;
+static Completion<>  sPresenceCheckCompletion;
+static Completion<>  sMakeReadonlyCompletion;
+
+// Only one RF operation runs at a time. An asynchronous operation holds the
+// slot from its start until its callback, which runs on another thread, so
+// this cannot be a mutex held across the operation.
+static Mutex        sRfOpMutex;
+static CondVar      sRfOpIdle;
+static bool         sRfOpBusy = false;
+
+/**
+ * The asynchronous operation holding the RF slot, if any.
+ */
+struct AsyncTagOp {
+  AsyncTagOp()
+    : op(TAG_OP_READ_NDEF), callback(NULL), writeSize(0), writeHash(0), abortOnTimeout(true), timedOut(false) {}
+  TagOperation op;
+  INfcTagCallback* callback;   // NULL when no operation is in flight.
+  std::vector<uint8_t> buf;    // NDEF message to write, until handed to the stack.
+  uint32_t writeSize;          // Size and TagInfoCache::hash() of the message
+  uint32_t writeHash;          // to write, for the cache.
+  bool abortOnTimeout;         // Deactivate the tag when the operation times out.
+  bool timedOut;
+  struct timespec stepDeadline; // Deadline of the step in flight, CLOCK_MONOTONIC.
+};
+static AsyncTagOp    sAsyncOp;
+static Mutex         sAsyncOpMutex;  // Guards sAsyncOp against its timeout timer.
+static IntervalTimer sAsyncOpTimer;
+
+// The message handed to NFA_RwWriteNDef. The stack reads it until
+// NFA_WRITE_CPLT_EVT or the deactivation of the tag, which may come long
+// after the operation timed out and was finished, so sAsyncOp.buf is swapped
+// into it. Guarded by sAsyncOpMutex.
+static std::vector<uint8_t> sStackWriteBuf;
+static bool                 sStackWriteBusy = false;
+
+/**
+ * The stack is done with sStackWriteBuf.
+ */
+static void releaseStackWriteBuf()
+{
+  AutoMutex lock(sAsyncOpMutex);
+  sStackWriteBusy = false;
+  sStackWriteBuf.clear();
+}
+
+/**
+ * Raw frames to the tag in the field, for T2tReader. Used with the RF slot
+ * held.
+ */
+class RawFrameTransport : public T2tReader::Transport
+{
+public:
+  TransceiveStatus transceive(const std::vector<uint8_t>& command,
+                              std::vector<uint8_t>& response)
+  {
+    return NfcTagManager::doTransceive(command, response, 0);
+  }
+
+  bool reactivate()
+  {
+    return NfcTagManager::reSelect(NFA_INTERFACE_FRAME) == 0;
+  }
+};
+
+// Image of the Type 2 tag in the field, as last read or written with raw
+// frames; the base of differential writes.
+static RawFrameTransport sRawFrameTransport;
+static T2tReader     sT2tReader(sRawFrameTransport);
+
+static void addMilliseconds(struct timespec& ts, int ms)
+{
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+}
+
+static long long millisecondsUntil(const struct timespec& ts)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (ts.tv_sec - now.tv_sec) * 1000LL + (ts.tv_nsec - now.tv_nsec) / 1000000;
+}
+
+/**
+ * Milliseconds an RF operation may wait for the stack: its default timeout,
+ * cut short by the deadline of the current request if there is one.
+ */
+static int operationTimeout(int defaultMs)
+{
+  if (!sHasDeadline)
+    return defaultMs;
+
+  long long leftMs = millisecondsUntil(sDeadline);
+  if (leftMs <= 0)
+    return 0;
+  return leftMs < defaultMs ? (int) leftMs : defaultMs;
+}
+
+/**
+ * An operation timed out; deactivate the tag so the stack drops the pending
+ * command and later completion events are not taken for a new operation.
+ */
+static void abortOnTimeout(const char* fn)
+{
+  NFC_LOGE(TAG, "%s: operation timed out; deactivate tag", fn);
+  sTimedOut = true;
+  if (NfcTag::getInstance().getActivationState() == NfcTag::Active) {
+    NFA_TRACED_REQUEST(REQUEST_DEACTIVATE, NFA_Deactivate(FALSE));
+  }
+}
+
+static void beginRfOperation()
+{
+  AutoMutex lock(sRfOpMutex);
+  while (sRfOpBusy)
+    sRfOpIdle.wait(sRfOpMutex);
+  sRfOpBusy = true;
+}
+
+static void endRfOperation()
+{
+  AutoMutex lock(sRfOpMutex);
+  sRfOpBusy = false;
+  sRfOpIdle.notifyOne();
+}
+
+/**
+ * Take over the RF slot for an asynchronous operation. Must be called with
+ * the slot held.
+ */
+static void startAsyncOp(TagOperation op, INfcTagCallback* callback, bool abortOnTimeout)
+{
+  AutoMutex lock(sAsyncOpMutex);
+  sAsyncOp.op = op;
+  sAsyncOp.callback = callback;
+  sAsyncOp.abortOnTimeout = abortOnTimeout;
+  sAsyncOp.timedOut = false;
+  sAsyncOp.buf.clear();
+  sAsyncOp.writeSize = 0;
+  sAsyncOp.writeHash = 0;
+}
+
+/**
+ * Keep the cached state of the tag in step with what an operation did to it.
+ */
+static void noteTagOperation(TagOperation op, bool isOk, uint32_t writeSize, uint32_t writeHash)
+{
+  TagInfoCache& cache = TagInfoCache::getInstance();
+  switch (op) {
+    case TAG_OP_WRITE_NDEF:
+      // Writing to a tag without NDEF formats it first; its new layout is
+      // only known after the next detection.
+      if (isOk && sCheckNdefStatus == NFA_STATUS_OK) {
+        cache.noteWrite(sTagFingerprint, writeSize, writeHash);
+      } else {
+        cache.invalidate(sTagFingerprint);
+      }
+      // So that readNdef() reads the message back.
+      if (isOk)
+        sCheckNdefCurrentSize = writeSize;
+      break;
+    case TAG_OP_MAKE_READ_ONLY:
+      sT2tReader.reset();
+      if (isOk) {
+        cache.noteReadOnly(sTagFingerprint);
+      } else {
+        cache.invalidate(sTagFingerprint);
+      }
+      break;
+    case TAG_OP_FORMAT_NDEF:
+      sT2tReader.reset();
+      cache.invalidate(sTagFingerprint);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Report the result of the asynchronous operation and release the RF slot.
+ */
+static void finishAsyncOp(bool isOk)
+{
+  INfcTagCallback* callback;
+  TagOperation op;
+  uint32_t writeSize, writeHash;
+  std::vector<uint8_t> buf;
+  {
+    AutoMutex lock(sAsyncOpMutex);
+    callback = sAsyncOp.callback;
+    op = sAsyncOp.op;
+    if (!callback)
+      return;
+    sAsyncOp.callback = NULL;
+    writeSize = sAsyncOp.writeSize;
+    writeHash = sAsyncOp.writeHash;
+    sAsyncOp.buf.swap(buf);
+  }
+
+  noteTagOperation(op, isOk, writeSize, writeHash);
+
+  // Released first, so the callback may start the next operation.
+  endRfOperation();
+  callback->onTagOperationComplete(op, isOk, NULL);
+}
+
+/**
+ * The step of the asynchronous operation in flight timed out. Cancelling its
+ * completion finishes the operation through the step's continuation.
+ */
+static void asyncOpTimeout(union sigval)
+{
+  bool abort;
+  {
+    AutoMutex lock(sAsyncOpMutex);
+    // A stale expiry of an earlier step or operation.
+    if (!sAsyncOp.callback || millisecondsUntil(sAsyncOp.stepDeadline) > 0)
+      return;
+    sAsyncOp.timedOut = true;
+    abort = sAsyncOp.abortOnTimeout;
+  }
+
+  if (abort)
+    abortOnTimeout(__FUNCTION__);
+  else
+    NFC_LOGE(TAG, "%s: operation timed out", __FUNCTION__);
+
+  sWriteCompletion.cancel(NFA_STATUS_TIMEOUT);
+  sFormatCompletion.cancel(NFA_STATUS_TIMEOUT);
+  sPresenceCheckCompletion.cancel(NFA_STATUS_TIMEOUT);
+  sMakeReadonlyCompletion.cancel(NFA_STATUS_TIMEOUT);
+}
+
+/**
+ * Arm the completion of the next step of the asynchronous operation and
+ * its timeout. Must be called before the step is handed to the stack.
+ *
+ * @param  completion   Completion of the step.
+ * @param  continuation Continues or finishes the operation once the step
+ *                      completes or is cancelled.
+ * @param  timeoutMs    Timeout of the step.
+ * @return              False if the step cannot be started, e.g. the
+ *                      operation is out of time; the caller finishes it.
+ */
+static bool armAsyncStep(Completion<>& completion, Completion<>::Continuation continuation, int timeoutMs)
+{
+  {
+    AutoMutex lock(sAsyncOpMutex);
+    if (!sAsyncOp.timedOut && timeoutMs > 0) {
+      clock_gettime(CLOCK_MONOTONIC, &sAsyncOp.stepDeadline);
+      addMilliseconds(sAsyncOp.stepDeadline, timeoutMs);
+      // Without its timer the step could wait forever.
+      if (!sAsyncOpTimer.set(timeoutMs, asyncOpTimeout)) {
+        NFC_LOGE(TAG, "%s: fail to set timer", __FUNCTION__);
+        return false;
+      }
+      completion.arm(continuation);
+      return true;
+    }
+    sAsyncOp.timedOut = true;
+  }
+
+  if (sAsyncOp.abortOnTimeout)
+    abortOnTimeout(__FUNCTION__);
+  return false;
+}
+
+/**
+ * Continuation of the last step of an asynchronous operation that succeeds
+ * if the stack reports NFA_STATUS_OK.
+ */
+static void onAsyncStepComplete(Completion<>& completion, void* context)
+{
+  finishAsyncOp(completion.state() == COMPLETION_DONE &&
+                completion.status() == NFA_STATUS_OK);
+}
+
+static void onPresenceCheckComplete(Completion<>& completion, void* context)
+{
+  // The tag is only considered gone after several failed checks in a row.
+  bool isPresent = completion.state() == COMPLETION_DONE && sCountTagAway <= 3;
+  if (!isPresent)
+    NFC_LOGD(TAG, "%s: tag absent ????", __FUNCTION__);
+  finishAsyncOp(isPresent);
+}
+
+static void writeNdefStep()
+{
+  if (!armAsyncStep(sWriteCompletion, onAsyncStepComplete,
+                    operationTimeout(NfcTagManager::WRITE_TIMEOUT_MS))) {
+    finishAsyncOp(false);
+    return;
+  }
+
+  tNFA_STATUS status;
+  {
+    AutoMutex lock(sAsyncOpMutex);
+    if (sStackWriteBusy) {
+      // A write that timed out is still running in the stack.
+      NFC_LOGE(TAG, "%s: previous write not complete", __FUNCTION__);
+      status = NFA_STATUS_BUSY;
+    } else {
+      sStackWriteBuf.swap(sAsyncOp.buf);
+      NFC_LOGD(TAG, "%s: NFA_RwWriteNDef", __FUNCTION__);
+      status = NFA_TRACED_REQUEST(REQUEST_WRITE_NDEF,
+                                  NFA_RwWriteNDef(sStackWriteBuf.empty() ? NULL : &sStackWriteBuf[0],
+                                                  sStackWriteBuf.size()));
+      sStackWriteBusy = (status == NFA_STATUS_OK);
+    }
+  }
+  if (status != NFA_STATUS_OK) {
+    NFC_LOGE(TAG, "%s: write error=%d", __FUNCTION__, status);
+    sWriteCompletion.cancel(status);
+  }
+}
+
+static void onWriteFormatComplete(Completion<>& completion, void* context)
+{
+  if (completion.state() != COMPLETION_DONE || completion.status() != NFA_STATUS_OK) {
+    NFC_LOGE(TAG, "%s: format failed", __FUNCTION__);
+    finishAsyncOp(false);
+    return;
+  }
+  writeNdefStep();
+}
+
+/**
+ * Result of a synchronous operation built on its asynchronous variant.
+ */
+class SyncTagCallback
+  : public INfcTagCallback
+{
+public:
+  SyncTagCallback()
+  {
+    mDone.arm();
+  }
+
+  void onTagOperationComplete(TagOperation op, bool isOk, NdefMessage* ndef)
+  {
+    mDone.complete(isOk);
+  }
+
+  /**
+   * Wait for the result. The operation always completes, at the latest
+   * when its timeout expires.
+   *
+   * @return True if the operation succeeded.
+   */
+  bool wait()
+  {
+    mDone.wait(-1);
+    return mDone.status();
+  }
+
+private:
+  Completion<> mDone;
+};
+
+/**
+ * Wait for an RF operation of the current request, aborting it when its
+ * deadline expires.
+ *
+ * @param  completion Completion armed for the operation.
+ * @param  defaultMs  Default timeout of the operation.
+ * @param  fn         Caller, for logging.
+ * @return            True if the operation completed; its status is then in
+ *                    the completion.
+ */
+template<typename T>
+static bool waitForCompletion(Completion<T>& completion, int defaultMs, const char* fn)
+{
+  switch (completion.wait(operationTimeout(defaultMs))) {
+    case COMPLETION_DONE:
+      return true;
+    case COMPLETION_TIMED_OUT:
+      abortOnTimeout(fn);
+      return false;
+    default:
+      NFC_LOGD(TAG, "%s: operation cancelled", fn);
+      return false;
+  }
+}
+
+/**
+ * Update the NDEF state of the tag from the result of NFA_RwDetectNDef.
+ */
+static void applyCheckNdefResult(tNFA_STATUS status, const NdefDetectResult& result)
+{
+  sCheckNdefStatus = status;
+  sCheckNdefCapable = false; // Assume tag is NOT ndef capable.
+  if (sCheckNdefStatus == NFA_STATUS_OK) {
+    // NDEF content is on the tag.
+    sCheckNdefMaxSize = result.maxSize;
+    sCheckNdefCurrentSize = result.currentSize;
+    sCheckNdefCardReadOnly = result.flags & RW_NDEF_FL_READ_ONLY;
+    sCheckNdefCapable = true;
+  } else if (sCheckNdefStatus == NFA_STATUS_FAILED) {
+    // No NDEF content on the tag.
+    sCheckNdefMaxSize = 0;
+    sCheckNdefCurrentSize = 0;
+    sCheckNdefCardReadOnly = result.flags & RW_NDEF_FL_READ_ONLY;
+    if ((result.flags & RW_NDEF_FL_UNKNOWN) == 0) { // If stack understands the tag.
+      if (result.flags & RW_NDEF_FL_SUPPORTED) {    // If tag is ndef capable.
+        sCheckNdefCapable = true;
+      }
+    }
+  } else {
+    NFC_LOGE(TAG, "%s: unknown status=0x%X", __FUNCTION__, status);
+    sCheckNdefMaxSize = 0;
+    sCheckNdefCurrentSize = 0;
+    sCheckNdefCardReadOnly = false;
+  }
+}
+
+/**
+ * Report the NDEF state of the tag as checkNdefWithStatus() does.
+ *
+ * @param  ndefInfo Returns the max NDEF size and the NDEF mode of the tag.
+ * @return          NFA_STATUS_OK if the tag holds an NDEF message.
+ */
+static int reportCheckNdefResult(int ndefInfo[])
+{
+  int status;
+
+  if (sCheckNdefStatus == NFA_STATUS_OK) {
+
+    // Stack found a NDEF message on the tag.
+    if (NfcTag::getInstance().getProtocol() == NFA_PROTOCOL_T1T)
+      ndefInfo[0] = NfcTag::getInstance().getT1tMaxMessageSize();
+    else
+      ndefInfo[0] = sCheckNdefMaxSize;
+    if (sCheckNdefCardReadOnly)
+      ndefInfo[1] = NDEF_MODE_READ_ONLY;
+    else
+      ndefInfo[1] = NDEF_MODE_READ_WRITE;
+    status = NFA_STATUS_OK;
+  } else if (sCheckNdefStatus == NFA_STATUS_FAILED) {
+    // Stack did not find a NDEF message on the tag.
+    if (NfcTag::getInstance().getProtocol() == NFA_PROTOCOL_T1T)
+      ndefInfo[0] = NfcTag::getInstance().getT1tMaxMessageSize();
+    else
+      ndefInfo[0] = sCheckNdefMaxSize;
+    if (sCheckNdefCardReadOnly)
+      ndefInfo[1] = NDEF_MODE_READ_ONLY;
+    else
+      ndefInfo[1] = NDEF_MODE_READ_WRITE;
+    status = NFA_STATUS_FAILED;
+  } else if (sCheckNdefStatus == NFA_STATUS_TIMEOUT) {
+    pn544InteropStopPolling();
+    status = sCheckNdefStatus;
+  } else {
+    NFC_LOGD(TAG, "%s: unknown status 0x%X", __FUNCTION__, sCheckNdefStatus);
+    status = sCheckNdefStatus;
+  }
+
+  return status;
+}
 
 static void ndefHandlerCallback(tNFA_NDEF_EVT event, tNFA_NDEF_EVT_DATA *eventData)
 {
-  ALOGD("%s: event=%u, eventData=%p", __FUNCTION__, event, eventData);
+  NFC_LOGD(TAG, "%s: event=%u, eventData=%p", __FUNCTION__, event, eventData);
+  NfaEventTrace::getInstance().recordNdefEvent(event, eventData);
 
   switch (event) {
     case NFA_NDEF_REGISTER_EVT: {
       tNFA_NDEF_REGISTER& ndef_reg = eventData->ndef_reg;
-      ALOGD("%s: NFA_NDEF_REGISTER_EVT; status=0x%X; h=0x%X", __FUNCTION__, ndef_reg.status, ndef_reg.ndef_type_handle);
+      NFC_LOGD(TAG, "%s: NFA_NDEF_REGISTER_EVT; status=0x%X; h=0x%X", __FUNCTION__, ndef_reg.status, ndef_reg.ndef_type_handle);
       sNdefTypeHandlerHandle = ndef_reg.ndef_type_handle;
       break;
     }
 
     case NFA_NDEF_DATA_EVT: {
-      ALOGD("%s: NFA_NDEF_DATA_EVT; data_len = %lu", __FUNCTION__, eventData->ndef_data.len);
-      sReadDataLen = eventData->ndef_data.len;
-      sReadData = (uint8_t*) malloc(sReadDataLen);
-      memcpy(sReadData, eventData->ndef_data.p_data, eventData->ndef_data.len);
+      NFC_LOGD(TAG, "%s: NFA_NDEF_DATA_EVT; data_len = %lu", __FUNCTION__, eventData->ndef_data.len);
+      const uint8_t* data = eventData->ndef_data.p_data;
+      SyncEventGuard g(sReadEvent);
+      // Late data of a read that timed out, or data nobody asked for.
+      if (!sIsReadingNdefMessage) {
+        NFC_LOGD(TAG, "%s: not reading; drop NDEF data", __FUNCTION__);
+        break;
+      }
+      NdefBufferPool::getInstance().acquire(eventData->ndef_data.len, sReadData);
+      sReadData.assign(data, data + eventData->ndef_data.len);
       break;
     }
 
     default:
-      ALOGE("%s: Unknown event %u ????", __FUNCTION__, event);
+      NFC_LOGE(TAG, "%s: Unknown event %u ????", __FUNCTION__, event);
       break;
   }
 }
@@ -113,6 +597,7 @@ static void ndefHandlerCallback(tNFA_NDEF_EVT event, tNFA_NDEF_EVT_DATA *eventDa
 NfcTagManager::NfcTagManager()
 {
   pthread_mutex_init(&mMutex, NULL);
+  NfaEventTrace::getInstance().setNdefCallback(ndefHandlerCallback);
 }
 
 NfcTagManager::~NfcTagManager()
@@ -126,7 +611,7 @@ NdefDetail* NfcTagManager::ReadNdefDetail()
   NdefDetail* pNdefDetail = NULL;
   status = checkNdefWithStatus(ndefinfo);
   if (status != 0) {
-    ALOGE("%s: Check NDEF Failed - status = %d", __FUNCTION__, status);
+    NFC_LOGE(TAG, "%s: Check NDEF Failed - status = %d", __FUNCTION__, status);
   } else {
     int ndefType = getNdefType(getConnectedLibNfcType());
 
@@ -147,23 +632,26 @@ NdefMessage* NfcTagManager::findAndReadNdef()
   int formattableLibNfcType = 0;
   int status;
 
-  for(uint32_t techIndex = 0; techIndex < mTechList.size(); techIndex++) {
-    // Have we seen this handle before?
-    for (uint32_t i = 0; i < techIndex; i++) {
-      if (mTechHandles[i] == mTechHandles[techIndex]) {
-        continue;  // Don't check duplicate handles.
-      }
-    }
+  TagProbePlanner& planner = TagProbePlanner::getInstance();
+  TagFingerprint fingerprint;
+  getFingerprint(fingerprint);
 
-    status = connectWithStatus(mTechList[techIndex]);
+  // One technology per handle, likeliest to expose NDEF first.
+  std::vector<uint32_t> probeOrder;
+  planner.plan(fingerprint, mTechList, mTechHandles, mTechLibNfcTypes, probeOrder);
+
+  for (uint32_t probe = 0; probe < probeOrder.size(); probe++) {
+    uint32_t techIndex = probeOrder[probe];
+
+    status = connectToIndex(techIndex);
     if (status != 0) {
-      ALOGE("%s: Connect Failed - status = %d", __FUNCTION__, status);
-      if (status == STATUS_CODE_TARGET_LOST) {
+      NFC_LOGE(TAG, "%s: Connect Failed - status = %d", __FUNCTION__, status);
+      if (status == STATUS_CODE_TARGET_LOST || sTimedOut) {
         break;
       }
       continue;  // Try next handle.
     } else {
-      ALOGI("Connect Succeeded! (status = %d)", status);
+      NFC_LOGI(TAG, "Connect Succeeded! (status = %d)", status);
     }
 
     // Check if this type is NDEF formatable
@@ -183,13 +671,14 @@ NdefMessage* NfcTagManager::findAndReadNdef()
     int ndefinfo[2];
     status = checkNdefWithStatus(ndefinfo);
     if (status != 0) {
-      ALOGE("%s: Check NDEF Failed - status = %d", __FUNCTION__, status);
-      if (status == STATUS_CODE_TARGET_LOST) {
+      NFC_LOGE(TAG, "%s: Check NDEF Failed - status = %d", __FUNCTION__, status);
+      if (status == STATUS_CODE_TARGET_LOST || sTimedOut) {
         break;
       }
       continue;  // Try next handle.
     } else {
-      ALOGI("Check Succeeded! (status = %d)", status);
+      NFC_LOGI(TAG, "Check Succeeded! (status = %d)", status);
+      planner.remember(fingerprint, mTechList[techIndex]);
     }
 
     // Found our NDEF handle.
@@ -200,7 +689,9 @@ NdefMessage* NfcTagManager::findAndReadNdef()
     readNdef(buf);
     if (buf.size() != 0) {
       ndefMsg = new NdefMessage();
-      if (ndefMsg->init(buf)) {
+      bool parsed = ndefMsg->init(buf);
+      NdefBufferPool::getInstance().release(buf);
+      if (parsed) {
         addTechnology(NDEF, getConnectedHandle(), getConnectedLibNfcType());
         // TODO : check why android call reconnect here
         //reconnect();
@@ -216,7 +707,7 @@ NdefMessage* NfcTagManager::findAndReadNdef()
     }
 
     if (generateEmptyNdef == true) {
-      ALOGI("Couldn't read NDEF!");
+      NFC_LOGI(TAG, "Couldn't read NDEF!");
       // TODO : Implement generate empty Ndef
       addTechnology(NDEF, getConnectedHandle(), getConnectedLibNfcType());
       //reconnect();
@@ -233,15 +724,66 @@ NdefMessage* NfcTagManager::findAndReadNdef()
   return ndefMsg;
 }
 
+void NfcTagManager::getFingerprint(TagFingerprint& fingerprint)
+{
+  fingerprint.uid.clear();
+  fingerprint.family.clear();
+  if (!mUid.empty()) {
+    fingerprint.uid = mUid[0];
+  }
+  if (!mTechPollBytes.empty()) {
+    fingerprint.family = mTechPollBytes[0];
+  }
+  if (!mTechActBytes.empty()) {
+    fingerprint.family.insert(fingerprint.family.end(),
+                              mTechActBytes[0].begin(), mTechActBytes[0].end());
+  }
+}
+
+struct ReadNdefJob {
+  NfcTagManager* manager;
+  INfcTagCallback* callback;
+};
+
+static void* readNdefThreadFunc(void* arg)
+{
+  ReadNdefJob* job = reinterpret_cast<ReadNdefJob*>(arg);
+  NdefMessage* ndef = job->manager->findAndReadNdef();
+  job->callback->onTagOperationComplete(TAG_OP_READ_NDEF, ndef != NULL, ndef);
+  delete job;
+  return NULL;
+}
+
+void NfcTagManager::findAndReadNdefAsync(INfcTagCallback* callback)
+{
+  // Probing the technologies of the tag is a sequence of connect, check and
+  // read steps, each of which may reselect the tag, so the read runs on its
+  // own thread rather than as a chain of NFA events.
+  ReadNdefJob* job = new ReadNdefJob();
+  job->manager = this;
+  job->callback = callback;
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, readNdefThreadFunc, job) != 0) {
+    NFC_LOGE(TAG, "%s: pthread_create failed", __FUNCTION__);
+    delete job;
+    callback->onTagOperationComplete(TAG_OP_READ_NDEF, false, NULL);
+    return;
+  }
+  pthread_detach(tid);
+}
+
 bool NfcTagManager::disconnect()
 {
   bool result = false;
 
   mIsPresent = false;
 
-  pthread_mutex_lock(&mMutex);
+  beginRfOperation();
   result = doDisconnect();
-  pthread_mutex_unlock(&mMutex);
+  sTagFingerprint = TagFingerprint();
+  sT2tReader.reset();
+  endRfOperation();
 
   mConnectedTechIndex = -1;
   mConnectedHandle = -1;
@@ -263,19 +805,19 @@ bool NfcTagManager::reconnect()
 
 int NfcTagManager::reconnectWithStatus()
 {
-  ALOGD("%s: enter", __FUNCTION__);
+  NFC_LOGD(TAG, "%s: enter", __FUNCTION__);
   int retCode = NFCSTATUS_SUCCESS;
   NfcTag& natTag = NfcTag::getInstance();
 
   if (natTag.getActivationState() != NfcTag::Active) {
-    ALOGD("%s: tag already deactivated", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: tag already deactivated", __FUNCTION__);
     retCode = NFCSTATUS_FAILED;
     goto TheEnd;
   }
 
   // Special case for Kovio.
   if (NfcTag::getInstance().mTechList [0] == TARGET_TYPE_KOVIO_BARCODE) {
-    ALOGD("%s: fake out reconnect for Kovio", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: fake out reconnect for Kovio", __FUNCTION__);
     goto TheEnd;
   }
 
@@ -286,68 +828,77 @@ int NfcTagManager::reconnectWithStatus()
     retCode = reSelect(NFA_INTERFACE_FRAME);
 
 TheEnd:
-  ALOGD("%s: exit 0x%X", __FUNCTION__, retCode);
+  NFC_LOGD(TAG, "%s: exit 0x%X", __FUNCTION__, retCode);
   return retCode;
 }
 
 int NfcTagManager::reconnectWithStatus(int technology)
 {
   int status = -1;
-  pthread_mutex_lock(&mMutex);
+  beginRfOperation();
   status = doConnect(technology);
-  pthread_mutex_unlock(&mMutex);
+  endRfOperation();
   return status;
 }
 
 int NfcTagManager::connectWithStatus(int technology)
 {
-  int status = -1;
   for (uint32_t i = 0; i < mTechList.size(); i++) {
     if (mTechList[i] == technology) {
-      // Get the handle and connect, if not already connected.
-      if (mConnectedHandle != mTechHandles[i]) {
-        // We're not yet connected, there are a few scenario's
-        // here:
-        // 1) We are not connected to anything yet - allow
-        // 2) We are connected to a technology which has
-        //    a different handle (multi-protocol tag); we support
-        //    switching to that.
-        // 3) We are connected to a technology which has the same
-        //    handle; we do not support connecting at a different
-        //    level (libnfc auto-activates to the max level on
-        //    any handle).
-        // 4) We are connecting to the ndef technology - always
-        //    allowed.
-        if (mConnectedHandle == -1) {
-          // Not connected yet.
-          status = doConnect(i);
-        } else {
-          // Connect to a tech with a different handle.
-          ALOGD("%s: Connect to a tech with a different handle", __FUNCTION__);
-          status = reconnectWithStatus(i);
-        }
-        if (status == 0) {
-          mConnectedHandle = mTechHandles[i];
-          mConnectedTechIndex = i;
-        }
-      } else {
-        // 1) We are connected to a technology which has the same
-        //    handle; we do not support connecting at a different
-        //    level (libnfc auto-activates to the max level on
-        //    any handle).
-        // 2) We are connecting to the ndef technology - always
-        //    allowed.
-        if ((technology == NDEF) ||
-            (technology == NDEF_FORMATABLE)) {
-          i = 0;
-        }
-
-        status = reconnectWithStatus(i);
-        if (status == 0) {
-          mConnectedTechIndex = i;
-        }
-      }
-      break;
+      return connectToIndex(i);
+    }
+  }
+  return -1;
+}
+
+int NfcTagManager::connectToIndex(uint32_t techIndex)
+{
+  int status = -1;
+  if (techIndex >= mTechList.size())
+    return status;
+
+  int technology = mTechList[techIndex];
+  // Get the handle and connect, if not already connected.
+  if (mConnectedHandle != mTechHandles[techIndex]) {
+    // We're not yet connected, there are a few scenario's
+    // here:
+    // 1) We are not connected to anything yet - allow
+    // 2) We are connected to a technology which has
+    //    a different handle (multi-protocol tag); we support
+    //    switching to that.
+    // 3) We are connected to a technology which has the same
+    //    handle; we do not support connecting at a different
+    //    level (libnfc auto-activates to the max level on
+    //    any handle).
+    // 4) We are connecting to the ndef technology - always
+    //    allowed.
+    if (mConnectedHandle == -1) {
+      // Not connected yet.
+      status = doConnect(techIndex);
+    } else {
+      // Connect to a tech with a different handle.
+      NFC_LOGD(TAG, "%s: Connect to a tech with a different handle", __FUNCTION__);
+      status = reconnectWithStatus(techIndex);
+    }
+    if (status == 0) {
+      mConnectedHandle = mTechHandles[techIndex];
+      mConnectedTechIndex = techIndex;
+    }
+  } else {
+    // 1) We are connected to a technology which has the same
+    //    handle; we do not support connecting at a different
+    //    level (libnfc auto-activates to the max level on
+    //    any handle).
+    // 2) We are connecting to the ndef technology - always
+    //    allowed.
+    if ((technology == NDEF) ||
+        (technology == NDEF_FORMATABLE)) {
+      techIndex = 0;
+    }
+
+    status = reconnectWithStatus(techIndex);
+    if (status == 0) {
+      mConnectedTechIndex = techIndex;
     }
   }
   return status;
@@ -355,65 +906,67 @@ int NfcTagManager::connectWithStatus(int technology)
 
 void NfcTagManager::doRead(std::vector<uint8_t>& buf)
 {
-  ALOGD("%s: enter", __FUNCTION__);
+  NFCD_TRACE_SCOPE(TRACE_TAG_READ);
+  NFC_LOGD(TAG, "%s: enter", __FUNCTION__);
   tNFA_STATUS status = NFA_STATUS_FAILED;
-    
-  sReadDataLen = 0;
-  if (sReadData != NULL) {
-    free(sReadData);
-    sReadData = NULL;
+  NdefBufferPool& pool = NdefBufferPool::getInstance();
+
+  if (sCheckNdefCurrentSize > 0 && NfcTag::getInstance().getProtocol() == NFA_PROTOCOL_T2T) {
+    // Bulk reads instead of NFA_RwReadNDef's 4 pages per round trip.
+    pool.acquire(sCheckNdefCurrentSize, buf);
+    sT2tReader.reset();
+    if (sT2tReader.readNdef(buf) && !buf.empty()) {
+      NFC_LOGD(TAG, "%s: read %zu bytes in %u round trips", __FUNCTION__,
+               buf.size(), sT2tReader.getRoundTrips());
+      NFC_LOGD(TAG, "%s: exit", __FUNCTION__);
+      return;
+    }
+    NFC_LOGD(TAG, "%s: bulk read failed; fall back to NFA", __FUNCTION__);
+    buf.clear();
   }
 
   if (sCheckNdefCurrentSize > 0) {
-    {
-      SyncEventGuard g(sReadEvent);
-      sIsReadingNdefMessage = true;
-      status = NFA_RwReadNDef();
-      sReadEvent.wait(); // Wait for NFA_READ_CPLT_EVT.
+    SyncEventGuard g(sReadEvent);
+    pool.release(sReadData);
+    sIsReadingNdefMessage = true;
+    status = NFA_TRACED_REQUEST(REQUEST_READ_NDEF, NFA_RwReadNDef());
+    // Wait for NFA_READ_CPLT_EVT.
+    if (!sReadEvent.wait(operationTimeout(READ_TIMEOUT_MS))) {
+      abortOnTimeout(__FUNCTION__);
+      pool.release(sReadData);
     }
     sIsReadingNdefMessage = false;
-   
-    if (sReadDataLen > 0) { // If stack actually read data from the tag.
-      ALOGD("%s: read %u bytes", __FUNCTION__, sReadDataLen);
-      for(uint32_t idx = 0; idx < sReadDataLen; idx++) {
-        buf.push_back(sReadData[idx]);
-      }
+
+    if (!sReadData.empty()) { // If stack actually read data from the tag.
+      NFC_LOGD(TAG, "%s: read %zu bytes", __FUNCTION__, sReadData.size());
+      buf.swap(sReadData);
     }
+    pool.release(sReadData);
   } else {
-    ALOGD("%s: create emtpy buffer", __FUNCTION__);
-    sReadDataLen = 0;
-    sReadData = (uint8_t*) malloc(1);
-    buf.push_back(sReadData[0]);
-  }
-
-  if (sReadData) {
-    free(sReadData);
-    sReadData = NULL;
+    NFC_LOGD(TAG, "%s: tag holds no NDEF message", __FUNCTION__);
   }
-  sReadDataLen = 0;
 
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(TAG, "%s: exit", __FUNCTION__);
   return;
 }
 
 void NfcTagManager::doWriteStatus(bool isWriteOk)
 {
-  if (sWriteWaitingForComplete != false) {
-    sWriteWaitingForComplete = false;
-    sWriteOk = isWriteOk;
-    sem_post(&sWriteSem);
-  }
+  releaseStackWriteBuf();
+  sWriteCompletion.complete(isWriteOk ? NFA_STATUS_OK : NFA_STATUS_FAILED);
 }
 
 int NfcTagManager::doCheckNdef(int ndefInfo[])
 {
+  NFCD_TRACE_SCOPE(TRACE_TAG_CHECK_NDEF);
   tNFA_STATUS status = NFA_STATUS_FAILED;
 
-  ALOGD("%s: enter", __FUNCTION__);
+  NFC_LOGD(TAG, "%s: enter", __FUNCTION__);
+  sCheckNdefDetected = false;
 
   // Special case for Kovio.
   if (NfcTag::getInstance().mTechList [0] == TARGET_TYPE_KOVIO_BARCODE) {
-    ALOGD("%s: Kovio tag, no NDEF", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: Kovio tag, no NDEF", __FUNCTION__);
     ndefInfo[0] = 0;
     ndefInfo[1] = NDEF_MODE_READ_ONLY;
     return NFA_STATUS_FAILED;
@@ -421,87 +974,133 @@ int NfcTagManager::doCheckNdef(int ndefInfo[])
 
   // Special case for Kovio.
   if (NfcTag::getInstance().mTechList [0] == TARGET_TYPE_KOVIO_BARCODE) {
-    ALOGD("%s: Kovio tag, no NDEF", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: Kovio tag, no NDEF", __FUNCTION__);
     ndefInfo[0] = 0;
     ndefInfo[1] = NDEF_MODE_READ_ONLY;
     return NFA_STATUS_FAILED;
   }
 
-  // Create the write semaphore.
-  if (sem_init(&sCheckNdefSem, 0, 0) == -1) {
-    ALOGE("%s: Check NDEF semaphore creation failed (errno=0x%08x)", __FUNCTION__, errno);
-    return false;
-  }
-
   if (NfcTag::getInstance().getActivationState() != NfcTag::Active) {
-    ALOGE("%s: tag already deactivated", __FUNCTION__);
+    NFC_LOGE(TAG, "%s: tag already deactivated", __FUNCTION__);
     goto TheEnd;
   }
 
-  ALOGD("%s: try NFA_RwDetectNDef", __FUNCTION__);
-  sCheckNdefWaitingForComplete = true;
-  status = NFA_RwDetectNDef();
+  NFC_LOGD(TAG, "%s: try NFA_RwDetectNDef", __FUNCTION__);
+  sCheckNdefCompletion.arm();
+  status = NFA_TRACED_REQUEST(REQUEST_DETECT_NDEF, NFA_RwDetectNDef());
 
   if (status != NFA_STATUS_OK) {
-    ALOGE("%s: NFA_RwDetectNDef failed, status = 0x%X", __FUNCTION__, status);
+    NFC_LOGE(TAG, "%s: NFA_RwDetectNDef failed, status = 0x%X", __FUNCTION__, status);
     goto TheEnd;
   }
 
   // Wait for check NDEF completion status.
-  if (sem_wait(&sCheckNdefSem)) {
-    ALOGE("%s: Failed to wait for check NDEF semaphore (errno=0x%08x)", __FUNCTION__, errno);
+  if (!waitForCompletion(sCheckNdefCompletion, CHECK_NDEF_TIMEOUT_MS, __FUNCTION__)) {
+    status = NFA_STATUS_TIMEOUT;
     goto TheEnd;
   }
+  applyCheckNdefResult(sCheckNdefCompletion.status(), sCheckNdefCompletion.payload());
+  sCheckNdefDetected = true;
+  status = reportCheckNdefResult(ndefInfo);
 
-  if (sCheckNdefStatus == NFA_STATUS_OK) {
-    // Stack found a NDEF message on the tag.
-    if (NfcTag::getInstance().getProtocol() == NFA_PROTOCOL_T1T)
-      ndefInfo[0] = NfcTag::getInstance().getT1tMaxMessageSize();
-    else
-      ndefInfo[0] = sCheckNdefMaxSize;
-    if (sCheckNdefCardReadOnly)
-      ndefInfo[1] = NDEF_MODE_READ_ONLY;
-    else
-      ndefInfo[1] = NDEF_MODE_READ_WRITE;
-    status = NFA_STATUS_OK;
-  } else if (sCheckNdefStatus == NFA_STATUS_FAILED) {
-    // Stack did not find a NDEF message on the tag.
-    if (NfcTag::getInstance().getProtocol() == NFA_PROTOCOL_T1T)
-      ndefInfo[0] = NfcTag::getInstance().getT1tMaxMessageSize();
-    else
-      ndefInfo[0] = sCheckNdefMaxSize;
-    if (sCheckNdefCardReadOnly)
-      ndefInfo[1] = NDEF_MODE_READ_ONLY;
-    else
-      ndefInfo[1] = NDEF_MODE_READ_WRITE;
-    status = NFA_STATUS_FAILED;
-  } else if (sCheckNdefStatus == NFA_STATUS_TIMEOUT) {
-    pn544InteropStopPolling();
-    status = sCheckNdefStatus;
-  } else {
-    ALOGD("%s: unknown status 0x%X", __FUNCTION__, sCheckNdefStatus);
-    status = sCheckNdefStatus;
+TheEnd:
+  sCheckNdefCompletion.cancel();
+  NFC_LOGD(TAG, "%s: exit; status=0x%X", __FUNCTION__, status);
+  return status;
+}
+
+void NfcTagManager::doTransceiveStatus(tNFA_STATUS status, uint8_t* data, uint32_t len)
+{
+  NFC_LOGD(TAG, "%s: status=0x%X; len=%u", __FUNCTION__, status, len);
+  SyncEventGuard g(sTransceiveEvent);
+  if (!sWaitingForTransceive) {
+    NFC_LOGE(TAG, "%s: not waiting for a response", __FUNCTION__);
+    return;
   }
 
-TheEnd:
-  // Destroy semaphore.
-  if (sem_destroy(&sCheckNdefSem)) {
-    ALOGE("%s: Failed to destroy check NDEF semaphore (errno=0x%08x)", __FUNCTION__, errno);
+  if (data && len) {
+    sTransceiveData.insert(sTransceiveData.end(), data, data + len);
   }
-  sCheckNdefWaitingForComplete = false;
-  ALOGD("%s: exit; status=0x%X", __FUNCTION__, status);
-  return status;
+  // A chained response arrives in several NFA_DATA_EVTs.
+  if (status == NFA_STATUS_CONTINUE)
+    return;
+  sTransceiveEvent.notifyOne();
+}
+
+void NfcTagManager::doTransceiveRfTimeout()
+{
+  NFC_LOGD(TAG, "%s", __FUNCTION__);
+  SyncEventGuard g(sTransceiveEvent);
+  sTransceiveRfTimeout = true;
+  sTransceiveEvent.notifyOne();
+}
+
+TransceiveStatus NfcTagManager::doTransceive(const std::vector<uint8_t>& command,
+                                             std::vector<uint8_t>& response,
+                                             int timeoutMs)
+{
+  NFCD_TRACE_SCOPE_ARG(TRACE_TAG_TRANSCEIVE, command.size());
+  NfcTag& natTag = NfcTag::getInstance();
+  TransceiveStatus result = TRANSCEIVE_OK;
+
+  response.clear();
+  if (natTag.getActivationState() != NfcTag::Active) {
+    NFC_LOGE(TAG, "%s: tag already deactivated", __FUNCTION__);
+    return TRANSCEIVE_TARGET_LOST;
+  }
+  if (command.empty()) {
+    return TRANSCEIVE_FAILED;
+  }
+
+  // NfcA and NfcB on an ISO-DEP tag talk over the frame interface; see
+  // doConnect().
+  if (sNeedToSwitchRf) {
+    if (!switchRfInterface(NFA_INTERFACE_FRAME)) {
+      NFC_LOGE(TAG, "%s: cannot switch to frame interface", __FUNCTION__);
+      return TRANSCEIVE_FAILED;
+    }
+    sNeedToSwitchRf = false;
+  }
+
+  {
+    SyncEventGuard g(sTransceiveEvent);
+    sTransceiveData.clear();
+    sTransceiveRfTimeout = false;
+    sWaitingForTransceive = true;
+
+    tNFA_STATUS status = NFA_TRACED_REQUEST(REQUEST_SEND_RAW_FRAME,
+      NFA_SendRawFrame(const_cast<uint8_t*>(&command[0]), command.size(),
+                       NFA_DM_DEFAULT_PRESENCE_CHECK_START_DELAY));
+    if (status != NFA_STATUS_OK) {
+      NFC_LOGE(TAG, "%s: NFA_SendRawFrame failed, status = 0x%X", __FUNCTION__, status);
+      result = TRANSCEIVE_FAILED;
+    } else if (!sTransceiveEvent.wait(operationTimeout(timeoutMs > 0 ? timeoutMs : gGeneralTransceiveTimeout))) {
+      abortOnTimeout(__FUNCTION__);
+      result = TRANSCEIVE_TIMEOUT;
+    } else if (sTransceiveRfTimeout || natTag.getActivationState() != NfcTag::Active) {
+      result = TRANSCEIVE_TARGET_LOST;
+    } else {
+      response.swap(sTransceiveData);
+    }
+    sWaitingForTransceive = false;
+    sTransceiveData.clear();
+  }
+
+  NFC_LOGD(TAG, "%s: exit; result=%d; response len=%zu", __FUNCTION__, result, response.size());
+  return result;
 }
 
 void NfcTagManager::doAbortWaits()
 {
-  ALOGD("%s", __FUNCTION__);
+  NFC_LOGD(TAG, "%s", __FUNCTION__);
   {
     SyncEventGuard g(sReadEvent);
     sReadEvent.notifyOne();
   }
-  sem_post(&sWriteSem);
-  sem_post(&sFormatSem);
+  sWriteCompletion.cancel();
+  sFormatCompletion.cancel();
+  // The stack drops a write in progress when the tag goes away.
+  releaseStackWriteBuf();
   {
     SyncEventGuard g(sTransceiveEvent);
     sTransceiveEvent.notifyOne();
@@ -511,25 +1110,22 @@ void NfcTagManager::doAbortWaits()
     sReconnectEvent.notifyOne();
   }
 
-  sem_post(&sCheckNdefSem);
-  sem_post(&sPresenceCheckSem);
-  sem_post(&sMakeReadonlySem);
+  sCheckNdefCompletion.cancel();
+  sPresenceCheckCompletion.cancel();
+  sMakeReadonlyCompletion.cancel();
 }
 
 void NfcTagManager::doReadCompleted(tNFA_STATUS status)
 {
-  ALOGD("%s: status=0x%X; is reading=%u", __FUNCTION__, status, sIsReadingNdefMessage);
+  SyncEventGuard g(sReadEvent);
+  NFC_LOGD(TAG, "%s: status=0x%X; is reading=%u", __FUNCTION__, status, sIsReadingNdefMessage);
 
   if (sIsReadingNdefMessage == false)
     return; // Not reading NDEF message right now, so just return.
 
   if (status != NFA_STATUS_OK) {
-    sReadDataLen = 0;
-    if (sReadData)
-      free (sReadData);
-    sReadData = NULL;
+    NdefBufferPool::getInstance().release(sReadData);
   }
-  SyncEventGuard g(sReadEvent);
   sReadEvent.notifyOne();
 }
 
@@ -563,28 +1159,24 @@ void NfcTagManager::doPresenceCheckResult(tNFA_STATUS status)
   else
     sCountTagAway++;
   if (sCountTagAway > 0)
-    ALOGD("%s: sCountTagAway=%d", __FUNCTION__, sCountTagAway);
-  sem_post(&sPresenceCheckSem);
+    NFC_LOGD(TAG, "%s: sCountTagAway=%d", __FUNCTION__, sCountTagAway);
+  sPresenceCheckCompletion.complete(status);
 }
 
-bool NfcTagManager::doNdefFormat()
+void NfcTagManager::doStartNdefFormat()
 {
-  ALOGD ("%s: enter", __FUNCTION__);
-  tNFA_STATUS status = NFA_STATUS_OK;
+  NFC_LOGD(TAG, "%s: enter", __FUNCTION__);
 
-  sem_init (&sFormatSem, 0, 0);
-  sFormatOk = false;
-  status = NFA_RwFormatTag ();
-  if (status == NFA_STATUS_OK) {
-    ALOGD ("%s: wait for completion", __FUNCTION__);
-    sem_wait (&sFormatSem);
-    status = sFormatOk ? NFA_STATUS_OK : NFA_STATUS_FAILED;
-  } else
-    ALOGE ("%s: error status=%u", __FUNCTION__, status);
-  sem_destroy (&sFormatSem);
+  if (!armAsyncStep(sFormatCompletion, onAsyncStepComplete, operationTimeout(FORMAT_TIMEOUT_MS))) {
+    finishAsyncOp(false);
+    return;
+  }
 
-  ALOGD ("%s: exit", __FUNCTION__);
-  return (status == NFA_STATUS_OK) ? true : false;
+  tNFA_STATUS status = NFA_TRACED_REQUEST(REQUEST_FORMAT, NFA_RwFormatTag());
+  if (status != NFA_STATUS_OK) {
+    NFC_LOGE(TAG, "%s: error status=%u", __FUNCTION__, status);
+    sFormatCompletion.cancel(status);
+  }
 }
 
 void NfcTagManager::doCheckNdefResult(tNFA_STATUS status, uint32_t maxSize, uint32_t currentSize, uint8_t flags)
@@ -598,150 +1190,99 @@ void NfcTagManager::doCheckNdefResult(tNFA_STATUS status, uint32_t maxSize, uint
   // #define RW_NDEF_FL_FORMATABLE 0x10    /* Tag supports format operation */
 
   if (status == NFC_STATUS_BUSY) {
-    ALOGE("%s: stack is busy", __FUNCTION__);
-    return;
-  }
-
-  if (!sCheckNdefWaitingForComplete) {
-    ALOGE("%s: not waiting", __FUNCTION__);
+    NFC_LOGE(TAG, "%s: stack is busy", __FUNCTION__);
     return;
   }
 
   if (flags & RW_NDEF_FL_READ_ONLY)
-    ALOGD("%s: flag read-only", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: flag read-only", __FUNCTION__);
   if (flags & RW_NDEF_FL_FORMATED)
-    ALOGD("%s: flag formatted for ndef", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: flag formatted for ndef", __FUNCTION__);
   if (flags & RW_NDEF_FL_SUPPORTED)
-    ALOGD("%s: flag ndef supported", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: flag ndef supported", __FUNCTION__);
   if (flags & RW_NDEF_FL_UNKNOWN)
-    ALOGD("%s: flag all unknown", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: flag all unknown", __FUNCTION__);
   if (flags & RW_NDEF_FL_FORMATABLE)
-    ALOGD("%s: flag formattable", __FUNCTION__);
-
-  sCheckNdefWaitingForComplete = false;
-  sCheckNdefStatus = status;
-  sCheckNdefCapable = false; // Assume tag is NOT ndef capable.
-  if (sCheckNdefStatus == NFA_STATUS_OK) {
-    // NDEF content is on the tag.
-    sCheckNdefMaxSize = maxSize;
-    sCheckNdefCurrentSize = currentSize;
-    sCheckNdefCardReadOnly = flags & RW_NDEF_FL_READ_ONLY;
-    sCheckNdefCapable = true;
-  } else if (sCheckNdefStatus == NFA_STATUS_FAILED) {
-    // No NDEF content on the tag.
-    sCheckNdefMaxSize = 0;
-    sCheckNdefCurrentSize = 0;
-    sCheckNdefCardReadOnly = flags & RW_NDEF_FL_READ_ONLY;
-    if ((flags & RW_NDEF_FL_UNKNOWN) == 0) { // If stack understands the tag.
-      if (flags & RW_NDEF_FL_SUPPORTED) {    // If tag is ndef capable.
-        sCheckNdefCapable = true;
-      }
-    }
-  } else {
-    ALOGE("%s: unknown status=0x%X", __FUNCTION__, status);
-    sCheckNdefMaxSize = 0;
-    sCheckNdefCurrentSize = 0;
-    sCheckNdefCardReadOnly = false;
+    NFC_LOGD(TAG, "%s: flag formattable", __FUNCTION__);
+
+  // The tag state is updated by the waiter in doCheckNdef().
+  NdefDetectResult result;
+  result.maxSize = maxSize;
+  result.currentSize = currentSize;
+  result.flags = flags;
+  if (!sCheckNdefCompletion.complete(status, result)) {
+    NFC_LOGE(TAG, "%s: not waiting", __FUNCTION__);
   }
-  sem_post(&sCheckNdefSem);
 }
 
 void NfcTagManager::doMakeReadonlyResult(tNFA_STATUS status)
 {
-  if (sMakeReadonlyWaitingForComplete != false) {
-    sMakeReadonlyWaitingForComplete = false;
-    sMakeReadonlyStatus = status;
-
-    sem_post(&sMakeReadonlySem);
-  }
+  sMakeReadonlyCompletion.complete(status);
 }
 
-bool NfcTagManager::doMakeReadonly()
+void NfcTagManager::doStartMakeReadonly()
 {
-  bool result = false;
-  tNFA_STATUS status;
+  NFC_LOGD(TAG, "%s", __FUNCTION__);
 
-  ALOGD("%s", __FUNCTION__);
-
-  // Create the make_readonly semaphore.
-  if (sem_init(&sMakeReadonlySem, 0, 0) == -1) {
-    ALOGE("%s: Make readonly semaphore creation failed (errno=0x%08x)", __FUNCTION__, errno);
-    return false;
+  if (!armAsyncStep(sMakeReadonlyCompletion, onAsyncStepComplete,
+                    operationTimeout(MAKE_READONLY_TIMEOUT_MS))) {
+    finishAsyncOp(false);
+    return;
   }
 
-  sMakeReadonlyWaitingForComplete = true;
-
   // Hard-lock the tag (cannot be reverted).
-  status = NFA_RwSetTagReadOnly(true);
-
+  tNFA_STATUS status = NFA_TRACED_REQUEST(REQUEST_SET_READ_ONLY, NFA_RwSetTagReadOnly(true));
   if (status != NFA_STATUS_OK) {
-    ALOGE("%s: NFA_RwSetTagReadOnly failed, status = %d", __FUNCTION__, status);
-    goto TheEnd;
-  }
-
-  // Wait for check NDEF completion status.
-  if (sem_wait(&sMakeReadonlySem)) {
-    ALOGE("%s: Failed to wait for make_readonly semaphore (errno=0x%08x)", __FUNCTION__, errno);
-    goto TheEnd;
-  }
-
-  if (sMakeReadonlyStatus == NFA_STATUS_OK) {
-    result = true;
-  }
-
-TheEnd:
-  // Destroy semaphore.
-  if (sem_destroy(&sMakeReadonlySem)) {
-    ALOGE("%s: Failed to destroy read_only semaphore (errno=0x%08x)", __FUNCTION__, errno);
+    NFC_LOGE(TAG, "%s: NFA_RwSetTagReadOnly failed, status = %d", __FUNCTION__, status);
+    sMakeReadonlyCompletion.cancel(status);
   }
-  sMakeReadonlyWaitingForComplete = false;
-  return result;
 }
 
 // Register a callback to receive NDEF message from the tag
 // from the NFA_NDEF_DATA_EVT.
 void NfcTagManager::doRegisterNdefTypeHandler()
 {
-  ALOGD("%s", __FUNCTION__);
+  NFC_LOGD(TAG, "%s", __FUNCTION__);
   sNdefTypeHandlerHandle = NFA_HANDLE_INVALID;
   NFA_RegisterNDefTypeHandler(TRUE, NFA_TNF_DEFAULT, (UINT8 *) "", 0, ndefHandlerCallback);
 }
 
 void NfcTagManager::doDeregisterNdefTypeHandler()
 {
-  ALOGD("%s", __FUNCTION__);
+  NFC_LOGD(TAG, "%s", __FUNCTION__);
   NFA_DeregisterNDefTypeHandler(sNdefTypeHandlerHandle);
   sNdefTypeHandlerHandle = NFA_HANDLE_INVALID;
 }
 
 int NfcTagManager::doConnect(int targetHandle)
 {
-  ALOGD("%s: targetHandle = %d", __FUNCTION__, targetHandle);
+  NFCD_TRACE_SCOPE_ARG(TRACE_TAG_CONNECT, targetHandle);
+  NFC_LOGD(TAG, "%s: targetHandle = %d", __FUNCTION__, targetHandle);
   int i = targetHandle;
   NfcTag& natTag = NfcTag::getInstance();
   int retCode = NFCSTATUS_SUCCESS;
 
   sNeedToSwitchRf = false;
   if (i >= NfcTag::MAX_NUM_TECHNOLOGY) {
-    ALOGE("%s: Handle not found", __FUNCTION__);
+    NFC_LOGE(TAG, "%s: Handle not found", __FUNCTION__);
     retCode = NFCSTATUS_FAILED;
     goto TheEnd;
   }
 
   if (natTag.getActivationState() != NfcTag::Active) {
-    ALOGE("%s: tag already deactivated", __FUNCTION__);
+    NFC_LOGE(TAG, "%s: tag already deactivated", __FUNCTION__);
     retCode = NFCSTATUS_FAILED;
     goto TheEnd;
   }
 
   if (natTag.mTechLibNfcTypes[i] != NFC_PROTOCOL_ISO_DEP) {
-    ALOGD("%s() Nfc type = %d, do nothing for non ISO_DEP", __FUNCTION__, natTag.mTechLibNfcTypes[i]);
+    NFC_LOGD(TAG, "%s() Nfc type = %d, do nothing for non ISO_DEP", __FUNCTION__, natTag.mTechLibNfcTypes[i]);
     retCode = NFCSTATUS_SUCCESS;
     goto TheEnd;
   }
 
   if (natTag.mTechList[i] == TARGET_TYPE_ISO14443_3A || natTag.mTechList[i] == TARGET_TYPE_ISO14443_3B) {
-    ALOGD("%s: switching to tech: %d need to switch rf intf to frame", __FUNCTION__, natTag.mTechList[i]);
+    NFC_LOGD(TAG, "%s: switching to tech: %d need to switch rf intf to frame", __FUNCTION__, natTag.mTechList[i]);
     // Connecting to NfcA or NfcB don't actually switch until/unless we get a transceive.
     sNeedToSwitchRf = true;
   } else {
@@ -750,21 +1291,19 @@ int NfcTagManager::doConnect(int targetHandle)
   }
 
 TheEnd:
-  ALOGD("%s: exit 0x%X", __FUNCTION__, retCode);
+  NFC_LOGD(TAG, "%s: exit 0x%X", __FUNCTION__, retCode);
   return retCode;
 }
 
-bool NfcTagManager::doPresenceCheck()
+void NfcTagManager::doStartPresenceCheck()
 {
-  ALOGD("%s", __FUNCTION__);
-  tNFA_STATUS status = NFA_STATUS_OK;
-  bool isPresent = false;
+  NFC_LOGD(TAG, "%s", __FUNCTION__);
 
   // Special case for Kovio. The deactivation would have already occurred
   // but was ignored so that normal tag opertions could complete.  Now we
   // want to process as if the deactivate just happened.
   if (NfcTag::getInstance().mTechList [0] == TARGET_TYPE_KOVIO_BARCODE) {
-    ALOGD("%s: Kovio, force deactivate handling", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: Kovio, force deactivate handling", __FUNCTION__);
     tNFA_DEACTIVATED deactivated = {NFA_DEACTIVATE_TYPE_IDLE};
 
     NfcTag::getInstance().setDeactivationState(deactivated);
@@ -773,46 +1312,40 @@ bool NfcTagManager::doPresenceCheck()
     doAbortWaits();
     NfcTag::getInstance().abort();
 
-    return false;
+    finishAsyncOp(false);
+    return;
   }
 
   if (nfcManager_isNfcActive() == false) {
-    ALOGD("%s: NFC is no longer active.", __FUNCTION__);
-    return false;
+    NFC_LOGD(TAG, "%s: NFC is no longer active.", __FUNCTION__);
+    finishAsyncOp(false);
+    return;
   }
 
   if (NfcTag::getInstance().getActivationState() != NfcTag::Active) {
-    ALOGD("%s: tag already deactivated", __FUNCTION__);
-    return false;
-  }
-
-  if (sem_init(&sPresenceCheckSem, 0, 0) == -1) {
-    ALOGE("%s: semaphore creation failed (errno=0x%08x)", __FUNCTION__, errno);
-    return false;
+    NFC_LOGD(TAG, "%s: tag already deactivated", __FUNCTION__);
+    finishAsyncOp(false);
+    return;
   }
 
-  status = NFA_RwPresenceCheck();
-  if (status == NFA_STATUS_OK) {
-    if (sem_wait(&sPresenceCheckSem)) {
-      ALOGE("%s: failed to wait (errno=0x%08x)", __FUNCTION__, errno);
-    } else {
-      isPresent = (sCountTagAway > 3) ? false : true;
-    }
+  // Runs outside of any request, so only the operation's own timeout
+  // applies; a tag that does not answer in time is treated as gone.
+  if (!armAsyncStep(sPresenceCheckCompletion, onPresenceCheckComplete, PRESENCE_CHECK_TIMEOUT_MS)) {
+    finishAsyncOp(false);
+    return;
   }
 
-  if (sem_destroy(&sPresenceCheckSem)) {
-    ALOGE("%s: Failed to destroy check NDEF semaphore (errno=0x%08x)", __FUNCTION__, errno);
+  tNFA_STATUS status = NFA_TRACED_REQUEST(REQUEST_PRESENCE_CHECK, NFA_RwPresenceCheck());
+  if (status != NFA_STATUS_OK) {
+    NFC_LOGE(TAG, "%s: NFA_RwPresenceCheck failed, status = %d", __FUNCTION__, status);
+    sPresenceCheckCompletion.cancel(status);
   }
-
-  if (isPresent == false)
-    ALOGD("%s: tag absent ????", __FUNCTION__);
-
-  return isPresent;
 }
 
 int NfcTagManager::reSelect(tNFA_INTF_TYPE rfInterface)
 {
-  ALOGD("%s: enter; rf intf = %d", __FUNCTION__, rfInterface);
+  NFCD_TRACE_SCOPE_ARG(TRACE_TAG_RESELECT, rfInterface);
+  NFC_LOGD(TAG, "%s: enter; rf intf = %d", __FUNCTION__, rfInterface);
   NfcTag& natTag = NfcTag::getInstance();
 
   tNFA_STATUS status;
@@ -822,7 +1355,7 @@ int NfcTagManager::reSelect(tNFA_INTF_TYPE rfInterface)
   {
     // If tag has shutdown, abort this method.
     if (NfcTag::getInstance().isNdefDetectionTimedOut()) {
-      ALOGD("%s: ndef detection timeout; break", __FUNCTION__);
+      NFC_LOGD(TAG, "%s: ndef detection timeout; break", __FUNCTION__);
       rVal = STATUS_CODE_TARGET_LOST;
       break;
     }
@@ -831,19 +1364,19 @@ int NfcTagManager::reSelect(tNFA_INTF_TYPE rfInterface)
       SyncEventGuard g(sReconnectEvent);
       gIsTagDeactivating = true;
       sGotDeactivate = false;
-      ALOGD("%s: deactivate to sleep", __FUNCTION__);
-      if (NFA_STATUS_OK != (status = NFA_Deactivate(TRUE))) { // Deactivate to sleep state.
-        ALOGE("%s: deactivate failed, status = %d", __FUNCTION__, status);
+      NFC_LOGD(TAG, "%s: deactivate to sleep", __FUNCTION__);
+      if (NFA_STATUS_OK != (status = NFA_TRACED_REQUEST(REQUEST_DEACTIVATE_SLEEP, NFA_Deactivate(TRUE)))) { // Deactivate to sleep state.
+        NFC_LOGE(TAG, "%s: deactivate failed, status = %d", __FUNCTION__, status);
         break;
       }
 
       if (sReconnectEvent.wait(1000) == false) { // If timeout occurred.
-        ALOGE("%s: timeout waiting for deactivate", __FUNCTION__);
+        NFC_LOGE(TAG, "%s: timeout waiting for deactivate", __FUNCTION__);
       }
     }
 
     if (NfcTag::getInstance().getActivationState() != NfcTag::Sleep) {
-      ALOGD("%s: tag is not in sleep", __FUNCTION__);
+      NFC_LOGD(TAG, "%s: tag is not in sleep", __FUNCTION__);
       rVal = STATUS_CODE_TARGET_LOST;
       break;
     }
@@ -854,23 +1387,24 @@ int NfcTagManager::reSelect(tNFA_INTF_TYPE rfInterface)
       SyncEventGuard g2 (sReconnectEvent);
 
       sConnectWaitingForComplete = true;
-      ALOGD("%s: select interface %u", __FUNCTION__, rfInterface);
+      NFC_LOGD(TAG, "%s: select interface %u", __FUNCTION__, rfInterface);
       gIsSelectingRfInterface = true;
-      if (NFA_STATUS_OK != (status = NFA_Select(natTag.mTechHandles[0], natTag.mTechLibNfcTypes[0], rfInterface))) {
-        ALOGE("%s: NFA_Select failed, status = %d", __FUNCTION__, status);
+      if (NFA_STATUS_OK != (status = NFA_TRACED_REQUEST(REQUEST_SELECT,
+                    NFA_Select(natTag.mTechHandles[0], natTag.mTechLibNfcTypes[0], rfInterface)))) {
+        NFC_LOGE(TAG, "%s: NFA_Select failed, status = %d", __FUNCTION__, status);
         break;
       }
 
       sConnectOk = false;
       if (sReconnectEvent.wait(1000) == false) { // If timeout occured.
-          ALOGE("%s: timeout waiting for select", __FUNCTION__);
+          NFC_LOGE(TAG, "%s: timeout waiting for select", __FUNCTION__);
           break;
       }
     }
 
-    ALOGD("%s: select completed; sConnectOk=%d", __FUNCTION__, sConnectOk);
+    NFC_LOGD(TAG, "%s: select completed; sConnectOk=%d", __FUNCTION__, sConnectOk);
     if (NfcTag::getInstance().getActivationState() != NfcTag::Active) {
-      ALOGD("%s: tag is not active", __FUNCTION__);
+      NFC_LOGD(TAG, "%s: tag is not active", __FUNCTION__);
       rVal = STATUS_CODE_TARGET_LOST;
       break;
     }
@@ -880,22 +1414,22 @@ int NfcTagManager::reSelect(tNFA_INTF_TYPE rfInterface)
   sConnectWaitingForComplete = false;
   gIsTagDeactivating = false;
   gIsSelectingRfInterface = false;
-  ALOGD("%s: exit; status=%d", __FUNCTION__, rVal);
+  NFC_LOGD(TAG, "%s: exit; status=%d", __FUNCTION__, rVal);
   return rVal;
 }
 
 bool NfcTagManager::switchRfInterface(tNFA_INTF_TYPE rfInterface)
 {
-  ALOGD("%s: rf intf = %d", __FUNCTION__, rfInterface);
+  NFC_LOGD(TAG, "%s: rf intf = %d", __FUNCTION__, rfInterface);
   NfcTag& natTag = NfcTag::getInstance();
 
   if (natTag.mTechLibNfcTypes[0] != NFC_PROTOCOL_ISO_DEP) {
-    ALOGD("%s: protocol: %d not ISO_DEP, do nothing", __FUNCTION__, natTag.mTechLibNfcTypes[0]);
+    NFC_LOGD(TAG, "%s: protocol: %d not ISO_DEP, do nothing", __FUNCTION__, natTag.mTechLibNfcTypes[0]);
     return true;
   }
 
   sRfInterfaceMutex.lock();
-  ALOGD("%s: new rf intf = %d, cur rf intf = %d", __FUNCTION__, rfInterface, sCurrentRfInterface);
+  NFC_LOGD(TAG, "%s: new rf intf = %d, cur rf intf = %d", __FUNCTION__, rfInterface, sCurrentRfInterface);
 
   bool rVal = true;
   if (rfInterface != sCurrentRfInterface) {
@@ -959,102 +1493,90 @@ int NfcTagManager::getConnectedLibNfcType()
 
 bool NfcTagManager::doDisconnect()
 {
-  ALOGD("%s: enter", __FUNCTION__);
+  NFCD_TRACE_SCOPE(TRACE_TAG_DISCONNECT);
+  NFC_LOGD(TAG, "%s: enter", __FUNCTION__);
   tNFA_STATUS nfaStat = NFA_STATUS_OK;
 
   gGeneralTransceiveTimeout = DEFAULT_GENERAL_TRANS_TIMEOUT;
 
   if (NfcTag::getInstance().getActivationState() != NfcTag::Active) {
-    ALOGD("%s: tag already deactivated", __FUNCTION__);
+    NFC_LOGD(TAG, "%s: tag already deactivated", __FUNCTION__);
     goto TheEnd;
   }
 
-  nfaStat = NFA_Deactivate(FALSE);
+  nfaStat = NFA_TRACED_REQUEST(REQUEST_DEACTIVATE, NFA_Deactivate(FALSE));
   if (nfaStat != NFA_STATUS_OK)
-    ALOGE("%s: deactivate failed; error=0x%X", __FUNCTION__, nfaStat);
+    NFC_LOGE(TAG, "%s: deactivate failed; error=0x%X", __FUNCTION__, nfaStat);
 
 TheEnd:
-  ALOGD("%s: exit", __FUNCTION__);
+  NFC_LOGD(TAG, "%s: exit", __FUNCTION__);
   return (nfaStat == NFA_STATUS_OK) ? true : false;
 }
 
 void NfcTagManager::formatStatus(bool isOk)
 {
-  sFormatOk = isOk;
-  sem_post (&sFormatSem);
+  sFormatCompletion.complete(isOk ? NFA_STATUS_OK : NFA_STATUS_FAILED);
 }
 
-bool NfcTagManager::doWrite(std::vector<uint8_t>& buf)
+void NfcTagManager::doStartWrite()
 {
-  bool result = false;
-  tNFA_STATUS status = 0;
-  const int maxBufferSize = 1024;
-  UINT8 buffer[maxBufferSize] = { 0 };
-  UINT32 curDataSize = 0;
- 
-  uint8_t* p_data = reinterpret_cast<uint8_t*>(malloc(buf.size()));
-  for (uint8_t idx = 0; idx < buf.size(); idx++)
-    p_data[idx] = buf[idx];
-
-  ALOGD("%s: enter; len = %zu", __FUNCTION__, buf.size());
-
-  // Create the write semaphore.
-  if (sem_init(&sWriteSem, 0, 0) == -1) {
-    ALOGE("%s: semaphore creation failed (errno=0x%08x)", __FUNCTION__, errno);
-    free(p_data);
-    return false;
+  std::vector<uint8_t>& buf = sAsyncOp.buf;
+
+  NFC_LOGD(TAG, "%s: enter; len = %zu", __FUNCTION__, buf.size());
+
+  // A message the tag cannot hold fails here rather than after the RF
+  // exchanges; the size of a tag without NDEF is only known once formatted.
+  if (sCheckNdefStatus == NFA_STATUS_OK && buf.size() > sCheckNdefMaxSize) {
+    NFC_LOGE(TAG, "%s: message of %zu bytes exceeds tag capacity %u", __FUNCTION__,
+             buf.size(), sCheckNdefMaxSize);
+    finishAsyncOp(false);
+    return;
   }
 
-  sWriteWaitingForComplete = true;
   if (sCheckNdefStatus == NFA_STATUS_FAILED) {
     // If tag does not contain a NDEF message
     // and tag is capable of storing NDEF message.
     if (sCheckNdefCapable) {
-      ALOGD("%s: try format", __FUNCTION__);
-      sem_init(&sFormatSem, 0, 0);
-      sFormatOk = false;
-      status = NFA_RwFormatTag();
-      sem_wait(&sFormatSem);
-      sem_destroy(&sFormatSem);
-      if (sFormatOk == false) // If format operation failed.
-        goto TheEnd;
+      NFC_LOGD(TAG, "%s: try format", __FUNCTION__);
+      if (!armAsyncStep(sFormatCompletion, onWriteFormatComplete, operationTimeout(FORMAT_TIMEOUT_MS))) {
+        finishAsyncOp(false);
+        return;
+      }
+      tNFA_STATUS status = NFA_TRACED_REQUEST(REQUEST_FORMAT, NFA_RwFormatTag());
+      if (status != NFA_STATUS_OK) {
+        NFC_LOGE(TAG, "%s: format error=%d", __FUNCTION__, status);
+        sFormatCompletion.cancel(status);
+      }
+      return;
     }
-    ALOGD("%s: try write", __FUNCTION__);
-    status = NFA_RwWriteNDef(p_data, buf.size());
   } else if (buf.size() == 0) {
     // If (NXP TagWriter wants to erase tag) then create and write an empty ndef message.
-    NDEF_MsgInit(buffer, maxBufferSize, &curDataSize);
-    status = NDEF_MsgAddRec(buffer, maxBufferSize, &curDataSize, NDEF_TNF_EMPTY, NULL, 0, NULL, 0, NULL, 0);
-    ALOGD("%s: create empty ndef msg; status=%u; size=%lu", __FUNCTION__, status, curDataSize);
-    status = NFA_RwWriteNDef(buffer, curDataSize);
-  } else {
-    ALOGD("%s: NFA_RwWriteNDef", __FUNCTION__);
-    status = NFA_RwWriteNDef(p_data, buf.size());
+    NdefRecord empty(NdefRecord::TNF_EMPTY, 0, NULL, 0, NULL, 0, NULL);
+    empty.writeToByteBuffer(buf, true, true);
+    NFC_LOGD(TAG, "%s: create empty ndef msg; size=%zu", __FUNCTION__, buf.size());
   }
 
-  if (status != NFA_STATUS_OK) {
-    ALOGE("%s: write/format error=%d", __FUNCTION__, status);
-    goto TheEnd;
-  }
-
-  // Wait for write completion status
-  sWriteOk = false;
-  if (sem_wait(&sWriteSem)) {
-    ALOGE("%s: wait semaphore (errno=0x%08x)", __FUNCTION__, errno);
-    goto TheEnd;
+  // Taken before the stack takes over the message. A write after a format
+  // is not cached, so the format path needs none.
+  sAsyncOp.writeSize = buf.size();
+  sAsyncOp.writeHash = TagInfoCache::hash(buf);
+
+  if (sCheckNdefStatus == NFA_STATUS_OK && NfcTag::getInstance().getProtocol() == NFA_PROTOCOL_T2T) {
+    // Only the pages that change.
+    T2tNdefWriter writer(sT2tReader);
+    if (writer.writeNdef(buf)) {
+      finishAsyncOp(true);
+      return;
+    }
+    if (sTimedOut) {
+      finishAsyncOp(false);
+      return;
+    }
+    NFC_LOGD(TAG, "%s: differential write failed; fall back to NFA", __FUNCTION__);
   }
 
-  result = sWriteOk;
-
-TheEnd:
-  // Destroy semaphore
-  if (sem_destroy(&sWriteSem)) {
-    ALOGE("%s: failed destroy semaphore (errno=0x%08x)", __FUNCTION__, errno);
-  }
-  sWriteWaitingForComplete = false;
-  ALOGD("%s: exit; result=%d", __FUNCTION__, result);
-  free(p_data);
-  return result;
+  sT2tReader.reset();
+  writeNdefStep();
 }
 
 bool NfcTagManager::doIsNdefFormatable()
@@ -1070,53 +1592,138 @@ bool NfcTagManager::doIsNdefFormatable()
     case NFA_PROTOCOL_T2T:
         isFormattable = NfcTag::getInstance().isMifareUltralight() ? true : false;
   }
-  ALOGD("%s: is formattable=%u", __FUNCTION__, isFormattable);
+  NFC_LOGD(TAG, "%s: is formattable=%u", __FUNCTION__, isFormattable);
   return isFormattable; 
 }
 
 bool NfcTagManager::presenceCheck() 
 {
-  bool result;
-  pthread_mutex_lock(&mMutex);
-  result = doPresenceCheck();
-  pthread_mutex_unlock(&mMutex);
-  return result;
+  NFCD_TRACE_SCOPE(TRACE_TAG_PRESENCE_CHECK);
+  SyncTagCallback callback;
+  presenceCheckAsync(&callback);
+  return callback.wait();
+}
+
+void NfcTagManager::presenceCheckAsync(INfcTagCallback* callback)
+{
+  beginRfOperation();
+  startAsyncOp(TAG_OP_PRESENCE_CHECK, callback, false);
+  doStartPresenceCheck();
 }
 
 void NfcTagManager::readNdef(std::vector<uint8_t>& buf) 
 {
-  pthread_mutex_lock(&mMutex);
+  beginRfOperation();
+  bool hasContent = sCheckNdefCurrentSize > 0;
   doRead(buf);
-  pthread_mutex_unlock(&mMutex);
+  if (hasContent) {
+    TagInfoCache::getInstance().noteRead(sTagFingerprint, buf);
+  }
+  endRfOperation();
 }
 
 int NfcTagManager::checkNdefWithStatus(int ndefinfo[]) 
 {
   int status = -1;
-  pthread_mutex_lock(&mMutex);
-  status = doCheckNdef(ndefinfo);
-  pthread_mutex_unlock(&mMutex);
+  TagTechnology tech = UNKNOWN_TECH;
+  if (mConnectedTechIndex >= 0 && mConnectedTechIndex < (int)mTechList.size()) {
+    tech = mTechList[mConnectedTechIndex];
+  }
+
+  beginRfOperation();
+  TagInfoCache& cache = TagInfoCache::getInstance();
+  CachedTagInfo info;
+  TagFingerprint fingerprint;
+  getFingerprint(fingerprint);
+  if (fingerprint.uid != sTagFingerprint.uid || fingerprint.family != sTagFingerprint.family) {
+    // Another tag, possibly before disconnect() ran for the previous one:
+    // nothing read from that one applies.
+    sT2tReader.reset();
+  }
+  sTagFingerprint = fingerprint;
+  sT2tReader.setUid(fingerprint.uid);
+
+  if (NfcTag::getInstance().getActivationState() == NfcTag::Active &&
+      cache.lookup(sTagFingerprint, mTechList, mTechLibNfcTypes, tech, info)) {
+    // Seen this tag before; NFA_RwReadNDef and NFA_RwWriteNDef detect NDEF
+    // themselves when needed.
+    NFC_LOGD(TAG, "%s: cached NDEF state, status=0x%X", __FUNCTION__, info.ndefStatus);
+    NdefDetectResult result;
+    result.maxSize = info.maxSize;
+    result.currentSize = info.currentSize;
+    result.flags = info.flags;
+    applyCheckNdefResult(info.ndefStatus, result);
+    status = reportCheckNdefResult(ndefinfo);
+  } else {
+    status = doCheckNdef(ndefinfo);
+    if (sCheckNdefDetected &&
+        (sCheckNdefStatus == NFA_STATUS_OK || sCheckNdefStatus == NFA_STATUS_FAILED)) {
+      const NdefDetectResult& result = sCheckNdefCompletion.payload();
+      info.techList = mTechList;
+      info.libNfcTypes = mTechLibNfcTypes;
+      info.ndefTech = tech;
+      info.ndefType = getNdefType(getConnectedLibNfcType());
+      info.ndefStatus = sCheckNdefStatus;
+      info.maxSize = result.maxSize;
+      info.currentSize = result.currentSize;
+      info.flags = result.flags;
+      info.readOnly = sCheckNdefCardReadOnly;
+      cache.store(sTagFingerprint, info);
+    }
+  }
+  endRfOperation();
   return status;
 }
 
 bool NfcTagManager::writeNdef(NdefMessage& ndef) 
 {
-  bool result;
+  NFCD_TRACE_SCOPE(TRACE_TAG_WRITE);
+  SyncTagCallback callback;
+  writeNdefAsync(ndef, &callback);
+  return callback.wait();
+}
+
+void NfcTagManager::writeNdefAsync(NdefMessage& ndef, INfcTagCallback* callback)
+{
   std::vector<uint8_t> buf;
   ndef.toByteArray(buf);
-  pthread_mutex_lock(&mMutex);
-  result = doWrite(buf);
-  pthread_mutex_unlock(&mMutex);
-  return result;
+
+  beginRfOperation();
+  startAsyncOp(TAG_OP_WRITE_NDEF, callback, true);
+  sAsyncOp.buf.swap(buf);
+  doStartWrite();
 }
 
 bool NfcTagManager::makeReadOnly() 
 {
-  bool result;
+  NFCD_TRACE_SCOPE(TRACE_TAG_MAKE_READONLY);
+  SyncTagCallback callback;
+  makeReadOnlyAsync(&callback);
+  return callback.wait();
+}
+
+void NfcTagManager::makeReadOnlyAsync(INfcTagCallback* callback)
+{
+  beginRfOperation();
+  startAsyncOp(TAG_OP_MAKE_READ_ONLY, callback, true);
+  doStartMakeReadonly();
+}
+
+void NfcTagManager::setDeadline(int timeoutMs)
+{
   pthread_mutex_lock(&mMutex);
-  result = doMakeReadonly();
+  sTimedOut = false;
+  sHasDeadline = timeoutMs > 0;
+  if (sHasDeadline) {
+    clock_gettime(CLOCK_MONOTONIC, &sDeadline);
+    addMilliseconds(sDeadline, timeoutMs);
+  }
   pthread_mutex_unlock(&mMutex);
-  return result;
+}
+
+bool NfcTagManager::hasTimedOut()
+{
+  return sTimedOut;
 }
 
 bool NfcTagManager::isNdefFormatable()
@@ -1124,11 +1731,45 @@ bool NfcTagManager::isNdefFormatable()
   return doIsNdefFormatable();
 }
 
-bool NfcTagManager::formatNdef()
+TransceiveStatus NfcTagManager::transceive(const std::vector<uint8_t>& command,
+                                           std::vector<uint8_t>& response,
+                                           int timeoutMs)
 {
-  bool result;
-  pthread_mutex_lock(&mMutex);
-  result = doNdefFormat();
-  pthread_mutex_unlock(&mMutex);
+  beginRfOperation();
+  // A raw command may change the tag behind the cached NDEF state.
+  TagInfoCache::getInstance().invalidate(sTagFingerprint);
+  sT2tReader.reset();
+  TransceiveStatus status = doTransceive(command, response, timeoutMs);
+  endRfOperation();
+  return status;
+}
+
+bool NfcTagManager::dumpMemory(std::vector<uint8_t>& memory)
+{
+  memory.clear();
+  if (NfcTag::getInstance().getProtocol() != NFA_PROTOCOL_T2T) {
+    NFC_LOGE(TAG, "%s: only Type 2 tags are supported", __FUNCTION__);
+    return false;
+  }
+
+  beginRfOperation();
+  sT2tReader.reset();
+  bool result = sT2tReader.dumpMemory(memory);
+  endRfOperation();
   return result;
 }
+
+bool NfcTagManager::formatNdef()
+{
+  NFCD_TRACE_SCOPE(TRACE_TAG_FORMAT);
+  SyncTagCallback callback;
+  formatNdefAsync(&callback);
+  return callback.wait();
+}
+
+void NfcTagManager::formatNdefAsync(INfcTagCallback* callback)
+{
+  beginRfOperation();
+  startAsyncOp(TAG_OP_FORMAT_NDEF, callback, true);
+  doStartNdefFormat();
+}
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "INfcTag.h"
+#include "TagProbePlanner.h"
 extern "C"
 {
   #include "nfa_rw_api.h"
@@ -18,6 +19,15 @@ class NfcTagManager
   : public INfcTag
 {
 public:
+  // Default timeout of each RF operation, in milliseconds, used when the
+  // request has no deadline or a later one.
+  static const int CHECK_NDEF_TIMEOUT_MS = 2000;
+  static const int READ_TIMEOUT_MS = 5000;
+  static const int WRITE_TIMEOUT_MS = 5000;
+  static const int FORMAT_TIMEOUT_MS = 5000;
+  static const int MAKE_READONLY_TIMEOUT_MS = 3000;
+  static const int PRESENCE_CHECK_TIMEOUT_MS = 1000;
+
   NfcTagManager();
   virtual ~NfcTagManager();
 
@@ -35,6 +45,17 @@ public:
   bool makeReadOnly();
   bool isNdefFormatable();
   bool formatNdef();
+  TransceiveStatus transceive(const std::vector<uint8_t>& command,
+                              std::vector<uint8_t>& response,
+                              int timeoutMs);
+  bool dumpMemory(std::vector<uint8_t>& memory);
+  void findAndReadNdefAsync(INfcTagCallback* callback);
+  void writeNdefAsync(NdefMessage& ndef, INfcTagCallback* callback);
+  void presenceCheckAsync(INfcTagCallback* callback);
+  void makeReadOnlyAsync(INfcTagCallback* callback);
+  void formatNdefAsync(INfcTagCallback* callback);
+  void setDeadline(int timeoutMs);
+  bool hasTimedOut();
 
   std::vector<TagTechnology>& getTechList() { return mTechList; };
   std::vector<int>& getTechHandles() { return mTechHandles; };
@@ -61,12 +82,12 @@ public:
   static void doRead(std::vector<uint8_t>& buf);
 
   /**
-   * Write a NDEF message to the tag.
+   * Start writing the NDEF message of the asynchronous operation to the tag,
+   * formatting the tag first if needed.
    *
-   * @param  buf Contains a NDEF message.
-   * @return     True if ok.
+   * @return None.
    */
-  static bool doWrite(std::vector<uint8_t>& buf);
+  static void doStartWrite();
 
   /**
    * Unblock all thread synchronization objects.
@@ -93,6 +114,24 @@ public:
    */
   static void doWriteStatus(bool isWriteOk);
 
+  /**
+   * Receive the response to a raw frame. Called by NFA_DATA_EVT.
+   *
+   * @param  status Status of the operation; NFA_STATUS_CONTINUE if more of
+   *                the response follows.
+   * @param  data   Response data.
+   * @param  len    Length of the data.
+   * @return        None.
+   */
+  static void doTransceiveStatus(tNFA_STATUS status, uint8_t* data, uint32_t len);
+
+  /**
+   * The tag did not answer a raw frame. Called by NFA_RW_INTF_ERROR_EVT.
+   *
+   * @return None.
+   */
+  static void doTransceiveRfTimeout();
+
   /**
    * Receive the completion status of connect operation.
    *
@@ -159,11 +198,11 @@ public:
   static void doDeregisterNdefTypeHandler();
 
   /**
-   * Check if the tag is in the RF field.
+   * Start checking if the tag is in the RF field.
    *
    * @return None.
    */
-  static bool doPresenceCheck();
+  static void doStartPresenceCheck();
 
   /**
    * Deactivate the RF field.
@@ -182,11 +221,11 @@ public:
   static void doMakeReadonlyResult(tNFA_STATUS status);
 
   /**
-   * Make the tag read-only.
+   * Start making the tag read-only.
    *
-   * @return True if ok.
+   * @return None.
    */
-  static bool doMakeReadonly();
+  static void doStartMakeReadonly();
 
   /**
    * Receive the completion status of format operation. Called by NFA_FORMAT_CPLT_EVT.
@@ -197,15 +236,17 @@ public:
   static void formatStatus(bool isOk);
 
   /**
-   * Format a tag so it can store NDEF message.
+   * Start formatting a tag so it can store NDEF message.
    *
-   * @return True if ok.
+   * @return None.
    */
-  static bool doNdefFormat();
+  static void doStartNdefFormat();
 
   static bool doIsNdefFormatable();
 
 private:
+  friend class RawFrameTransport;
+
   pthread_mutex_t mMutex;
 
   std::vector<TagTechnology> mTechList;
@@ -249,11 +290,37 @@ private:
    */
   static bool switchRfInterface(tNFA_INTF_TYPE rfInterface);
 
+  /**
+   * Send a raw frame to the tag and wait for its response.
+   *
+   * @param  command   Frame to send.
+   * @param  response  Returns the response.
+   * @param  timeoutMs Time the tag may take to answer, 0 for the default.
+   * @return           TRANSCEIVE_OK if the tag answered.
+   */
+  static TransceiveStatus doTransceive(const std::vector<uint8_t>& command,
+                                       std::vector<uint8_t>& response,
+                                       int timeoutMs);
+
   int getNdefType(int libnfcType);
 
   void addTechnology(TagTechnology tech, int handle, int libnfctype);
 
   int getConnectedLibNfcType();
+
+  /**
+   * Connect to the technology at an index of mTechList.
+   *
+   * @param  techIndex Index in mTechList.
+   * @return           Status code, 0 on success.
+   */
+  int connectToIndex(uint32_t techIndex);
+
+  /**
+   * Fingerprint of the tag, from its UID and the poll and activation bytes
+   * of its first technology.
+   */
+  void getFingerprint(TagFingerprint& fingerprint);
 };
 
 #endif // mozilla_nfcd_NfcTagManager_h
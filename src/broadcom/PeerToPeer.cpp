@@ -13,10 +13,13 @@
 #include "config.h"
 #include "IP2pDevice.h"
 #include "NfcTagManager.h"
+#include "NfaEventTrace.h"
+#include "TraceRing.h"
 
 #undef LOG_TAG
 #define LOG_TAG "BroadcomNfc"
 #include <cutils/log.h>
+#include "NfcLog.h"
 
 using namespace android;
 
@@ -40,6 +43,7 @@ PeerToPeer::PeerToPeer()
                     | NFA_TECHNOLOGY_MASK_F
                     | NFA_TECHNOLOGY_MASK_A_ACTIVE
                     | NFA_TECHNOLOGY_MASK_F_ACTIVE)
+ , mConfiguredListenTechMask(mP2pListenTechMask)
  , mNextHandle(1)
  , mNfcManager(NULL)
 {
@@ -62,8 +66,10 @@ void PeerToPeer::initialize(NfcManager* pNfcManager)
 
   mNfcManager = pNfcManager;
 
+  // A discovery profile may have changed the mask since the last time.
   if (GetNumValue("P2P_LISTEN_TECH_MASK", &num, sizeof(num)))
-    mP2pListenTechMask = num;
+    mConfiguredListenTechMask = num;
+  mP2pListenTechMask = mConfiguredListenTechMask;
 }
 
 sp<P2pServer> PeerToPeer::findServerLocked(tNFA_HANDLE nfaP2pServerHandle)
@@ -106,13 +112,13 @@ sp<P2pServer> PeerToPeer::findServerLocked(const char *serviceName)
 bool PeerToPeer::registerServer(unsigned int handle, const char *serviceName)
 {
   static const char fn [] = "PeerToPeer::registerServer";
-  ALOGD("%s: enter; service name: %s  handle: %u", fn, serviceName, handle);
+  NFC_LOGD(P2P, "%s: enter; service name: %s  handle: %u", fn, serviceName, handle);
   sp<P2pServer>   pSrv = NULL;
 
   mMutex.lock();
   // Check if already registered.
   if ((pSrv = findServerLocked(serviceName)) != NULL) {
-    ALOGD("%s: service name=%s  already registered, handle: 0x%04x", fn, serviceName, pSrv->mNfaP2pServerHandle);
+    NFC_LOGD(P2P, "%s: service name=%s  already registered, handle: 0x%04x", fn, serviceName, pSrv->mNfaP2pServerHandle);
     // Update handle.
     pSrv->mHandle = handle;
     mMutex.unlock();
@@ -122,22 +128,22 @@ bool PeerToPeer::registerServer(unsigned int handle, const char *serviceName)
   for (int ii = 0; ii < sMax; ii++) {
     if (mServers[ii] == NULL) {
       pSrv = mServers[ii] = new P2pServer(handle, serviceName);
-      ALOGD("%s: added new p2p server  index: %d  handle: %u  name: %s", fn, ii, handle, serviceName);
+      NFC_LOGD(P2P, "%s: added new p2p server  index: %d  handle: %u  name: %s", fn, ii, handle, serviceName);
       break;
     }
   }
   mMutex.unlock();
 
   if (pSrv == NULL) {
-    ALOGE("%s: service name=%s  no free entry", fn, serviceName);
+    NFC_LOGE(P2P, "%s: service name=%s  no free entry", fn, serviceName);
     return false;
   }
 
   if (pSrv->registerWithStack()) {
-    ALOGD("%s: got new p2p server h=0x%X", fn, pSrv->mNfaP2pServerHandle);
+    NFC_LOGD(P2P, "%s: got new p2p server h=0x%X", fn, pSrv->mNfaP2pServerHandle);
     return true;
   } else {
-    ALOGE("%s: invalid server handle", fn);
+    NFC_LOGE(P2P, "%s: invalid server handle", fn);
     removeServer(handle);
     return false;
   }
@@ -151,25 +157,25 @@ void PeerToPeer::removeServer(unsigned int handle)
 
   for (int i = 0; i < sMax; i++) {
     if ((mServers[i] != NULL) && (mServers[i]->mHandle == handle) ) {
-      ALOGD("%s: server handle: %u;  nfa_handle: 0x%04x; name: %s; index=%d",
+      NFC_LOGD(P2P, "%s: server handle: %u;  nfa_handle: 0x%04x; name: %s; index=%d",
         fn, handle, mServers[i]->mNfaP2pServerHandle, mServers[i]->mServiceName.c_str(), i);
       mServers[i] = NULL;
       return;
     }
   }
-  ALOGE("%s: unknown server handle: %u", fn, handle);
+  NFC_LOGE(P2P, "%s: unknown server handle: %u", fn, handle);
 }
 
 void PeerToPeer::llcpActivatedHandler(tNFA_LLCP_ACTIVATED& activated)
 {
   static const char fn [] = "PeerToPeer::llcpActivatedHandler";
-  ALOGD("%s: enter", fn);
+  NFC_LOGD(P2P, "%s: enter", fn);
 
   IP2pDevice* pIP2pDevice = 
     reinterpret_cast<IP2pDevice*>(mNfcManager->queryInterface(INTERFACE_P2P_DEVICE));
 
   if (pIP2pDevice == NULL) {
-    ALOGE("%s : cannot get p2p device class", fn);
+    NFC_LOGE(P2P, "%s : cannot get p2p device class", fn);
     return;
   }
     
@@ -177,10 +183,10 @@ void PeerToPeer::llcpActivatedHandler(tNFA_LLCP_ACTIVATED& activated)
   NfcTagManager::doDeregisterNdefTypeHandler();
 
   if (activated.is_initiator == true) {
-    ALOGD("%s: p2p initiator", fn);
+    NFC_LOGD(P2P, "%s: p2p initiator", fn);
     pIP2pDevice->getMode() = NfcDepEndpoint::MODE_P2P_INITIATOR;
   } else {
-    ALOGD("%s: p2p target", fn);
+    NFC_LOGD(P2P, "%s: p2p target", fn);
     pIP2pDevice->getMode() = NfcDepEndpoint::MODE_P2P_TARGET;
   }
 
@@ -188,36 +194,36 @@ void PeerToPeer::llcpActivatedHandler(tNFA_LLCP_ACTIVATED& activated)
 
   mNfcManager->notifyLlcpLinkActivation(reinterpret_cast<void*>(pIP2pDevice));
 
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(P2P, "%s: exit", fn);
 }
 
 void PeerToPeer::llcpDeactivatedHandler(tNFA_LLCP_DEACTIVATED& /*deactivated*/)
 {
   static const char fn [] = "PeerToPeer::llcpDeactivatedHandler";
-  ALOGD("%s: enter", fn);
+  NFC_LOGD(P2P, "%s: enter", fn);
 
   IP2pDevice* pIP2pDevice =
     reinterpret_cast<IP2pDevice*>(mNfcManager->queryInterface(INTERFACE_P2P_DEVICE));
 
   if (pIP2pDevice == NULL) {
-    ALOGE("%s : cannot get p2p device class", fn);
+    NFC_LOGE(P2P, "%s : cannot get p2p device class", fn);
     return;
   }
 
   mNfcManager->notifyLlcpLinkDeactivated(reinterpret_cast<void*>(pIP2pDevice));
 
   NfcTagManager::doRegisterNdefTypeHandler();
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(P2P, "%s: exit", fn);
 }
 
 void PeerToPeer::llcpFirstPacketHandler()
 {
   static const char fn [] = "PeerToPeer::llcpFirstPacketHandler";
-  ALOGD("%s: enter", fn);
+  NFC_LOGD(P2P, "%s: enter", fn);
 
   mNfcManager->notifyLlcpLinkFirstPacketReceived();
 
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(P2P, "%s: exit", fn);
 }
 
 bool PeerToPeer::accept(unsigned int serverHandle, unsigned int connHandle, int maxInfoUnit, int recvWindow)
@@ -225,12 +231,12 @@ bool PeerToPeer::accept(unsigned int serverHandle, unsigned int connHandle, int
   static const char fn [] = "PeerToPeer::accept";
   sp<P2pServer> pSrv = NULL;
 
-  ALOGD("%s: enter; server handle: %u; conn handle: %u; maxInfoUnit: %d; recvWindow: %d", fn,
+  NFC_LOGD(P2P, "%s: enter; server handle: %u; conn handle: %u; maxInfoUnit: %d; recvWindow: %d", fn,
     serverHandle, connHandle, maxInfoUnit, recvWindow);
 
   mMutex.lock();
   if ((pSrv = findServerLocked(serverHandle)) == NULL) {
-    ALOGE("%s: unknown server handle: %u", fn, serverHandle);
+    NFC_LOGE(P2P, "%s: unknown server handle: %u", fn, serverHandle);
     mMutex.unlock();
     return false;
   }
@@ -242,13 +248,13 @@ bool PeerToPeer::accept(unsigned int serverHandle, unsigned int connHandle, int
 bool PeerToPeer::deregisterServer(unsigned int handle)
 {
   static const char fn [] = "PeerToPeer::deregisterServer";
-  ALOGD("%s: enter; handle: %u", fn, handle);
+  NFC_LOGD(P2P, "%s: enter; handle: %u", fn, handle);
   tNFA_STATUS     nfaStat = NFA_STATUS_FAILED;
   sp<P2pServer>   pSrv = NULL;
 
   mMutex.lock();
   if ((pSrv = findServerLocked(handle)) == NULL) {
-    ALOGE("%s: unknown service handle: %u", fn, handle);
+    NFC_LOGE(P2P, "%s: unknown service handle: %u", fn, handle);
     mMutex.unlock();
     return false;
   }
@@ -262,12 +268,12 @@ bool PeerToPeer::deregisterServer(unsigned int handle)
 
   nfaStat = NFA_P2pDeregister(pSrv->mNfaP2pServerHandle);
   if (nfaStat != NFA_STATUS_OK) {
-    ALOGE("%s: deregister error=0x%X", fn, nfaStat);
+    NFC_LOGE(P2P, "%s: deregister error=0x%X", fn, nfaStat);
   }
 
   removeServer(handle);
 
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(P2P, "%s: exit", fn);
   return true;
 }
 
@@ -275,7 +281,7 @@ bool PeerToPeer::createClient(unsigned int handle, UINT16 miu, UINT8 rw)
 {
   static const char fn [] = "PeerToPeer::createClient";
   int i = 0;
-  ALOGD("%s: enter: h: %u  miu: %u  rw: %u", fn, handle, miu, rw);
+  NFC_LOGD(P2P, "%s: enter: h: %u  miu: %u  rw: %u", fn, handle, miu, rw);
 
   mMutex.lock();
   sp<P2pClient> client = NULL;
@@ -292,11 +298,11 @@ bool PeerToPeer::createClient(unsigned int handle, UINT16 miu, UINT8 rw)
   mMutex.unlock();
 
   if (client == NULL) {
-    ALOGE("%s: fail", fn);
+    NFC_LOGE(P2P, "%s: fail", fn);
     return false;
   }
 
-  ALOGD("%s: pClient: 0x%p  assigned for client handle: %u", fn, client.get(), handle);
+  NFC_LOGD(P2P, "%s: pClient: 0x%p  assigned for client handle: %u", fn, client.get(), handle);
 
   {
     SyncEventGuard guard(mClients[i]->mRegisteringEvent);
@@ -305,10 +311,10 @@ bool PeerToPeer::createClient(unsigned int handle, UINT16 miu, UINT8 rw)
   }
 
   if (mClients[i]->mNfaP2pClientHandle != NFA_HANDLE_INVALID) {
-    ALOGD("%s: exit; new client handle: %u   NFA Handle: 0x%04x", fn, handle, client->mClientConn->mNfaConnHandle);
+    NFC_LOGD(P2P, "%s: exit; new client handle: %u   NFA Handle: 0x%04x", fn, handle, client->mClientConn->mNfaConnHandle);
     return true;
   } else {
-    ALOGE("%s: FAILED; new client handle: %u   NFA Handle: 0x%04x", fn, handle, client->mClientConn->mNfaConnHandle);
+    NFC_LOGE(P2P, "%s: FAILED; new client handle: %u   NFA Handle: 0x%04x", fn, handle, client->mClientConn->mNfaConnHandle);
     removeConn(handle);
     return false;
   }
@@ -326,7 +332,7 @@ void PeerToPeer::removeConn(unsigned int handle)
         NFA_P2pDeregister(mClients[ii]->mNfaP2pClientHandle);
 
       mClients[ii] = NULL;
-      ALOGD("%s: deleted client handle: %u  index: %u", fn, handle, ii);
+      NFC_LOGD(P2P, "%s: deleted client handle: %u  index: %u", fn, handle, ii);
       return;
     }
   }
@@ -340,36 +346,36 @@ void PeerToPeer::removeConn(unsigned int handle)
     }
   }
 
-  ALOGE("%s: could not find handle: %u", fn, handle);
+  NFC_LOGE(P2P, "%s: could not find handle: %u", fn, handle);
 }
 
 bool PeerToPeer::connectConnOriented(unsigned int handle, const char* serviceName)
 {
   static const char fn [] = "PeerToPeer::connectConnOriented";
-  ALOGD("%s: enter; h: %u  service name=%s", fn, handle, serviceName);
+  NFC_LOGD(P2P, "%s: enter; h: %u  service name=%s", fn, handle, serviceName);
   bool stat = createDataLinkConn(handle, serviceName, 0);
-  ALOGD("%s: exit; h: %u  stat: %u", fn, handle, stat);
+  NFC_LOGD(P2P, "%s: exit; h: %u  stat: %u", fn, handle, stat);
   return stat;
 }
 
 bool PeerToPeer::connectConnOriented(unsigned int handle, UINT8 destinationSap)
 {
   static const char fn [] = "PeerToPeer::connectConnOriented";
-  ALOGD("%s: enter; h: %u  dest sap: 0x%X", fn, handle, destinationSap);
+  NFC_LOGD(P2P, "%s: enter; h: %u  dest sap: 0x%X", fn, handle, destinationSap);
   bool stat = createDataLinkConn(handle, NULL, destinationSap);
-  ALOGD("%s: exit; h: %u  stat: %u", fn, handle, stat);
+  NFC_LOGD(P2P, "%s: exit; h: %u  stat: %u", fn, handle, stat);
   return stat;
 }
 
 bool PeerToPeer::createDataLinkConn(unsigned int handle, const char* serviceName, UINT8 destinationSap)
 {
   static const char fn [] = "PeerToPeer::createDataLinkConn";
-  ALOGD("%s: enter", fn);
+  NFC_LOGD(P2P, "%s: enter", fn);
   tNFA_STATUS nfaStat = NFA_STATUS_FAILED;
   sp<P2pClient>   pClient = NULL;
 
   if ((pClient = findClient(handle)) == NULL) {
-    ALOGE("%s: can't find client, handle: %u", fn, handle);
+    NFC_LOGE(P2P, "%s: can't find client, handle: %u", fn, handle);
     return false;
   }
 
@@ -386,7 +392,7 @@ bool PeerToPeer::createDataLinkConn(unsigned int handle, const char* serviceName
                   pClient->mClientConn->mMaxInfoUnit, pClient->mClientConn->mRecvWindow);
 
     if (nfaStat == NFA_STATUS_OK) {
-      ALOGD("%s: wait for connected event  mConnectingEvent: 0x%p", fn, pClient.get());
+      NFC_LOGD(P2P, "%s: wait for connected event  mConnectingEvent: 0x%p", fn, pClient.get());
       pClient->mConnectingEvent.wait();
     }
   }
@@ -400,10 +406,10 @@ bool PeerToPeer::createDataLinkConn(unsigned int handle, const char* serviceName
     }
   } else {
     removeConn(handle);
-    ALOGE("%s: fail; error=0x%X", fn, nfaStat);
+    NFC_LOGE(P2P, "%s: fail; error=0x%X", fn, nfaStat);
   }
 
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(P2P, "%s: exit", fn);
   return nfaStat == NFA_STATUS_OK;
 }
 
@@ -490,11 +496,12 @@ sp<NfaConn> PeerToPeer::findConnection(unsigned int handle)
 bool PeerToPeer::send(unsigned int handle, UINT8 *buffer, UINT16 bufferLen)
 {
   static const char fn [] = "PeerToPeer::send";
+  NFCD_TRACE_SCOPE_ARG(TRACE_P2P_SEND, bufferLen);
   tNFA_STATUS nfaStat = NFA_STATUS_FAILED;
   sp<NfaConn>     pConn =  NULL;
 
   if ((pConn = findConnection(handle)) == NULL) {
-    ALOGE("%s: can't find connection handle: %u", fn, handle);
+    NFC_LOGE(P2P, "%s: can't find connection handle: %u", fn, handle);
     return false;
   }
 
@@ -518,7 +525,7 @@ bool PeerToPeer::send(unsigned int handle, UINT8 *buffer, UINT16 bufferLen)
   if (nfaStat == NFA_STATUS_OK)
     ALOGD_IF((appl_trace_level>=BT_TRACE_LEVEL_DEBUG), "%s: exit OK; handle: %u  NFA Handle: 0x%04x", fn, handle, pConn->mNfaConnHandle);
   else
-    ALOGE("%s: Data not sent; handle: %u  NFA Handle: 0x%04x  error: 0x%04x",
+    NFC_LOGE(P2P, "%s: Data not sent; handle: %u  NFA Handle: 0x%04x  error: 0x%04x",
       fn, handle, pConn->mNfaConnHandle, nfaStat);
 
   return nfaStat == NFA_STATUS_OK;
@@ -527,6 +534,7 @@ bool PeerToPeer::send(unsigned int handle, UINT8 *buffer, UINT16 bufferLen)
 bool PeerToPeer::receive(unsigned int handle, UINT8* buffer, UINT16 bufferLen, UINT16& actualLen)
 {
   static const char fn [] = "PeerToPeer::receive";
+  NFCD_TRACE_SCOPE(TRACE_P2P_RECEIVE);
   ALOGD_IF((appl_trace_level>=BT_TRACE_LEVEL_DEBUG), "%s: enter; handle: %u  bufferLen: %u", fn, handle, bufferLen);
   sp<NfaConn> pConn = NULL;
   tNFA_STATUS stat = NFA_STATUS_FAILED;
@@ -535,7 +543,7 @@ bool PeerToPeer::receive(unsigned int handle, UINT8* buffer, UINT16 bufferLen, U
   bool retVal = false;
 
   if ((pConn = findConnection(handle)) == NULL) {
-    ALOGE("%s: can't find connection handle: %u", fn, handle);
+    NFC_LOGE(P2P, "%s: can't find connection handle: %u", fn, handle);
     return false;
   }
 
@@ -567,10 +575,10 @@ bool PeerToPeer::disconnectConnOriented(unsigned int handle)
   sp<P2pClient>   pClient = NULL;
   sp<NfaConn>     pConn = NULL;
 
-  ALOGD("%s: enter; handle: %u", fn, handle);
+  NFC_LOGD(P2P, "%s: enter; handle: %u", fn, handle);
 
   if ((pConn = findConnection(handle)) == NULL) {
-    ALOGE("%s: can't find connection handle: %u", fn, handle);
+    NFC_LOGE(P2P, "%s: can't find connection handle: %u", fn, handle);
     return false;
   }
 
@@ -591,12 +599,12 @@ bool PeerToPeer::disconnectConnOriented(unsigned int handle)
   }
 
   if (pConn->mNfaConnHandle != NFA_HANDLE_INVALID) {
-    ALOGD("%s: try disconn nfa h=0x%04X", fn, pConn->mNfaConnHandle);
+    NFC_LOGD(P2P, "%s: try disconn nfa h=0x%04X", fn, pConn->mNfaConnHandle);
     SyncEventGuard guard (pConn->mDisconnectingEvent);
     nfaStat = NFA_P2pDisconnect(pConn->mNfaConnHandle, FALSE);
 
     if (nfaStat != NFA_STATUS_OK)
-      ALOGE("%s: fail p2p disconnect", fn);
+      NFC_LOGE(P2P, "%s: fail p2p disconnect", fn);
     else
       pConn->mDisconnectingEvent.wait();
   }
@@ -605,7 +613,7 @@ bool PeerToPeer::disconnectConnOriented(unsigned int handle)
   removeConn(handle);
   mDisconnectMutex.unlock();
 
-  ALOGD("%s: exit; handle: %u", fn, handle);
+  NFC_LOGD(P2P, "%s: exit; handle: %u", fn, handle);
   return nfaStat == NFA_STATUS_OK;
 }
 
@@ -615,21 +623,21 @@ UINT16 PeerToPeer::getRemoteMaxInfoUnit(unsigned int handle)
   sp<NfaConn> pConn = NULL;
 
   if ((pConn = findConnection(handle)) == NULL) {
-    ALOGE("%s: can't find client  handle: %u", fn, handle);
+    NFC_LOGE(P2P, "%s: can't find client  handle: %u", fn, handle);
     return 0;
   }
-  ALOGD("%s: handle: %u   MIU: %u", fn, handle, pConn->mRemoteMaxInfoUnit);
+  NFC_LOGD(P2P, "%s: handle: %u   MIU: %u", fn, handle, pConn->mRemoteMaxInfoUnit);
   return pConn->mRemoteMaxInfoUnit;
 }
 
 UINT8 PeerToPeer::getRemoteRecvWindow(unsigned int handle)
 {
   static const char fn [] = "PeerToPeer::getRemoteRecvWindow";
-  ALOGD("%s: client handle: %u", fn, handle);
+  NFC_LOGD(P2P, "%s: client handle: %u", fn, handle);
   sp<NfaConn> pConn = NULL;
 
   if ((pConn = findConnection(handle)) == NULL) {
-    ALOGE("%s: can't find client", fn);
+    NFC_LOGE(P2P, "%s: can't find client", fn);
     return 0;
   }
   return pConn->mRemoteRecvWindow;
@@ -645,7 +653,7 @@ void PeerToPeer::enableP2pListening(bool isEnable)
   static const char    fn []   = "PeerToPeer::enableP2pListening";
   tNFA_STATUS          nfaStat = NFA_STATUS_FAILED;
 
-  ALOGD("%s: enter isEnable: %u  mIsP2pListening: %u", fn, isEnable, mIsP2pListening);
+  NFC_LOGD(P2P, "%s: enter isEnable: %u  mIsP2pListening: %u", fn, isEnable, mIsP2pListening);
 
   // If request to enable P2P listening, and we were not already listening.
   if ((isEnable == true) && (mIsP2pListening == false) && (mP2pListenTechMask != 0) ) {
@@ -655,7 +663,7 @@ void PeerToPeer::enableP2pListening(bool isEnable)
       mIsP2pListening = true;
     }
     else
-      ALOGE("%s: fail enable listen; error=0x%X", fn, nfaStat);
+      NFC_LOGE(P2P, "%s: fail enable listen; error=0x%X", fn, nfaStat);
   } else if ((isEnable == false) && (mIsP2pListening == true) ) {
     SyncEventGuard guard(mSetTechEvent);
     // Request to disable P2P listening, check if it was enabled.
@@ -663,16 +671,16 @@ void PeerToPeer::enableP2pListening(bool isEnable)
       mSetTechEvent.wait();
       mIsP2pListening = false;
     } else {
-      ALOGE("%s: fail disable listen; error=0x%X", fn, nfaStat);
+      NFC_LOGE(P2P, "%s: fail disable listen; error=0x%X", fn, nfaStat);
     }
   }
-  ALOGD("%s: exit; mIsP2pListening: %u", fn, mIsP2pListening);
+  NFC_LOGD(P2P, "%s: exit; mIsP2pListening: %u", fn, mIsP2pListening);
 }
 
 void PeerToPeer::handleNfcOnOff(bool isOn)
 {
   static const char fn [] = "PeerToPeer::handleNfcOnOff";
-  ALOGD("%s: enter; is on=%u", fn, isOn);
+  NFC_LOGD(P2P, "%s: enter; is on=%u", fn, isOn);
 
   mIsP2pListening = false;            // In both cases, P2P will not be listening.
 
@@ -690,14 +698,8 @@ void PeerToPeer::handleNfcOnOff(bool isOn)
           mClients[ii]->mConnectingEvent.notifyOne();
         } else {
           mClients[ii]->mClientConn->mNfaConnHandle = NFA_HANDLE_INVALID;
-          {
-            SyncEventGuard guard1(mClients[ii]->mClientConn->mCongEvent);
-            mClients[ii]->mClientConn->mCongEvent.notifyOne(); // Unblock send().
-          }
-          {
-            SyncEventGuard guard2(mClients[ii]->mClientConn->mReadEvent);
-            mClients[ii]->mClientConn->mReadEvent.notifyOne(); // Unblock receive().
-          }
+          // Unblock send() and receive(), also if about to wait.
+          mClients[ii]->mClientConn->mIoCancel.cancel();
         }
       }
     } // Loop.
@@ -710,7 +712,7 @@ void PeerToPeer::handleNfcOnOff(bool isOn)
     } // Loop.
 
   }
-  ALOGD("%s: exit", fn);
+  NFC_LOGD(P2P, "%s: exit", fn);
 }
 
 void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eventData)
@@ -720,17 +722,18 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
   sp<NfaConn>     pConn = NULL;
 
   ALOGD_IF((appl_trace_level>=BT_TRACE_LEVEL_DEBUG), "%s: enter; event=0x%X", fn, p2pEvent);
+  NfaEventTrace::getInstance().recordP2pEvent(NfaEventTrace::SOURCE_P2P_SERVER, p2pEvent, eventData);
 
   switch (p2pEvent) {
     case NFA_P2P_REG_SERVER_EVT:  // NFA_P2pRegisterServer() has started to listen.
-      ALOGD("%s: NFA_P2P_REG_SERVER_EVT; handle: 0x%04x; service sap=0x%02x  name: %s", fn,
+      NFC_LOGD(P2P, "%s: NFA_P2P_REG_SERVER_EVT; handle: 0x%04x; service sap=0x%02x  name: %s", fn,
         eventData->reg_server.server_handle, eventData->reg_server.server_sap, eventData->reg_server.service_name);
 
       sP2p.mMutex.lock();
       pSrv = sP2p.findServerLocked(eventData->reg_server.service_name);
       sP2p.mMutex.unlock();
       if (pSrv == NULL) {
-        ALOGE("%s: NFA_P2P_REG_SERVER_EVT for unknown service: %s", fn, eventData->reg_server.service_name);
+        NFC_LOGE(P2P, "%s: NFA_P2P_REG_SERVER_EVT for unknown service: %s", fn, eventData->reg_server.service_name);
       } else {
         SyncEventGuard guard(pSrv->mRegServerEvent);
         pSrv->mNfaP2pServerHandle = eventData->reg_server.server_handle;
@@ -739,69 +742,69 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
       break;
 
     case NFA_P2P_ACTIVATED_EVT: // Remote device has activated.
-      ALOGD("%s: NFA_P2P_ACTIVATED_EVT; handle: 0x%04x", fn, eventData->activated.handle);
+      NFC_LOGD(P2P, "%s: NFA_P2P_ACTIVATED_EVT; handle: 0x%04x", fn, eventData->activated.handle);
       break;
 
     case NFA_P2P_DEACTIVATED_EVT:
-      ALOGD("%s: NFA_P2P_DEACTIVATED_EVT; handle: 0x%04x", fn, eventData->activated.handle);
+      NFC_LOGD(P2P, "%s: NFA_P2P_DEACTIVATED_EVT; handle: 0x%04x", fn, eventData->activated.handle);
       break;
 
     case NFA_P2P_CONN_REQ_EVT:
-      ALOGD("%s: NFA_P2P_CONN_REQ_EVT; nfa server h=0x%04x; nfa conn h=0x%04x; remote sap=0x%02x", fn,
+      NFC_LOGD(P2P, "%s: NFA_P2P_CONN_REQ_EVT; nfa server h=0x%04x; nfa conn h=0x%04x; remote sap=0x%02x", fn,
         eventData->conn_req.server_handle, eventData->conn_req.conn_handle, eventData->conn_req.remote_sap);
 
       sP2p.mMutex.lock();
       pSrv = sP2p.findServerLocked(eventData->conn_req.server_handle);
       sP2p.mMutex.unlock();
       if (pSrv == NULL) {
-        ALOGE("%s: NFA_P2P_CONN_REQ_EVT; unknown server h", fn);
+        NFC_LOGE(P2P, "%s: NFA_P2P_CONN_REQ_EVT; unknown server h", fn);
         return;
       }
-      ALOGD("%s: NFA_P2P_CONN_REQ_EVT; server h=%u", fn, pSrv->mHandle);
+      NFC_LOGD(P2P, "%s: NFA_P2P_CONN_REQ_EVT; server h=%u", fn, pSrv->mHandle);
 
       // Look for a connection block that is waiting (handle invalid).
       if ((pConn = pSrv->findServerConnection((tNFA_HANDLE) NFA_HANDLE_INVALID)) == NULL) {
-        ALOGE("%s: NFA_P2P_CONN_REQ_EVT; server not listening", fn);
+        NFC_LOGE(P2P, "%s: NFA_P2P_CONN_REQ_EVT; server not listening", fn);
       } else {
         SyncEventGuard guard(pSrv->mConnRequestEvent);
         pConn->mNfaConnHandle = eventData->conn_req.conn_handle;
         pConn->mRemoteMaxInfoUnit = eventData->conn_req.remote_miu;
         pConn->mRemoteRecvWindow = eventData->conn_req.remote_rw;
-        ALOGD("%s: NFA_P2P_CONN_REQ_EVT; server h=%u; conn h=%u; notify conn req", fn, pSrv->mHandle, pConn->mHandle);
+        NFC_LOGD(P2P, "%s: NFA_P2P_CONN_REQ_EVT; server h=%u; conn h=%u; notify conn req", fn, pSrv->mHandle, pConn->mHandle);
         pSrv->mConnRequestEvent.notifyOne(); // Unblock accept().
       }
       break;
 
     case NFA_P2P_CONNECTED_EVT:
-      ALOGD("%s: NFA_P2P_CONNECTED_EVT; h=0x%x  remote sap=0x%X", fn,
+      NFC_LOGD(P2P, "%s: NFA_P2P_CONNECTED_EVT; h=0x%x  remote sap=0x%X", fn,
       eventData->connected.client_handle, eventData->connected.remote_sap);
       break;
 
     case NFA_P2P_DISC_EVT:
-      ALOGD("%s: NFA_P2P_DISC_EVT; h=0x%04x; reason=0x%X", fn, eventData->disc.handle, eventData->disc.reason);
+      NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; h=0x%04x; reason=0x%X", fn, eventData->disc.handle, eventData->disc.reason);
       // Look for the connection block.
       if ((pConn = sP2p.findConnection(eventData->disc.handle)) == NULL) {
-        ALOGE("%s: NFA_P2P_DISC_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->disc.handle);
+        NFC_LOGE(P2P, "%s: NFA_P2P_DISC_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->disc.handle);
       } else {
         sP2p.mDisconnectMutex.lock();
         pConn->mNfaConnHandle = NFA_HANDLE_INVALID;
         {
-          ALOGD("%s: NFA_P2P_DISC_EVT; try guard disconn event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; try guard disconn event", fn);
           SyncEventGuard guard3(pConn->mDisconnectingEvent);
           pConn->mDisconnectingEvent.notifyOne();
-          ALOGD("%s: NFA_P2P_DISC_EVT; notified disconn event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; notified disconn event", fn);
         }
         {
-          ALOGD("%s: NFA_P2P_DISC_EVT; try guard congest event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; try guard congest event", fn);
           SyncEventGuard guard1(pConn->mCongEvent);
           pConn->mCongEvent.notifyOne(); // Unblock write (if congested).
-          ALOGD("%s: NFA_P2P_DISC_EVT; notified congest event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; notified congest event", fn);
         }
         {
-          ALOGD("%s: NFA_P2P_DISC_EVT; try guard read event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; try guard read event", fn);
           SyncEventGuard guard2(pConn->mReadEvent);
           pConn->mReadEvent.notifyOne(); // Unblock receive().
-          ALOGD("%s: NFA_P2P_DISC_EVT; notified read event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; notified read event", fn);
         }
         sP2p.mDisconnectMutex.unlock();
       }
@@ -810,7 +813,7 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
     case NFA_P2P_DATA_EVT:
       // Look for the connection block.
       if ((pConn = sP2p.findConnection(eventData->data.handle)) == NULL) {
-        ALOGE("%s: NFA_P2P_DATA_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->data.handle);
+        NFC_LOGE(P2P, "%s: NFA_P2P_DATA_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->data.handle);
       } else {
         ALOGD_IF((appl_trace_level>=BT_TRACE_LEVEL_DEBUG), "%s: NFA_P2P_DATA_EVT; h=0x%X; remote sap=0x%X", fn,
                     eventData->data.handle, eventData->data.remote_sap);
@@ -822,9 +825,9 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
     case NFA_P2P_CONGEST_EVT:
       // Look for the connection block.
       if ((pConn = sP2p.findConnection(eventData->congest.handle)) == NULL) {
-        ALOGE("%s: NFA_P2P_CONGEST_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->congest.handle);
+        NFC_LOGE(P2P, "%s: NFA_P2P_CONGEST_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->congest.handle);
       } else {
-        ALOGD("%s: NFA_P2P_CONGEST_EVT; nfa handle: 0x%04x  congested: %u", fn,
+        NFC_LOGD(P2P, "%s: NFA_P2P_CONGEST_EVT; nfa handle: 0x%04x  congested: %u", fn,
           eventData->congest.handle, eventData->congest.is_congested);
         if (eventData->congest.is_congested == FALSE) {
           SyncEventGuard guard(pConn->mCongEvent);
@@ -834,7 +837,7 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
       break;
 
     default:
-      ALOGE("%s: unknown event 0x%X ????", fn, p2pEvent);
+      NFC_LOGE(P2P, "%s: unknown event 0x%X ????", fn, p2pEvent);
       break;
     }
     ALOGD_IF((appl_trace_level>=BT_TRACE_LEVEL_DEBUG), "%s: exit", fn);
@@ -847,14 +850,15 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
   sp<P2pClient>   pClient = NULL;
 
   ALOGD_IF((appl_trace_level>=BT_TRACE_LEVEL_DEBUG), "%s: enter; event=%u", fn, p2pEvent);
+  NfaEventTrace::getInstance().recordP2pEvent(NfaEventTrace::SOURCE_P2P_CLIENT, p2pEvent, eventData);
 
   switch (p2pEvent) {
     case NFA_P2P_REG_CLIENT_EVT:
       // Look for a client that is trying to register.
       if ((pClient = sP2p.findClient((tNFA_HANDLE)NFA_HANDLE_INVALID)) == NULL) {
-        ALOGE("%s: NFA_P2P_REG_CLIENT_EVT: can't find waiting client", fn);
+        NFC_LOGE(P2P, "%s: NFA_P2P_REG_CLIENT_EVT: can't find waiting client", fn);
       } else {
-        ALOGD("%s: NFA_P2P_REG_CLIENT_EVT; Conn Handle: 0x%04x, pClient: 0x%p", fn, eventData->reg_client.client_handle, pClient.get());
+        NFC_LOGD(P2P, "%s: NFA_P2P_REG_CLIENT_EVT; Conn Handle: 0x%04x, pClient: 0x%p", fn, eventData->reg_client.client_handle, pClient.get());
 
         SyncEventGuard guard(pClient->mRegisteringEvent);
         pClient->mNfaP2pClientHandle = eventData->reg_client.client_handle;
@@ -865,22 +869,22 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
     case NFA_P2P_ACTIVATED_EVT:
       // Look for a client that is trying to register.
       if ((pClient = sP2p.findClient(eventData->activated.handle)) == NULL) {
-        ALOGE("%s: NFA_P2P_ACTIVATED_EVT: can't find client", fn);
+        NFC_LOGE(P2P, "%s: NFA_P2P_ACTIVATED_EVT: can't find client", fn);
       } else {
-        ALOGD("%s: NFA_P2P_ACTIVATED_EVT; Conn Handle: 0x%04x, pClient: 0x%p", fn, eventData->activated.handle, pClient.get());
+        NFC_LOGD(P2P, "%s: NFA_P2P_ACTIVATED_EVT; Conn Handle: 0x%04x, pClient: 0x%p", fn, eventData->activated.handle, pClient.get());
       }
       break;
 
     case NFA_P2P_DEACTIVATED_EVT:
-      ALOGD("%s: NFA_P2P_DEACTIVATED_EVT: conn handle: 0x%X", fn, eventData->deactivated.handle);
+      NFC_LOGD(P2P, "%s: NFA_P2P_DEACTIVATED_EVT: conn handle: 0x%X", fn, eventData->deactivated.handle);
       break;
 
     case NFA_P2P_CONNECTED_EVT:
       // Look for the client that is trying to connect.
       if ((pClient = sP2p.findClient(eventData->connected.client_handle)) == NULL) {
-        ALOGE("%s: NFA_P2P_CONNECTED_EVT: can't find client: 0x%04x", fn, eventData->connected.client_handle);
+        NFC_LOGE(P2P, "%s: NFA_P2P_CONNECTED_EVT: can't find client: 0x%04x", fn, eventData->connected.client_handle);
       } else {
-        ALOGD("%s: NFA_P2P_CONNECTED_EVT; client_handle=0x%04x  conn_handle: 0x%04x  remote sap=0x%X  pClient: 0x%p", fn,
+        NFC_LOGD(P2P, "%s: NFA_P2P_CONNECTED_EVT; client_handle=0x%04x  conn_handle: 0x%04x  remote sap=0x%X  pClient: 0x%p", fn,
         eventData->connected.client_handle, eventData->connected.conn_handle, eventData->connected.remote_sap, pClient.get());
 
         SyncEventGuard guard(pClient->mConnectingEvent);
@@ -892,12 +896,12 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
       break;
 
     case NFA_P2P_DISC_EVT:
-      ALOGD("%s: NFA_P2P_DISC_EVT; h=0x%04x; reason=0x%X", fn, eventData->disc.handle, eventData->disc.reason);
+      NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; h=0x%04x; reason=0x%X", fn, eventData->disc.handle, eventData->disc.reason);
       // Look for the connection block.
       if ((pConn = sP2p.findConnection(eventData->disc.handle)) == NULL) {
         // If no connection, may be a client that is trying to connect.
         if ((pClient = sP2p.findClient(eventData->disc.handle)) == NULL) {
-          ALOGE("%s: NFA_P2P_DISC_EVT: can't find client for NFA handle: 0x%04x", fn, eventData->disc.handle);
+          NFC_LOGE(P2P, "%s: NFA_P2P_DISC_EVT: can't find client for NFA handle: 0x%04x", fn, eventData->disc.handle);
           return;
         }
         // Unblock createDataLinkConn().
@@ -907,22 +911,22 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
         sP2p.mDisconnectMutex.lock();
         pConn->mNfaConnHandle = NFA_HANDLE_INVALID;
         {
-          ALOGD("%s: NFA_P2P_DISC_EVT; try guard disconn event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; try guard disconn event", fn);
           SyncEventGuard guard3(pConn->mDisconnectingEvent);
           pConn->mDisconnectingEvent.notifyOne();
-          ALOGD("%s: NFA_P2P_DISC_EVT; notified disconn event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; notified disconn event", fn);
         }
         {
-          ALOGD("%s: NFA_P2P_DISC_EVT; try guard congest event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; try guard congest event", fn);
           SyncEventGuard guard1(pConn->mCongEvent);
           pConn->mCongEvent.notifyOne(); // Unblock write (if congested).
-          ALOGD("%s: NFA_P2P_DISC_EVT; notified congest event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; notified congest event", fn);
         }
         {
-          ALOGD("%s: NFA_P2P_DISC_EVT; try guard read event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; try guard read event", fn);
           SyncEventGuard guard2(pConn->mReadEvent);
           pConn->mReadEvent.notifyOne(); // Unblock receive().
-          ALOGD("%s: NFA_P2P_DISC_EVT; notified read event", fn);
+          NFC_LOGD(P2P, "%s: NFA_P2P_DISC_EVT; notified read event", fn);
         }
         sP2p.mDisconnectMutex.unlock();
       }
@@ -931,7 +935,7 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
     case NFA_P2P_DATA_EVT:
       // Look for the connection block.
       if ((pConn = sP2p.findConnection(eventData->data.handle)) == NULL) {
-        ALOGE("%s: NFA_P2P_DATA_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->data.handle);
+        NFC_LOGE(P2P, "%s: NFA_P2P_DATA_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->data.handle);
       } else {
         ALOGD_IF((appl_trace_level>=BT_TRACE_LEVEL_DEBUG), "%s: NFA_P2P_DATA_EVT; h=0x%X; remote sap=0x%X", fn,
           eventData->data.handle, eventData->data.remote_sap);
@@ -943,7 +947,7 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
     case NFA_P2P_CONGEST_EVT:
       // Look for the connection block.
       if ((pConn = sP2p.findConnection(eventData->congest.handle)) == NULL) {
-        ALOGE("%s: NFA_P2P_CONGEST_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->congest.handle);
+        NFC_LOGE(P2P, "%s: NFA_P2P_CONGEST_EVT: can't find conn for NFA handle: 0x%04x", fn, eventData->congest.handle);
       } else {
         ALOGD_IF((appl_trace_level>=BT_TRACE_LEVEL_DEBUG), "%s: NFA_P2P_CONGEST_EVT; nfa handle: 0x%04x  congested: %u", fn,
         eventData->congest.handle, eventData->congest.is_congested);
@@ -954,7 +958,7 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent, tNFA_P2P_EVT_DATA* eve
       break;
 
     default:
-      ALOGE("%s: unknown event 0x%X ????", fn, p2pEvent);
+      NFC_LOGE(P2P, "%s: unknown event 0x%X ????", fn, p2pEvent);
       break;
     }
 }
@@ -992,7 +996,7 @@ P2pServer::P2pServer(unsigned int handle, const char* serviceName)
 bool P2pServer::registerWithStack()
 {
   static const char fn [] = "P2pServer::registerWithStack";
-  ALOGD("%s: enter; service name: %s  handle: %u", fn, mServiceName.c_str(), mHandle);
+  NFC_LOGD(P2P, "%s: enter; service name: %s  handle: %u", fn, mServiceName.c_str(), mHandle);
   tNFA_STATUS     stat  = NFA_STATUS_OK;
   UINT8           serverSap = NFA_P2P_ANY_SAP;
 
@@ -1018,7 +1022,7 @@ bool P2pServer::registerWithStack()
          LLCP_DATA_LINK_TIMEOUT,
          LLCP_DELAY_TIME_TO_SEND_FIRST_PDU);
   if (stat != NFA_STATUS_OK)
-    ALOGE("%s: fail set LLCP config; error=0x%X", fn, stat);
+    NFC_LOGE(P2P, "%s: fail set LLCP config; error=0x%X", fn, stat);
 
   if (sSnepServiceName.compare(mServiceName) == 0)
     serverSap = LLCP_SAP_SNEP; // LLCP_SAP_SNEP == 4.
@@ -1028,10 +1032,10 @@ bool P2pServer::registerWithStack()
     stat = NFA_P2pRegisterServer(serverSap, NFA_P2P_DLINK_TYPE, const_cast<char*>(mServiceName.c_str()),
              PeerToPeer::nfaServerCallback);
     if (stat != NFA_STATUS_OK) {
-      ALOGE("%s: fail register p2p server; error=0x%X", fn, stat);
+      NFC_LOGE(P2P, "%s: fail register p2p server; error=0x%X", fn, stat);
       return false;
     }
-    ALOGD("%s: wait for listen-completion event", fn);
+    NFC_LOGD(P2P, "%s: wait for listen-completion event", fn);
     // Wait for NFA_P2P_REG_SERVER_EVT.
     mRegServerEvent.wait();
   }
@@ -1047,36 +1051,36 @@ bool P2pServer::accept(unsigned int serverHandle, unsigned int connHandle,
 
   sp<NfaConn> connection = allocateConnection(connHandle);
   if (connection == NULL) {
-    ALOGE("%s: failed to allocate new server connection", fn);
+    NFC_LOGE(P2P, "%s: failed to allocate new server connection", fn);
     return false;
   }
 
   {
     // Wait for NFA_P2P_CONN_REQ_EVT or NFA_NDEF_DATA_EVT when remote device requests connection.
     SyncEventGuard guard(mConnRequestEvent);
-    ALOGD("%s: serverHandle: %u; connHandle: %u; wait for incoming connection", fn,
+    NFC_LOGD(P2P, "%s: serverHandle: %u; connHandle: %u; wait for incoming connection", fn,
       serverHandle, connHandle);
     mConnRequestEvent.wait();
-    ALOGD("%s: serverHandle: %u; connHandle: %u; nfa conn h: 0x%X; got incoming connection", fn,
+    NFC_LOGD(P2P, "%s: serverHandle: %u; connHandle: %u; nfa conn h: 0x%X; got incoming connection", fn,
       serverHandle, connHandle, connection->mNfaConnHandle);
   }
 
   if (connection->mNfaConnHandle == NFA_HANDLE_INVALID) {
     removeServerConnection(connHandle);
-    ALOGD("%s: no handle assigned", fn);
+    NFC_LOGD(P2P, "%s: no handle assigned", fn);
     return false;
   }
 
-  ALOGD("%s: serverHandle: %u; connHandle: %u; nfa conn h: 0x%X; try accept", fn,
+  NFC_LOGD(P2P, "%s: serverHandle: %u; connHandle: %u; nfa conn h: 0x%X; try accept", fn,
     serverHandle, connHandle, connection->mNfaConnHandle);
   nfaStat = NFA_P2pAcceptConn(connection->mNfaConnHandle, maxInfoUnit, recvWindow);
 
   if (nfaStat != NFA_STATUS_OK) {
-    ALOGE("%s: fail to accept remote; error=0x%X", fn, nfaStat);
+    NFC_LOGE(P2P, "%s: fail to accept remote; error=0x%X", fn, nfaStat);
     return false;
   }
 
-  ALOGD("%s: exit; serverHandle: %u; connHandle: %u; nfa conn h: 0x%X", fn,
+  NFC_LOGD(P2P, "%s: exit; serverHandle: %u; connHandle: %u; nfa conn h: 0x%X", fn,
     serverHandle, connHandle, connection->mNfaConnHandle);
   return true;
 }
@@ -1087,14 +1091,8 @@ void P2pServer::unblockAll()
   for (int jj = 0; jj < MAX_NFA_CONNS_PER_SERVER; jj++) {
     if (mServerConn[jj] != NULL) {
       mServerConn[jj]->mNfaConnHandle = NFA_HANDLE_INVALID;
-      {
-        SyncEventGuard guard1(mServerConn[jj]->mCongEvent);
-        mServerConn[jj]->mCongEvent.notifyOne(); // Unblock write (if congested).
-      }
-      {
-        SyncEventGuard guard2(mServerConn[jj]->mReadEvent);
-        mServerConn[jj]->mReadEvent.notifyOne(); // Unblock receive().
-      }
+      // Unblock write (if congested) and receive(), also if about to wait.
+      mServerConn[jj]->mIoCancel.cancel();
     }
   }
 }
@@ -1177,4 +1175,6 @@ NfaConn::NfaConn()
  , mRemoteMaxInfoUnit(0)
  , mRemoteRecvWindow(0)
 {
+  mIoCancel.add(mReadEvent);
+  mIoCancel.add(mCongEvent);
 }
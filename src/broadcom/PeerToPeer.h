@@ -181,6 +181,13 @@ public:
    */
   void setP2pListenMask(tNFA_TECHNOLOGY_MASK p2pListenMask);
 
+  /**
+   * Get the p2p listen technology mask of the configuration.
+   *
+   * @return The mask set by P2P_LISTEN_TECH_MASK, or the default one.
+   */
+  tNFA_TECHNOLOGY_MASK getConfiguredP2pListenMask() const { return mConfiguredListenTechMask; }
+
   /**
    * Start/stop polling/listening to peer that supports P2P.
    *
@@ -230,6 +237,7 @@ private:
   UINT16          		mRemoteWKS;         // Peer's well known services.
   bool            		mIsP2pListening;    // If P2P listening is enabled or not.
   tNFA_TECHNOLOGY_MASK  mP2pListenTechMask; // P2P Listen mask.
+  tNFA_TECHNOLOGY_MASK  mConfiguredListenTechMask; // P2P Listen mask of the configuration.
 
   // Variable below is protected by mNewHandleMutex.
   unsigned int     mNextHandle;
@@ -285,6 +293,7 @@ public:
   SyncEvent           mReadEvent;          // Event for reading.
   SyncEvent           mCongEvent;          // Event for congestion.
   SyncEvent           mDisconnectingEvent; // Event for disconnecting.
+  CancelToken         mIoCancel;           // Cancels mReadEvent and mCongEvent.
 
   NfaConn();
 };
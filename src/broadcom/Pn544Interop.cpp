@@ -9,6 +9,8 @@
  */
 #include "Pn544Interop.h"
 
+#include <pthread.h>
+
 #include "NfcUtil.h"
 #include "IntervalTimer.h"
 #include "Mutex.h"
@@ -24,6 +26,7 @@ static const int gIntervalTime = 1000; // Millisecond between the check to resto
 static IntervalTimer gTimer;
 static Mutex gMutex;
 static void pn544InteropStartPolling(union sigval); // Callback function for interval timer.
+static void* pn544InteropStartPollingThread(void* arg);
 static bool gIsBusy = false;   // Is timer busy?
 static bool gAbortNow = false; // Stop timer during next callback.
 
@@ -41,6 +44,23 @@ void pn544InteropStopPolling()
 }
 
 void pn544InteropStartPolling(union sigval)
+{
+  // Restarting polling waits for the stack, which the timer thread must not.
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int ret = pthread_create(&thread, &attr, pn544InteropStartPollingThread, NULL);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    ALOGE("%s: fail create thread, error=%d", __FUNCTION__, ret);
+    gMutex.lock();
+    gTimer.set(gIntervalTime, pn544InteropStartPolling);
+    gMutex.unlock();
+  }
+}
+
+void* pn544InteropStartPollingThread(void* arg)
 {
   ALOGD("%s: enter", __FUNCTION__);
 
@@ -69,6 +89,7 @@ TheEnd:
   gMutex.unlock();
 
   ALOGD("%s: exit", __FUNCTION__);
+  return NULL;
 }
 
 bool pn544InteropIsBusy()
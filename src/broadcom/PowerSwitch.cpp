@@ -88,7 +88,6 @@ bool PowerSwitch::setLevel(PowerLevel newLevel)
         retval = setPowerOffSleepState(false);
       break;
     case LOW_POWER:
-    case POWER_OFF:
       if (isPowerOffSleepFeatureEnabled()) {
         retval = setPowerOffSleepState(true);
       } else if (mDesiredScreenOffPowerState == 1) { //.conf file desires full-power.
@@ -96,6 +95,15 @@ bool PowerSwitch::setLevel(PowerLevel newLevel)
         retval = true;
       }
       break;
+    case POWER_OFF:
+      // Standby powers down whatever the power-off-sleep feature is set to.
+      if (mCurrDeviceMgtPowerState == NFA_DM_PWR_MODE_OFF_SLEEP)
+        retval = true;
+      else
+        retval = setPowerOffSleepState(true);
+      if (retval)
+        mCurrLevel = POWER_OFF;
+      break;
     default:
       ALOGE("%s: not handled", __FUNCTION__);
       break;
@@ -0,0 +1,118 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * Synchronize two or more threads using a condition variable and a mutex.
+ */
+#include "SyncEvent.h"
+
+#include <string.h>
+
+#define LOG_TAG "BroadcomNfc"
+#include <cutils/log.h>
+#include "NfcLog.h"
+
+static uint32_t microsecondsSince(const struct timespec& begin)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long us = (now.tv_sec - begin.tv_sec) * 1000000LL +
+                 (now.tv_nsec - begin.tv_nsec) / 1000;
+  if (us < 0)
+    return 0;
+  return us > 0xFFFFFFFFLL ? 0xFFFFFFFF : (uint32_t) us;
+}
+
+SyncEvent::SyncEvent()
+  : mCancelled(false)
+{
+  memset(&mStats, 0, sizeof(mStats));
+}
+
+void SyncEvent::wait()
+{
+  if (mCancelled) {
+    mStats.cancelled++;
+    return;
+  }
+
+  struct timespec begin;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  mCondVar.wait(mMutex);
+  endWait(begin, false);
+}
+
+bool SyncEvent::wait(long millisec)
+{
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += millisec / 1000;
+  deadline.tv_nsec += (millisec % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+  return waitUntil(deadline);
+}
+
+bool SyncEvent::waitUntil(const struct timespec& deadline)
+{
+  if (mCancelled) {
+    mStats.cancelled++;
+    return false;
+  }
+
+  struct timespec begin;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  bool retVal = mCondVar.waitUntil(mMutex, deadline);
+  endWait(begin, !retVal);
+  return retVal && !mCancelled;
+}
+
+void SyncEvent::endWait(const struct timespec& begin, bool timedOut)
+{
+  uint32_t us = microsecondsSince(begin);
+
+  mStats.waits++;
+  if (timedOut)
+    mStats.timeouts++;
+  else if (mCancelled)
+    mStats.cancelled++;
+  mStats.lastWaitUs = us;
+  if (us > mStats.maxWaitUs)
+    mStats.maxWaitUs = us;
+  mStats.totalWaitUs += us;
+}
+
+void SyncEvent::getStats(SyncEventStats& stats)
+{
+  mMutex.lock();
+  stats = mStats;
+  mMutex.unlock();
+}
+
+void CancelToken::add(SyncEvent& event)
+{
+  if (mCount >= MAX_EVENTS) {
+    NFC_LOGE(SERVICE, "%s: too many events", __FUNCTION__);
+    return;
+  }
+  mEvents[mCount++] = &event;
+}
+
+void CancelToken::cancel()
+{
+  for (int i = 0; i < mCount; i++) {
+    SyncEventGuard guard(*mEvents[i]);
+    mEvents[i]->cancel();
+  }
+}
+
+void CancelToken::reset()
+{
+  for (int i = 0; i < mCount; i++) {
+    SyncEventGuard guard(*mEvents[i]);
+    mEvents[i]->reset();
+  }
+}
@@ -3,15 +3,35 @@
  * You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #pragma once
+#include <stdint.h>
+#include <time.h>
 #include "CondVar.h"
 #include "Mutex.h"
 
+/**
+ * Counters of a SyncEvent, to tell how long and how contended its waits are.
+ */
+struct SyncEventStats {
+  uint32_t contended;   // Times start() had to wait for the lock.
+  uint32_t waits;       // Waits that blocked.
+  uint32_t timeouts;    // Timed waits that timed out.
+  uint32_t cancelled;   // Waits that returned because of cancel().
+  uint32_t lastWaitUs;  // Duration of the last wait.
+  uint32_t maxWaitUs;   // Longest wait.
+  uint64_t totalWaitUs; // Time spent waiting.
+};
+
 /**
  * Synchronize two or more threads using a condition variable and a mutex.
+ *
+ * Once cancelled, waits return at once until the event is reset, so a
+ * thread that checks its condition just before the event is cancelled
+ * cannot block for good.
  */
 class SyncEvent
 {
 public:
+  SyncEvent();
   ~SyncEvent() {}
 
   /**
@@ -21,7 +41,10 @@ public:
    */
   void start()
   {
-    mMutex.lock();
+    if (!mMutex.tryLock()) {
+      mMutex.lock();
+      mStats.contended++;
+    }
   }
 
   /**
@@ -29,22 +52,24 @@ public:
    *
    * @return None.
    */
-  void wait()
-  {
-    mCondVar.wait(mMutex);
-  }
+  void wait();
 
   /**
    * Block the thread and wait for the event to occur.
-   * 
+   *
    * @param  millisec Timeout in milliseconds.
    * @return          True if wait is successful; false if timeout occurs.
    */
-  bool wait(long millisec)
-  {
-    bool retVal = mCondVar.wait(mMutex, millisec);
-    return retVal;
-  }
+  bool wait(long millisec);
+
+  /**
+   * Block the thread and wait for the event to occur until a deadline.
+   *
+   * @param  deadline Absolute time of CLOCK_MONOTONIC.
+   * @return          True if wait is successful; false if timeout occurs or
+   *                  the event is cancelled.
+   */
+  bool waitUntil(const struct timespec& deadline);
 
   /**
    * Notify a blocked thread that the event has occured. Unblocks it.
@@ -56,6 +81,47 @@ public:
     mCondVar.notifyOne();
   }
 
+  /**
+   * Notify all blocked threads that the event has occured. Unblocks them.
+   *
+   * @return None.
+   */
+  void notifyAll()
+  {
+    mCondVar.notifyAll();
+  }
+
+  /**
+   * Unblock all waiting threads, and the ones waiting later until reset().
+   *
+   * @return None.
+   */
+  void cancel()
+  {
+    mCancelled = true;
+    mCondVar.notifyAll();
+  }
+
+  /**
+   * Let waits block again after cancel().
+   *
+   * @return None.
+   */
+  void reset()
+  {
+    mCancelled = false;
+  }
+
+  /**
+   * Check whether the event was cancelled.
+   *
+   * @return True if cancel() was called since the last reset().
+   */
+  bool isCancelled() const
+  {
+    return mCancelled;
+  }
+
   /**
    * End a synchronization operation.
    *
@@ -66,9 +132,25 @@ public:
     mMutex.unlock();
   }
 
+  /**
+   * Get the counters of the event. Takes the lock, so must not be called
+   * within a synchronization operation of the event.
+   *
+   * @param  stats Returns the counters.
+   * @return       None.
+   */
+  void getStats(SyncEventStats& stats);
+
 private:
+  /**
+   * Account a wait that began at the given time.
+   */
+  void endWait(const struct timespec& begin, bool timedOut);
+
   CondVar mCondVar;
   Mutex mMutex;
+  bool mCancelled;
+  SyncEventStats mStats;
 };
 
 /**
@@ -102,3 +184,45 @@ public:
 private:
   SyncEvent& mEvent;
 };
+
+/**
+ * Cancel a fixed group of events at once, e.g. all the events the users of
+ * a connection may be blocked on when it goes away.
+ */
+class CancelToken
+{
+public:
+  static const int MAX_EVENTS = 4;
+
+  CancelToken()
+    : mCount(0)
+  {
+  }
+
+  /**
+   * Add an event to the group.
+   *
+   * @param  event Event cancelled with the group; must outlive the token.
+   * @return       None.
+   */
+  void add(SyncEvent& event);
+
+  /**
+   * Cancel every event of the group, each in its own synchronization
+   * operation.
+   *
+   * @return None.
+   */
+  void cancel();
+
+  /**
+   * Reset every event of the group.
+   *
+   * @return None.
+   */
+  void reset();
+
+private:
+  SyncEvent* mEvents[MAX_EVENTS];
+  int mCount;
+};
@@ -0,0 +1,151 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "T2tNdefWriter.h"
+
+#include <string.h>
+
+#undef LOG_TAG
+#define LOG_TAG "BroadcomNfc"
+#include <cutils/log.h>
+#include "NfcLog.h"
+
+static const uint8_t CMD_WRITE = 0xA2;
+static const uint8_t ACK = 0x0A;
+static const uint8_t TLV_NULL = 0x00;
+static const uint8_t TLV_TERMINATOR = 0xFE;
+static const uint32_t PAGE_SIZE = T2tReader::PAGE_SIZE;
+
+/**
+ * Store an NDEF TLV length in its 1-byte or 3-byte format.
+ */
+static void setLength(uint8_t* field, uint32_t length, uint32_t fieldSize)
+{
+  if (fieldSize == 1) {
+    field[0] = length;
+  } else {
+    field[0] = 0xFF;
+    field[1] = length >> 8;
+    field[2] = length & 0xFF;
+  }
+}
+
+static bool samePage(const std::vector<uint8_t>& image,
+                     const std::vector<uint8_t>& memory,
+                     uint32_t page)
+{
+  uint32_t offset = page * PAGE_SIZE;
+  return offset + PAGE_SIZE <= memory.size() &&
+         memcmp(&image[offset], &memory[offset], PAGE_SIZE) == 0;
+}
+
+T2tNdefWriter::T2tNdefWriter(T2tReader& reader)
+  : mReader(reader)
+  , mPagesWritten(0)
+{
+}
+
+bool T2tNdefWriter::writeNdef(const std::vector<uint8_t>& ndef)
+{
+  // The current message is the base the new one is compared against.
+  uint32_t tlvOffset, msgOffset, length;
+  if (!mReader.findNdefTlv(tlvOffset, msgOffset, length) ||
+      !mReader.ensure(msgOffset + length, false))
+    return false;
+
+  if (!mReader.mWritable) {
+    NFC_LOGD(TAG, "%s: tag is read only", __FUNCTION__);
+    return false;
+  }
+
+  uint32_t fieldSize = msgOffset - tlvOffset - 1;
+  uint32_t lengthPage = (tlvOffset + 1) / PAGE_SIZE;
+  if (fieldSize != (ndef.size() < 0xFF ? 1u : 3u) ||
+      (msgOffset - 1) / PAGE_SIZE != lengthPage) {
+    NFC_LOGD(TAG, "%s: length field changes format or spans two pages", __FUNCTION__);
+    return false;
+  }
+
+  uint32_t dataAreaEnd = mReader.mDataAreaEnd;
+  uint32_t msgEnd = msgOffset + ndef.size();
+  if (msgEnd > dataAreaEnd) {
+    NFC_LOGD(TAG, "%s: message does not fit", __FUNCTION__);
+    return false;
+  }
+
+  // The new image of the tag, ending with a Terminator TLV if there is room.
+  const std::vector<uint8_t>& memory = mReader.mMemory;
+  std::vector<uint8_t> image(memory);
+  uint32_t imageEnd = msgEnd < dataAreaEnd ? msgEnd + 1 : msgEnd;
+  uint32_t endPage = (imageEnd + PAGE_SIZE - 1) / PAGE_SIZE;
+  if (image.size() < endPage * PAGE_SIZE) {
+    image.resize(endPage * PAGE_SIZE, TLV_NULL);
+  }
+  std::copy(ndef.begin(), ndef.end(), image.begin() + msgOffset);
+  if (msgEnd < dataAreaEnd) {
+    image[msgEnd] = TLV_TERMINATOR;
+  }
+  setLength(&image[tlvOffset + 1], ndef.size(), fieldSize);
+
+  std::vector<uint32_t> dataPages;
+  for (uint32_t page = tlvOffset / PAGE_SIZE; page < endPage; page++) {
+    if (page != lengthPage && !samePage(image, memory, page)) {
+      dataPages.push_back(page);
+    }
+  }
+
+  // Empty the message while its data pages change.
+  if (!dataPages.empty() && length != 0) {
+    uint8_t cleared[PAGE_SIZE];
+    memcpy(cleared, &image[lengthPage * PAGE_SIZE], PAGE_SIZE);
+    setLength(cleared + tlvOffset + 1 - lengthPage * PAGE_SIZE, 0, fieldSize);
+    if (!writePage(lengthPage, cleared))
+      goto Fail;
+  }
+
+  for (uint32_t i = 0; i < dataPages.size(); i++) {
+    if (!writePage(dataPages[i], &image[dataPages[i] * PAGE_SIZE]))
+      goto Fail;
+  }
+
+  if (!samePage(image, mReader.mMemory, lengthPage) &&
+      !writePage(lengthPage, &image[lengthPage * PAGE_SIZE]))
+    goto Fail;
+
+  NFC_LOGD(TAG, "%s: %zu bytes; %u of %u pages written", __FUNCTION__,
+           ndef.size(), mPagesWritten, endPage - tlvOffset / PAGE_SIZE);
+  return true;
+
+Fail:
+  // Whatever the tag holds now is unknown.
+  mReader.reset();
+  return false;
+}
+
+bool T2tNdefWriter::writePage(uint32_t page, const uint8_t* data)
+{
+  std::vector<uint8_t>& memory = mReader.mMemory;
+  uint32_t offset = page * PAGE_SIZE;
+  if (offset > memory.size())
+    return false;
+
+  std::vector<uint8_t> command;
+  command.push_back(CMD_WRITE);
+  command.push_back(page);
+  command.insert(command.end(), data, data + PAGE_SIZE);
+
+  std::vector<uint8_t> response;
+  if (mReader.exchange(command, response) != TRANSCEIVE_OK ||
+      response.size() != 1 || response[0] != ACK) {
+    NFC_LOGE(TAG, "%s: write of page %u failed", __FUNCTION__, page);
+    return false;
+  }
+
+  mPagesWritten++;
+  if (offset == memory.size()) {
+    memory.resize(offset + PAGE_SIZE);
+  }
+  memcpy(&memory[offset], data, PAGE_SIZE);
+  return true;
+}
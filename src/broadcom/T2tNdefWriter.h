@@ -0,0 +1,50 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "T2tReader.h"
+
+/**
+ * Rewrites the NDEF message of a Type 2 tag page by page, writing only the
+ * pages whose content changes against the image last read by a T2tReader.
+ *
+ * A tag torn out of the field mid-write must not be left holding a valid
+ * length over half-written data. So, as in NFC Forum Type 2 Tag Operation,
+ * the NDEF length is set to 0 before any data page is written, and set to
+ * the new length last. Only rewrites that keep the length field in one page
+ * and in the same format are done here; the caller falls back to a full
+ * write for the others.
+ */
+class T2tNdefWriter
+{
+public:
+  T2tNdefWriter(T2tReader& reader);
+
+  /**
+   * Write an NDEF message over the current one.
+   *
+   * @param  ndef NDEF message to write.
+   * @return      False if the rewrite is not supported or failed. After a
+   *              failed write the image of the reader is reset.
+   */
+  bool writeNdef(const std::vector<uint8_t>& ndef);
+
+  /**
+   * @return Pages written so far.
+   */
+  uint32_t getPagesWritten() const { return mPagesWritten; }
+
+private:
+  /**
+   * Write one page, and keep the image of the reader in step.
+   */
+  bool writePage(uint32_t page, const uint8_t* data);
+
+  T2tReader& mReader;
+  uint32_t mPagesWritten;
+};
@@ -0,0 +1,342 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "T2tReader.h"
+
+#include <algorithm>
+
+#undef LOG_TAG
+#define LOG_TAG "BroadcomNfc"
+#include <cutils/log.h>
+#include "NfcLog.h"
+
+// Type 2 tag commands; see NFC Forum Type 2 Tag Operation and the NTAG21x
+// data sheet.
+static const uint8_t CMD_READ = 0x30;
+static const uint8_t CMD_FAST_READ = 0x3A;
+static const uint8_t CMD_GET_VERSION = 0x60;
+
+static const uint32_t READ_PAGES = 4;  // Pages returned by READ.
+static const uint32_t HEADER_PAGES = 4; // UID, lock bytes and capability container.
+static const uint32_t CC_OFFSET = 12;  // Capability container, page 3.
+static const uint8_t CC_NDEF_MAGIC = 0xE1;
+static const uint32_t GET_VERSION_LEN = 8;
+static const uint8_t ACK = 0x0A;
+static const uint32_t UID_LEN = 7;    // Double size UID of NXP Type 2 tags.
+
+// TLV types.
+static const uint8_t TLV_NULL = 0x00;
+static const uint8_t TLV_LOCK_CONTROL = 0x01;
+static const uint8_t TLV_MEMORY_CONTROL = 0x02;
+static const uint8_t TLV_NDEF = 0x03;
+static const uint8_t TLV_TERMINATOR = 0xFE;
+
+/**
+ * Total pages of the NXP tags that answer GET_VERSION, from its storage size
+ * byte; 0 if unknown.
+ */
+static uint32_t pagesFromVersion(const std::vector<uint8_t>& version)
+{
+  static const uint8_t VENDOR_NXP = 0x04;
+  if (version[1] != VENDOR_NXP)
+    return 0;
+
+  switch (version[6]) {
+    case 0x0B: return 20;   // Ultralight EV1, MF0UL11.
+    case 0x0E: return 41;   // Ultralight EV1, MF0UL21.
+    case 0x0F: return 45;   // NTAG213.
+    case 0x11: return 135;  // NTAG215.
+    case 0x13: return 231;  // NTAG216.
+    default:   return 0;
+  }
+}
+
+/**
+ * Whether the bytes a Lock or Memory Control TLV reserves overlap
+ * [dataStart, dataEnd). The value holds the position of the area in major
+ * and minor offsets, its size, in bits for lock bytes, and the size of a
+ * major offset.
+ */
+static bool reservesDataArea(uint8_t type, const uint8_t* value,
+                             uint32_t dataStart, uint32_t dataEnd)
+{
+  uint32_t majorOffsetSize = 1 << (value[2] & 0x0F);
+  uint32_t start = (value[0] >> 4) * majorOffsetSize + (value[0] & 0x0F);
+  uint32_t size = value[1] ? value[1] : 256;
+  if (type == TLV_LOCK_CONTROL) {
+    size = (size + 7) / 8;
+  }
+  return start < dataEnd && start + size > dataStart;
+}
+
+T2tReader::T2tReader(Transport& transport)
+  : mTransport(transport)
+  , mProbed(false)
+  , mHasFastRead(false)
+  , mNumPages(0)
+  , mDataAreaEnd(0)
+  , mWritable(false)
+  , mRoundTrips(0)
+  , mVersionKnown(false)
+  , mVersionFastRead(false)
+  , mVersionPages(0)
+{
+}
+
+void T2tReader::reset()
+{
+  mProbed = false;
+  mHasFastRead = false;
+  mNumPages = 0;
+  mDataAreaEnd = 0;
+  mWritable = false;
+  mRoundTrips = 0;
+  mMemory.clear();
+}
+
+void T2tReader::setUid(const std::vector<uint8_t>& uid)
+{
+  if (uid != mUid) {
+    reset();
+    mVersionKnown = false;
+    mUid = uid;
+  }
+}
+
+bool T2tReader::headerMatchesUid() const
+{
+  if (mUid.size() != UID_LEN)
+    return true;
+  if (mMemory.size() < 2 * PAGE_SIZE)
+    return false;
+
+  // UID0-2 and BCC0 in page 0, UID3-6 in page 1, BCC1 in page 2.
+  return std::equal(mUid.begin(), mUid.begin() + 3, mMemory.begin()) &&
+         std::equal(mUid.begin() + 3, mUid.end(), mMemory.begin() + PAGE_SIZE);
+}
+
+TransceiveStatus T2tReader::exchange(const std::vector<uint8_t>& command, std::vector<uint8_t>& response)
+{
+  mRoundTrips++;
+  TransceiveStatus status = mTransport.transceive(command, response);
+  // A 4-bit ACK or NAK comes in as a single byte.
+  if (status == TRANSCEIVE_OK && response.size() == 1 && response[0] != ACK) {
+    NFC_LOGD(TAG, "%s: NAK 0x%X to command 0x%X", __FUNCTION__, response[0], command[0]);
+    return TRANSCEIVE_FAILED;
+  }
+  return status;
+}
+
+bool T2tReader::probe()
+{
+  if (mProbed) {
+    if (headerMatchesUid())
+      return true;
+    // Read from another tag.
+    NFC_LOGD(TAG, "%s: image of another tag; read again", __FUNCTION__);
+    std::vector<uint8_t> uid;
+    uid.swap(mUid);
+    reset();
+    mVersionKnown = false;
+    mUid.swap(uid);
+  }
+
+  if (mVersionKnown) {
+    mHasFastRead = mVersionFastRead;
+    mNumPages = mVersionPages;
+  } else {
+    // Only tags with FAST_READ answer GET_VERSION; the others NAK it and
+    // fall back to IDLE, from where they must be woken up again. So it is
+    // only asked once per UID.
+    std::vector<uint8_t> command(1, CMD_GET_VERSION);
+    std::vector<uint8_t> version;
+    TransceiveStatus status = exchange(command, version);
+    if (status == TRANSCEIVE_OK && version.size() >= GET_VERSION_LEN) {
+      mHasFastRead = true;
+      mNumPages = pagesFromVersion(version);
+    } else if (status == TRANSCEIVE_TIMEOUT) {
+      // The tag was deactivated.
+      return false;
+    } else if (!mTransport.reactivate()) {
+      NFC_LOGE(TAG, "%s: cannot reactivate tag", __FUNCTION__);
+      return false;
+    }
+    // Without a UID the next tag could be another one.
+    mVersionKnown = !mUid.empty();
+    mVersionFastRead = mHasFastRead;
+    mVersionPages = mNumPages;
+  }
+
+  // The header; with FAST_READ also the start of the data area.
+  uint32_t numPages = READ_PAGES;
+  if (mHasFastRead) {
+    numPages = HEADER_PAGES + READ_AHEAD_PAGES;
+    if (mNumPages && numPages > mNumPages) {
+      numPages = mNumPages;
+    }
+  }
+  mMemory.clear();
+  if (!readPages(0, numPages))
+    return false;
+  if (!headerMatchesUid()) {
+    NFC_LOGE(TAG, "%s: header does not match the UID of the tag", __FUNCTION__);
+    mMemory.clear();
+    return false;
+  }
+
+  const uint8_t* cc = &mMemory[CC_OFFSET];
+  if (cc[0] != CC_NDEF_MAGIC) {
+    NFC_LOGD(TAG, "%s: no NDEF capability container", __FUNCTION__);
+    mDataAreaEnd = HEADER_PAGES * PAGE_SIZE;
+    mWritable = false;
+  } else {
+    mDataAreaEnd = HEADER_PAGES * PAGE_SIZE + cc[2] * 8;
+    mWritable = (cc[3] & 0x0F) == 0;  // Write access nibble.
+  }
+  // Tags that did not identify themselves are read up to their data area.
+  uint32_t dataAreaPages = (mDataAreaEnd + PAGE_SIZE - 1) / PAGE_SIZE;
+  if (mNumPages < dataAreaPages) {
+    mNumPages = dataAreaPages;
+  }
+  if (mMemory.size() > mNumPages * PAGE_SIZE) {
+    mMemory.resize(mNumPages * PAGE_SIZE);
+  }
+
+  NFC_LOGD(TAG, "%s: fast read=%d; pages=%u; data area end=%u", __FUNCTION__,
+           mHasFastRead, mNumPages, mDataAreaEnd);
+  mProbed = true;
+  return true;
+}
+
+bool T2tReader::readPages(uint32_t firstPage, uint32_t numPages)
+{
+  std::vector<uint8_t> command;
+  std::vector<uint8_t> response;
+
+  if (mHasFastRead) {
+    command.push_back(CMD_FAST_READ);
+    command.push_back(firstPage);
+    command.push_back(firstPage + numPages - 1);
+  } else {
+    // READ always returns 4 pages, wrapping around the end of the memory.
+    numPages = READ_PAGES;
+    command.push_back(CMD_READ);
+    command.push_back(firstPage);
+  }
+
+  if (exchange(command, response) != TRANSCEIVE_OK || response.size() < numPages * PAGE_SIZE) {
+    NFC_LOGE(TAG, "%s: read of page %u failed", __FUNCTION__, firstPage);
+    return false;
+  }
+
+  mMemory.resize(firstPage * PAGE_SIZE);
+  mMemory.insert(mMemory.end(), response.begin(), response.begin() + numPages * PAGE_SIZE);
+  return true;
+}
+
+bool T2tReader::ensure(uint32_t endByte, bool readAhead)
+{
+  if (endByte > mNumPages * PAGE_SIZE)
+    return false;
+
+  while (mMemory.size() < endByte) {
+    uint32_t firstPage = mMemory.size() / PAGE_SIZE;
+    uint32_t lastPage = (endByte + PAGE_SIZE - 1) / PAGE_SIZE;  // Exclusive.
+    if (readAhead && lastPage < firstPage + READ_AHEAD_PAGES) {
+      lastPage = firstPage + READ_AHEAD_PAGES;
+    }
+    if (lastPage > mNumPages) {
+      lastPage = mNumPages;
+    }
+    uint32_t numPages = lastPage - firstPage;
+    if (mHasFastRead && numPages > MAX_FAST_READ_PAGES) {
+      numPages = MAX_FAST_READ_PAGES;
+    }
+    if (!readPages(firstPage, numPages))
+      return false;
+    if (mMemory.size() > mNumPages * PAGE_SIZE) {
+      mMemory.resize(mNumPages * PAGE_SIZE);
+    }
+  }
+  return true;
+}
+
+bool T2tReader::findNdefTlv(uint32_t& tlvOffset, uint32_t& msgOffset, uint32_t& length)
+{
+  if (!probe())
+    return false;
+
+  // Walk the TLVs of the data area. NTAG and Ultralight keep their lock
+  // and configuration bytes after the data area. Other tags may reserve
+  // bytes inside it, which the NDEF message then skips; those are left to
+  // NFA_RwReadNDef and NFA_RwWriteNDef.
+  uint32_t pos = HEADER_PAGES * PAGE_SIZE;
+  while (pos < mDataAreaEnd) {
+    if (!ensure(pos + 1, true))
+      return false;
+    tlvOffset = pos;
+    uint8_t type = mMemory[pos++];
+    if (type == TLV_NULL)
+      continue;
+    if (type == TLV_TERMINATOR)
+      break;
+
+    if (!ensure(pos + 1, true))
+      return false;
+    length = mMemory[pos++];
+    if (length == 0xFF) {
+      if (!ensure(pos + 2, true))
+        return false;
+      length = (mMemory[pos] << 8) | mMemory[pos + 1];
+      pos += 2;
+    }
+    if (pos + length > mDataAreaEnd) {
+      NFC_LOGE(TAG, "%s: TLV 0x%X overruns the data area", __FUNCTION__, type);
+      return false;
+    }
+
+    if (type == TLV_NDEF) {
+      msgOffset = pos;
+      return true;
+    }
+    if ((type == TLV_LOCK_CONTROL || type == TLV_MEMORY_CONTROL) && length == 3) {
+      if (!ensure(pos + length, true))
+        return false;
+      if (reservesDataArea(type, &mMemory[pos], HEADER_PAGES * PAGE_SIZE, mDataAreaEnd)) {
+        NFC_LOGD(TAG, "%s: TLV 0x%X reserves bytes in the data area", __FUNCTION__, type);
+        return false;
+      }
+    }
+    pos += length;
+  }
+
+  NFC_LOGD(TAG, "%s: no NDEF TLV", __FUNCTION__);
+  return false;
+}
+
+bool T2tReader::readNdef(std::vector<uint8_t>& ndef)
+{
+  ndef.clear();
+  uint32_t tlvOffset, msgOffset, length;
+  if (!findNdefTlv(tlvOffset, msgOffset, length))
+    return false;
+
+  // Exactly the rest of the message, in as few commands as possible.
+  if (!ensure(msgOffset + length, false))
+    return false;
+  ndef.assign(mMemory.begin() + msgOffset, mMemory.begin() + msgOffset + length);
+  NFC_LOGD(TAG, "%s: %u bytes in %u round trips", __FUNCTION__, length, mRoundTrips);
+  return true;
+}
+
+bool T2tReader::dumpMemory(std::vector<uint8_t>& memory)
+{
+  memory.clear();
+  if (!probe() || !ensure(mNumPages * PAGE_SIZE, false))
+    return false;
+
+  memory = mMemory;
+  NFC_LOGD(TAG, "%s: %u pages in %u round trips", __FUNCTION__, mNumPages, mRoundTrips);
+  return true;
+}
@@ -0,0 +1,151 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "INfcTag.h"
+
+/**
+ * Reads the memory of a Type 2 tag (MIFARE Ultralight, NTAG) with raw
+ * commands, instead of the 4-page READ per round trip of NFA_RwReadNDef.
+ *
+ * Tags that answer GET_VERSION (NTAG21x, Ultralight EV1) are read with
+ * FAST_READ, up to MAX_FAST_READ_PAGES pages per command; others with READ,
+ * 4 pages per command. The RF link is half duplex, so commands are issued
+ * back to back from the thread holding the tag rather than overlapped. An
+ * NDEF read parses the TLVs as pages arrive and stops at the end of the
+ * NDEF message.
+ *
+ * The NDEF message is taken as contiguous, so tags whose Lock or Memory
+ * Control TLVs reserve bytes inside the data area are not read or written.
+ */
+class T2tReader
+{
+public:
+  /**
+   * Exchanges frames with the tag.
+   */
+  class Transport
+  {
+  public:
+    virtual ~Transport() {};
+
+    /**
+     * @param  command  Frame to send.
+     * @param  response Returns the response of the tag.
+     * @return          TRANSCEIVE_OK if the tag answered.
+     */
+    virtual TransceiveStatus transceive(const std::vector<uint8_t>& command,
+                                        std::vector<uint8_t>& response) = 0;
+
+    /**
+     * Bring the tag back to the ACTIVE state after it refused a command.
+     *
+     * @return True if ok.
+     */
+    virtual bool reactivate() = 0;
+  };
+
+  static const uint32_t PAGE_SIZE = 4;
+  // Pages per FAST_READ; keeps the response within a 255-byte RF frame.
+  static const uint32_t MAX_FAST_READ_PAGES = 60;
+  // Pages read ahead of what the parser needs, so that a small NDEF
+  // message comes in with the capability container.
+  static const uint32_t READ_AHEAD_PAGES = 16;
+
+  T2tReader(Transport& transport);
+
+  /**
+   * Forget what was read, e.g. when another tag comes into the field or the
+   * tag may have been changed behind the reader. Whether the tag answers
+   * GET_VERSION is kept until the UID changes.
+   */
+  void reset();
+
+  /**
+   * Set the UID of the tag in the field. The image read so far and the
+   * answer to GET_VERSION are dropped if they belong to another tag.
+   *
+   * @param  uid UID reported by the stack, empty if unknown.
+   * @return     None.
+   */
+  void setUid(const std::vector<uint8_t>& uid);
+
+  /**
+   * Read the NDEF message of the tag.
+   *
+   * @param  ndef Returns the NDEF message, empty if the tag has an empty
+   *              NDEF TLV.
+   * @return      False if the tag holds no NDEF TLV, could not be read or
+   *              reserves bytes inside the data area.
+   */
+  bool readNdef(std::vector<uint8_t>& ndef);
+
+  /**
+   * Read all pages of the tag readable without authentication: the header,
+   * the data area and, if the tag identified itself, the lock and
+   * configuration pages after it.
+   *
+   * @param  memory Returns the memory, from page 0.
+   * @return        True if ok.
+   */
+  bool dumpMemory(std::vector<uint8_t>& memory);
+
+  /**
+   * @return Commands exchanged with the tag since the last reset.
+   */
+  uint32_t getRoundTrips() const { return mRoundTrips; }
+
+private:
+  friend class T2tNdefWriter;
+
+  /**
+   * Identify the tag and read its capability container.
+   */
+  bool probe();
+
+  /**
+   * Whether the UID bytes of pages 0 to 2 of the image match mUid. Only
+   * 7-byte UIDs are laid out there; others always match.
+   */
+  bool headerMatchesUid() const;
+
+  /**
+   * Walk the TLVs of the data area to the NDEF TLV.
+   *
+   * @param  tlvOffset Returns the offset of the TLV.
+   * @param  msgOffset Returns the offset of the NDEF message.
+   * @param  length    Returns the length of the NDEF message.
+   * @return           False if there is no NDEF TLV, it could not be read or
+   *                   the tag reserves bytes inside the data area.
+   */
+  bool findNdefTlv(uint32_t& tlvOffset, uint32_t& msgOffset, uint32_t& length);
+
+  /**
+   * Make sure mMemory covers [0, endByte), reading ahead if allowed.
+   */
+  bool ensure(uint32_t endByte, bool readAhead);
+
+  bool readPages(uint32_t firstPage, uint32_t numPages);
+
+  TransceiveStatus exchange(const std::vector<uint8_t>& command, std::vector<uint8_t>& response);
+
+  Transport& mTransport;
+  bool mProbed;
+  bool mHasFastRead;
+  uint32_t mNumPages;      // Readable pages, header included.
+  uint32_t mDataAreaEnd;   // End of the NDEF data area, in bytes from page 0.
+  bool mWritable;          // Write access granted by the capability container.
+  uint32_t mRoundTrips;
+  std::vector<uint8_t> mMemory; // Pages read so far, from page 0.
+  std::vector<uint8_t> mUid;    // UID of the tag in the field.
+
+  // Answer of the tag with mUid to GET_VERSION, kept across reset().
+  bool mVersionKnown;
+  bool mVersionFastRead;
+  uint32_t mVersionPages;
+};
@@ -0,0 +1,252 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "TagInfoCache.h"
+
+extern "C"
+{
+  #include "nfa_api.h"
+  #include "nfa_rw_api.h"
+}
+
+#undef LOG_TAG
+#define LOG_TAG "BroadcomNfc"
+#include <cutils/log.h>
+#include "NfcLog.h"
+
+// First byte of a random single-size NFC-A UID (ISO/IEC 14443-3).
+static const uint8_t RANDOM_UID_PREFIX = 0x08;
+static const size_t SINGLE_SIZE_UID_LEN = 4;
+
+/**
+ * Whether nfcd added the technology once the tag was read, rather than the
+ * stack discovering it.
+ */
+static bool isNdefTechnology(TagTechnology tech)
+{
+  return tech == NDEF || tech == NDEF_WRITABLE || tech == NDEF_FORMATABLE;
+}
+
+static long long millisecondsSince(const struct timespec& ts)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)(now.tv_sec - ts.tv_sec) * 1000 +
+         (now.tv_nsec - ts.tv_nsec) / 1000000;
+}
+
+TagInfoCache::TagInfoCache()
+{
+}
+
+TagInfoCache& TagInfoCache::getInstance()
+{
+  static TagInfoCache cache;
+  return cache;
+}
+
+bool TagInfoCache::lookup(const TagFingerprint& fingerprint,
+                          const std::vector<TagTechnology>& techList,
+                          const std::vector<int>& libNfcTypes,
+                          TagTechnology ndefTech,
+                          CachedTagInfo& info)
+{
+  Key key;
+  if (!makeKey(fingerprint, key))
+    return false;
+
+  AutoMutex lock(mMutex);
+  EntryMap::iterator it = mEntries.find(key);
+  if (it == mEntries.end())
+    return false;
+
+  Entry& entry = it->second;
+  if (!sameTechnologies(entry.info.techList, entry.info.libNfcTypes, techList, libNfcTypes)) {
+    NFC_LOGD(TAG, "%s: technologies changed", __FUNCTION__);
+    erase(it);
+    return false;
+  }
+  if (entry.info.ndefTech != ndefTech)
+    return false;
+  if (!entry.info.readOnly && millisecondsSince(entry.confirmedAt) > WRITABLE_TTL_MS) {
+    NFC_LOGD(TAG, "%s: entry expired", __FUNCTION__);
+    erase(it);
+    return false;
+  }
+
+  // Most recently used; only the tag itself confirms the entry.
+  mLru.splice(mLru.end(), mLru, entry.lru);
+  info = entry.info;
+  return true;
+}
+
+void TagInfoCache::store(const TagFingerprint& fingerprint, const CachedTagInfo& info)
+{
+  Key key;
+  if (!makeKey(fingerprint, key))
+    return;
+
+  AutoMutex lock(mMutex);
+  EntryMap::iterator it = mEntries.find(key);
+  if (it == mEntries.end()) {
+    if (mEntries.size() >= MAX_ENTRIES) {
+      erase(mEntries.find(mLru.front()));
+    }
+    it = mEntries.insert(EntryMap::value_type(key, Entry())).first;
+    it->second.lru = mLru.insert(mLru.end(), key);
+  }
+
+  // Keep the content hash while the message it was taken from is unchanged.
+  Entry& entry = it->second;
+  bool keepHash = entry.info.hasContentHash &&
+                  entry.info.ndefStatus == info.ndefStatus &&
+                  entry.info.currentSize == info.currentSize;
+  uint32_t contentHash = entry.info.contentHash;
+  entry.info = info;
+  if (keepHash) {
+    entry.info.hasContentHash = true;
+    entry.info.contentHash = contentHash;
+  }
+
+  entry.info.techList.clear();
+  entry.info.libNfcTypes.clear();
+  for (uint32_t i = 0; i < info.techList.size(); i++) {
+    if (!isNdefTechnology(info.techList[i])) {
+      entry.info.techList.push_back(info.techList[i]);
+      entry.info.libNfcTypes.push_back(info.libNfcTypes[i]);
+    }
+  }
+  touch(entry);
+}
+
+void TagInfoCache::noteRead(const TagFingerprint& fingerprint, const std::vector<uint8_t>& ndef)
+{
+  Key key;
+  if (!makeKey(fingerprint, key))
+    return;
+
+  AutoMutex lock(mMutex);
+  EntryMap::iterator it = mEntries.find(key);
+  if (it == mEntries.end())
+    return;
+
+  Entry& entry = it->second;
+  uint32_t contentHash = hash(ndef);
+  if (ndef.size() != entry.info.currentSize ||
+      (entry.info.readOnly && entry.info.hasContentHash && entry.info.contentHash != contentHash)) {
+    // Not the tag we remembered, or it was rewritten.
+    NFC_LOGD(TAG, "%s: content changed", __FUNCTION__);
+    erase(it);
+    return;
+  }
+  entry.info.hasContentHash = true;
+  entry.info.contentHash = contentHash;
+  touch(entry);
+}
+
+void TagInfoCache::noteWrite(const TagFingerprint& fingerprint, uint32_t size, uint32_t contentHash)
+{
+  Key key;
+  if (!makeKey(fingerprint, key))
+    return;
+
+  AutoMutex lock(mMutex);
+  EntryMap::iterator it = mEntries.find(key);
+  if (it == mEntries.end())
+    return;
+
+  Entry& entry = it->second;
+  entry.info.ndefStatus = NFA_STATUS_OK;
+  entry.info.currentSize = size;
+  entry.info.hasContentHash = true;
+  entry.info.contentHash = contentHash;
+  touch(entry);
+}
+
+void TagInfoCache::noteReadOnly(const TagFingerprint& fingerprint)
+{
+  Key key;
+  if (!makeKey(fingerprint, key))
+    return;
+
+  AutoMutex lock(mMutex);
+  EntryMap::iterator it = mEntries.find(key);
+  if (it == mEntries.end())
+    return;
+
+  Entry& entry = it->second;
+  entry.info.readOnly = true;
+  entry.info.flags |= RW_NDEF_FL_READ_ONLY;
+  touch(entry);
+}
+
+void TagInfoCache::invalidate(const TagFingerprint& fingerprint)
+{
+  Key key;
+  if (!makeKey(fingerprint, key))
+    return;
+
+  AutoMutex lock(mMutex);
+  EntryMap::iterator it = mEntries.find(key);
+  if (it != mEntries.end()) {
+    erase(it);
+  }
+}
+
+bool TagInfoCache::makeKey(const TagFingerprint& fingerprint, Key& key)
+{
+  const std::vector<uint8_t>& uid = fingerprint.uid;
+  if (uid.empty())
+    return false;
+  // A random UID changes on every activation, so it never hits, and could
+  // match a different tag.
+  if (uid.size() == SINGLE_SIZE_UID_LEN && uid[0] == RANDOM_UID_PREFIX)
+    return false;
+
+  key.clear();
+  key.push_back(uid.size());
+  key.insert(key.end(), uid.begin(), uid.end());
+  key.insert(key.end(), fingerprint.family.begin(), fingerprint.family.end());
+  return true;
+}
+
+bool TagInfoCache::sameTechnologies(const std::vector<TagTechnology>& cachedList,
+                                    const std::vector<int>& cachedTypes,
+                                    const std::vector<TagTechnology>& techList,
+                                    const std::vector<int>& libNfcTypes)
+{
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < techList.size(); i++) {
+    TagTechnology tech = techList[i];
+    if (isNdefTechnology(tech))
+      continue;
+    if (n >= cachedList.size() || cachedList[n] != tech || cachedTypes[n] != libNfcTypes[i])
+      return false;
+    n++;
+  }
+  return n == cachedList.size();
+}
+
+uint32_t TagInfoCache::hash(const std::vector<uint8_t>& bytes)
+{
+  // 32-bit FNV-1a.
+  uint32_t h = 2166136261u;
+  for (uint32_t i = 0; i < bytes.size(); i++) {
+    h ^= bytes[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void TagInfoCache::touch(Entry& entry)
+{
+  mLru.splice(mLru.end(), mLru, entry.lru);
+  clock_gettime(CLOCK_MONOTONIC, &entry.confirmedAt);
+}
+
+void TagInfoCache::erase(EntryMap::iterator it)
+{
+  mLru.erase(it->second.lru);
+  mEntries.erase(it);
+}
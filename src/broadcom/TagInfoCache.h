@@ -0,0 +1,188 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+
+#include "Mutex.h"
+#include "TagProbePlanner.h"
+#include "TagTechnology.h"
+
+/**
+ * What is known about a tag from an earlier tap.
+ */
+struct CachedTagInfo {
+  CachedTagInfo()
+    : ndefTech(UNKNOWN_TECH)
+    , ndefType(NDEF_UNKNOWN_TYPE)
+    , ndefStatus(0)
+    , maxSize(0)
+    , currentSize(0)
+    , flags(0)
+    , readOnly(false)
+    , hasContentHash(false)
+    , contentHash(0)
+  {
+  }
+
+  // Technologies the tag was discovered with, and their protocols.
+  std::vector<TagTechnology> techList;
+  std::vector<int> libNfcTypes;
+
+  // Technology that NDEF detection ran over.
+  TagTechnology ndefTech;
+  int ndefType;
+
+  // Result of NFA_RwDetectNDef: NFA_STATUS_OK if the tag holds an NDEF
+  // message, NFA_STATUS_FAILED if it does not.
+  int ndefStatus;
+  uint32_t maxSize;
+  uint32_t currentSize;
+  uint8_t flags;    // RW_NDEF_FL_*.
+  bool readOnly;
+
+  // Hash of the NDEF message last read from or written to the tag.
+  bool hasContentHash;
+  uint32_t contentHash;
+};
+
+/**
+ * Bounded LRU cache of the NDEF detection results of recently tapped tags,
+ * keyed by UID and the poll and activation bytes, so that a repeat tap of
+ * the same tag does not need NFA_RwDetectNDef.
+ *
+ * An entry is only trusted if:
+ * 1) the tag has a fixed UID; random UIDs are never cached,
+ * 2) the tag is discovered with the same technologies and protocols, and
+ *    NDEF detection would run over the same technology,
+ * 3) the tag is read-only, or the entry was confirmed within WRITABLE_TTL_MS,
+ *    since another reader may have rewritten it.
+ * An entry is dropped as soon as the tag contradicts it: a failed operation,
+ * or a read-only tag whose content changed.
+ */
+class TagInfoCache
+{
+public:
+  // Number of remembered tags.
+  static const size_t MAX_ENTRIES = 4096;
+  // How long the state of a writable tag is trusted, in milliseconds.
+  static const long WRITABLE_TTL_MS = 5 * 60 * 1000;
+
+  /**
+   * Get a reference to the singleton TagInfoCache object.
+   *
+   * @return Reference to TagInfoCache object.
+   */
+  static TagInfoCache& getInstance();
+
+  /**
+   * Look up a tag.
+   *
+   * @param  fingerprint Fingerprint of the tag.
+   * @param  techList    Technologies of the tag.
+   * @param  libNfcTypes Protocol of each technology.
+   * @param  ndefTech    Technology NDEF detection would run over.
+   * @param  info        Returns the cached state of the tag.
+   * @return             True if there is an entry that can be trusted.
+   */
+  bool lookup(const TagFingerprint& fingerprint,
+              const std::vector<TagTechnology>& techList,
+              const std::vector<int>& libNfcTypes,
+              TagTechnology ndefTech,
+              CachedTagInfo& info);
+
+  /**
+   * Remember the result of NDEF detection on a tag.
+   *
+   * @param  fingerprint Fingerprint of the tag.
+   * @param  info        State of the tag; techList holds the technologies
+   *                     the tag was discovered with.
+   * @return             None.
+   */
+  void store(const TagFingerprint& fingerprint, const CachedTagInfo& info);
+
+  /**
+   * Note the NDEF message read from a tag. Drops the entry if the tag is
+   * read-only and the message changed.
+   *
+   * @param  fingerprint Fingerprint of the tag.
+   * @param  ndef        The NDEF message.
+   * @return             None.
+   */
+  void noteRead(const TagFingerprint& fingerprint, const std::vector<uint8_t>& ndef);
+
+  /**
+   * Note an NDEF message written to a tag that already held one.
+   *
+   * @param  fingerprint Fingerprint of the tag.
+   * @param  size        Size of the NDEF message.
+   * @param  contentHash hash() of the NDEF message, taken before the message
+   *                     was handed to the stack.
+   * @return             None.
+   */
+  void noteWrite(const TagFingerprint& fingerprint, uint32_t size, uint32_t contentHash);
+
+  /**
+   * Content hash of an NDEF message.
+   */
+  static uint32_t hash(const std::vector<uint8_t>& bytes);
+
+  /**
+   * Note that a tag was made read-only.
+   *
+   * @param  fingerprint Fingerprint of the tag.
+   * @return             None.
+   */
+  void noteReadOnly(const TagFingerprint& fingerprint);
+
+  /**
+   * Forget a tag.
+   *
+   * @param  fingerprint Fingerprint of the tag.
+   * @return             None.
+   */
+  void invalidate(const TagFingerprint& fingerprint);
+
+private:
+  typedef std::vector<uint8_t> Key;
+
+  struct Entry {
+    CachedTagInfo info;
+    struct timespec confirmedAt; // CLOCK_MONOTONIC.
+    std::list<Key>::iterator lru;
+  };
+  typedef std::map<Key, Entry> EntryMap;
+
+  TagInfoCache();
+
+  /**
+   * @return False if the tag cannot be cached.
+   */
+  static bool makeKey(const TagFingerprint& fingerprint, Key& key);
+
+  /**
+   * Whether two technology lists are the same, ignoring the NDEF
+   * technologies nfcd adds once the tag has been read.
+   */
+  static bool sameTechnologies(const std::vector<TagTechnology>& cachedList,
+                               const std::vector<int>& cachedTypes,
+                               const std::vector<TagTechnology>& techList,
+                               const std::vector<int>& libNfcTypes);
+
+  /**
+   * Mark an entry as most recently used and confirmed now.
+   */
+  void touch(Entry& entry);
+
+  void erase(EntryMap::iterator it);
+
+  Mutex mMutex;
+  EntryMap mEntries;
+  std::list<Key> mLru; // Keys of mEntries, least recently used first.
+};
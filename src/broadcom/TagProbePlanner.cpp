@@ -0,0 +1,157 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "TagProbePlanner.h"
+
+extern "C"
+{
+  #include "nfa_api.h"
+}
+
+#undef LOG_TAG
+#define LOG_TAG "BroadcomNfc"
+#include <cutils/log.h>
+#include "NfcLog.h"
+
+// Key kinds; a tag and a family with the same bytes must not collide.
+static const uint8_t KEY_UID = 'U';
+static const uint8_t KEY_FAMILY = 'F';
+
+// Rank of a technology that is not expected to expose NDEF.
+static const int RANK_UNLIKELY = 3;
+
+TagProbePlanner::TagProbePlanner()
+{
+}
+
+TagProbePlanner& TagProbePlanner::getInstance()
+{
+  static TagProbePlanner planner;
+  return planner;
+}
+
+int TagProbePlanner::rank(TagTechnology tech, int libNfcType)
+{
+  // For NFA, libNfcType is the protocol the tag was activated with. Probing
+  // through the technology that maps onto the protocol's native RF
+  // interface avoids a reselect before NFA_RwDetectNDef.
+  switch (libNfcType) {
+    case NFA_PROTOCOL_ISO_DEP:
+      // Type 4 tag: NDEF is only reachable over the ISO-DEP interface.
+      return tech == NFC_ISO_DEP ? 0 : 2;
+    case NFA_PROTOCOL_T2T:
+      return tech == MIFARE_ULTRALIGHT ? 0 : (tech == NFC_A ? 1 : RANK_UNLIKELY);
+    case NFA_PROTOCOL_T1T:
+      return tech == NFC_A ? 0 : RANK_UNLIKELY;
+    case NFA_PROTOCOL_T3T:
+      return tech == NFC_F ? 0 : RANK_UNLIKELY;
+    case NFA_PROTOCOL_ISO15693:
+      return tech == NFC_V ? 1 : RANK_UNLIKELY;
+    default:
+      return RANK_UNLIKELY;
+  }
+}
+
+void TagProbePlanner::plan(const TagFingerprint& fingerprint,
+                           const std::vector<TagTechnology>& techList,
+                           const std::vector<int>& techHandles,
+                           const std::vector<int>& libNfcTypes,
+                           std::vector<uint32_t>& order)
+{
+  order.clear();
+
+  TagTechnology winner = UNKNOWN_TECH;
+  bool hasWinner = false;
+  {
+    Key key;
+    AutoMutex lock(mMutex);
+    if (makeKey(KEY_UID, fingerprint.uid, key)) {
+      hasWinner = lookup(key, winner);
+    }
+    if (!hasWinner && makeKey(KEY_FAMILY, fingerprint.family, key)) {
+      hasWinner = lookup(key, winner);
+    }
+  }
+
+  // Stable insertion sort: the remembered winner, then by rank, then in the
+  // order the stack reported the technologies. Tech lists hold a handful of
+  // entries.
+  std::vector<uint32_t> sorted;
+  std::vector<int> ranks;
+  for (uint32_t i = 0; i < techList.size(); i++) {
+    int r = (hasWinner && techList[i] == winner) ? -1 : rank(techList[i], libNfcTypes[i]);
+    uint32_t pos = sorted.size();
+    while (pos > 0 && ranks[pos - 1] > r) {
+      pos--;
+    }
+    sorted.insert(sorted.begin() + pos, i);
+    ranks.insert(ranks.begin() + pos, r);
+  }
+
+  // Probe each handle once, through its best technology.
+  for (uint32_t i = 0; i < sorted.size(); i++) {
+    bool seen = false;
+    for (uint32_t j = 0; j < order.size(); j++) {
+      if (techHandles[order[j]] == techHandles[sorted[i]]) {
+        seen = true;
+        break;
+      }
+    }
+    if (!seen) {
+      order.push_back(sorted[i]);
+    }
+  }
+
+  NFC_LOGD(TAG, "%s: %zu of %zu technologies to probe; winner %s", __FUNCTION__,
+           order.size(), techList.size(), hasWinner ? "known" : "unknown");
+}
+
+void TagProbePlanner::remember(const TagFingerprint& fingerprint, TagTechnology tech)
+{
+  Key key;
+  AutoMutex lock(mMutex);
+  if (makeKey(KEY_UID, fingerprint.uid, key)) {
+    store(key, tech);
+  }
+  if (makeKey(KEY_FAMILY, fingerprint.family, key)) {
+    store(key, tech);
+  }
+}
+
+bool TagProbePlanner::lookup(const Key& key, TagTechnology& tech)
+{
+  std::map<Key, TagTechnology>::iterator it = mWinners.find(key);
+  if (it == mWinners.end())
+    return false;
+  tech = it->second;
+  return true;
+}
+
+void TagProbePlanner::store(const Key& key, TagTechnology tech)
+{
+  std::map<Key, TagTechnology>::iterator it = mWinners.find(key);
+  if (it != mWinners.end()) {
+    it->second = tech;
+    return;
+  }
+
+  if (mWinners.size() >= MAX_ENTRIES) {
+    mWinners.erase(mOrder.front());
+    mOrder.pop_front();
+  }
+  mWinners[key] = tech;
+  mOrder.push_back(key);
+}
+
+bool TagProbePlanner::makeKey(uint8_t kind, const std::vector<uint8_t>& bytes, Key& key)
+{
+  // Without bytes, unrelated tags would share the key.
+  if (bytes.empty())
+    return false;
+
+  key.clear();
+  key.push_back(kind);
+  key.insert(key.end(), bytes.begin(), bytes.end());
+  return true;
+}
@@ -0,0 +1,95 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+#include "Mutex.h"
+#include "TagTechnology.h"
+
+/**
+ * Identifies a tag across taps.
+ */
+struct TagFingerprint {
+  // UID of the tag.
+  std::vector<uint8_t> uid;
+  // Poll and activation bytes of the first technology, e.g. ATQA and SAK
+  // for NFC-A; shared by the tags of a family.
+  std::vector<uint8_t> family;
+};
+
+/**
+ * Plans the order in which findAndReadNdef probes the technologies of a tag
+ * for NDEF, so that a tap costs as few connects and RF interface switches
+ * as possible.
+ *
+ * Each handle is probed once, through the technology most likely to expose
+ * NDEF for its protocol. The technology that found NDEF is remembered per
+ * tag and per tag family, and probed first when such a tag is tapped again.
+ */
+class TagProbePlanner
+{
+public:
+  // Number of remembered tags and tag families.
+  static const size_t MAX_ENTRIES = 64;
+
+  /**
+   * Get a reference to the singleton TagProbePlanner object.
+   *
+   * @return Reference to TagProbePlanner object.
+   */
+  static TagProbePlanner& getInstance();
+
+  /**
+   * Order the technologies of a tag for probing.
+   *
+   * @param  fingerprint  Fingerprint of the tag.
+   * @param  techList     Technologies of the tag.
+   * @param  techHandles  Handle of each technology.
+   * @param  libNfcTypes  Protocol of each technology.
+   * @param  order        Returns the indexes of the technologies to probe, in
+   *                      order; at most one per handle.
+   * @return              None.
+   */
+  void plan(const TagFingerprint& fingerprint,
+            const std::vector<TagTechnology>& techList,
+            const std::vector<int>& techHandles,
+            const std::vector<int>& libNfcTypes,
+            std::vector<uint32_t>& order);
+
+  /**
+   * Remember the technology through which NDEF was found on a tag.
+   *
+   * @param  fingerprint Fingerprint of the tag.
+   * @param  tech        The technology.
+   * @return             None.
+   */
+  void remember(const TagFingerprint& fingerprint, TagTechnology tech);
+
+private:
+  typedef std::vector<uint8_t> Key;
+
+  TagProbePlanner();
+
+  /**
+   * How likely a technology exposes NDEF for its protocol; lower is likelier.
+   */
+  static int rank(TagTechnology tech, int libNfcType);
+
+  bool lookup(const Key& key, TagTechnology& tech);
+  void store(const Key& key, TagTechnology tech);
+
+  /**
+   * @return False if there are no bytes to key on.
+   */
+  static bool makeKey(uint8_t kind, const std::vector<uint8_t>& bytes, Key& key);
+
+  Mutex mMutex;
+  std::map<Key, TagTechnology> mWinners;
+  std::list<Key> mOrder; // Keys of mWinners, least recently stored first.
+};
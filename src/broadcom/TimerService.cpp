@@ -0,0 +1,267 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "TimerService.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#undef LOG_TAG
+#define LOG_TAG "BroadcomNfc"
+#include <cutils/log.h>
+#include "NfcLog.h"
+
+static const uint64_t TICK_NS = TimerService::TICK_MS * 1000000ULL;
+
+static uint64_t nowNs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void initList(TimerService::Entry& head)
+{
+  head.prev = &head;
+  head.next = &head;
+}
+
+static bool isEmpty(const TimerService::Entry& head)
+{
+  return head.next == &head;
+}
+
+static void link(TimerService::Entry& head, TimerService::Entry& entry)
+{
+  entry.prev = head.prev;
+  entry.next = &head;
+  head.prev->next = &entry;
+  head.prev = &entry;
+}
+
+static void unlink(TimerService::Entry& entry)
+{
+  entry.prev->next = entry.next;
+  entry.next->prev = entry.prev;
+  entry.prev = NULL;
+  entry.next = NULL;
+}
+
+// Move all entries of a list to the end of another.
+static void splice(TimerService::Entry& from, TimerService::Entry& to)
+{
+  if (isEmpty(from))
+    return;
+  from.next->prev = to.prev;
+  to.prev->next = from.next;
+  from.prev->next = &to;
+  to.prev = from.prev;
+  initList(from);
+}
+
+TimerService::TimerService()
+ : mTimerFd(-1)
+ , mBaseNs(nowNs())
+ , mCurrentTick(0)
+ , mArmedTick(0)
+ , mCount(0)
+{
+  for (int i = 0; i < L0_SIZE; i++)
+    initList(mWheel0[i]);
+  for (int i = 0; i < L1_SIZE; i++)
+    initList(mWheel1[i]);
+  for (int i = 0; i < L2_SIZE; i++)
+    initList(mWheel2[i]);
+  initList(mExpired);
+}
+
+TimerService& TimerService::getInstance()
+{
+  // Never destroyed, timers in static storage cancel against it on exit.
+  static TimerService* service = new TimerService();
+  return *service;
+}
+
+bool TimerService::schedule(Entry& entry, int ms, Callback cb, union sigval value)
+{
+  AutoMutex lock(mMutex);
+
+  if (!start())
+    return false;
+
+  if (entry.next)
+    unlink(entry);
+  else
+    mCount++;
+
+  // Rounded up, so that the timer never fires early.
+  uint64_t ns = nowNs() - mBaseNs + (uint64_t)(ms > 0 ? ms : 0) * 1000000ULL;
+  uint64_t tick = (ns + TICK_NS - 1) / TICK_NS;
+  if (tick <= mCurrentTick)
+    tick = mCurrentTick + 1;
+
+  entry.expiryTick = tick;
+  entry.cb = cb;
+  entry.value = value;
+  insert(entry);
+
+  if (!mArmedTick || tick < mArmedTick)
+    arm(tick);
+  return true;
+}
+
+void TimerService::cancel(Entry& entry)
+{
+  AutoMutex lock(mMutex);
+
+  if (!entry.next)
+    return;
+  unlink(entry);
+  mCount--;
+  // The timerfd stays armed; waking up for nothing is harmless.
+}
+
+bool TimerService::start()
+{
+  if (mTimerFd >= 0)
+    return true;
+
+  mTimerFd = timerfd_create(CLOCK_MONOTONIC, 0);
+  if (mTimerFd < 0) {
+    NFC_LOGE(SERVICE, "%s: fail create timerfd, errno=%d", __FUNCTION__, errno);
+    return false;
+  }
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int ret = pthread_create(&thread, &attr, threadFunc, this);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    NFC_LOGE(SERVICE, "%s: fail create thread, error=%d", __FUNCTION__, ret);
+    close(mTimerFd);
+    mTimerFd = -1;
+    return false;
+  }
+  return true;
+}
+
+void* TimerService::threadFunc(void* arg)
+{
+  pthread_setname_np(pthread_self(), "NFC timer");
+  static_cast<TimerService*>(arg)->run();
+  return NULL;
+}
+
+void TimerService::run()
+{
+  while (true) {
+    uint64_t expirations;
+    if (read(mTimerFd, &expirations, sizeof(expirations)) < 0 && errno != EINTR) {
+      NFC_LOGE(SERVICE, "%s: fail read timerfd, errno=%d", __FUNCTION__, errno);
+      continue;
+    }
+
+    mMutex.lock();
+    mArmedTick = 0;
+    uint64_t now = (nowNs() - mBaseNs) / TICK_NS;
+    while (mCurrentTick < now)
+      advance();
+
+    while (!isEmpty(mExpired)) {
+      Entry* entry = mExpired.next;
+      unlink(*entry);
+      mCount--;
+      Callback cb = entry->cb;
+      union sigval value = entry->value;
+
+      // The entry may be re-armed or destroyed from here on.
+      mMutex.unlock();
+      cb(value);
+      mMutex.lock();
+    }
+
+    if (mCount)
+      arm(nextTick());
+    mMutex.unlock();
+  }
+}
+
+void TimerService::insert(Entry& entry)
+{
+  uint64_t tick = entry.expiryTick;
+  uint64_t delta = tick > mCurrentTick ? tick - mCurrentTick : 0;
+
+  if (delta < (uint64_t)L0_SIZE) {
+    // Due now when cascaded on its tick.
+    if (!delta)
+      tick = mCurrentTick;
+    link(mWheel0[tick & (L0_SIZE - 1)], entry);
+  } else if (delta < (1ULL << (L0_BITS + L1_BITS))) {
+    link(mWheel1[(tick >> L0_BITS) & (L1_SIZE - 1)], entry);
+  } else {
+    // Further than the wheel reaches: parked in its last block, and
+    // re-inserted from there.
+    uint64_t range = 1ULL << (L0_BITS + L1_BITS + L2_BITS);
+    if (delta >= range)
+      tick = mCurrentTick + range - 1;
+    link(mWheel2[(tick >> (L0_BITS + L1_BITS)) & (L2_SIZE - 1)], entry);
+  }
+}
+
+void TimerService::advance()
+{
+  uint64_t tick = ++mCurrentTick;
+
+  if ((tick & (L0_SIZE - 1)) == 0) {
+    uint64_t block = tick >> L0_BITS;
+    if ((block & (L1_SIZE - 1)) == 0)
+      cascade(mWheel2[(block >> L1_BITS) & (L2_SIZE - 1)]);
+    cascade(mWheel1[block & (L1_SIZE - 1)]);
+  }
+  splice(mWheel0[tick & (L0_SIZE - 1)], mExpired);
+}
+
+void TimerService::cascade(Entry& slot)
+{
+  Entry entries;
+  initList(entries);
+  splice(slot, entries);
+
+  while (!isEmpty(entries)) {
+    Entry& entry = *entries.next;
+    unlink(entry);
+    insert(entry);
+  }
+}
+
+uint64_t TimerService::nextTick()
+{
+  uint64_t tick = mCurrentTick;
+  for (int i = 0; i < L0_SIZE; i++) {
+    tick++;
+    if ((tick & (L0_SIZE - 1)) == 0 || !isEmpty(mWheel0[tick & (L0_SIZE - 1)]))
+      break;
+  }
+  return tick;
+}
+
+void TimerService::arm(uint64_t tick)
+{
+  uint64_t ns = mBaseNs + tick * TICK_NS;
+  struct itimerspec ts;
+  memset(&ts, 0, sizeof(ts));
+  ts.it_value.tv_sec = ns / 1000000000ULL;
+  ts.it_value.tv_nsec = ns % 1000000000ULL;
+
+  // A time already past fires at once.
+  if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &ts, NULL) == -1)
+    NFC_LOGE(SERVICE, "%s: fail set timerfd, errno=%d", __FUNCTION__, errno);
+  mArmedTick = tick;
+}
@@ -0,0 +1,151 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <signal.h>
+#include <stdint.h>
+
+#include "Mutex.h"
+
+/**
+ * Runs the one-shot timers of the daemon on a single thread.
+ *
+ * Timers are kept in a hierarchical timing wheel of TICK_MS ticks, and the
+ * thread sleeps on a timerfd armed for the next tick with work, so an expiry
+ * creates no thread and no timer means no wake-up. A timer never fires
+ * before its time, and at most one tick after it as long as the callbacks
+ * before it return at once.
+ *
+ * Callbacks run one at a time on the timer thread, without the service lock
+ * held, so they may set or cancel timers. They must not block, e.g. on a
+ * SyncEvent waiting for the stack: that delays every other timer, the
+ * request deadlines included. Work that waits is handed to another thread.
+ */
+class TimerService
+{
+public:
+  typedef void (*Callback)(union sigval);
+
+  /**
+   * A timer, owned by its user and linked into the wheel while pending.
+   */
+  struct Entry {
+    Entry()
+      : prev(NULL)
+      , next(NULL)
+      , expiryTick(0)
+      , cb(NULL)
+    {
+      value.sival_ptr = NULL;
+    }
+
+    Entry* prev;
+    Entry* next;
+    uint64_t expiryTick;
+    Callback cb;
+    union sigval value;
+  };
+
+  // Resolution of the timers.
+  static const int TICK_MS = 10;
+
+  /**
+   * Get a reference to the singleton TimerService object.
+   *
+   * @return Reference to TimerService object.
+   */
+  static TimerService& getInstance();
+
+  /**
+   * Arm a timer, or re-arm it if it is pending. Starts the timer thread on
+   * first use.
+   *
+   * @param  entry Timer to arm.
+   * @param  ms    Delay in milliseconds.
+   * @param  cb    Called on the timer thread once the delay expired.
+   * @param  value Passed to the callback.
+   * @return       True if ok.
+   */
+  bool schedule(Entry& entry, int ms, Callback cb, union sigval value);
+
+  /**
+   * Disarm a timer. A callback already running is not waited for.
+   *
+   * @param  entry Timer to disarm.
+   * @return       None.
+   */
+  void cancel(Entry& entry);
+
+private:
+  // Level 0 holds the next 256 ticks one per slot, level 1 the next 64
+  // blocks of 256 ticks and level 2 the next 64 blocks of 16384 ticks.
+  // Entries move down a level when the time reaches their block.
+  static const int L0_BITS = 8;
+  static const int L1_BITS = 6;
+  static const int L2_BITS = 6;
+  static const int L0_SIZE = 1 << L0_BITS;
+  static const int L1_SIZE = 1 << L1_BITS;
+  static const int L2_SIZE = 1 << L2_BITS;
+
+  TimerService();
+
+  static void* threadFunc(void* arg);
+
+  /**
+   * Open the timerfd and start the timer thread, unless done already. Must
+   * be called with mMutex held.
+   */
+  bool start();
+
+  /**
+   * Wait for the timerfd and run the callbacks due, forever.
+   */
+  void run();
+
+  /**
+   * Put an entry in the slot of its expiry. Must be called with mMutex held.
+   */
+  void insert(Entry& entry);
+
+  /**
+   * Move to the next tick: bring the entries of the blocks it starts down a
+   * level, and queue the entries due on it for their callback. Must be
+   * called with mMutex held.
+   */
+  void advance();
+
+  /**
+   * Re-insert the entries of a level 1 or 2 slot.
+   */
+  void cascade(Entry& slot);
+
+  /**
+   * Next tick the thread has to wake up at: one with entries due, or the
+   * start of a block to cascade. Must be called with mMutex held.
+   */
+  uint64_t nextTick();
+
+  /**
+   * Arm the timerfd for a tick. Must be called with mMutex held.
+   */
+  void arm(uint64_t tick);
+
+  Mutex mMutex;
+  int mTimerFd;
+  // CLOCK_MONOTONIC time of tick 0, in nanoseconds.
+  uint64_t mBaseNs;
+  // Last tick advanced to.
+  uint64_t mCurrentTick;
+  // Tick the timerfd is armed for, 0 if none.
+  uint64_t mArmedTick;
+  // Number of pending entries.
+  uint32_t mCount;
+  // Slots are circular lists with a sentinel entry.
+  Entry mWheel0[L0_SIZE];
+  Entry mWheel1[L1_SIZE];
+  Entry mWheel2[L2_SIZE];
+  // Entries due, waiting for their callback.
+  Entry mExpired;
+};
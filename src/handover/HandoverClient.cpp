@@ -10,6 +10,7 @@
 #include "ILlcpSocket.h"
 #include "NdefMessage.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
 
 HandoverClient::HandoverClient()
  : mSocket(NULL)
@@ -26,10 +27,10 @@ HandoverClient::~HandoverClient()
 
 bool HandoverClient::connect()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(HANDOVER, "%s: enter", FUNC);
 
   if (mState != HandoverClient::DISCONNECTED) {
-    ALOGE("%s: socket already in use", FUNC);
+    NFC_LOGE(HANDOVER, "%s: socket already in use", FUNC);
     return false;
   }
   mState = HandoverClient::CONNECTING;
@@ -38,13 +39,13 @@ bool HandoverClient::connect()
 
   mSocket = pINfcManager->createLlcpSocket(0, mMiu, 1, 1024);
   if (!mSocket) {
-    ALOGE("%s: could not connect to socket", FUNC);
+    NFC_LOGE(HANDOVER, "%s: could not connect to socket", FUNC);
     mState = HandoverClient::DISCONNECTED;
     return false;
   }
 
   if (!mSocket->connectToService(mServiceName)) {
-    ALOGE("%s: could not connect to service (%s)", FUNC, mServiceName);
+    NFC_LOGE(HANDOVER, "%s: could not connect to service (%s)", FUNC, mServiceName);
     mSocket->close();
     delete mSocket;
     mSocket = NULL;
@@ -54,7 +55,7 @@ bool HandoverClient::connect()
 
   mState = HandoverClient::CONNECTED;
 
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(HANDOVER, "%s: exit", FUNC);
   return true;
 }
 
@@ -77,7 +78,7 @@ NdefMessage* HandoverClient::receive()
     std::vector<uint8_t> partial;
     int size = mSocket->receive(partial);
     if (size < 0) {
-      ALOGE("%s: connection broken", FUNC);
+      NFC_LOGE(HANDOVER, "%s: connection broken", FUNC);
       break;
     } else {
       buffer.insert(buffer.end(), partial.begin(), partial.end());
@@ -85,7 +86,7 @@ NdefMessage* HandoverClient::receive()
 
     NdefMessage* ndef = new NdefMessage();
     if(ndef->init(buffer)) {
-      ALOGD("%s: get a complete NDEF message", FUNC);
+      NFC_LOGD(HANDOVER, "%s: get a complete NDEF message", FUNC);
       return ndef;
     } else {
       delete ndef;
@@ -96,10 +97,10 @@ NdefMessage* HandoverClient::receive()
 
 bool HandoverClient::put(NdefMessage& msg)
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(HANDOVER, "%s: enter", FUNC);
 
   if (mState != HandoverClient::CONNECTED) {
-    ALOGE("%s: not connected", FUNC);
+    NFC_LOGE(HANDOVER, "%s: not connected", FUNC);
     return false;
   }
 
@@ -107,13 +108,13 @@ bool HandoverClient::put(NdefMessage& msg)
   msg.toByteArray(buf);
   mSocket->send(buf);
 
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(HANDOVER, "%s: exit", FUNC);
   return true;
 }
 
 void HandoverClient::close()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(HANDOVER, "%s: enter", FUNC);
 
   if (mSocket) {
     mSocket->close();
@@ -123,5 +124,5 @@ void HandoverClient::close()
 
   mState = HandoverClient::DISCONNECTED;
 
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(HANDOVER, "%s: exit", FUNC);
 }
@@ -8,17 +8,18 @@
 #include "IHandoverCallback.h"
 #include "NdefMessage.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
 
 // Registered LLCP Service Names.
 const char* HandoverServer::DEFAULT_SERVICE_NAME = "urn:nfc:sn:handover";
 
 void* HandoverConnectionThreadFunc(void* arg)
 {
-  ALOGD("%s: connection thread enter", FUNC);
+  NFC_LOGD(HANDOVER, "%s: connection thread enter", FUNC);
 
   HandoverConnectionThread* pConnectionThread = reinterpret_cast<HandoverConnectionThread*>(arg);
   if (!pConnectionThread) {
-    ALOGE("%s: invalid parameter", FUNC);
+    NFC_LOGE(HANDOVER, "%s: invalid parameter", FUNC);
     return NULL;
   }
 
@@ -30,7 +31,7 @@ void* HandoverConnectionThreadFunc(void* arg)
     std::vector<uint8_t> partial;
     int size = pConnectionThread->mSock->receive(partial);
     if (size < 0) {
-      ALOGE("%s: connection broken", FUNC);
+      NFC_LOGE(HANDOVER, "%s: connection broken", FUNC);
       connectionBroken = true;
       break;
     } else {
@@ -41,10 +42,10 @@ void* HandoverConnectionThreadFunc(void* arg)
     // If yes. need to notify upper layer.
     NdefMessage* ndef = new NdefMessage();
     if(ndef->init(buffer)) {
-      ALOGD("%s: get a complete NDEF message", FUNC);
+      NFC_LOGD(HANDOVER, "%s: get a complete NDEF message", FUNC);
       ICallback->onMessageReceived(ndef);
     } else {
-      ALOGD("%s: cannot get a complete NDEF message", FUNC);
+      NFC_LOGD(HANDOVER, "%s: cannot get a complete NDEF message", FUNC);
     }
   }
 
@@ -54,7 +55,7 @@ void* HandoverConnectionThreadFunc(void* arg)
   // TODO : is this correct ??
   delete pConnectionThread;
 
-  ALOGD("%s: connection thread exit", FUNC);
+  NFC_LOGD(HANDOVER, "%s: connection thread exit", FUNC);
   return NULL;
 }
 
@@ -74,7 +75,7 @@ void HandoverConnectionThread::run()
 {
   pthread_t tid;
   if(pthread_create(&tid, NULL, HandoverConnectionThreadFunc, this) != 0) {
-    ALOGE("connection pthread_create failed");
+    NFC_LOGE(HANDOVER, "connection pthread_create failed");
     abort();
   }
 }
@@ -88,7 +89,7 @@ void* handoverServerThreadFunc(void* arg)
 {
   HandoverServer* pHandoverServer = reinterpret_cast<HandoverServer*>(arg);
   if (!pHandoverServer) {
-    ALOGE("%s: invalid parameter", FUNC);
+    NFC_LOGE(HANDOVER, "%s: invalid parameter", FUNC);
     return NULL;
   }
 
@@ -96,13 +97,13 @@ void* handoverServerThreadFunc(void* arg)
   IHandoverCallback* ICallback = pHandoverServer->mCallback;
 
   if (!serverSocket) {
-    ALOGE("%s: no server socket", FUNC);
+    NFC_LOGE(HANDOVER, "%s: no server socket", FUNC);
     return NULL;
   }
 
   while(pHandoverServer->mServerRunning) {
     if (!serverSocket) {
-        ALOGE("%s: server socket shut down", FUNC);
+        NFC_LOGE(HANDOVER, "%s: server socket shut down", FUNC);
         return NULL;
     }
 
@@ -133,24 +134,24 @@ HandoverServer::~HandoverServer()
 
 void HandoverServer::start()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(HANDOVER, "%s: enter", FUNC);
 
   INfcManager* pINfcManager = NfcService::getNfcManager();
   mServerSocket = pINfcManager->createLlcpServerSocket(mServiceSap, DEFAULT_SERVICE_NAME, DEFAULT_MIU, 1, 1024);
 
   if (!mServerSocket) {
-    ALOGE("%s: cannot create llcp server socket", FUNC);
+    NFC_LOGE(HANDOVER, "%s: cannot create llcp server socket", FUNC);
   }
 
   pthread_t tid;
   if(pthread_create(&tid, NULL, handoverServerThreadFunc, this) != 0)
   {
-    ALOGE("%s: pthread_create failed", FUNC);
+    NFC_LOGE(HANDOVER, "%s: pthread_create failed", FUNC);
     abort();
   }
   mServerRunning = true;
 
-  ALOGD("%s exit", FUNC);
+  NFC_LOGD(HANDOVER, "%s exit", FUNC);
 }
 
 void HandoverServer::stop()
@@ -0,0 +1,78 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_DiscoveryPolicy_h
+#define mozilla_nfcd_DiscoveryPolicy_h
+
+#include <stdint.h>
+
+/**
+ * Screen and lock state of the platform, as reported by the client.
+ */
+typedef enum {
+  SCREEN_OFF = 0,
+  SCREEN_ON_LOCKED = 1,
+  SCREEN_ON_UNLOCKED = 2
+} ScreenState;
+
+/**
+ * How often the controller polls, depending on activity and screen state.
+ *
+ * Right after a tag or peer leaves the field, discovery polls every
+ * activePollMs. Once nothing was tapped for idleTimeoutMs, stretched when
+ * several taps came in a row, it backs off to idlePollMs. While the screen
+ * is locked it stays at idlePollMs, and while it is off it polls every
+ * screenOffPollMs for the technologies of screenOffTechMask only.
+ *
+ * A policy with activePollMs 0 leaves the poll period to the configuration
+ * (NFA_DM_DISC_DURATION_POLL).
+ */
+struct DiscoveryPolicy {
+  DiscoveryPolicy()
+    : activePollMs(0)
+    , idlePollMs(0)
+    , screenOffPollMs(0)
+    , idleTimeoutMs(0)
+    , screenOffTechMask(0)
+  {
+  }
+
+  uint32_t activePollMs;
+  uint32_t idlePollMs;
+  uint32_t screenOffPollMs;
+  uint32_t idleTimeoutMs;
+  // NfcPollTechnology flags, 0 for the technologies polled otherwise.
+  uint32_t screenOffTechMask;
+};
+
+/**
+ * What discovery polls and listens for, for a use case.
+ */
+struct DiscoveryProfile {
+  // Field value that keeps what the configuration file sets.
+  static const uint32_t CONFIGURED = 0xFFFFFFFF;
+
+  DiscoveryProfile()
+    : techMask(CONFIGURED)
+    , p2pListenMask(CONFIGURED)
+    , pollMs(CONFIGURED)
+  {
+  }
+
+  DiscoveryProfile(uint32_t techs, uint32_t p2pListenTechs, uint32_t poll)
+    : techMask(techs)
+    , p2pListenMask(p2pListenTechs)
+    , pollMs(poll)
+  {
+  }
+
+  // NfcPollTechnology flags polled for; 0 to only listen.
+  uint32_t techMask;
+  // NfcPollTechnology flags P2P listens with; 0 not to listen.
+  uint32_t p2pListenMask;
+  // Poll period used without a DiscoveryPolicy.
+  uint32_t pollMs;
+};
+
+#endif
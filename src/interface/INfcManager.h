@@ -7,6 +7,7 @@
 
 #include "ILlcpServerSocket.h"
 #include "ILlcpSocket.h"
+#include "DiscoveryPolicy.h"
 
 class INfcManager {
 public:
@@ -34,6 +35,16 @@ public:
    */
   virtual bool deinitialize() = 0;
 
+  /**
+   * Enter or leave standby. In standby the stack stays initialized and its
+   * registrations kept, discovery is stopped and the controller powered
+   * down, so that leaving it only restarts discovery.
+   *
+   * @param  enter True to enter standby, false to leave it.
+   * @return       True if ok.
+   */
+  virtual bool standby(bool enter) = 0;
+
   /**
    * Start polling and listening for devices.
    *
@@ -48,6 +59,33 @@ public:
    */
   virtual void disableDiscovery() = 0;
 
+  /**
+   * Set how the poll period follows activity and screen state.
+   *
+   * @param  policy Policy of the discovery scheduler.
+   * @return        None.
+   */
+  virtual void setDiscoveryPolicy(const DiscoveryPolicy& policy) = 0;
+
+  /**
+   * Tell the discovery scheduler the screen and lock state.
+   *
+   * @param  state Screen state of the platform.
+   * @return       None.
+   */
+  virtual void setScreenState(ScreenState state) = 0;
+
+  /**
+   * Switch what discovery polls and listens for. Discovery, if enabled, is
+   * restarted with the profile without reinitializing NFC.
+   *
+   * @param  profile Profile to switch to.
+   * @return         False if discovery is enabled and a tag or peer is
+   *                 activated, which restarting discovery would deactivate;
+   *                 the profile is not switched then.
+   */
+  virtual bool setDiscoveryProfile(const DiscoveryProfile& profile) = 0;
+
   /**
    * Check Llcp connection.
    *
@@ -6,6 +6,7 @@
 #define mozilla_nfcd_INfcTag_h
 
 #include "TagTechnology.h"
+#include "INfcTagCallback.h"
 #include <vector>
 
 #define INTERFACE_TAG_MANAGER "NfcTagManager"
@@ -13,6 +14,16 @@
 class NdefMessage;
 class NdefDetail;
 
+/**
+ * Outcome of INfcTag::transceive().
+ */
+typedef enum {
+  TRANSCEIVE_OK = 0,
+  TRANSCEIVE_FAILED,       // The command could not be sent or the exchange failed.
+  TRANSCEIVE_TIMEOUT,      // No response in time; the tag was deactivated.
+  TRANSCEIVE_TARGET_LOST   // The tag left the field or stopped answering.
+} TransceiveStatus;
+
 class INfcTag {
 public:
   virtual ~INfcTag() {};
@@ -46,6 +57,15 @@ public:
    */
   virtual NdefMessage* findAndReadNdef() = 0;
 
+  /**
+   * Read the NDEF message over the technology findAndReadNdef() connected,
+   * without probing the others or changing the technology list.
+   *
+   * @param  buf Returns the NDEF message, empty if none could be read.
+   * @return     None.
+   */
+  virtual void readNdef(std::vector<uint8_t>& buf) = 0;
+
   /**
    * Read tag information and fill the NdefDetail structure.
    *
@@ -82,6 +102,59 @@ public:
    */
   virtual bool formatNdef() = 0;
 
+  /**
+   * Send a raw command to the tag over the connected technology and wait
+   * for its response, e.g. an ISO-DEP APDU or an NFC-A command.
+   *
+   * @param  command   Command to send.
+   * @param  response  Returns the response of the tag.
+   * @param  timeoutMs Time the tag may take to answer, 0 for the default.
+   * @return           TRANSCEIVE_OK if the tag answered.
+   */
+  virtual TransceiveStatus transceive(const std::vector<uint8_t>& command,
+                                      std::vector<uint8_t>& response,
+                                      int timeoutMs) = 0;
+
+  /**
+   * Read the raw memory of the tag, as far as it is readable without
+   * authentication. Only Type 2 tags are supported.
+   *
+   * @param  memory Returns the memory, from its first page.
+   * @return        True if ok.
+   */
+  virtual bool dumpMemory(std::vector<uint8_t>& memory) = 0;
+
+  /**
+   * Asynchronous variants of the operations above. Each returns once the
+   * operation is handed to the controller, waiting only for an operation
+   * already in progress, and reports its result through the callback.
+   *
+   * @param  callback Receives the result; must outlive the operation.
+   * @return          None.
+   */
+  virtual void findAndReadNdefAsync(INfcTagCallback* callback) = 0;
+  virtual void writeNdefAsync(NdefMessage& ndef, INfcTagCallback* callback) = 0;
+  virtual void presenceCheckAsync(INfcTagCallback* callback) = 0;
+  virtual void makeReadOnlyAsync(INfcTagCallback* callback) = 0;
+  virtual void formatNdefAsync(INfcTagCallback* callback) = 0;
+
+  /**
+   * Bound the RF operations that follow. Each operation waits at most until
+   * the deadline, or its own default timeout if that is sooner; an operation
+   * that runs out of time is aborted and the tag deactivated.
+   *
+   * @param  timeoutMs Time from now to the deadline, 0 for none.
+   * @return           None.
+   */
+  virtual void setDeadline(int timeoutMs) = 0;
+
+  /**
+   * Whether an operation timed out since the last setDeadline().
+   *
+   * @return True if an operation timed out.
+   */
+  virtual bool hasTimedOut() = 0;
+
   virtual std::vector<TagTechnology>& getTechList() = 0;
   virtual std::vector<int>& getTechHandles() = 0;
   virtual std::vector<int>& getTechLibNfcTypes() = 0;
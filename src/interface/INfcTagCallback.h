@@ -0,0 +1,40 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_nfcd_INfcTagCallback_h
+#define mozilla_nfcd_INfcTagCallback_h
+
+class NdefMessage;
+
+/**
+ * Asynchronous INfcTag operations.
+ */
+typedef enum {
+  TAG_OP_READ_NDEF = 0,
+  TAG_OP_WRITE_NDEF,
+  TAG_OP_PRESENCE_CHECK,
+  TAG_OP_MAKE_READ_ONLY,
+  TAG_OP_FORMAT_NDEF
+} TagOperation;
+
+class INfcTagCallback {
+public:
+  /**
+   * An asynchronous tag operation completed. Called exactly once per
+   * operation, on the thread that completed it; the tag is free for the
+   * next operation by then.
+   *
+   * @param  op   The operation.
+   * @param  isOk True if the operation succeeded. For TAG_OP_PRESENCE_CHECK,
+   *              whether the tag is still in the RF field.
+   * @param  ndef For TAG_OP_READ_NDEF, the NDEF message read, owned by the
+   *              callee; NULL otherwise.
+   * @return      None.
+   */
+  virtual void onTagOperationComplete(TagOperation op, bool isOk, NdefMessage* ndef) = 0;
+
+  virtual ~INfcTagCallback() {};
+};
+
+#endif
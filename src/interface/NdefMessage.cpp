@@ -24,6 +24,8 @@ bool NdefMessage::init(std::vector<uint8_t>& buf)
  */
 void NdefMessage::toByteArray(std::vector<uint8_t>& buf)
 {
+  buf.reserve(buf.size() + getByteLength());
+
   int recordSize = mRecords.size();
   for (int i = 0; i < recordSize; i++) {
     bool mb = (i == 0);  // first record
@@ -33,6 +35,15 @@ void NdefMessage::toByteArray(std::vector<uint8_t>& buf)
   return;
 }
 
+size_t NdefMessage::getByteLength() const
+{
+  size_t length = 0;
+  for (uint32_t i = 0; i < mRecords.size(); i++) {
+    length += mRecords[i].getByteLength();
+  }
+  return length;
+}
+
 NdefDetail::NdefDetail()
 {
 }
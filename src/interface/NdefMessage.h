@@ -15,8 +15,16 @@ public:
 
   bool init(std::vector<uint8_t>& buf, int offset);
   bool init(std::vector<uint8_t>& buf);
+  /**
+   * Append the encoded message to buf, growing it once.
+   */
   void toByteArray(std::vector<uint8_t>& buf);
 
+  /**
+   * @return Bytes toByteArray() appends for this message.
+   */
+  size_t getByteLength() const;
+
   std::vector<NdefRecord> mRecords;
 };
 
@@ -7,25 +7,17 @@
 NdefRecord::NdefRecord(uint8_t tnf, std::vector<uint8_t>& type, std::vector<uint8_t>& id, std::vector<uint8_t>& payload)
 {
   mTnf = tnf;
-
-  for(uint32_t i = 0; i < type.size(); i++)
-    mType.push_back(type[i]);
-  for(uint32_t i = 0; i < id.size(); i++)
-    mId.push_back(id[i]);
-  for(uint32_t i = 0; i < payload.size(); i++)
-    mPayload.push_back(payload[i]);
+  mType = type;
+  mId = id;
+  mPayload = payload;
 }
 
 NdefRecord::NdefRecord(uint8_t tnf, uint32_t typeLength, uint8_t* type, uint32_t idLength, uint8_t* id, uint32_t payloadLength, uint8_t* payload)
 {
   mTnf = tnf;
-
-  for (uint32_t i = 0; i < typeLength; i++)
-    mType.push_back((uint8_t)type[i]);
-  for (uint32_t i = 0; i < idLength; i++)
-    mId.push_back((uint8_t)id[i]);
-  for (uint32_t i = 0; i < payloadLength; i++)
-    mPayload.push_back((uint8_t)payload[i]);
+  mType.assign(type, type + typeLength);
+  mId.assign(id, id + idLength);
+  mPayload.assign(payload, payload + payloadLength);
 }
 
 NdefRecord::~NdefRecord()
@@ -98,21 +90,18 @@ bool NdefRecord::parse(std::vector<uint8_t>& buf, bool ignoreMbMe, std::vector<N
     }
 
     if (!inChunk) {
-      for (uint32_t idx = 0; idx < typeLength; idx++) {
-        type.push_back(buf[index++]);
-      }
-      for (uint32_t idx = 0; idx < idLength; idx++) {
-        id.push_back(buf[index++]);
-      }
+      type.assign(buf.begin() + index, buf.begin() + index + typeLength);
+      index += typeLength;
+      id.assign(buf.begin() + index, buf.begin() + index + idLength);
+      index += idLength;
     }
 
     if (!ensureSanePayloadSize(payloadLength)) {
       return false;
     }
 
-    for (uint32_t idx = 0; idx < payloadLength; idx++) {
-      payload.push_back(buf[index++]);
-    }
+    payload.assign(buf.begin() + index, buf.begin() + index + payloadLength);
+    index += payloadLength;
 
     if (cf && !inChunk) {
       // first chunk
@@ -134,9 +123,7 @@ bool NdefRecord::parse(std::vector<uint8_t>& buf, bool ignoreMbMe, std::vector<N
       }
 
       for(uint32_t i = 0; i < chunks.size(); i++) {
-        for(uint32_t j = 0; j < chunks[i].size(); j++) {
-          payload.push_back(chunks[i][j]);
-        }
+        payload.insert(payload.end(), chunks[i].begin(), chunks[i].end());
       }
       tnf = chunkTnf;
     }
@@ -153,8 +140,12 @@ bool NdefRecord::parse(std::vector<uint8_t>& buf, bool ignoreMbMe, std::vector<N
       return false;
     }
 
-    NdefRecord record(tnf, type, id, payload);
-    records.push_back(record);
+    // The parsed fields move into the record rather than being copied.
+    records.push_back(NdefRecord(tnf, 0, NULL, 0, NULL, 0, NULL));
+    NdefRecord& record = records.back();
+    record.mType.swap(type);
+    record.mId.swap(id);
+    record.mPayload.swap(payload);
 
     if (ignoreMbMe) {  // for parsing a single NdefRecord
       break;
@@ -231,10 +222,17 @@ void NdefRecord::writeToByteBuffer(std::vector<uint8_t>& buf, bool mb, bool me)
     buf.push_back((uint8_t)mId.size());
   }
 
-  for (uint32_t i = 0; i < mType.size(); i++)
-    buf.push_back(mType[i]);
-  for (uint32_t i = 0; i < mId.size(); i++)
-    buf.push_back(mId[i]);
-  for (uint32_t i = 0; i < mPayload.size(); i++)
-    buf.push_back(mPayload[i]);
+  buf.insert(buf.end(), mType.begin(), mType.end());
+  buf.insert(buf.end(), mId.begin(), mId.end());
+  buf.insert(buf.end(), mPayload.begin(), mPayload.end());
+}
+
+size_t NdefRecord::getByteLength() const
+{
+  bool sr = mPayload.size() < 256;
+  bool il = mId.size() > 0;
+
+  // Flags, type length, payload length, ID length.
+  size_t length = 2 + (sr ? 1 : 4) + (il ? 1 : 0);
+  return length + mType.size() + mId.size() + mPayload.size();
 }
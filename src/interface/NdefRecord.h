@@ -5,6 +5,7 @@
 #ifndef mozilla_nfcd_NdefRecord_h
 #define mozilla_nfcd_NdefRecord_h
 
+#include <stddef.h>
 #include <vector>
 
 class NdefRecord {
@@ -31,6 +32,11 @@ public:
   
   void writeToByteBuffer(std::vector<uint8_t>& buf, bool mb, bool me);
 
+  /**
+   * @return Bytes writeToByteBuffer() appends for this record.
+   */
+  size_t getByteLength() const;
+
   uint8_t mFlags;
   uint8_t mTnf;
   std::vector<uint8_t> mType;
@@ -3,14 +3,33 @@
  * You can obtain one at http://mozilla.org/MPL/2.0/. */
 #include "nfcd.h"
 
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "NfcManager.h"
 #include "NfcService.h"
 #include "NfcIpcSocket.h"
 #include "DeviceHost.h"
 #include "MessageHandler.h"
 #include "SnepServer.h"
+#include "NfcLog.h"
+#include "StartupTiming.h"
+#include "TapBenchmark.h"
+#include "TapLatency.h"
+#include "TraceRing.h"
+
+int main(int argc, char** argv) {
+
+  StartupTiming::Instance()->mark(StartupTiming::PHASE_PROCESS_START);
+
+  NfcLog::initialize();
 
-int main() {
+  // Created before any thread can mark a stage.
+  TapLatency::Instance()->initialize();
+
+  // "kill -USR2 <pid>" writes the hot-path trace rings as Chrome trace JSON.
+  TraceRing::installDumpSignal(SIGUSR2);
 
   // Create NFC Manager and do initialize.
   NfcManager* pNfcManager = new NfcManager();
@@ -25,6 +44,28 @@ int main() {
   socket->initialize(msgHandler);
   socket->setSocketListener(service);
   msgHandler->setOutgoingSocket(socket);
+
+  // "nfcd --replay <file> [speed%] [iterations]" feeds a recorded NFA
+  // event log back into the stack callbacks instead of waiting for the
+  // controller. It needs the device build: the replayed events still run
+  // through the HAL and NFA libraries nfcd links, so there is no host build.
+  if (argc >= 3 && strcmp(argv[1], "--replay") == 0) {
+    int speedPercent = (argc >= 4) ? atoi(argv[3]) : 100;
+    int iterations = (argc >= 5) ? atoi(argv[4]) : 1;
+    pNfcManager->startEventReplay(argv[2], speedPercent, iterations);
+  } else if (argc >= 3 && strcmp(argv[1], "--bench") == 0) {
+    // "nfcd --bench <script>" replays taps under load up to a client in the
+    // daemon and exits with the outcome, see TapBenchmark.h.
+    TapBenchmark* bench = new TapBenchmark(pNfcManager);
+    if (!bench->load(argv[2]) || !bench->start(socket)) {
+      return EXIT_FAILURE;
+    }
+  } else if (NfcService::wasEnabled()) {
+    // Initialize the controller on the service thread while this thread
+    // listens for and accepts the client, which will turn NFC on again.
+    service->warmUp();
+  }
+
   socket->loop();
 
   //TODO delete NfcIpcSocket, NfcService
@@ -8,6 +8,7 @@
 #include "NfcManager.h"
 #include "SnepServer.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
 
 SnepClient::SnepClient()
  : mMessenger(NULL)
@@ -78,12 +79,12 @@ SnepClient::~SnepClient()
 void SnepClient::put(NdefMessage& msg)
 {
   if (!mMessenger) {
-    ALOGE("%s: no messenger", FUNC);
+    NFC_LOGE(SNEP, "%s: no messenger", FUNC);
     return;
   }
 
   if (mState != SnepClient::CONNECTED) {
-    ALOGE("%s: socket is not connected", FUNC);
+    NFC_LOGE(SNEP, "%s: socket is not connected", FUNC);
     return;
   }
 
@@ -92,7 +93,7 @@ void SnepClient::put(NdefMessage& msg)
     // Send request.
     mMessenger->sendMessage(*snepRequest);
   } else {
-    ALOGE("%s: get put request fail", FUNC);
+    NFC_LOGE(SNEP, "%s: get put request fail", FUNC);
   }
 
   // Get response.
@@ -110,12 +111,12 @@ void SnepClient::put(NdefMessage& msg)
 SnepMessage* SnepClient::get(NdefMessage& msg)
 {
   if (!mMessenger) {
-    ALOGE("%s: no messenger", FUNC);
+    NFC_LOGE(SNEP, "%s: no messenger", FUNC);
     return NULL;
   }
 
   if (mState != SnepClient::CONNECTED) {
-    ALOGE("%s: socket is not connected", FUNC);
+    NFC_LOGE(SNEP, "%s: socket is not connected", FUNC);
     return NULL;
   }
 
@@ -130,7 +131,7 @@ SnepMessage* SnepClient::get(NdefMessage& msg)
 bool SnepClient::connect()
 {
   if (mState != SnepClient::DISCONNECTED) {
-    ALOGE("%s: snep already connected", FUNC);
+    NFC_LOGE(SNEP, "%s: snep already connected", FUNC);
     return false;
   }
   mState = SnepClient::CONNECTING;
@@ -143,7 +144,7 @@ bool SnepClient::connect()
    */
   ILlcpSocket* socket = pINfcManager->createLlcpSocket(0, mMiu, mRwSize, 1024);
   if (!socket) {
-    ALOGE("%s: could not connect to socket", FUNC);
+    NFC_LOGE(SNEP, "%s: could not connect to socket", FUNC);
     mState = SnepClient::DISCONNECTED;
     return false;
   }
@@ -151,14 +152,14 @@ bool SnepClient::connect()
   bool ret = false;
   if (mPort == -1) {
     if (!socket->connectToService(mServiceName)) {
-      ALOGE("%s: could not connect to service (%s)", FUNC, mServiceName);
+      NFC_LOGE(SNEP, "%s: could not connect to service (%s)", FUNC, mServiceName);
       mState = SnepClient::DISCONNECTED;
       delete socket;
       return false;
     }
   } else {
     if (!socket->connectToSap(mPort)) {
-      ALOGE("%s: could not connect to sap (%d)", FUNC, mPort);
+      NFC_LOGE(SNEP, "%s: could not connect to sap (%d)", FUNC, mPort);
       mState = SnepClient::DISCONNECTED;
       delete socket;
       return false;
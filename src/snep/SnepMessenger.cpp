@@ -3,6 +3,7 @@
 
 #include "ILlcpSocket.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
 
 /**
  * The Simple NDEF Exchange Protocol (SNEP) is a request/response protocol.
@@ -24,7 +25,7 @@ SnepMessenger::~SnepMessenger()
 
 void SnepMessenger::sendMessage(SnepMessage& msg)
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SNEP, "%s: enter", FUNC);
 
   uint8_t remoteContinue;
   if (mIsClient) {
@@ -40,7 +41,7 @@ void SnepMessenger::sendMessage(SnepMessage& msg)
   mSocket->send(buf);
 
   if (length == buf.size()) {
-    ALOGD("%s: exit", FUNC);
+    NFC_LOGD(SNEP, "%s: exit", FUNC);
     return;
   }
 
@@ -52,12 +53,12 @@ void SnepMessenger::sendMessage(SnepMessage& msg)
 
   SnepMessage* snepResponse = SnepMessage::fromByteArray(responseBytes);
   if (!snepResponse) {
-    ALOGE("%s: invalid SNEP message", FUNC);
+    NFC_LOGE(SNEP, "%s: invalid SNEP message", FUNC);
     return;
   }
 
   if (snepResponse->getField() != remoteContinue) {
-    ALOGE("%s: invalid response from server (%d)", FUNC, snepResponse->getField());
+    NFC_LOGE(SNEP, "%s: invalid response from server (%d)", FUNC, snepResponse->getField());
     delete snepResponse;
     return;
   }
@@ -73,7 +74,7 @@ void SnepMessenger::sendMessage(SnepMessage& msg)
     offset += length;
   }
 
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(SNEP, "%s: exit", FUNC);
 }
 
 /**
@@ -81,7 +82,7 @@ void SnepMessenger::sendMessage(SnepMessage& msg)
  */
 SnepMessage* SnepMessenger::getMessage()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SNEP, "%s: enter", FUNC);
 
   std::vector<uint8_t> partial;
   std::vector<uint8_t> buffer;
@@ -119,7 +120,7 @@ SnepMessage* SnepMessenger::getMessage()
   int size = mSocket->receive(partial);
   if (size < 0 || size < HEADER_LENGTH) {
     if (!socketSend(fieldReject)) {
-      ALOGE("%s: snep message send fail", FUNC);
+      NFC_LOGE(SNEP, "%s: snep message send fail", FUNC);
       return NULL;
     }
   } else {
@@ -136,7 +137,7 @@ SnepMessage* SnepMessenger::getMessage()
 
   if (((requestVersion & 0xF0) >> 4) != SnepMessage::VERSION_MAJOR) {
     // Invalid protocol version; treat message as complete.
-    ALOGE("%s: invalid protocol version %d != %d",
+    NFC_LOGE(SNEP, "%s: invalid protocol version %d != %d",
        FUNC, ((requestVersion & 0xF0) >> 4), SnepMessage::VERSION_MAJOR);
     return new SnepMessage(requestVersion, requestField, 0, 0, NULL);
   }
@@ -144,7 +145,7 @@ SnepMessage* SnepMessenger::getMessage()
   bool doneReading = false;
   if (requestSize > readSize) {
     if (!socketSend(fieldContinue)) {
-      ALOGE("%s: snep message send fail", FUNC);
+      NFC_LOGE(SNEP, "%s: snep message send fail", FUNC);
       return NULL;
     }
   } else {
@@ -158,7 +159,7 @@ SnepMessage* SnepMessenger::getMessage()
     size = mSocket->receive(partial);
     if (size < 0) {
       if (!socketSend(fieldReject)) {
-        ALOGE("%s: snep message send fail", FUNC);
+        NFC_LOGE(SNEP, "%s: snep message send fail", FUNC);
         return NULL;
       }
     } else {
@@ -172,9 +173,9 @@ SnepMessage* SnepMessenger::getMessage()
 
   SnepMessage* snep = SnepMessage::fromByteArray(buffer);
   if (!snep)
-    ALOGE("%s: nadly formatted NDEF message, ignoring", FUNC);
+    NFC_LOGE(SNEP, "%s: nadly formatted NDEF message, ignoring", FUNC);
 
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(SNEP, "%s: exit", FUNC);
   return snep;
 }
 
@@ -7,6 +7,7 @@
 #include "SnepServer.h"
 #include "ISnepCallback.h"
 #include "NfcDebug.h"
+#include "NfcLog.h"
 
 // Well-known LLCP SAP Values defined by NFC forum.
 const char* SnepServer::DEFAULT_SERVICE_NAME = "urn:nfc:sn:snep";
@@ -14,11 +15,11 @@ const char* SnepServer::DEFAULT_SERVICE_NAME = "urn:nfc:sn:snep";
 // Connection thread, used to handle incoming connections.
 void* SnepConnectionThreadFunc(void* arg)
 {
-  ALOGD("%s: connection thread enter", FUNC);
+  NFC_LOGD(SNEP, "%s: connection thread enter", FUNC);
 
   SnepConnectionThread* pConnectionThread = reinterpret_cast<SnepConnectionThread*>(arg);
   if (!pConnectionThread) {
-    ALOGE("%s: invalid parameter", FUNC);
+    NFC_LOGE(SNEP, "%s: invalid parameter", FUNC);
     return NULL;
   }
 
@@ -36,7 +37,7 @@ void* SnepConnectionThreadFunc(void* arg)
   // TODO : is this correct ??
   delete pConnectionThread;
 
-  ALOGD("%s: connection thread exit", FUNC);
+  NFC_LOGD(SNEP, "%s: connection thread exit", FUNC);
   return NULL;
 }
 
@@ -61,7 +62,7 @@ void SnepConnectionThread::run()
 {
   pthread_t tid;
   if(pthread_create(&tid, NULL, SnepConnectionThreadFunc, this) != 0) {
-    ALOGE("%s: pthread_create fail", FUNC);
+    NFC_LOGE(SNEP, "%s: pthread_create fail", FUNC);
     abort();
   }
 }
@@ -78,7 +79,7 @@ void* snepServerThreadFunc(void* arg)
 {
   SnepServer* pSnepServer = reinterpret_cast<SnepServer*>(arg);
   if (!pSnepServer) {
-    ALOGE("%s: invalid parameter", FUNC);
+    NFC_LOGE(SNEP, "%s: invalid parameter", FUNC);
     return NULL;
   }
 
@@ -87,13 +88,13 @@ void* snepServerThreadFunc(void* arg)
   const int fragmentLength = pSnepServer->mFragmentLength;
 
   if (!serverSocket) {
-    ALOGE("%s: no server socket", FUNC);
+    NFC_LOGE(SNEP, "%s: no server socket", FUNC);
     return NULL;
   }
 
   while(pSnepServer->mServerRunning) {
     if (!serverSocket) {
-      ALOGD("%s: server socket shut down", FUNC);
+      NFC_LOGD(SNEP, "%s: server socket shut down", FUNC);
       return NULL;
     }
 
@@ -167,25 +168,25 @@ SnepServer::~SnepServer()
 
 void SnepServer::start()
 {
-  ALOGD("%s: enter", FUNC);
+  NFC_LOGD(SNEP, "%s: enter", FUNC);
 
   INfcManager* pINfcManager = NfcService::getNfcManager();
   mServerSocket = pINfcManager->createLlcpServerSocket(mServiceSap, mServiceName, mMiu, mRwSize, 1024);
 
   if (!mServerSocket) {
-    ALOGE("%s: cannot create llcp server socket", FUNC);
+    NFC_LOGE(SNEP, "%s: cannot create llcp server socket", FUNC);
     abort();
   }
 
   pthread_t tid;
   if(pthread_create(&tid, NULL, snepServerThreadFunc, this) != 0)
   {
-    ALOGE("%s: pthread_create failed", FUNC);
+    NFC_LOGE(SNEP, "%s: pthread_create failed", FUNC);
     abort();
   }
   mServerRunning = true;
 
-  ALOGD("%s: exit", FUNC);
+  NFC_LOGD(SNEP, "%s: exit", FUNC);
 }
 
 void SnepServer::stop()
@@ -204,7 +205,7 @@ void SnepServer::stop()
 bool SnepServer::handleRequest(SnepMessenger* messenger, ISnepCallback* callback)
 {
   if (!messenger || !callback) {
-    ALOGE("%s:: invalid parameter", FUNC);
+    NFC_LOGE(SNEP, "%s:: invalid parameter", FUNC);
     return false;
   }
 
@@ -216,7 +217,7 @@ bool SnepServer::handleRequest(SnepMessenger* messenger, ISnepCallback* callback
      * Response Codes : BAD REQUEST
      * The request could not be understood by the server due to malformed syntax.
      */
-    ALOGE("%s: bad snep message", FUNC);
+    NFC_LOGE(SNEP, "%s: bad snep message", FUNC);
     response = SnepMessage::getMessage(SnepMessage::RESPONSE_BAD_REQUEST);
     if (response) {
       messenger->sendMessage(*response);
@@ -231,7 +232,7 @@ bool SnepServer::handleRequest(SnepMessenger* messenger, ISnepCallback* callback
      * The server does not support, or refuses to support, the SNEP protocol
      * version that was used in the request message.
      */
-    ALOGE("%s: unsupported version", FUNC);
+    NFC_LOGE(SNEP, "%s: unsupported version", FUNC);
     response = SnepMessage::getMessage(SnepMessage::RESPONSE_UNSUPPORTED_VERSION);
 
   } else if (request->getField() == SnepMessage::REQUEST_GET) {
@@ -243,7 +244,7 @@ bool SnepServer::handleRequest(SnepMessenger* messenger, ISnepCallback* callback
     response = callback->doPut(ndef);
 
   } else {
-    ALOGE("%s: bad request", FUNC);
+    NFC_LOGE(SNEP, "%s: bad request", FUNC);
     response = SnepMessage::getMessage(SnepMessage::RESPONSE_BAD_REQUEST);
   }
 
@@ -252,7 +253,7 @@ bool SnepServer::handleRequest(SnepMessenger* messenger, ISnepCallback* callback
     messenger->sendMessage(*response);
     delete response;
   } else {
-    ALOGE("%s: no response message is generated", FUNC);
+    NFC_LOGE(SNEP, "%s: no response message is generated", FUNC);
     return false;
   }
 
@@ -0,0 +1,337 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * Host test of T2tReader and T2tNdefWriter against an in-memory NTAG213.
+ * Exits with the number of failed checks.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "T2tReader.h"
+#include "T2tNdefWriter.h"
+
+static int sFailures = 0;
+
+#define EXPECT(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: %s: expected %s\n", __FILE__, __LINE__, __FUNCTION__, #cond); \
+      sFailures++; \
+    } \
+  } while (0)
+
+static const uint32_t PAGE_SIZE = T2tReader::PAGE_SIZE;
+static const uint32_t NUM_PAGES = 45;        // NTAG213.
+static const uint32_t LOCK_TLV_OFFSET = 16;  // Lock Control TLV, then the NDEF TLV.
+static const uint32_t NDEF_TLV_OFFSET = 21;
+static const uint32_t LENGTH_PAGE = (NDEF_TLV_OFFSET + 1) / PAGE_SIZE;
+static const uint8_t UID[] = { 0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+
+/**
+ * A Type 2 tag answering READ, FAST_READ, GET_VERSION and WRITE, that can be
+ * torn out of the field before a given WRITE.
+ */
+class FakeTag : public T2tReader::Transport
+{
+public:
+  FakeTag(bool fastRead)
+    : mFastRead(fastRead)
+    , mMemory(NUM_PAGES * PAGE_SIZE, 0)
+    , mTearAtWrite(-1)
+    , mReactivations(0)
+  {
+    // UID0-2 and BCC0, UID3-6, BCC1 and lock bytes.
+    memcpy(&mMemory[0], UID, 3);
+    mMemory[3] = 0x88 ^ UID[0] ^ UID[1] ^ UID[2];
+    memcpy(&mMemory[4], UID + 3, 4);
+    mMemory[8] = UID[3] ^ UID[4] ^ UID[5] ^ UID[6];
+    // Capability container: 144-byte data area, read and write access.
+    mMemory[12] = 0xE1;
+    mMemory[13] = 0x10;
+    mMemory[14] = 0x12;
+    mMemory[15] = 0x00;
+    // Lock Control TLV, skipped on the way to the NDEF TLV.
+    const uint8_t lockTlv[] = { 0x01, 0x03, 0xA0, 0x0C, 0x34 };
+    memcpy(&mMemory[LOCK_TLV_OFFSET], lockTlv, sizeof(lockTlv));
+  }
+
+  void setNdef(const std::vector<uint8_t>& ndef)
+  {
+    mMemory[NDEF_TLV_OFFSET] = 0x03;
+    mMemory[NDEF_TLV_OFFSET + 1] = ndef.size();
+    std::copy(ndef.begin(), ndef.end(), mMemory.begin() + NDEF_TLV_OFFSET + 2);
+    mMemory[NDEF_TLV_OFFSET + 2 + ndef.size()] = 0xFE;
+  }
+
+  virtual TransceiveStatus transceive(const std::vector<uint8_t>& command,
+                                      std::vector<uint8_t>& response)
+  {
+    response.clear();
+    switch (command[0]) {
+      case 0x60: {  // GET_VERSION: NTAG213, or a NAK from an older tag.
+        static const uint8_t version[] = { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x0F, 0x03 };
+        if (mFastRead)
+          response.assign(version, version + sizeof(version));
+        else
+          response.push_back(0x00);
+        return TRANSCEIVE_OK;
+      }
+      case 0x30:    // READ: 4 pages, wrapping around.
+        for (uint32_t i = 0; i < 4 * PAGE_SIZE; i++) {
+          response.push_back(mMemory[(command[1] * PAGE_SIZE + i) % mMemory.size()]);
+        }
+        return TRANSCEIVE_OK;
+      case 0x3A:    // FAST_READ
+        if (!mFastRead || command[2] < command[1] || command[2] >= NUM_PAGES) {
+          response.push_back(0x00);
+          return TRANSCEIVE_OK;
+        }
+        response.assign(mMemory.begin() + command[1] * PAGE_SIZE,
+                        mMemory.begin() + (command[2] + 1) * PAGE_SIZE);
+        return TRANSCEIVE_OK;
+      case 0xA2:    // WRITE
+        if ((int) mWrites.size() == mTearAtWrite)
+          return TRANSCEIVE_TARGET_LOST;
+        mWrites.push_back(command[1]);
+        std::copy(command.begin() + 2, command.begin() + 2 + PAGE_SIZE,
+                  mMemory.begin() + command[1] * PAGE_SIZE);
+        response.push_back(0x0A);
+        return TRANSCEIVE_OK;
+      default:
+        response.push_back(0x00);
+        return TRANSCEIVE_OK;
+    }
+  }
+
+  virtual bool reactivate()
+  {
+    mReactivations++;
+    return true;
+  }
+
+  bool mFastRead;
+  std::vector<uint8_t> mMemory;
+  std::vector<uint8_t> mWrites;  // Pages written, in order.
+  int mTearAtWrite;              // Index of the WRITE the tag is lost at.
+  int mReactivations;
+};
+
+/**
+ * A short Text record of textLen bytes of fill.
+ */
+static std::vector<uint8_t> textNdef(uint32_t textLen, char fill)
+{
+  const uint8_t header[] = { 0xD1, 0x01, (uint8_t) (textLen + 3), 'T', 0x02, 'e', 'n' };
+  std::vector<uint8_t> ndef(header, header + sizeof(header));
+  ndef.insert(ndef.end(), textLen, fill);
+  return ndef;
+}
+
+/**
+ * NDEF length in the tag memory.
+ */
+static uint8_t tagLength(const FakeTag& tag)
+{
+  return tag.mMemory[NDEF_TLV_OFFSET + 1];
+}
+
+static std::vector<uint8_t> readBack(FakeTag& tag)
+{
+  T2tReader reader(tag);
+  std::vector<uint8_t> ndef;
+  EXPECT(reader.readNdef(ndef));
+  return ndef;
+}
+
+static void testFastRead()
+{
+  FakeTag tag(true);
+  std::vector<uint8_t> ndef = textNdef(33, 'a');
+  tag.setNdef(ndef);
+
+  T2tReader reader(tag);
+  std::vector<uint8_t> read;
+  EXPECT(reader.readNdef(read));
+  EXPECT(read == ndef);
+  // GET_VERSION, then the header and the read-ahead cover the message.
+  EXPECT(reader.getRoundTrips() == 2);
+  EXPECT(tag.mReactivations == 0);
+}
+
+static void testRead()
+{
+  FakeTag tag(false);
+  std::vector<uint8_t> ndef = textNdef(33, 'a');
+  tag.setNdef(ndef);
+
+  T2tReader reader(tag);
+  std::vector<uint8_t> read;
+  EXPECT(reader.readNdef(read));
+  EXPECT(read == ndef);
+  // GET_VERSION NAKed, then READ of pages 0, 4, 8 and 12.
+  EXPECT(reader.getRoundTrips() == 5);
+  EXPECT(tag.mReactivations == 1);
+}
+
+static void testVersionKept()
+{
+  FakeTag tag(false);
+  std::vector<uint8_t> ndef = textNdef(33, 'a');
+  tag.setNdef(ndef);
+
+  T2tReader reader(tag);
+  std::vector<uint8_t> read;
+  reader.setUid(std::vector<uint8_t>(UID, UID + sizeof(UID)));
+  EXPECT(reader.readNdef(read));
+  EXPECT(reader.getRoundTrips() == 5);
+
+  // The NAK to GET_VERSION is remembered for the UID: READs only, and no
+  // other reactivation.
+  reader.reset();
+  EXPECT(reader.readNdef(read));
+  EXPECT(read == ndef);
+  EXPECT(reader.getRoundTrips() == 4);
+  EXPECT(tag.mReactivations == 1);
+
+  // Another tag is asked again.
+  std::vector<uint8_t> other(UID, UID + sizeof(UID));
+  other[6] ^= 0xFF;
+  reader.setUid(other);
+  EXPECT(!reader.readNdef(read));
+  EXPECT(tag.mReactivations == 2);
+}
+
+static void testUid()
+{
+  FakeTag tag(true);
+  tag.setNdef(textNdef(33, 'a'));
+
+  T2tReader reader(tag);
+  std::vector<uint8_t> read;
+  reader.setUid(std::vector<uint8_t>(UID, UID + sizeof(UID)));
+  EXPECT(reader.readNdef(read));
+
+  // Another tag: its image is not trusted.
+  std::vector<uint8_t> other(UID, UID + sizeof(UID));
+  other[6] ^= 0xFF;
+  reader.setUid(other);
+  EXPECT(!reader.readNdef(read));
+}
+
+static void testDiffWrite()
+{
+  FakeTag tag(true);
+  std::vector<uint8_t> ndef = textNdef(33, 'a');
+  tag.setNdef(ndef);
+
+  T2tReader reader(tag);
+  std::vector<uint8_t> read;
+  EXPECT(reader.readNdef(read));
+
+  // The same message writes nothing.
+  T2tNdefWriter same(reader);
+  EXPECT(same.writeNdef(ndef));
+  EXPECT(same.getPagesWritten() == 0);
+  EXPECT(tag.mWrites.empty());
+
+  // Only the last text byte, in page 15, changes.
+  std::vector<uint8_t> changed(ndef);
+  changed.back() = 'b';
+  T2tNdefWriter writer(reader);
+  EXPECT(writer.writeNdef(changed));
+  EXPECT(writer.getPagesWritten() == 3);
+  EXPECT(tag.mWrites.size() == 3);
+  if (tag.mWrites.size() == 3) {
+    // Length cleared, data page, length set last.
+    EXPECT(tag.mWrites[0] == LENGTH_PAGE);
+    EXPECT(tag.mWrites[1] == 15);
+    EXPECT(tag.mWrites[2] == LENGTH_PAGE);
+  }
+  EXPECT(readBack(tag) == changed);
+}
+
+static void testShorterWrite()
+{
+  FakeTag tag(true);
+  tag.setNdef(textNdef(33, 'a'));
+
+  T2tReader reader(tag);
+  std::vector<uint8_t> read;
+  EXPECT(reader.readNdef(read));
+
+  // Same first 20 bytes; a Terminator TLV ends the shorter message.
+  std::vector<uint8_t> shorter = textNdef(13, 'a');
+  T2tNdefWriter writer(reader);
+  EXPECT(writer.writeNdef(shorter));
+  EXPECT(!tag.mWrites.empty());
+  if (!tag.mWrites.empty()) {
+    EXPECT(tag.mWrites.front() == LENGTH_PAGE);
+    EXPECT(tag.mWrites.back() == LENGTH_PAGE);
+  }
+  EXPECT(tag.mMemory[NDEF_TLV_OFFSET + 2 + shorter.size()] == 0xFE);
+  EXPECT(readBack(tag) == shorter);
+}
+
+static void testReservedArea()
+{
+  FakeTag tag(true);
+  std::vector<uint8_t> ndef = textNdef(33, 'a');
+  tag.setNdef(ndef);
+  // Memory Control TLV in place of the Lock Control TLV: 4 bytes reserved
+  // at byte 48, inside the data area.
+  const uint8_t memoryTlv[] = { 0x02, 0x03, 0x30, 0x04, 0x34 };
+  memcpy(&tag.mMemory[LOCK_TLV_OFFSET], memoryTlv, sizeof(memoryTlv));
+
+  T2tReader reader(tag);
+  std::vector<uint8_t> read;
+  EXPECT(!reader.readNdef(read));
+
+  std::vector<uint8_t> changed(ndef);
+  changed.back() = 'b';
+  T2tNdefWriter writer(reader);
+  EXPECT(!writer.writeNdef(changed));
+  EXPECT(tag.mWrites.empty());
+}
+
+static void testTornWrite()
+{
+  FakeTag tag(true);
+  tag.setNdef(textNdef(33, 'a'));
+
+  T2tReader reader(tag);
+  std::vector<uint8_t> read;
+  EXPECT(reader.readNdef(read));
+
+  // Lost after the length is cleared and one data page is written.
+  tag.mTearAtWrite = 2;
+  T2tNdefWriter writer(reader);
+  EXPECT(!writer.writeNdef(textNdef(33, 'b')));
+  EXPECT(tagLength(tag) == 0);
+  EXPECT(reader.getRoundTrips() == 0);
+
+  // The tag holds an empty message rather than a mix of both.
+  T2tReader again(tag);
+  EXPECT(again.readNdef(read));
+  EXPECT(read.empty());
+}
+
+int main()
+{
+  testFastRead();
+  testRead();
+  testVersionKept();
+  testUid();
+  testDiffWrite();
+  testShorterWrite();
+  testReservedArea();
+  testTornWrite();
+
+  if (sFailures)
+    fprintf(stderr, "%d check(s) failed\n", sFailures);
+  else
+    printf("all checks passed\n");
+  return sFailures;
+}